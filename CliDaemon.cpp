@@ -0,0 +1,352 @@
+
+#include "CliDaemon.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QRegExp>
+#include <QTimer>
+#include <memory>
+#include <stdexcept>
+#include "CommandLine.h"
+#include "ConsoleBatch.h"
+#include "PageInfo.h"
+#include "Utils.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// A job description is expected to fit into a single line of that many bytes.
+const qint64 MAX_JOB_LINE_LENGTH = 4 << 20;
+
+// Limits on how many parsed projects and thumbnail caches to keep around.
+const size_t MAX_CACHED_PROJECTS = 16;
+const size_t MAX_THUMBNAIL_CACHES = 8;
+
+QString absolutePath(const QJsonValue& value, const char* what) {
+  if (!value.isString() || value.toString().isEmpty()) {
+    throw std::runtime_error(std::string("Expected a path in \"") + what + "\"");
+  }
+
+  return QFileInfo(value.toString()).absoluteFilePath();
+}
+
+/**
+ * Removes the directories makeDirectory() has created, as long as nothing was put there.
+ */
+void removeDirectory(const QString& path, const QString& topmost) {
+  if (topmost.isEmpty()) {
+    return;
+  }
+
+  QString dir(QDir::cleanPath(path));
+  while (QDir().rmdir(dir) && (dir != topmost)) {
+    dir = QFileInfo(dir).path();
+  }
+}
+
+/**
+ * Creates a directory along with its missing parents.
+ *
+ * \return The topmost directory that had to be created, or an empty string if it existed.
+ */
+QString makeDirectory(const QString& path) {
+  QString topmost;
+  for (QFileInfo dir(QDir::cleanPath(path)); !dir.exists(); dir.setFile(dir.path())) {
+    topmost = dir.filePath();
+  }
+  if (!QDir().mkpath(path)) {
+    removeDirectory(path, topmost);
+    throw std::runtime_error("Unable to create the output directory");
+  }
+
+  return topmost;
+}
+
+/**
+ * Whether a socket left behind under that name may be removed.  Those of other users may not.
+ */
+bool mayRemoveSocket(const QString& socket_name) {
+#ifdef Q_OS_UNIX
+  // That's where QLocalServer puts sockets given by name rather than path.
+  const QString path(QDir::isAbsolutePath(socket_name) ? socket_name : QDir(QDir::tempPath()).filePath(socket_name));
+  struct stat st;
+  if (lstat(QFile::encodeName(path).constData(), &st) != 0) {
+    return true;
+  }
+
+  return st.st_uid == getuid();
+#else
+  return true;
+#endif
+}
+}  // namespace
+
+CliDaemon::CliDaemon(QObject* parent) : QObject(parent), m_jobScheduled(false) {
+  connect(&m_server, &QLocalServer::newConnection, this, &CliDaemon::acceptConnections);
+}
+
+CliDaemon::~CliDaemon() = default;
+
+bool CliDaemon::listen(const QString& socket_name, QString* error) {
+  // Jobs read and write files with the daemon's privileges, so only its user may submit them.
+  m_server.setSocketOptions(QLocalServer::UserAccessOption);
+
+  if (m_server.listen(socket_name)) {
+    return true;
+  }
+
+  if (m_server.serverError() == QAbstractSocket::AddressInUseError) {
+    // Either another daemon is running or a previous one has left its socket behind.
+    QLocalSocket probe;
+    probe.connectToServer(socket_name);
+    if (!probe.waitForConnected(1000) && mayRemoveSocket(socket_name)) {
+      QLocalServer::removeServer(socket_name);
+      if (m_server.listen(socket_name)) {
+        return true;
+      }
+    }
+  }
+
+  if (error) {
+    *error = m_server.errorString();
+  }
+
+  return false;
+}
+
+void CliDaemon::acceptConnections() {
+  while (QLocalSocket* client = m_server.nextPendingConnection()) {
+    connect(client, &QLocalSocket::readyRead, this, [this, client]() { readJobs(client); });
+    connect(client, &QLocalSocket::disconnected, client, &QObject::deleteLater);
+  }
+}
+
+void CliDaemon::readJobs(QLocalSocket* client) {
+  while (client->canReadLine()) {
+    const QByteArray line(client->readLine().trimmed());
+    if (line.isEmpty()) {
+      continue;
+    }
+
+    QJsonParseError parse_error;
+    const QJsonDocument doc(QJsonDocument::fromJson(line, &parse_error));
+    if (!doc.isObject()) {
+      const QString reason = (parse_error.error != QJsonParseError::NoError) ? parse_error.errorString()
+                                                                             : QString("a job must be a JSON object");
+      send(client, QJsonValue(), {{"event", "failed"}, {"error", "Malformed job: " + reason}});
+      continue;
+    }
+
+    Job job;
+    job.client = client;
+    job.description = doc.object();
+    job.id = job.description.value("id");
+    m_jobs.push_back(job);
+    send(client, job.id, {{"event", "queued"}, {"position", static_cast<int>(m_jobs.size())}});
+  }
+
+  if (client->bytesAvailable() > MAX_JOB_LINE_LENGTH) {
+    send(client, QJsonValue(), {{"event", "failed"}, {"error", "Job description is too long"}});
+    client->disconnectFromServer();
+  }
+
+  scheduleNextJob();
+}
+
+void CliDaemon::scheduleNextJob() {
+  if (m_jobScheduled || m_jobs.empty()) {
+    return;
+  }
+
+  // Jobs run from the event loop, so that new connections and jobs
+  // get accepted between them.
+  m_jobScheduled = true;
+  QTimer::singleShot(0, this, &CliDaemon::processNextJob);
+}
+
+void CliDaemon::processNextJob() {
+  m_jobScheduled = false;
+  if (m_jobs.empty()) {
+    return;
+  }
+
+  const Job job(m_jobs.front());
+  m_jobs.pop_front();
+
+  // Nobody is waiting for the results of a client that has gone away.
+  if (job.client) {
+    runJob(job);
+  }
+
+  scheduleNextJob();
+}
+
+void CliDaemon::runJob(const Job& job) {
+  QElapsedTimer timer;
+  timer.start();
+  send(job.client, job.id, {{"event", "started"}});
+
+  QString output_directory;
+  QString created_directory;
+  try {
+    const QStringList args(toArguments(job.description));
+    // The parser insists on the last argument being an existing directory.
+    output_directory = args.last();
+    created_directory = makeDirectory(output_directory);
+
+    const CommandLine cli(args, false);
+    if (cli.isError()) {
+      throw std::runtime_error("Invalid options: " + cli.errors().join("; ").toStdString());
+    }
+    CommandLine::replace(cli);
+
+    const ConsoleBatch::ThumbnailCacheFactory thumbnail_cache_factory
+        = [this](const QString& output_directory) { return thumbnailCache(output_directory); };
+
+    std::unique_ptr<ConsoleBatch> batch;
+    if (!cli.projectFile().isEmpty()) {
+      batch = std::make_unique<ConsoleBatch>(loadProject(cli.projectFile()), thumbnail_cache_factory);
+    } else if (!cli.images().empty()) {
+      batch = std::make_unique<ConsoleBatch>(cli.images(), cli.outputDirectory(), cli.getLayoutDirection(),
+                                             thumbnail_cache_factory);
+    } else {
+      throw std::runtime_error("No images to process");
+    }
+
+    const QPointer<QLocalSocket> client(job.client);
+    batch->process([&client, &job](int filter_idx, int page_idx, int num_pages, const PageInfo& page) {
+      send(client, job.id,
+           {{"event", "progress"},
+            {"filter", filter_idx + 1},
+            {"page", page_idx + 1},
+            {"pages", num_pages},
+            {"image", page.imageId().filePath()}});
+    });
+
+    if (cli.hasOutputProject()) {
+      batch->saveProject(cli.outputProjectFile());
+    }
+  } catch (const std::exception& e) {
+    // Don't leave an empty output directory behind, for instance when the options were rejected.
+    removeDirectory(output_directory, created_directory);
+    send(job.client, job.id,
+         {{"event", "failed"}, {"error", QString::fromLocal8Bit(e.what())}, {"elapsed_ms", timer.elapsed()}});
+
+    return;
+  }
+
+  send(job.client, job.id, {{"event", "finished"}, {"elapsed_ms", timer.elapsed()}});
+}  // CliDaemon::runJob
+
+QStringList CliDaemon::toArguments(const QJsonObject& description) {
+  // The first argument is skipped by the parser.
+  QStringList args(QCoreApplication::applicationFilePath());
+
+  const QJsonObject options(description.value("options").toObject());
+  for (auto it = options.begin(); it != options.end(); ++it) {
+    const QString& key = it.key();
+    const QJsonValue& value = it.value();
+    if (key == "daemon") {
+      throw std::runtime_error("The daemon option is not allowed in jobs");
+    }
+
+    if (value.isBool()) {
+      if (value.toBool()) {
+        args.push_back("--" + key);
+      }
+    } else if (value.isDouble()) {
+      args.push_back(QString("--%1=%2").arg(key).arg(value.toDouble()));
+    } else if (value.isString()) {
+      args.push_back(QString("--%1=%2").arg(key, value.toString()));
+    } else {
+      throw std::runtime_error("Unsupported value of option " + key.toStdString());
+    }
+  }
+
+  const bool has_project = description.contains("project");
+  if (has_project == description.contains("images")) {
+    throw std::runtime_error("A job needs either \"images\" or \"project\"");
+  }
+
+  if (has_project) {
+    const QString project(absolutePath(description.value("project"), "project"));
+    if (!QRegExp(".*\\.ScanTailor$", Qt::CaseInsensitive).exactMatch(project)) {
+      throw std::runtime_error("A project file must have the .ScanTailor extension");
+    }
+    args.push_back(project);
+  } else {
+    // Absolute paths also prevent file names from being taken for options.
+    for (const QJsonValue& image : description.value("images").toArray()) {
+      args.push_back(absolutePath(image, "images"));
+    }
+  }
+
+  // The output directory goes last.  runJob() creates it.
+  args.push_back(absolutePath(description.value("output"), "output"));
+
+  return args;
+}  // CliDaemon::toArguments
+
+QDomDocument CliDaemon::loadProject(const QString& path) {
+  const QFileInfo file_info(path);
+  const QString key(file_info.canonicalFilePath());
+  const auto it = m_projects.find(key);
+  if ((it != m_projects.end()) && (it->second.lastModified == file_info.lastModified())
+      && (it->second.size == file_info.size())) {
+    return it->second.document;
+  }
+
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    throw std::runtime_error("Unable to open the project file.");
+  }
+
+  QDomDocument doc;
+  if (!doc.setContent(&file)) {
+    throw std::runtime_error("The project file is broken.");
+  }
+
+  if ((it == m_projects.end()) && (m_projects.size() >= MAX_CACHED_PROJECTS)) {
+    m_projects.clear();
+  }
+  m_projects[key] = CachedProject{file_info.lastModified(), file_info.size(), doc};
+
+  return doc;
+}
+
+intrusive_ptr<ThumbnailPixmapCache> CliDaemon::thumbnailCache(const QString& output_directory) {
+  const QString key(QDir(output_directory).absolutePath());
+  const auto it = m_thumbnailCaches.find(key);
+  if (it != m_thumbnailCaches.end()) {
+    return it->second;
+  }
+
+  if (m_thumbnailCaches.size() >= MAX_THUMBNAIL_CACHES) {
+    m_thumbnailCaches.clear();
+  }
+
+  const intrusive_ptr<ThumbnailPixmapCache> cache(Utils::createThumbnailCache(output_directory));
+  m_thumbnailCaches[key] = cache;
+
+  return cache;
+}
+
+void CliDaemon::send(QLocalSocket* client, const QJsonValue& id, QJsonObject message) {
+  if (!client || (client->state() != QLocalSocket::ConnectedState)) {
+    return;
+  }
+
+  message.insert("id", id);
+  client->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+  client->write("\n");
+  // Jobs block the event loop, so progress would otherwise be held back until the job is over.
+  client->flush();
+}
@@ -0,0 +1,103 @@
+
+#ifndef SCANTAILOR_CLIDAEMON_H
+#define SCANTAILOR_CLIDAEMON_H
+
+#include <QDateTime>
+#include <QDomDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QLocalServer>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+#include <deque>
+#include <map>
+#include "NonCopyable.h"
+#include "ThumbnailPixmapCache.h"
+#include "intrusive_ptr.h"
+
+class QLocalSocket;
+
+/**
+ * \brief Processes scantailor-cli jobs coming through a local socket.
+ *
+ * Clients send jobs as JSON objects, one per line:
+ * \code
+ * {"id": "a", "images": ["/in/1.tif", "/in/2.tif"], "output": "/out", "options": {"color-mode": "mixed"}}
+ * {"id": "b", "project": "/in/book.ScanTailor", "output": "/out", "options": {"verbose": true}}
+ * \endcode
+ * The options are the command line ones, without the leading dashes.  Switches take true.
+ *
+ * Every message the daemon sends back is a JSON object on its own line as well,
+ * carrying the job's id and an "event" being one of "queued", "started", "progress",
+ * "finished" or "failed".  Jobs are processed one at a time, in the order they arrive.
+ *
+ * Compared to running scantailor-cli for every job, jobs share the worker threads,
+ * the thumbnail caches and the parsed project files.
+ */
+class CliDaemon : public QObject {
+  Q_OBJECT
+  DECLARE_NON_COPYABLE(CliDaemon)
+
+ public:
+  explicit CliDaemon(QObject* parent = nullptr);
+
+  ~CliDaemon() override;
+
+  /**
+   * \brief Starts accepting connections.
+   *
+   * Only the user running the daemon may connect.  A socket left behind by a previous
+   * daemon gets replaced, unless it belongs to another user.
+   *
+   * \param socket_name Either a name or a path of a Unix-domain socket.
+   * \param error Receives the reason of a failure.
+   * \return Whether the daemon is listening.
+   */
+  bool listen(const QString& socket_name, QString* error);
+
+ private:
+  struct Job {
+    QPointer<QLocalSocket> client;
+    QJsonValue id;
+    QJsonObject description;
+  };
+
+  struct CachedProject {
+    QDateTime lastModified;
+    qint64 size;
+    QDomDocument document;
+  };
+
+  void acceptConnections();
+
+  void readJobs(QLocalSocket* client);
+
+  void scheduleNextJob();
+
+  void processNextJob();
+
+  void runJob(const Job& job);
+
+  /**
+   * Converts a job description to scantailor-cli arguments.  The last one is the output
+   * directory, which isn't created here.
+   */
+  static QStringList toArguments(const QJsonObject& description);
+
+  QDomDocument loadProject(const QString& path);
+
+  intrusive_ptr<ThumbnailPixmapCache> thumbnailCache(const QString& output_directory);
+
+  static void send(QLocalSocket* client, const QJsonValue& id, QJsonObject message);
+
+  QLocalServer m_server;
+  std::deque<Job> m_jobs;
+  bool m_jobScheduled;
+  std::map<QString, CachedProject> m_projects;
+  std::map<QString, intrusive_ptr<ThumbnailPixmapCache>> m_thumbnailCaches;
+};
+
+
+#endif  // SCANTAILOR_CLIDAEMON_H
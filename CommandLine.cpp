@@ -21,6 +21,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 
 #include <QDir>
 #include <QMap>
@@ -41,6 +42,11 @@ void CommandLine::set(const CommandLine& cl) {
   m_globalInstance.setGlobal();
 }
 
+void CommandLine::replace(const CommandLine& cl) {
+  m_globalInstance = cl;
+  m_globalInstance.setGlobal();
+}
+
 bool CommandLine::parseCli(const QStringList& argv) {
   QRegExp rx("^--([^=]+)=(.*)$");
   QRegExp rx_switch("^--([^=]+)$");
@@ -115,6 +121,10 @@ bool CommandLine::parseCli(const QStringList& argv) {
   opts << "tiff-force-rgb";
   opts << "tiff-force-grayscale";
   opts << "tiff-force-keep-color-space";
+  opts << "daemon";
+  opts << "headless-profile";
+  opts << "spill-directory";
+  opts << "spill-threshold";
 
   QMap<QString, QString> shortMap;
   shortMap["h"] = "help";
@@ -132,32 +142,28 @@ bool CommandLine::parseCli(const QStringList& argv) {
     if (rx.exactMatch(argv[i])) {
       QString key = rx.cap(1);
       if (!opts.contains(key)) {
-        m_error = true;
-        std::cout << "Unknown option '" << key.toStdString() << "'" << std::endl;
+        reportError("Unknown option '" + key + "'");
         continue;
       }
       m_options[key] = rx.cap(2);
     } else if (rx_switch.exactMatch(argv[i])) {
       QString key = rx_switch.cap(1);
       if (!opts.contains(key)) {
-        m_error = true;
-        std::cout << "Unknown switch '" << key.toStdString() << "'" << std::endl;
+        reportError("Unknown switch '" + key + "'");
         continue;
       }
       m_options[key] = "true";
     } else if (rx_short.exactMatch(argv[i])) {
       QString key = shortMap[rx_short.cap(1)];
       if (key == "") {
-        std::cout << "Unknown option: '" << rx_short.cap(1).toStdString() << "'" << std::endl;
-        m_error = true;
+        reportError("Unknown option: '" + rx_short.cap(1) + "'");
         continue;
       }
       m_options[key] = rx_short.cap(2);
     } else if (rx_short_switch.exactMatch(argv[i])) {
       QString key = shortMap[rx_short_switch.cap(1)];
       if (key == "") {
-        std::cout << "Unknown switch: '" << rx_short_switch.cap(1).toStdString() << "'" << std::endl;
-        m_error = true;
+        reportError("Unknown switch: '" + rx_short_switch.cap(1) + "'");
         continue;
       }
       m_options[key] = "true";
@@ -172,8 +178,7 @@ bool CommandLine::parseCli(const QStringList& argv) {
         if (file.isDir()) {
           CommandLine::m_outputDirectory = file.filePath();
         } else {
-          std::cout << "Error: Last argument must be an existing directory" << std::endl;
-          exit(1);
+          reportError("Error: Last argument must be an existing directory");
         }
       } else if (file.filePath() == "-") {
         // file names from stdin
@@ -209,6 +214,12 @@ bool CommandLine::parseCli(const QStringList& argv) {
   return m_error;
 }  // CommandLine::parseCli
 
+void CommandLine::reportError(const QString& message) {
+  std::cout << message.toLocal8Bit().constData() << std::endl;
+  m_error = true;
+  m_errors.push_back(message);
+}
+
 void CommandLine::addImage(const QString& path) {
   QFileInfo file(path);
   m_files.push_back(file);
@@ -245,6 +256,7 @@ void CommandLine::setup() {
   m_pageDetectionBox = fetchPageDetectionBox();
   m_pageDetectionTolerance = fetchPageDetectionTolerance();
   m_defaultNull = fetchDefaultNull();
+  m_spillThreshold = fetchSpillThreshold();
 
   QRegExp exp(".*(tif|tiff|jpg|jpeg|bmp|gif|png|pbm|pgm|ppm|xbm|xpm)$", Qt::CaseInsensitive);
   for (auto& m_file : m_files) {
@@ -274,6 +286,7 @@ void CommandLine::printHelp() {
   std::cout << "\t2) scantailor <project_file>" << std::endl;
   std::cout << "\t3) scantailor-cli [options] <images|directory|-> <output_directory>" << std::endl;
   std::cout << "\t4) scantailor-cli [options] <project_file> [output_directory]" << std::endl;
+  std::cout << "\t5) scantailor-cli --daemon=<socket>" << std::endl;
   std::cout << std::endl;
   std::cout << "1)" << std::endl;
   std::cout << "\tstart ScanTailor's GUI interface" << std::endl;
@@ -286,6 +299,11 @@ void CommandLine::printHelp() {
   std::cout << "\tbatch processing project from command line; no GUI" << std::endl;
   std::cout << "\tif output_directory is specified as last argument, it overwrites the one in project file"
             << std::endl;
+  std::cout << "5)" << std::endl;
+  std::cout << "\tkeep running and process jobs coming through a local socket; no GUI" << std::endl;
+  std::cout << "\tjobs are JSON objects, one per line: {\"id\": ..., \"images\": [...] or \"project\": ...," << std::endl;
+  std::cout << "\t\"output\": <output_directory>, \"options\": {<option>: <value>, ...}}" << std::endl;
+  std::cout << "\toptions are the same as below, without the leading dashes; switches take true" << std::endl;
   std::cout << std::endl;
   std::cout << "Options:" << std::endl;
   std::cout << "\t--help, -h" << std::endl;
@@ -370,8 +388,12 @@ void CommandLine::printHelp() {
   std::cout << "\t--window-title=WindowTitle\t\t-- default: project name" << std::endl;
   std::cout << "\t--page-detection-box=<widthxheight>\t\t-- in mm" << std::endl;
   std::cout << "\t\t--page-detection-tolerance=<0.0..1.0>\t-- default: 0.1" << std::endl;
-  std::cout << "\t--disable-check-output\t\t\t-- don't check if page is valid when switching to step 6";
+  std::cout << "\t--disable-check-output\t\t\t-- don't check if page is valid when switching to step 6" << std::endl;
+  std::cout << "\t--headless-profile\t\t\t-- don't write thumbnails, picture masks and speckles;" << std::endl;
+  std::cout << "\t\t\t\t\t\t   the GUI re-creates them when the project is opened";
   std::cout << std::endl;
+  std::cout << "\t--spill-directory=<path>\t\t-- keep large intermediate images in temporary files there" << std::endl;
+  std::cout << "\t\t--spill-threshold=<MiB>\t\t-- default: 64" << std::endl;
 }  // CommandLine::printHelp
 
 page_split::LayoutType CommandLine::fetchLayoutType() {
@@ -592,8 +614,9 @@ QRectF CommandLine::fetchContentRect() {
     return QRectF(rx.cap(1).toFloat(), rx.cap(2).toFloat(), rx.cap(3).toFloat(), rx.cap(4).toFloat());
   }
 
-  std::cout << "invalid --content-box=" << m_options["content-box"].toLatin1().constData() << std::endl;
-  exit(1);
+  reportError("invalid --content-box=" + m_options["content-box"]);
+
+  return QRectF();
 }
 
 double CommandLine::fetchContentDeviation() {
@@ -619,8 +642,8 @@ CommandLine::Orientation CommandLine::fetchOrientation() {
   } else if (cli_orient == "upsidedown") {
     orient = UPSIDEDOWN;
   } else {
-    std::cout << "Wrong orientation " << m_options["orientation"].toLatin1().constData() << std::endl;
-    exit(1);
+    reportError("Wrong orientation " + m_options["orientation"]);
+    orient = TOP;
   }
 
   return orient;
@@ -748,7 +771,7 @@ QString CommandLine::fetchWindowTitle() const {
   return "";
 }
 
-QSizeF CommandLine::fetchPageDetectionBox() const {
+QSizeF CommandLine::fetchPageDetectionBox() {
   if (!hasPageDetectionBox()) {
     return QSizeF();
   }
@@ -758,8 +781,9 @@ QSizeF CommandLine::fetchPageDetectionBox() const {
     return QSizeF(rx.cap(1).toFloat(), rx.cap(2).toFloat());
   }
 
-  std::cout << "invalid --page-detection-box=" << m_options["page-detection-box"].toLatin1().constData() << std::endl;
-  exit(1);
+  reportError("invalid --page-detection-box=" + m_options["page-detection-box"]);
+
+  return QSizeF();
 }
 
 double CommandLine::fetchPageDetectionTolerance() const {
@@ -779,3 +803,25 @@ bool CommandLine::fetchDefaultNull() {
 
   return m_defaultNull;
 }
+
+size_t CommandLine::fetchSpillThreshold() {
+  if (!contains("spill-threshold")) {
+    return 0;
+  }
+  if (!hasSpillDirectory()) {
+    reportError("--spill-threshold requires --spill-directory");
+
+    return 0;
+  }
+
+  // A threshold of 0, as a typo like "64M" would yield, would spill even the tiniest images.
+  bool ok = false;
+  const qulonglong mib = m_options["spill-threshold"].toULongLong(&ok);
+  if (!ok || (mib == 0) || (mib > (std::numeric_limits<size_t>::max() >> 20))) {
+    reportError("invalid --spill-threshold=" + m_options["spill-threshold"] + ", expected a positive number of MiB");
+
+    return 0;
+  }
+
+  return static_cast<size_t>(mib) << 20;
+}
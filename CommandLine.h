@@ -58,6 +58,13 @@ class CommandLine {
 
   static void set(const CommandLine& cl);
 
+  /**
+   * \brief Same as set(), except it may be called repeatedly.
+   *
+   * Meant for the daemon mode, where every job comes with its own command line.
+   */
+  static void replace(const CommandLine& cl);
+
   explicit CommandLine(const QStringList& argv, bool g = true)
       : m_error(false), m_gui(g), m_global(false), m_defaultNull(false) {
     CommandLine::parseCli(argv);
@@ -69,6 +76,11 @@ class CommandLine {
 
   bool isError() const { return m_error; }
 
+  /**
+   * \brief Describes the problems that made isError() return true.
+   */
+  const QStringList& errors() const { return m_errors; }
+
   const std::vector<ImageFileInfo>& images() const { return m_images; }
 
   const QString& outputDirectory() const { return m_outputDirectory; }
@@ -169,6 +181,26 @@ class CommandLine {
 
   bool hasDisableCheckOutput() const { return contains("disable-check-output"); }
 
+  /**
+   * Batch processing omits the files only the GUI makes use of.
+   */
+  bool isHeadlessProfile() const { return !m_gui && contains("headless-profile"); }
+
+  bool hasDaemon() const { return contains("daemon") && !m_options["daemon"].isEmpty(); }
+
+  QString getDaemonSocket() const { return m_options["daemon"]; }
+
+  bool hasSpillDirectory() const { return contains("spill-directory") && !m_options["spill-directory"].isEmpty(); }
+
+  QString getSpillDirectory() const { return m_options["spill-directory"]; }
+
+  bool hasSpillThreshold() const { return contains("spill-threshold") && !m_options["spill-threshold"].isEmpty(); }
+
+  /**
+   * \brief The size in bytes, starting from which image buffers get spilled.
+   */
+  size_t getSpillThreshold() const { return m_spillThreshold; }
+
   page_split::LayoutType getLayout() const { return m_layoutType; }
 
   Qt::LayoutDirection getLayoutDirection() const { return m_layoutDirection; }
@@ -240,6 +272,7 @@ class CommandLine {
 
   static CommandLine m_globalInstance;
   bool m_error;
+  QStringList m_errors;
   bool m_gui;
   bool m_global;
   QString m_language;
@@ -287,9 +320,16 @@ class CommandLine {
   double m_despeckleLevel{2.0};
   output::DepthPerception m_depthPerception;
   float m_matchLayoutTolerance{0.2f};
+  size_t m_spillThreshold{0};
 
   bool parseCli(const QStringList& argv);
 
+  /**
+   * Prints the message and marks the command line as erroneous, instead of exiting,
+   * so that a daemon may survive a job with bad options.
+   */
+  void reportError(const QString& message);
+
   void addImage(const QString& path);
 
   void setup();
@@ -346,11 +386,13 @@ class CommandLine {
 
   QString fetchWindowTitle() const;
 
-  QSizeF fetchPageDetectionBox() const;
+  QSizeF fetchPageDetectionBox();
 
   double fetchPageDetectionTolerance() const;
 
   bool fetchDefaultNull();
+
+  size_t fetchSpillThreshold();
 };
 
 
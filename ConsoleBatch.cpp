@@ -54,7 +54,8 @@
 
 ConsoleBatch::ConsoleBatch(const std::vector<ImageFileInfo>& images,
                            const QString& output_directory,
-                           const Qt::LayoutDirection layout)
+                           const Qt::LayoutDirection layout,
+                           const ThumbnailCacheFactory& thumbnail_cache_factory)
     : batch(true),
       debug(true),
       m_disambiguator(new FileNameDisambiguator),
@@ -63,7 +64,8 @@ ConsoleBatch::ConsoleBatch(const std::vector<ImageFileInfo>& images,
   m_stages = make_intrusive<StageSequence>(m_pages, accessor);
   // m_thumbnailCache = make_intrusive<ThumbnailPixmapCache>(output_dir+"/cache/thumbs",
   // QSize(200,200), 40, 5);
-  m_thumbnailCache = Utils::createThumbnailCache(output_directory);
+  m_thumbnailCache = thumbnail_cache_factory ? thumbnail_cache_factory(output_directory)
+                                             : Utils::createThumbnailCache(output_directory);
   m_outFileNameGen = OutputFileNameGenerator(m_disambiguator, output_directory, m_pages->layoutDirection());
 }
 
@@ -80,6 +82,15 @@ ConsoleBatch::ConsoleBatch(const QString project_file) : batch(true), debug(true
 
   file.close();
 
+  init(doc, ThumbnailCacheFactory());
+}
+
+ConsoleBatch::ConsoleBatch(const QDomDocument& project, const ThumbnailCacheFactory& thumbnail_cache_factory)
+    : batch(true), debug(true) {
+  init(project, thumbnail_cache_factory);
+}
+
+void ConsoleBatch::init(const QDomDocument& doc, const ThumbnailCacheFactory& thumbnail_cache_factory) {
   m_reader = std::make_unique<ProjectReader>(doc);
   m_pages = m_reader->pages();
 
@@ -96,7 +107,8 @@ ConsoleBatch::ConsoleBatch(const QString project_file) : batch(true), debug(true
   }
   // m_thumbnailCache = make_intrusive<    // ThumbnailPixmapCache>(output_directory+"/cache/thumbs",
   // QSize(200,200), 40, 5);
-  m_thumbnailCache = Utils::createThumbnailCache(output_directory);
+  m_thumbnailCache = thumbnail_cache_factory ? thumbnail_cache_factory(output_directory)
+                                             : Utils::createThumbnailCache(output_directory);
   m_outFileNameGen = OutputFileNameGenerator(m_disambiguator, output_directory, m_pages->layoutDirection());
 }
 
@@ -142,7 +154,7 @@ BackgroundTaskPtr ConsoleBatch::createCompositeTask(const PageInfo& page, const
 }  // ConsoleBatch::createCompositeTask
 
 // process the image vector **images** and save output to **output_dir**
-void ConsoleBatch::process() {
+void ConsoleBatch::process(const ProgressCallback& progress_callback) {
   const CommandLine& cli = CommandLine::get();
 
   int startFilterIdx = m_stages->fixOrientationFilterIdx();
@@ -177,6 +189,9 @@ void ConsoleBatch::process() {
       }
       BackgroundTaskPtr bgTask = createCompositeTask(page, j);
       (*bgTask)();
+      if (progress_callback) {
+        progress_callback(j, static_cast<int>(i), static_cast<int>(page_sequence.numPages()), page);
+      }
     }
   }
 
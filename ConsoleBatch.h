@@ -22,6 +22,7 @@
 #define CONSOLEBATCH_H_
 
 #include <QString>
+#include <functional>
 #include <vector>
 
 #include "BackgroundTask.h"
@@ -38,17 +39,36 @@
 #include "ThumbnailPixmapCache.h"
 #include "intrusive_ptr.h"
 
+class QDomDocument;
 
 class ConsoleBatch {
   // Member-wise copying is OK.
  public:
+  /**
+   * Creates the thumbnail cache for an output directory.
+   */
+  typedef std::function<intrusive_ptr<ThumbnailPixmapCache>(const QString& output_directory)> ThumbnailCacheFactory;
+
+  /**
+   * Called after a page has been processed by a filter.
+   */
+  typedef std::function<void(int filter_idx, int page_idx, int num_pages, const PageInfo& page)> ProgressCallback;
+
   ConsoleBatch(const std::vector<ImageFileInfo>& images,
                const QString& output_directory,
-               const Qt::LayoutDirection layout);
+               const Qt::LayoutDirection layout,
+               const ThumbnailCacheFactory& thumbnail_cache_factory = ThumbnailCacheFactory());
 
   ConsoleBatch(const QString project_file);
 
-  void process();
+  /**
+   * Same as above, except the project file is already parsed.
+   * An empty \p thumbnail_cache_factory stands for Utils::createThumbnailCache().
+   */
+  explicit ConsoleBatch(const QDomDocument& project,
+                        const ThumbnailCacheFactory& thumbnail_cache_factory = ThumbnailCacheFactory());
+
+  void process(const ProgressCallback& progress_callback = ProgressCallback());
 
   void saveProject(const QString project_file);
 
@@ -62,6 +82,8 @@ class ConsoleBatch {
   intrusive_ptr<ThumbnailPixmapCache> m_thumbnailCache;
   std::unique_ptr<ProjectReader> m_reader;
 
+  void init(const QDomDocument& project, const ThumbnailCacheFactory& thumbnail_cache_factory);
+
   void setupFilter(int idx, std::set<PageId> allPages);
 
   void setupFixOrientation(std::set<PageId> allPages);
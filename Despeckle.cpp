@@ -19,8 +19,10 @@
 #include "Despeckle.h"
 #include <QDebug>
 #include <QImage>
+#include <algorithm>
 #include <cmath>
 #include <unordered_map>
+#include <vector>
 #include "DebugImages.h"
 #include "Dpi.h"
 #include "FastQueue.h"
@@ -141,6 +143,8 @@ struct Component {
 
   Component() : num_pixels(0) {}
 
+  uint32_t size() const { return num_pixels & ~TAG_MASK; }
+
   const uint32_t anchoredToBig() const { return num_pixels & ANCHORED_TO_BIG; }
 
   void setAnchoredToBig() { num_pixels |= ANCHORED_TO_BIG; }
@@ -316,12 +320,14 @@ void tagSourceComponent(Component& source, const Component& target, uint32_t sqd
     return;
   }
 
-  if (sqdist > source.num_pixels * settings.pixelsToSqDist) {
+  // Note that tags must not be taken for a part of the size, otherwise
+  // the outcome would depend on the order the connections are visited.
+  if (sqdist > source.size() * settings.pixelsToSqDist) {
     // Too far.
     return;
   }
 
-  if (target.num_pixels >= settings.minRelativeParentWeight * source.num_pixels) {
+  if (target.size() >= settings.minRelativeParentWeight * source.size()) {
     source.setAnchoredToBig();
   } else {
     source.setAnchoredToSmall();
@@ -963,3 +969,259 @@ void Despeckle::despeckleInPlace(imageproc::BinaryImage& image,
   despeckleImpl(image, dpi, settings, status, dbg);
 }
 // Despeckle::despeckleInPlace
+
+/*========================== Despeckle::Analysis ===========================*/
+
+class Despeckle::Analysis::Impl {
+ public:
+  Impl(const BinaryImage& image, const Dpi& dpi, const TaskStatus& status);
+
+  BinaryImage despeckle(const Settings& settings, const TaskStatus& status) const;
+
+  const Dpi& dpi() const { return m_dpi; }
+
+ private:
+  /**
+   * A horizontal run of black pixels belonging to a single component.
+   */
+  struct Run {
+    int y;
+    int xBegin;
+    int xEnd;
+    uint32_t label;
+  };
+
+  /**
+   * The distance between neighboring components, as found by voronoiDistances().
+   */
+  struct Neighbors {
+    uint32_t label1;
+    uint32_t label2;
+    uint32_t sqdist;
+  };
+
+  BinaryImage m_image;
+  Dpi m_dpi;
+
+  /**
+   * Indexed by connected component labels, with label 0 not being used.
+   */
+  std::vector<uint32_t> m_numPixels;
+  std::vector<BoundingBox> m_boundingBoxes;
+
+  std::vector<Run> m_runs;
+  std::vector<Neighbors> m_neighbors;
+};
+
+
+Despeckle::Analysis::Analysis() = default;
+
+Despeckle::Analysis::Analysis(const BinaryImage& image, const Dpi& dpi, const TaskStatus& status)
+    : m_impl(std::make_shared<Impl>(image, dpi, status)) {}
+
+BinaryImage Despeckle::Analysis::despeckle(const Level level, const TaskStatus& status) const {
+  assert(m_impl);
+
+  return m_impl->despeckle(Settings::get(level, m_impl->dpi()), status);
+}
+
+BinaryImage Despeckle::Analysis::despeckle(const double level, const TaskStatus& status) const {
+  assert(m_impl);
+
+  return m_impl->despeckle(Settings::get(level, m_impl->dpi()), status);
+}
+
+Despeckle::Analysis::Impl::Impl(const BinaryImage& image, const Dpi& dpi, const TaskStatus& status)
+    : m_image(image), m_dpi(dpi) {
+  ConnectivityMap cmap(image, CONN8);
+  if (cmap.maxLabel() == 0) {
+    return;
+  }
+
+  status.throwIfCancelled();
+
+  m_numPixels.resize(cmap.maxLabel() + 1, 0);
+  m_boundingBoxes.resize(cmap.maxLabel() + 1);
+
+  const int width = image.width();
+  const int height = image.height();
+
+  const uint32_t* cmap_line = cmap.data();
+  const int cmap_stride = cmap.stride();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width;) {
+      const uint32_t label = cmap_line[x];
+      if (label == 0) {
+        ++x;
+        continue;
+      }
+
+      const int x_begin = x;
+      for (++x; (x < width) && (cmap_line[x] == label); ++x) {
+      }
+
+      m_numPixels[label] += x - x_begin;
+      m_boundingBoxes[label].extend(x_begin, y);
+      m_boundingBoxes[label].extend(x - 1, y);
+      m_runs.push_back(Run{y, x_begin, x, label});
+    }
+    cmap_line += cmap_stride;
+  }
+
+  status.throwIfCancelled();
+
+  // Labels in the Voronoi diagram don't affect the distances, so unifying
+  // big components, as despeckleImpl() does, may be postponed until the level
+  // is known.  The distance to the unified component is then the minimum
+  // of the distances to its parts.
+  std::vector<Distance> distance_matrix;
+  voronoi(cmap, distance_matrix);
+
+  status.throwIfCancelled();
+
+  std::unordered_map<Connection, uint32_t, Connection::hash> conns;
+  voronoiDistances(cmap, distance_matrix, conns);
+
+  m_neighbors.reserve(conns.size());
+  for (const auto& pair : conns) {
+    m_neighbors.push_back(Neighbors{pair.first.lesser_label, pair.first.greater_label, pair.second});
+  }
+}
+
+BinaryImage Despeckle::Analysis::Impl::despeckle(const Settings& settings, const TaskStatus& status) const {
+  BinaryImage dst(m_image);
+  if (m_numPixels.empty()) {
+    // Completely white image?
+    return dst;
+  }
+
+  // Unify big components the same way despeckleImpl() does.
+  const auto max_orig_label = static_cast<uint32_t>(m_numPixels.size() - 1);
+  std::vector<uint32_t> remapping_table(max_orig_label + 1, 0);
+  std::vector<Component> components(1);
+  uint32_t unified_big_component = 0;
+  for (uint32_t label = 1; label <= max_orig_label; ++label) {
+    if ((m_boundingBoxes[label].width() < settings.bigObjectThreshold)
+        && (m_boundingBoxes[label].height() < settings.bigObjectThreshold)) {
+      remapping_table[label] = static_cast<uint32_t>(components.size());
+      components.emplace_back();
+      components.back().num_pixels = m_numPixels[label];
+    } else {
+      if (unified_big_component == 0) {
+        unified_big_component = static_cast<uint32_t>(components.size());
+        components.emplace_back();
+        components.back().num_pixels = m_image.width() * m_image.height();
+      }
+      remapping_table[label] = unified_big_component;
+    }
+  }
+
+  status.throwIfCancelled();
+
+  // despeckleImpl() computes the Voronoi diagram again if the last component is
+  // only anchored to small ones.  The outcome of that isn't derivable from
+  // the statistics we have, so we do the whole thing in that case.
+  const auto last_label = static_cast<uint32_t>(components.size() - 1);
+  if (last_label != unified_big_component) {
+    Component last = components[last_label];
+    for (const Neighbors& nbh : m_neighbors) {
+      const uint32_t label1 = remapping_table[nbh.label1];
+      const uint32_t label2 = remapping_table[nbh.label2];
+      if ((label1 != label2) && ((label1 == last_label) || (label2 == last_label))) {
+        tagSourceComponent(last, components[label1 == last_label ? label2 : label1], nbh.sqdist, settings);
+      }
+    }
+
+    if (last.anchoredToSmallButNotBig()) {
+      despeckleImpl(dst, m_dpi, settings, status, nullptr);
+
+      return dst;
+    }
+  }
+
+  status.throwIfCancelled();
+
+  // Build the directional connections, grouped by target.
+  std::vector<uint32_t> first_source(components.size() + 1, 0);
+  std::vector<uint32_t> sources;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (const Neighbors& nbh : m_neighbors) {
+      const uint32_t label1 = remapping_table[nbh.label1];
+      const uint32_t label2 = remapping_table[nbh.label2];
+      if (label1 == label2) {
+        continue;
+      }
+
+      const uint32_t conns[2][2] = {{label2, label1}, {label1, label2}};
+      for (const auto& conn : conns) {
+        const uint32_t target = conn[0];
+        const uint32_t source = conn[1];
+        if (!canBeAttachedTo(components[source], components[target], nbh.sqdist, settings)) {
+          continue;
+        }
+        if (pass == 0) {
+          ++first_source[target + 1];
+        } else {
+          sources[first_source[target]++] = source;
+        }
+      }
+    }
+
+    if (pass == 0) {
+      for (size_t i = 1; i < first_source.size(); ++i) {
+        first_source[i] += first_source[i - 1];
+      }
+      sources.resize(first_source.back());
+    } else {
+      // The second pass has shifted the group boundaries by one group.
+      for (size_t i = first_source.size() - 1; i > 0; --i) {
+        first_source[i] = first_source[i - 1];
+      }
+      first_source[0] = 0;
+    }
+  }
+
+  status.throwIfCancelled();
+
+  // Labels of components that are to be retained.
+  FastQueue<uint32_t> ok_labels;
+  ok_labels.push(unified_big_component);
+
+  while (!ok_labels.empty()) {
+    const uint32_t label = ok_labels.front();
+    ok_labels.pop();
+
+    Component& comp = components[label];
+    if (comp.anchoredToBig()) {
+      continue;
+    }
+
+    comp.setAnchoredToBig();
+
+    for (uint32_t i = first_source[label]; i < first_source[label + 1]; ++i) {
+      ok_labels.push(sources[i]);
+    }
+  }
+
+  status.throwIfCancelled();
+
+  // Remove unmarked components from the binary image.
+  uint32_t* const dst_data = dst.data();
+  const int dst_stride = dst.wordsPerLine();
+  for (const Run& run : m_runs) {
+    if (components[remapping_table[run.label]].anchoredToBig()) {
+      continue;
+    }
+
+    uint32_t* const line = dst_data + run.y * dst_stride;
+    for (int x = run.xBegin; x < run.xEnd;) {
+      const int word_end = std::min((x & ~31) + 32, run.xEnd);
+      const uint32_t head = ~uint32_t(0) >> (x & 31);
+      const uint32_t tail = (word_end & 31) ? ~(~uint32_t(0) >> (word_end & 31)) : ~uint32_t(0);
+      line[x >> 5] &= ~(head & tail);
+      x = word_end;
+    }
+  }
+
+  return dst;
+}  // Despeckle::Analysis::Impl::despeckle
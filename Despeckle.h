@@ -19,6 +19,8 @@
 #ifndef DESPECKLE_H_
 #define DESPECKLE_H_
 
+#include <memory>
+
 class Dpi;
 class TaskStatus;
 class DebugImages;
@@ -67,6 +69,42 @@ class Despeckle {
                                double level,
                                const TaskStatus& status,
                                DebugImages* dbg = nullptr);
+
+  /**
+   * \brief The level-independent part of despeckling a particular image.
+   *
+   * Connected components, their sizes and bounding boxes and the distances
+   * between neighboring components are collected once.  Despeckling at any
+   * level then comes down to thresholding these statistics, giving the same
+   * result as despeckle() would.
+   *
+   * Member-wise copying is OK, as copies share the collected data.
+   */
+  class Analysis {
+   public:
+    /**
+     * Constructs a null analysis.
+     */
+    Analysis();
+
+    /**
+     * \param image The image to be despeckled.  Must not be null.
+     * \param dpi DPI of \p image.
+     * \param status For asynchronous task cancellation.
+     */
+    Analysis(const imageproc::BinaryImage& image, const Dpi& dpi, const TaskStatus& status);
+
+    bool isNull() const { return !m_impl; }
+
+    imageproc::BinaryImage despeckle(Level level, const TaskStatus& status) const;
+
+    imageproc::BinaryImage despeckle(double level, const TaskStatus& status) const;
+
+   private:
+    class Impl;
+
+    std::shared_ptr<const Impl> m_impl;
+  };
 };
 
 
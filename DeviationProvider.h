@@ -3,6 +3,7 @@
 #define SCANTAILOR_DEVIATION_H
 
 #include <foundation/NonCopyable.h>
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <unordered_map>
@@ -33,13 +34,24 @@ class DeviationProvider {
   void update() const;
 
  private:
+  void addValue(double value, size_t newCount);
+
+  void removeValue(double value, size_t newCount);
+
+  double standardDeviation() const;
+
   std::function<double(const K&)> m_computeValueByKey;
   std::unordered_map<K, double, Hash> m_keyValueMap;
 
-  // Cached values.
-  mutable bool m_needUpdate = false;
+  // Running moments, maintained incrementally using Welford's algorithm,
+  // so that adding, updating or removing a value is O(1).
   mutable double m_meanValue = 0.0;
-  mutable double m_standardDeviation = 0.0;
+  mutable double m_squaredDifferencesSum = 0.0;
+
+  // Removals make rounding errors of the running moments accumulate,
+  // so once there were as many of them as there are values, the moments
+  // are recalculated from scratch.  That keeps the amortized cost O(1).
+  mutable size_t m_removalsSinceRecalculation = 0;
 };
 
 
@@ -49,63 +61,76 @@ DeviationProvider<K, Hash>::DeviationProvider(const std::function<double(const K
 
 template <typename K, typename Hash>
 bool DeviationProvider<K, Hash>::isDeviant(const K& key, const double coefficient, const double threshold) const {
-  if (m_keyValueMap.find(key) == m_keyValueMap.end()) {
+  const auto it = m_keyValueMap.find(key);
+  if (it == m_keyValueMap.end()) {
     return false;
   }
+
   if (m_keyValueMap.size() < 3) {
     return false;
   }
 
   update();
 
-  return (std::abs(m_keyValueMap.at(key) - m_meanValue) > std::max((coefficient * m_standardDeviation), threshold));
+  return (std::abs(it->second - m_meanValue) > std::max((coefficient * standardDeviation()), threshold));
 }
 
 template <typename K, typename Hash>
 double DeviationProvider<K, Hash>::getDeviationValue(const K& key) const {
-  if (m_keyValueMap.find(key) == m_keyValueMap.end()) {
+  const auto it = m_keyValueMap.find(key);
+  if (it == m_keyValueMap.end()) {
     return .0;
   }
+
   if (m_keyValueMap.size() < 2) {
     return .0;
   }
 
   update();
 
-  return std::abs(m_keyValueMap.at(key) - m_meanValue);
+  return std::abs(it->second - m_meanValue);
 }
 
 template <typename K, typename Hash>
 void DeviationProvider<K, Hash>::addOrUpdate(const K& key) {
-  m_needUpdate = true;
-
-  m_keyValueMap[key] = m_computeValueByKey(key);
+  addOrUpdate(key, m_computeValueByKey(key));
 }
 
 template <typename K, typename Hash>
 void DeviationProvider<K, Hash>::addOrUpdate(const K& key, const double value) {
-  m_needUpdate = true;
-
-  m_keyValueMap[key] = value;
+  const auto it = m_keyValueMap.find(key);
+  if (it == m_keyValueMap.end()) {
+    m_keyValueMap.emplace(key, value);
+    addValue(value, m_keyValueMap.size());
+  } else if (it->second != value) {
+    removeValue(it->second, m_keyValueMap.size() - 1);
+    addValue(value, m_keyValueMap.size());
+    it->second = value;
+  }
 }
 
 template <typename K, typename Hash>
 void DeviationProvider<K, Hash>::remove(const K& key) {
-  m_needUpdate = true;
-
-  if (m_keyValueMap.find(key) == m_keyValueMap.end()) {
+  const auto it = m_keyValueMap.find(key);
+  if (it == m_keyValueMap.end()) {
     return;
   }
 
-  m_keyValueMap.erase(key);
+  const double value = it->second;
+  m_keyValueMap.erase(it);
+  removeValue(value, m_keyValueMap.size());
 }
 
 template <typename K, typename Hash>
 void DeviationProvider<K, Hash>::update() const {
-  if (!m_needUpdate) {
+  if (m_removalsSinceRecalculation < m_keyValueMap.size()) {
     return;
   }
-  if (m_keyValueMap.size() < 2) {
+
+  m_meanValue = 0.0;
+  m_squaredDifferencesSum = 0.0;
+  m_removalsSinceRecalculation = 0;
+  if (m_keyValueMap.empty()) {
     return;
   }
 
@@ -116,16 +141,44 @@ void DeviationProvider<K, Hash>::update() const {
     }
     m_meanValue = sum / m_keyValueMap.size();
   }
-
   {
     double differencesSum = .0;
     for (const std::pair<K, double>& keyAndValue : m_keyValueMap) {
       differencesSum += std::pow(keyAndValue.second - m_meanValue, 2);
     }
-    m_standardDeviation = std::sqrt(differencesSum / (m_keyValueMap.size() - 1));
+    m_squaredDifferencesSum = differencesSum;
+  }
+}
+
+template <typename K, typename Hash>
+void DeviationProvider<K, Hash>::addValue(const double value, const size_t newCount) {
+  const double delta = value - m_meanValue;
+  m_meanValue += delta / newCount;
+  m_squaredDifferencesSum += delta * (value - m_meanValue);
+}
+
+template <typename K, typename Hash>
+void DeviationProvider<K, Hash>::removeValue(const double value, const size_t newCount) {
+  if (newCount == 0) {
+    m_meanValue = 0.0;
+    m_squaredDifferencesSum = 0.0;
+    m_removalsSinceRecalculation = 0;
+    return;
   }
 
-  m_needUpdate = false;
+  const double delta = value - m_meanValue;
+  m_meanValue -= delta / newCount;
+  m_squaredDifferencesSum = std::max(0.0, m_squaredDifferencesSum - delta * (value - m_meanValue));
+  ++m_removalsSinceRecalculation;
+}
+
+template <typename K, typename Hash>
+double DeviationProvider<K, Hash>::standardDeviation() const {
+  if (m_keyValueMap.size() < 2) {
+    return 0.0;
+  }
+
+  return std::sqrt(m_squaredDifferencesSum / (m_keyValueMap.size() - 1));
 }
 
 template <typename K, typename Hash>
@@ -136,11 +189,9 @@ void DeviationProvider<K, Hash>::setComputeValueByKey(const std::function<double
 template <typename K, typename Hash>
 void DeviationProvider<K, Hash>::clear() {
   m_keyValueMap.clear();
-
-  m_needUpdate = false;
   m_meanValue = 0.0;
-  m_standardDeviation = 0.0;
+  m_squaredDifferencesSum = 0.0;
+  m_removalsSinceRecalculation = 0;
 }
 
-
 #endif  // SCANTAILOR_DEVIATION_H
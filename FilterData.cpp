@@ -17,21 +17,32 @@
  */
 
 #include "FilterData.h"
+#include <utility>
 #include "Dpm.h"
 #include "imageproc/Grayscale.h"
 
 using namespace imageproc;
 
 FilterData::FilterData(const QImage& image)
-    : m_origImage(image), m_grayImage(toGrayscale(m_origImage)), m_xform(image.rect(), Dpm(image)) {}
+    : m_origImage(image),
+      m_grayImage(toGrayscale(m_origImage)),
+      m_pyramid(new PagePyramid(m_grayImage)),
+      m_xform(image.rect(), Dpm(image)),
+      m_origImageKey(m_origImage.cacheKey()),
+      m_grayImageKey(m_grayImage.toQImage().cacheKey()) {}
 
-FilterData::FilterData(const FilterData& other, const ImageTransformation& xform)
-    : m_origImage(other.m_origImage),
-      m_grayImage(other.m_grayImage),
+FilterData::FilterData(FilterData&& other, const ImageTransformation& xform)
+    : m_origImage(std::move(other.m_origImage)),
+      m_grayImage(std::move(other.m_grayImage)),
+      m_pyramid(std::move(other.m_pyramid)),
       m_xform(xform),
-      m_imageParams(other.m_imageParams) {}
+      m_imageParams(other.m_imageParams),
+      m_origImageKey(other.m_origImageKey),
+      m_grayImageKey(other.m_grayImageKey) {}
 
-FilterData::FilterData(const FilterData& other) = default;
+FilterData::FilterData(FilterData&& other) = default;
+
+FilterData& FilterData::operator=(FilterData&& other) = default;
 
 imageproc::BinaryThreshold FilterData::bwThreshold() const {
   return m_imageParams.getBwThreshold();
@@ -49,6 +60,10 @@ const imageproc::GrayImage& FilterData::grayImage() const {
   return m_grayImage;
 }
 
+const PagePyramid& FilterData::pyramid() const {
+  return *m_pyramid;
+}
+
 bool FilterData::isBlackOnWhite() const {
   return m_imageParams.isBlackOnWhite();
 }
@@ -56,3 +71,8 @@ bool FilterData::isBlackOnWhite() const {
 void FilterData::updateImageParams(const ImageSettings::PageParams& imageParams) {
   m_imageParams = imageParams;
 }
+
+bool FilterData::imagesIntact() const {
+  // QImage::cacheKey() changes once an image gets detached or modified in place.
+  return (m_origImage.cacheKey() == m_origImageKey) && (m_grayImage.toQImage().cacheKey() == m_grayImageKey);
+}
@@ -22,17 +22,34 @@
 #include <QImage>
 #include "ImageSettings.h"
 #include "ImageTransformation.h"
+#include "PagePyramid.h"
 #include "imageproc/BinaryThreshold.h"
 #include "imageproc/GrayImage.h"
-
+#include "intrusive_ptr.h"
+
+/**
+ * \brief The images of a page along with its transformation, handed from one
+ *        filter task to the next one.
+ *
+ * It's move-only, so that each stage explicitly gives the images up
+ * to the next one instead of holding on to another reference.
+ */
 class FilterData {
-  // Member-wise copying is OK.
  public:
   explicit FilterData(const QImage& image);
 
-  FilterData(const FilterData& other, const ImageTransformation& xform);
+  /**
+   * \brief Hands the images over to the next stage along with a new transformation.
+   */
+  FilterData(FilterData&& other, const ImageTransformation& xform);
+
+  FilterData(FilterData&& other);
+
+  FilterData(const FilterData& other) = delete;
 
-  FilterData(const FilterData& other);
+  FilterData& operator=(FilterData&& other);
+
+  FilterData& operator=(const FilterData& other) = delete;
 
   imageproc::BinaryThreshold bwThreshold() const;
 
@@ -42,15 +59,30 @@ class FilterData {
 
   const imageproc::GrayImage& grayImage() const;
 
+  /**
+   * \brief Reduced resolution versions of grayImage(), shared by all the
+   *        copies of this FilterData.
+   */
+  const PagePyramid& pyramid() const;
+
   bool isBlackOnWhite() const;
 
   void updateImageParams(const ImageSettings::PageParams& imageParams);
 
+  /**
+   * \brief Checks that origImage() and grayImage() were neither modified nor deep copied
+   *        since the image loader has produced them.
+   */
+  bool imagesIntact() const;
+
  private:
   QImage m_origImage;
   imageproc::GrayImage m_grayImage;
+  intrusive_ptr<PagePyramid> m_pyramid;
   ImageTransformation m_xform;
   ImageSettings::PageParams m_imageParams;
+  qint64 m_origImageKey;
+  qint64 m_grayImageKey;
 };
 
 
@@ -0,0 +1,51 @@
+
+#include "ImagePyramid.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include "imageproc/Scale.h"
+
+using namespace imageproc;
+
+namespace {
+/**
+ * Levels with any of the dimensions below this value are not built.
+ */
+const int MIN_LEVEL_SIZE = 64;
+}  // namespace
+
+ImagePyramid::ImagePyramid(const QImage& image) : m_originalImage(image) {
+  m_levels.push_back(image);
+}
+
+QImage ImagePyramid::levelForScale(const double scale, QTransform& level_to_image) const {
+  int target_level = 0;
+  if ((scale > 0.0) && (scale < 1.0)) {
+    target_level = static_cast<int>(std::floor(std::log2(1.0 / scale)));
+  }
+
+  QMutexLocker locker(&m_mutex);
+
+  while (static_cast<int>(m_levels.size()) <= target_level) {
+    const QImage& prev = m_levels.back();
+    if ((prev.width() / 2 < MIN_LEVEL_SIZE) || (prev.height() / 2 < MIN_LEVEL_SIZE)) {
+      break;
+    }
+    m_levels.push_back(downscaleByHalf(prev));
+  }
+
+  const QImage& level = m_levels[std::min<size_t>(target_level, m_levels.size() - 1)];
+
+  level_to_image.reset();
+  level_to_image.scale((double) m_originalImage.width() / level.width(),
+                       (double) m_originalImage.height() / level.height());
+
+  return level;
+}
+
+QImage ImagePyramid::downscaleByHalf(const QImage& image) {
+  const int w = (image.width() + 1) / 2;
+  const int h = (image.height() + 1) / 2;
+
+  return scaleByArea(image, QSize(w, h));
+}
@@ -0,0 +1,54 @@
+
+#ifndef SCANTAILOR_IMAGEPYRAMID_H
+#define SCANTAILOR_IMAGEPYRAMID_H
+
+#include <QImage>
+#include <QMutex>
+#include <QTransform>
+#include <vector>
+#include "NonCopyable.h"
+#include "ref_countable.h"
+
+/**
+ * \brief A set of progressively downscaled versions of an image.
+ *
+ * Level 0 is the original image.  Every next level is half the size
+ * of the previous one.  Levels are built lazily, on first request,
+ * and are then kept for the lifetime of the pyramid.
+ *
+ * The object may be shared between the GUI thread and background
+ * threads.  All the public methods are thread-safe.
+ */
+class ImagePyramid : public ref_countable {
+  DECLARE_NON_COPYABLE(ImagePyramid)
+
+ public:
+  explicit ImagePyramid(const QImage& image);
+
+  const QImage& originalImage() const { return m_originalImage; }
+
+  /**
+   * \brief Returns the smallest level that is still detailed enough
+   *        to be displayed at the given scale.
+   *
+   * The returned level is never smaller than what's required to display
+   * it at \p scale, so that rendering from it is still a downscaling
+   * (or a one to one mapping) operation.
+   *
+   * \param scale The number of display pixels per original image pixel.
+   * \param[out] level_to_image Transformation from the coordinates of the
+   *             returned image to the original image coordinates.
+   * \return The image representing the selected level.
+   */
+  QImage levelForScale(double scale, QTransform& level_to_image) const;
+
+ private:
+  static QImage downscaleByHalf(const QImage& image);
+
+  const QImage m_originalImage;
+  mutable QMutex m_mutex;
+  mutable std::vector<QImage> m_levels;
+};
+
+
+#endif  // SCANTAILOR_IMAGEPYRAMID_H
@@ -18,6 +18,7 @@
 
 #include "ImageViewBase.h"
 #include <QApplication>
+#include <QCursor>
 #include <QGLWidget>
 #include <QMouseEvent>
 #include <QPaintEngine>
@@ -26,25 +27,47 @@
 #include <QSettings>
 #include <QtWidgets/QMainWindow>
 #include <QtWidgets/QStatusBar>
+#include <algorithm>
+#include <cmath>
 #include "BackgroundExecutor.h"
 #include "ColorSchemeManager.h"
 #include "Dpm.h"
 #include "ImagePresentation.h"
+#include "ImagePyramid.h"
+#include "ImageViewCache.h"
 #include "OpenGLSupport.h"
 #include "PixmapRenderer.h"
 #include "ScopedIncDec.h"
 #include "UnitsProvider.h"
 #include "Utils.h"
 #include "imageproc/PolygonUtils.h"
+#include "imageproc/Scale.h"
 #include "imageproc/Transform.h"
 
 using namespace imageproc;
 
-class ImageViewBase::HqTransformTask : public AbstractCommand<intrusive_ptr<AbstractCommand<void>>>, public QObject {
-  DECLARE_NON_COPYABLE(HqTransformTask)
+namespace {
+/**
+ * The width and height of a high quality tile, in widget pixels.
+ */
+const int HQ_TILE_SIZE = 256;
+
+/**
+ * The fractional part of the translation of a tile grid is rounded
+ * to a multiple of 1 / HQ_GRID_SUBPIXEL_STEPS of a pixel, so that
+ * panning by whole pixels reuses the already built tiles.
+ */
+const double HQ_GRID_SUBPIXEL_STEPS = 64.0;
+}  // namespace
+
+class ImageViewBase::HqTileTask : public AbstractCommand<intrusive_ptr<AbstractCommand<void>>>, public QObject {
+  DECLARE_NON_COPYABLE(HqTileTask)
 
  public:
-  HqTransformTask(ImageViewBase* image_view, const QImage& image, const QTransform& xform, const QSize& target_size);
+  HqTileTask(ImageViewBase* image_view,
+             const intrusive_ptr<ImagePyramid>& pyramid,
+             const TilePixmapCache::Key& key,
+             const QRect& tile_rect);
 
   void cancel() { m_result->cancel(); }
 
@@ -55,9 +78,9 @@ class ImageViewBase::HqTransformTask : public AbstractCommand<intrusive_ptr<Abst
  private:
   class Result : public AbstractCommand<void> {
    public:
-    explicit Result(ImageViewBase* image_view);
+    Result(ImageViewBase* image_view, const TilePixmapCache::Key& key);
 
-    void setData(const QPoint& origin, const QImage& hq_image);
+    void setData(const QImage& hq_image);
 
     void cancel() { m_cancelFlag.fetchAndStoreRelaxed(1); }
 
@@ -67,16 +90,16 @@ class ImageViewBase::HqTransformTask : public AbstractCommand<intrusive_ptr<Abst
 
    private:
     QPointer<ImageViewBase> m_imageView;
-    QPoint m_origin;
+    TilePixmapCache::Key m_key;
     QImage m_hqImage;
     mutable QAtomicInt m_cancelFlag;
   };
 
 
   intrusive_ptr<Result> m_result;
-  QImage m_image;
+  intrusive_ptr<ImagePyramid> m_pyramid;
   QTransform m_xform;
-  QSize m_targetSize;
+  QRect m_tileRect;
 };
 
 
@@ -128,6 +151,8 @@ ImageViewBase::ImageViewBase(const QImage& image,
                              const ImagePresentation& presentation,
                              const Margins& margins)
     : m_image(image),
+      m_pyramid(new ImagePyramid(image)),
+      m_hqSourceId(ImageViewCache::instance().sourceId(image)),
       m_virtualImageCropArea(presentation.cropArea()),
       m_virtualDisplayArea(presentation.displayArea()),
       m_imageToVirtual(presentation.transform()),
@@ -175,12 +200,18 @@ ImageViewBase::ImageViewBase(const QImage& image,
   setFrameShape(QFrame::NoFrame);
   viewport()->setFocusPolicy(Qt::WheelFocus);
 
-  if (downscaled_version.isNull()) {
-    m_pixmap = QPixmap::fromImage(createDownscaledImage(image));
-  } else if (downscaled_version.pixmap().isNull()) {
-    m_pixmap = QPixmap::fromImage(downscaled_version.image());
+  ImageViewCache& view_cache = ImageViewCache::instance();
+  if (const QPixmap* cached_pixmap = view_cache.findDownscaledPixmap(m_hqSourceId)) {
+    m_pixmap = *cached_pixmap;
   } else {
-    m_pixmap = downscaled_version.pixmap();
+    if (downscaled_version.isNull()) {
+      m_pixmap = QPixmap::fromImage(createDownscaledImage(image));
+    } else if (downscaled_version.pixmap().isNull()) {
+      m_pixmap = QPixmap::fromImage(downscaled_version.image());
+    } else {
+      m_pixmap = downscaled_version.pixmap();
+    }
+    view_cache.insertDownscaledPixmap(m_hqSourceId, m_pixmap);
   }
 
   m_pixmapToImage.scale((double) m_image.width() / m_pixmap.width(), (double) m_image.height() / m_pixmap.height());
@@ -216,20 +247,16 @@ ImageViewBase::ImageViewBase(const QImage& image,
   connect(verticalScrollBar(), SIGNAL(valueChanged(int)), SLOT(reactToScrollBars()));
 }
 
-ImageViewBase::~ImageViewBase() = default;
+ImageViewBase::~ImageViewBase() {
+  cancelHqTiles();
+}
 
 void ImageViewBase::hqTransformSetEnabled(const bool enabled) {
   if (!enabled && m_hqTransformEnabled) {
     // Turning off.
     m_hqTransformEnabled = false;
-    if (m_hqTransformTask) {
-      m_hqTransformTask->cancel();
-      m_hqTransformTask.reset();
-    }
-    if (!m_hqPixmap.isNull()) {
-      m_hqPixmap = QPixmap();
-      update();
-    }
+    cancelHqTiles();
+    update();
   } else if (enabled && !m_hqTransformEnabled) {
     // Turning on.
     m_hqTransformEnabled = true;
@@ -257,10 +284,7 @@ QImage ImageViewBase::createDownscaledImage(const QImage& image) {
     return image;
   }
 
-  QTransform xform;
-  xform.scale((double) d_w / o_w, (double) d_h / o_h);
-
-  return transform(image, xform, QRect(0, 0, d_w, d_h), OutsidePixels::assumeColor(Qt::white));
+  return scaleByArea(image, QSize(d_w, d_h));
 }
 
 QRectF ImageViewBase::maxViewportRect() const {
@@ -424,18 +448,16 @@ void ImageViewBase::paintEvent(QPaintEvent* event) {
   // Disable antialiasing for large zoom levels.
   painter.setRenderHint(QPainter::SmoothPixmapTransform, pixel_width < 0.5);
 
-  if (validateHqPixmap()) {
-    // HQ pixmap maps one to one to screen pixels, so antialiasing is not necessary.
-    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
-
-    QPainterPath clip_path;
-    clip_path.addPolygon(m_virtualToWidget.map(m_virtualImageCropArea));
-    painter.setClipPath(clip_path);
+  std::vector<std::pair<QPoint, QPixmap>> hq_tiles;
+  const bool hq_complete = collectHqTiles(hq_tiles);
 
-    painter.drawPixmap(m_hqPixmapPos, m_hqPixmap);
-  } else {
+  if (!hq_complete) {
     scheduleHqVersionRebuild();
 
+    // Draw the downscaled version, to be partially covered by
+    // whatever high quality tiles we already have.
+    painter.save();
+
     const QTransform pixmap_to_virtual(m_pixmapToImage * m_imageToVirtual);
     painter.setWorldTransform(pixmap_to_virtual * m_virtualToWidget);
 
@@ -444,6 +466,21 @@ void ImageViewBase::paintEvent(QPaintEvent* event) {
     painter.setClipPath(clip_path);
 
     PixmapRenderer::drawPixmap(painter, m_pixmap);
+
+    painter.restore();
+  }
+
+  if (!hq_tiles.empty()) {
+    // HQ tiles map one to one to screen pixels, so antialiasing is not necessary.
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+
+    QPainterPath clip_path;
+    clip_path.addPolygon(m_virtualToWidget.map(m_virtualImageCropArea));
+    painter.setClipPath(clip_path);
+
+    for (const auto& tile : hq_tiles) {
+      painter.drawPixmap(tile.first, tile.second);
+    }
   }
 
   painter.restore();
@@ -896,75 +933,176 @@ void ImageViewBase::setWidgetFocalPointWithoutMoving(const QPointF new_widget_fp
 }
 
 /**
- * Returns true if m_hqPixmap is valid and up to date.
+ * Returns the transformation from image coordinates to the coordinates of
+ * the tile grid matching the current zoom level and position.
+ *
+ * \param[out] grid_origin The position of the grid origin in widget coordinates.
  */
-bool ImageViewBase::validateHqPixmap() const {
-  if (!m_hqTransformEnabled) {
-    return false;
+QTransform ImageViewBase::currentTileGrid(QPoint& grid_origin) const {
+  const QTransform xform(m_imageToVirtual * m_virtualToWidget);
+
+  const double origin_x = std::floor(xform.dx());
+  const double origin_y = std::floor(xform.dy());
+  grid_origin = QPoint(static_cast<int>(origin_x), static_cast<int>(origin_y));
+
+  const double frac_x = std::round((xform.dx() - origin_x) * HQ_GRID_SUBPIXEL_STEPS) / HQ_GRID_SUBPIXEL_STEPS;
+  const double frac_y = std::round((xform.dy() - origin_y) * HQ_GRID_SUBPIXEL_STEPS) / HQ_GRID_SUBPIXEL_STEPS;
+
+  return QTransform(xform.m11(), xform.m12(), xform.m21(), xform.m22(), frac_x, frac_y);
+}
+
+/**
+ * Returns the positions of tiles covering the visible part of the image.
+ */
+std::vector<QPoint> ImageViewBase::visibleTiles(const QPoint& grid_origin) const {
+  const QRect image_rect(
+      m_virtualToWidget.map(m_virtualImageCropArea).boundingRect().toAlignedRect().intersected(viewport()->rect()));
+
+  std::vector<QPoint> tiles;
+  if (image_rect.isEmpty()) {
+    return tiles;
   }
 
-  if (m_hqPixmap.isNull()) {
-    return false;
+  const QRect grid_rect(image_rect.translated(-grid_origin));
+  const auto tile_index = [](const int coord) {
+    return (coord >= 0) ? coord / HQ_TILE_SIZE : -((-coord - 1) / HQ_TILE_SIZE) - 1;
+  };
+
+  const int first_col = tile_index(grid_rect.left());
+  const int last_col = tile_index(grid_rect.right());
+  const int first_row = tile_index(grid_rect.top());
+  const int last_row = tile_index(grid_rect.bottom());
+
+  tiles.reserve(static_cast<size_t>((last_col - first_col + 1) * (last_row - first_row + 1)));
+  for (int row = first_row; row <= last_row; ++row) {
+    for (int col = first_col; col <= last_col; ++col) {
+      tiles.emplace_back(col, row);
+    }
   }
 
-  if (m_hqSourceId != m_image.cacheKey()) {
+  return tiles;
+}
+
+/**
+ * Collects the cached high quality tiles covering the visible part of the image.
+ *
+ * \param[out] tiles Pairs of tile positions in widget coordinates and tile pixmaps.
+ * \return true if all the visible tiles are available.
+ */
+bool ImageViewBase::collectHqTiles(std::vector<std::pair<QPoint, QPixmap>>& tiles) {
+  if (!m_hqTransformEnabled) {
     return false;
   }
 
-  if (m_hqXform != m_imageToVirtual * m_virtualToWidget) {
-    return false;
+  TilePixmapCache& tile_cache = ImageViewCache::instance().hqTiles();
+  QPoint grid_origin;
+  const QTransform grid(currentTileGrid(grid_origin));
+  const std::vector<QPoint> visible_tiles(visibleTiles(grid_origin));
+
+  bool complete = true;
+  for (const QPoint& tile : visible_tiles) {
+    if (const QPixmap* pixmap = tile_cache.find(TilePixmapCache::Key(m_hqSourceId, grid, tile))) {
+      tiles.emplace_back(grid_origin + tile * HQ_TILE_SIZE, *pixmap);
+    } else {
+      complete = false;
+    }
   }
 
-  return true;
+  return complete;
 }
 
 void ImageViewBase::scheduleHqVersionRebuild() {
   const QTransform xform(m_imageToVirtual * m_virtualToWidget);
 
-  if (!m_timer.isActive() || (m_potentialHqXform != xform)) {
-    if (m_hqTransformTask) {
-      m_hqTransformTask->cancel();
-      m_hqTransformTask.reset();
-    }
+  if (m_potentialHqXform != xform) {
+    // Tiles being built for another zoom level won't be needed soon.
+    QPoint grid_origin;
+    const QTransform grid(currentTileGrid(grid_origin));
+    cancelHqTiles(&grid);
     m_potentialHqXform = xform;
   }
   m_timer.start();
 }
 
+/**
+ * Cancels the pending tile building tasks.
+ *
+ * \param grid_to_keep If provided, the tasks building tiles for this grid are kept.
+ */
+void ImageViewBase::cancelHqTiles(const QTransform* grid_to_keep) {
+  for (auto it = m_pendingTiles.begin(); it != m_pendingTiles.end();) {
+    if (grid_to_keep && (it->first.grid == *grid_to_keep)) {
+      ++it;
+    } else {
+      it->second->cancel();
+      it = m_pendingTiles.erase(it);
+    }
+  }
+}
+
 void ImageViewBase::initiateBuildingHqVersion() {
-  if (validateHqPixmap()) {
+  if (!m_hqTransformEnabled) {
     return;
   }
 
-  m_hqPixmap = QPixmap();
+  TilePixmapCache& tile_cache = ImageViewCache::instance().hqTiles();
+  QPoint grid_origin;
+  const QTransform grid(currentTileGrid(grid_origin));
+  cancelHqTiles(&grid);
 
-  if (m_hqTransformTask) {
-    m_hqTransformTask->cancel();
-    m_hqTransformTask.reset();
+  std::vector<QPoint> missing_tiles;
+  for (const QPoint& tile : visibleTiles(grid_origin)) {
+    const TilePixmapCache::Key key(m_hqSourceId, grid, tile);
+    if (!tile_cache.find(key) && (m_pendingTiles.find(key) == m_pendingTiles.end())) {
+      missing_tiles.push_back(tile);
+    }
   }
 
-  const QTransform xform(m_imageToVirtual * m_virtualToWidget);
-  const auto task = make_intrusive<HqTransformTask>(this, m_image, xform, viewport()->size());
+  // Tasks are executed in the order they are enqueued,
+  // so the tiles closest to the point of interest go first.
+  QPointF focus(viewport()->mapFromGlobal(QCursor::pos()));
+  if (!viewport()->rect().contains(focus.toPoint())) {
+    focus = QRectF(viewport()->rect()).center();
+  }
+  focus -= grid_origin;
 
-  backgroundExecutor().enqueueTask(task);
+  const auto distance_to_focus = [&focus](const QPoint& tile) {
+    const QPointF center((tile.x() + 0.5) * HQ_TILE_SIZE, (tile.y() + 0.5) * HQ_TILE_SIZE);
+    const QPointF vec(center - focus);
 
-  m_hqTransformTask = task;
-  m_hqXform = xform;
-  m_hqSourceId = m_image.cacheKey();
-}
+    return vec.x() * vec.x() + vec.y() * vec.y();
+  };
+  std::sort(missing_tiles.begin(), missing_tiles.end(), [&distance_to_focus](const QPoint& lhs, const QPoint& rhs) {
+    return distance_to_focus(lhs) < distance_to_focus(rhs);
+  });
+
+  for (const QPoint& tile : missing_tiles) {
+    const TilePixmapCache::Key key(m_hqSourceId, grid, tile);
+    const QRect tile_rect(tile * HQ_TILE_SIZE, QSize(HQ_TILE_SIZE, HQ_TILE_SIZE));
+    const auto task = make_intrusive<HqTileTask>(this, m_pyramid, key, tile_rect);
+
+    backgroundExecutor().enqueueTask(task);
+
+    m_pendingTiles.emplace(key, task);
+  }
+}  // ImageViewBase::initiateBuildingHqVersion
 
 /**
- * Gets called from HqTransformationTask::Result.
+ * Gets called from HqTileTask::Result.
  */
-void ImageViewBase::hqVersionBuilt(const QPoint& origin, const QImage& image) {
-  if (!m_hqTransformEnabled) {
+void ImageViewBase::hqTileBuilt(const TilePixmapCache::Key& key, const QImage& image) {
+  m_pendingTiles.erase(key);
+
+  if (!m_hqTransformEnabled || (key.sourceId != m_hqSourceId)) {
     return;
   }
 
-  m_hqPixmap = QPixmap::fromImage(image);
-  m_hqPixmapPos = origin;
-  m_hqTransformTask.reset();
-  update();
+  ImageViewCache::instance().hqTiles().insert(key, QPixmap::fromImage(image));
+
+  QPoint grid_origin;
+  if (currentTileGrid(grid_origin) == key.grid) {
+    viewport()->update(QRect(grid_origin + key.tile * HQ_TILE_SIZE, image.size()));
+  }
 }
 
 void ImageViewBase::updateStatusTipAndCursor() {
@@ -1011,49 +1149,50 @@ ImageViewInfoProvider& ImageViewBase::infoProvider() {
   return m_infoProvider;
 }
 
-/*==================== ImageViewBase::HqTransformTask ======================*/
+/*======================= ImageViewBase::HqTileTask ========================*/
 
-ImageViewBase::HqTransformTask::HqTransformTask(ImageViewBase* image_view,
-                                                const QImage& image,
-                                                const QTransform& xform,
-                                                const QSize& target_size)
-    : m_result(new Result(image_view)), m_image(image), m_xform(xform), m_targetSize(target_size) {}
+ImageViewBase::HqTileTask::HqTileTask(ImageViewBase* image_view,
+                                      const intrusive_ptr<ImagePyramid>& pyramid,
+                                      const TilePixmapCache::Key& key,
+                                      const QRect& tile_rect)
+    : m_result(new Result(image_view, key)), m_pyramid(pyramid), m_xform(key.grid), m_tileRect(tile_rect) {}
 
-intrusive_ptr<AbstractCommand<void>> ImageViewBase::HqTransformTask::operator()() {
+intrusive_ptr<AbstractCommand<void>> ImageViewBase::HqTileTask::operator()() {
   if (isCancelled()) {
     return nullptr;
   }
 
-  const QRect target_rect(
-      m_xform.map(QRectF(m_image.rect())).boundingRect().toRect().intersected(QRect(QPoint(0, 0), m_targetSize)));
+  const double scale = std::sqrt(std::fabs(m_xform.determinant()));
+  QTransform level_to_image;
+  const QImage level(m_pyramid->levelForScale(scale, level_to_image));
 
-  QImage hq_image(
-      transform(m_image, m_xform, target_rect, OutsidePixels::assumeWeakColor(Qt::white), QSizeF(0.0, 0.0)));
+  QImage hq_image(transform(level, level_to_image * m_xform, m_tileRect, OutsidePixels::assumeWeakColor(Qt::white),
+                            QSizeF(0.0, 0.0)));
 
-  // In many cases m_image and therefore hq_image are grayscale with
+  // In many cases the source image and therefore hq_image are grayscale with
   // a palette, but given that hq_image will be converted to a QPixmap
   // on the GUI thread, it's better to convert it to RGB as a preparation
   // step while we are still in a background thread.
   hq_image = hq_image.convertToFormat(hq_image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
                                                                  : QImage::Format_RGB32);
 
-  m_result->setData(target_rect.topLeft(), hq_image);
+  m_result->setData(hq_image);
 
   return m_result;
 }
 
-/*================ ImageViewBase::HqTransformTask::Result ================*/
+/*=================== ImageViewBase::HqTileTask::Result ====================*/
 
-ImageViewBase::HqTransformTask::Result::Result(ImageViewBase* image_view) : m_imageView(image_view) {}
+ImageViewBase::HqTileTask::Result::Result(ImageViewBase* image_view, const TilePixmapCache::Key& key)
+    : m_imageView(image_view), m_key(key) {}
 
-void ImageViewBase::HqTransformTask::Result::setData(const QPoint& origin, const QImage& hq_image) {
+void ImageViewBase::HqTileTask::Result::setData(const QImage& hq_image) {
   m_hqImage = hq_image;
-  m_origin = origin;
 }
 
-void ImageViewBase::HqTransformTask::Result::operator()() {
+void ImageViewBase::HqTileTask::Result::operator()() {
   if (m_imageView && !isCancelled()) {
-    m_imageView->hqVersionBuilt(m_origin, m_hqImage);
+    m_imageView->hqTileBuilt(m_key, m_hqImage);
   }
 }
 
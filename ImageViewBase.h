@@ -31,16 +31,20 @@
 #include <QTransform>
 #include <QWidget>
 #include <Qt>
+#include <unordered_map>
+#include <vector>
 #include "ImagePixmapUnion.h"
 #include "ImageViewInfoProvider.h"
 #include "InteractionHandler.h"
 #include "InteractionState.h"
 #include "Margins.h"
+#include "TilePixmapCache.h"
 #include "intrusive_ptr.h"
 
 class QPainter;
 class BackgroundExecutor;
 class ImagePresentation;
+class ImagePyramid;
 
 /**
  * \brief The base class for widgets that display and manipulate images.
@@ -279,7 +283,7 @@ class ImageViewBase : public QAbstractScrollArea {
   void reactToScrollBars();
 
  private:
-  class HqTransformTask;
+  class HqTileTask;
   class TempFocalPointAdjuster;
 
   class TransformChangeWatcher;
@@ -300,11 +304,17 @@ class ImageViewBase : public QAbstractScrollArea {
 
   QPointF centeredWidgetFocalPoint() const;
 
-  bool validateHqPixmap() const;
+  QTransform currentTileGrid(QPoint& grid_origin) const;
+
+  std::vector<QPoint> visibleTiles(const QPoint& grid_origin) const;
+
+  bool collectHqTiles(std::vector<std::pair<QPoint, QPixmap>>& tiles);
 
   void scheduleHqVersionRebuild();
 
-  void hqVersionBuilt(const QPoint& origin, const QImage& image);
+  void cancelHqTiles(const QTransform* grid_to_keep = nullptr);
+
+  void hqTileBuilt(const TilePixmapCache::Key& key, const QImage& image);
 
   void updateStatusTipAndCursor();
 
@@ -337,37 +347,30 @@ class ImageViewBase : public QAbstractScrollArea {
   QPixmap m_pixmap;
 
   /**
-   * The high quality, pre-transformed version of m_pixmap.
+   * Progressively downscaled versions of m_image, shared with
+   * the background tasks building high quality tiles.
    */
-  QPixmap m_hqPixmap;
+  intrusive_ptr<ImagePyramid> m_pyramid;
 
   /**
-   * The position, in widget coordinates, where m_hqPixmap is to be drawn.
+   * Tiles that are being built in background.
    */
-  QPoint m_hqPixmapPos;
+  std::unordered_map<TilePixmapCache::Key, intrusive_ptr<HqTileTask>, TilePixmapCache::KeyHash> m_pendingTiles;
 
   /**
-   * The transformation used to build m_hqPixmap.
-   * It's used to detect if m_hqPixmap needs to be rebuild.
-   */
-  QTransform m_hqXform;
-
-  /**
-   * Used to check if we need to extend the delay before building m_hqPixmap.
+   * Used to check if pending tiles became obsolete due to zooming.
    */
   QTransform m_potentialHqXform;
 
   /**
-   * The ID (QImage::cacheKey()) of the image that was used
-   * to build m_hqPixmap.  It's used to detect if m_hqPixmap
-   * needs to be rebuilt.
-   */
-  qint64 m_hqSourceId;
-
-  /**
-   * The pending (if any) high quality transformation task.
+   * The content identifier of m_image, as given by ImageViewCache.
+   * High quality, pre-transformed tiles of m_image are cached under it
+   * in ImageViewCache::hqTiles().  Tiles of different zoom levels coexist
+   * there, so that going back to a recently used zoom level, panning over
+   * a recently seen area, or coming back to a recently viewed page doesn't
+   * require rebuilding.
    */
-  intrusive_ptr<HqTransformTask> m_hqTransformTask;
+  const qint64 m_hqSourceId;
 
   /**
    * Transformation from m_pixmap coordinates to m_image coordinates.
@@ -0,0 +1,116 @@
+
+#include "ImageViewCache.h"
+#include <QCoreApplication>
+#include <QTransform>
+#include <cstring>
+
+namespace {
+/**
+ * The memory budget for downscaled pixmaps.  At 200 DPI, a color
+ * page takes around 16MB, a black and white one 4 times less.
+ */
+const qint64 DOWNSCALED_PIXMAPS_BYTES = 128 * 1024 * 1024;
+
+/**
+ * The memory budget for high quality tiles of all the image views.
+ */
+const qint64 HQ_TILES_BYTES = 128 * 1024 * 1024;
+
+/**
+ * The number of QImage::cacheKey() values to remember the source ids of.
+ */
+const size_t MAX_REMEMBERED_CACHE_KEYS = 256;
+
+inline quint64 mix(quint64 hash, const quint64 word) {
+  hash ^= word;
+  hash *= 0x9E3779B97F4A7C15ull;
+
+  return hash ^ (hash >> 32);
+}
+
+TilePixmapCache::Key downscaledPixmapKey(const qint64 source_id) {
+  return TilePixmapCache::Key(source_id, QTransform(), QPoint(0, 0));
+}
+}  // namespace
+
+ImageViewCache::ImageViewCache() : m_downscaledPixmaps(DOWNSCALED_PIXMAPS_BYTES), m_hqTiles(HQ_TILES_BYTES) {}
+
+ImageViewCache& ImageViewCache::instance() {
+  static ImageViewCache* object = nullptr;
+  if (!object) {
+    object = new ImageViewCache();
+    // Pixmaps must not outlive the application object.
+    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, []() { object->clear(); });
+  }
+
+  return *object;
+}
+
+qint64 ImageViewCache::sourceId(const QImage& image) {
+  const auto it = m_sourceIdsByCacheKey.find(image.cacheKey());
+  if (it != m_sourceIdsByCacheKey.end()) {
+    return it->second;
+  }
+
+  if (m_sourceIdsByCacheKey.size() >= MAX_REMEMBERED_CACHE_KEYS) {
+    m_sourceIdsByCacheKey.clear();
+  }
+
+  const qint64 source_id = hashImage(image);
+  m_sourceIdsByCacheKey[image.cacheKey()] = source_id;
+
+  return source_id;
+}
+
+const QPixmap* ImageViewCache::findDownscaledPixmap(const qint64 source_id) {
+  return m_downscaledPixmaps.find(downscaledPixmapKey(source_id));
+}
+
+void ImageViewCache::insertDownscaledPixmap(const qint64 source_id, const QPixmap& pixmap) {
+  m_downscaledPixmaps.insert(downscaledPixmapKey(source_id), pixmap);
+}
+
+void ImageViewCache::clear() {
+  m_downscaledPixmaps.clear();
+  m_hqTiles.clear();
+  m_sourceIdsByCacheKey.clear();
+}
+
+qint64 ImageViewCache::hashImage(const QImage& image) {
+  quint64 hash = mix(0, static_cast<quint64>(image.format()));
+  hash = mix(hash, (static_cast<quint64>(image.width()) << 32) | static_cast<quint32>(image.height()));
+  for (const QRgb color : image.colorTable()) {
+    hash = mix(hash, color);
+  }
+
+  // Padding bits and bytes at the end of lines are excluded, as they are undefined.
+  const int line_bits = image.width() * image.depth();
+  const int full_bytes = line_bits / 8;
+  const int trailing_bits = line_bits % 8;
+  uchar trailing_mask = 0;
+  if (trailing_bits != 0) {
+    trailing_mask = (image.format() == QImage::Format_MonoLSB) ? static_cast<uchar>((1 << trailing_bits) - 1)
+                                                               : static_cast<uchar>(0xff << (8 - trailing_bits));
+  }
+
+  for (int y = 0; y < image.height(); ++y) {
+    const uchar* line = image.constScanLine(y);
+    int i = 0;
+    for (; i + 8 <= full_bytes; i += 8) {
+      quint64 word;
+      std::memcpy(&word, line + i, sizeof(word));
+      hash = mix(hash, word);
+    }
+
+    quint64 tail = 0;
+    for (; i < full_bytes; ++i) {
+      tail = (tail << 8) | line[i];
+    }
+    if (trailing_mask != 0) {
+      tail = (tail << 8) | (line[full_bytes] & trailing_mask);
+    }
+    hash = mix(hash, tail);
+  }
+
+  return static_cast<qint64>(hash);
+}  // ImageViewCache::hashImage
@@ -0,0 +1,69 @@
+
+#ifndef SCANTAILOR_IMAGEVIEWCACHE_H
+#define SCANTAILOR_IMAGEVIEWCACHE_H
+
+#include <QImage>
+#include <QPixmap>
+#include <unordered_map>
+#include "NonCopyable.h"
+#include "TilePixmapCache.h"
+
+/**
+ * \brief Keeps the pixmaps prepared by image views of recently viewed pages.
+ *
+ * Every time a page or a tab is switched to, a new image view gets created
+ * for a freshly produced (or reloaded from disk) image.  In most cases though,
+ * the image is identical to the one displayed a moment ago.  Pixmaps are
+ * therefore cached by the image content rather than by QImage::cacheKey(),
+ * which lets new views pick up the downscaled pixmap and the high quality
+ * tiles of an older view of the same image.
+ *
+ * To be used from the GUI thread only.
+ */
+class ImageViewCache {
+  DECLARE_NON_COPYABLE(ImageViewCache)
+
+ public:
+  static ImageViewCache& instance();
+
+  /**
+   * \brief Returns an identifier of the image content.
+   *
+   * Images with equal pixels, dimensions, format and color table
+   * get the same identifier.  Hashing the pixels is only done once
+   * for a given QImage::cacheKey().
+   */
+  qint64 sourceId(const QImage& image);
+
+  /**
+   * \return A pointer to the cached downscaled pixmap of an image,
+   *         or null if there isn't one.  The pointer stays valid until
+   *         the next call to insertDownscaledPixmap() or clear().
+   */
+  const QPixmap* findDownscaledPixmap(qint64 source_id);
+
+  void insertDownscaledPixmap(qint64 source_id, const QPixmap& pixmap);
+
+  /**
+   * High quality tiles of all the image views, keyed by source id.
+   */
+  TilePixmapCache& hqTiles() { return m_hqTiles; }
+
+  void clear();
+
+ private:
+  ImageViewCache();
+
+  static qint64 hashImage(const QImage& image);
+
+  /**
+   * Whole downscaled pixmaps, each stored as a single tile at the origin
+   * of an identity grid.
+   */
+  TilePixmapCache m_downscaledPixmaps;
+  TilePixmapCache m_hqTiles;
+  std::unordered_map<qint64, qint64> m_sourceIdsByCacheKey;
+};
+
+
+#endif  // SCANTAILOR_IMAGEVIEWCACHE_H
@@ -21,6 +21,7 @@
 #include <QFile>
 #include <QTextDocument>
 #include "AbstractFilter.h"
+#include "CommandLine.h"
 #include "Dpm.h"
 #include "ErrorWidget.h"
 #include "FilterData.h"
@@ -75,7 +76,9 @@ FilterResultPtr LoadFileTask::operator()() {
     } else {
       updateImageSizeIfChanged(image);
       overrideDpi(image);
-      m_thumbnailCache->ensureThumbnailExists(m_imageId, image);
+      if ((type() != BATCH) || !CommandLine::get().isHeadlessProfile()) {
+        m_thumbnailCache->ensureThumbnailExists(m_imageId, image);
+      }
 
       return m_nextTask->process(*this, FilterData(image));
     }
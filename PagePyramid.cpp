@@ -0,0 +1,112 @@
+
+#include "PagePyramid.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include "imageproc/Constants.h"
+#include "imageproc/Scale.h"
+
+using namespace imageproc;
+
+PagePyramid::PagePyramid(const GrayImage& image) : m_fullRes(image), m_darkest(-1), m_lightest(-1) {}
+
+std::pair<double, double> PagePyramid::levelScale(const int dpi) const {
+  const int dpm_x = m_fullRes.dotsPerMeterX();
+  const int dpm_y = m_fullRes.dotsPerMeterY();
+  if ((dpm_x <= 0) || (dpm_y <= 0)) {
+    return std::make_pair(1.0, 1.0);
+  }
+
+  const double xfactor = (dpi * constants::DPI2DPM) / dpm_x;
+  const double yfactor = (dpi * constants::DPI2DPM) / dpm_y;
+  if ((xfactor > 0.9) || (yfactor > 0.9)) {
+    return std::make_pair(1.0, 1.0);
+  }
+
+  return std::make_pair(xfactor, yfactor);
+}
+
+const PagePyramid::GrayLevel& PagePyramid::grayLevelLocked(const int dpi) const {
+  const auto it = m_grayLevels.find(dpi);
+  if (it != m_grayLevels.end()) {
+    return it->second;
+  }
+
+  GrayLevel level;
+  const std::pair<double, double> scale(levelScale(dpi));
+  if ((scale.first == 1.0) && (scale.second == 1.0)) {
+    level.image = m_fullRes;
+  } else {
+    const QSize size(std::max(1, (int) std::ceil(scale.first * m_fullRes.width())),
+                     std::max(1, (int) std::ceil(scale.second * m_fullRes.height())));
+    level.image = scaleToGray(m_fullRes, size);
+    level.origToLevel.scale(scale.first, scale.second);
+  }
+
+  return m_grayLevels.emplace(dpi, level).first->second;
+}
+
+GrayImage PagePyramid::grayLevel(const int dpi, QTransform* orig_to_level) const {
+  const QMutexLocker locker(&m_mutex);
+
+  const GrayLevel& level = grayLevelLocked(dpi);
+  if (orig_to_level) {
+    *orig_to_level = level.origToLevel;
+  }
+
+  return level.image;
+}
+
+BinaryImage PagePyramid::binaryLevel(const int dpi, const BinaryThreshold threshold, QTransform* orig_to_level) const {
+  const QMutexLocker locker(&m_mutex);
+
+  const GrayLevel& level = grayLevelLocked(dpi);
+  if (orig_to_level) {
+    *orig_to_level = level.origToLevel;
+  }
+
+  const std::pair<int, int> key(dpi, int(threshold));
+  auto it = m_binaryLevels.find(key);
+  if (it == m_binaryLevels.end()) {
+    it = m_binaryLevels.emplace(key, BinaryImage(level.image, threshold)).first;
+  }
+
+  return it->second;
+}
+
+uint8_t PagePyramid::darkestGrayLevel() const {
+  const QMutexLocker locker(&m_mutex);
+  calcGrayRangeLocked();
+
+  return static_cast<uint8_t>(m_darkest);
+}
+
+uint8_t PagePyramid::lightestGrayLevel() const {
+  const QMutexLocker locker(&m_mutex);
+  calcGrayRangeLocked();
+
+  return static_cast<uint8_t>(m_lightest);
+}
+
+void PagePyramid::calcGrayRangeLocked() const {
+  if (m_darkest >= 0) {
+    return;
+  }
+
+  const int width = m_fullRes.width();
+  const int height = m_fullRes.height();
+  const uint8_t* line = m_fullRes.data();
+  const int stride = m_fullRes.stride();
+
+  uint8_t darkest = 0xff;
+  uint8_t lightest = 0x00;
+  for (int y = 0; y < height; ++y, line += stride) {
+    for (int x = 0; x < width; ++x) {
+      darkest = std::min(darkest, line[x]);
+      lightest = std::max(lightest, line[x]);
+    }
+  }
+
+  m_darkest = darkest;
+  m_lightest = lightest;
+}
@@ -0,0 +1,95 @@
+
+#ifndef SCANTAILOR_PAGEPYRAMID_H
+#define SCANTAILOR_PAGEPYRAMID_H
+
+#include <QMutex>
+#include <QTransform>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include "NonCopyable.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BinaryThreshold.h"
+#include "imageproc/GrayImage.h"
+#include "ref_countable.h"
+
+/**
+ * \brief Reduced resolution versions of a grayscale page image, shared
+ *        by the analysis stages.
+ *
+ * Analysis stages don't need the full resolution of the page, yet they used
+ * to build their own downscaled and binarized copies of it.  The pyramid
+ * builds each such level once, on first request, and keeps it for as long
+ * as the pyramid lives, which is as long as any FilterData referring to it.
+ *
+ * Levels are in the coordinates of the original image, not transformed by
+ * any of the ImageTransformation's, so they are valid for every stage.
+ *
+ * All the public methods are thread-safe.
+ */
+class PagePyramid : public ref_countable {
+  DECLARE_NON_COPYABLE(PagePyramid)
+
+ public:
+  /**
+   * \param image The full resolution grayscale image, with its DPM set.
+   */
+  explicit PagePyramid(const imageproc::GrayImage& image);
+
+  const imageproc::GrayImage& fullResolution() const { return m_fullRes; }
+
+  /**
+   * \brief Returns the image at the given resolution.
+   *
+   * The image is never upscaled.  If its resolution is below the requested
+   * one or is within 10% of it, the full resolution image is returned.
+   *
+   * \param dpi The requested resolution.
+   * \param[out] orig_to_level If not null, receives the transformation from
+   *             the full resolution image coordinates to the level's ones.
+   */
+  imageproc::GrayImage grayLevel(int dpi, QTransform* orig_to_level = nullptr) const;
+
+  /**
+   * \brief Returns grayLevel(dpi) binarized with the given threshold.
+   */
+  imageproc::BinaryImage binaryLevel(int dpi,
+                                     imageproc::BinaryThreshold threshold,
+                                     QTransform* orig_to_level = nullptr) const;
+
+  /**
+   * \brief Returns the darkest gray level of the full resolution image.
+   */
+  uint8_t darkestGrayLevel() const;
+
+  /**
+   * \brief Returns the lightest gray level of the full resolution image.
+   */
+  uint8_t lightestGrayLevel() const;
+
+ private:
+  struct GrayLevel {
+    imageproc::GrayImage image;
+    QTransform origToLevel;
+  };
+
+  /**
+   * Returns the scaling factors for the given resolution, or (1, 1)
+   * for the full resolution.
+   */
+  std::pair<double, double> levelScale(int dpi) const;
+
+  const GrayLevel& grayLevelLocked(int dpi) const;
+
+  void calcGrayRangeLocked() const;
+
+  const imageproc::GrayImage m_fullRes;
+  mutable QMutex m_mutex;
+  mutable std::map<int, GrayLevel> m_grayLevels;
+  mutable std::map<std::pair<int, int>, imageproc::BinaryImage> m_binaryLevels;
+  mutable int m_darkest;
+  mutable int m_lightest;
+};
+
+
+#endif  // SCANTAILOR_PAGEPYRAMID_H
@@ -17,67 +17,65 @@
  */
 
 #include "ProcessingTaskQueue.h"
+#include <iterator>
 
 ProcessingTaskQueue::Entry::Entry(const PageInfo& page_info, const BackgroundTaskPtr& tsk)
     : pageInfo(page_info), task(tsk), takenForProcessing(false) {}
 
-ProcessingTaskQueue::ProcessingTaskQueue() = default;
+ProcessingTaskQueue::ProcessingTaskQueue()
+    : m_queue(m_entries.get<QueueTag>()),
+      m_tasksByKey(m_entries.get<TaskTag>()),
+      m_tasksByPage(m_entries.get<PageTag>()),
+      m_firstNotTaken(m_queue.end()) {}
 
 void ProcessingTaskQueue::addProcessingTask(const PageInfo& page_info, const BackgroundTaskPtr& task) {
-  m_queue.emplace_back(page_info, task);
+  const QMutexLocker locker(&m_mutex);
+
+  const auto result(m_queue.emplace_back(page_info, task));
+  if (result.second && (m_firstNotTaken == m_queue.end())) {
+    m_firstNotTaken = result.first;
+  }
   m_pageToSelectWhenDone = PageInfo();
 }
 
 BackgroundTaskPtr ProcessingTaskQueue::takeForProcessing() {
-  for (Entry& ent : m_queue) {
-    if (!ent.takenForProcessing) {
-      ent.takenForProcessing = true;
+  const QMutexLocker locker(&m_mutex);
 
-      if (m_selectedPage.isNull()) {
-        // In this mode we select the most recently submitted for processing page.
-        // This means question marks on selected pages, but at least this avoids
-        // jumps caused by dynamic ordering.
-        m_selectedPage = ent.pageInfo;
-      }
+  if (m_firstNotTaken == m_queue.end()) {
+    return nullptr;
+  }
 
-      return ent.task;
-    }
+  const Entry& ent = *m_firstNotTaken;
+  ++m_firstNotTaken;
+  ent.takenForProcessing = true;
+
+  if (m_selectedPage.isNull()) {
+    // In this mode we select the most recently submitted for processing page.
+    // This means question marks on selected pages, but at least this avoids
+    // jumps caused by dynamic ordering.
+    m_selectedPage = ent.pageInfo;
   }
 
-  return nullptr;
+  return ent.task;
 }
 
 void ProcessingTaskQueue::processingFinished(const BackgroundTaskPtr& task) {
-  auto it(m_queue.begin());
-  const auto end(m_queue.end());
+  const QMutexLocker locker(&m_mutex);
 
-  for (;; ++it) {
-    if (it == end) {
-      // Task not found.
-      return;
-    }
-
-    if (!it->takenForProcessing) {
-      // There is no point in looking further.
-      return;
-    }
-
-    if (it->task == task) {
-      break;
-    }
+  const auto k_it(m_tasksByKey.find(task.get()));
+  if ((k_it == m_tasksByKey.end()) || !k_it->takenForProcessing) {
+    return;
   }
 
+  const Queue::iterator it(m_entries.project<QueueTag>(k_it));
+  const PageInfo page_info(it->pageInfo);
+  const bool removing_selected_page = (m_selectedPage.id() == page_info.id());
 
-  const bool removing_selected_page = (m_selectedPage.id() == it->pageInfo.id());
-
-  auto next_it(it);
-  ++next_it;
-
-  if ((next_it == end) && m_pageToSelectWhenDone.isNull()) {
-    m_pageToSelectWhenDone = it->pageInfo;
+  if ((std::next(it) == m_queue.end()) && m_pageToSelectWhenDone.isNull()) {
+    m_pageToSelectWhenDone = page_info;
   }
 
-  m_queue.erase(it);
+  eraseLocked(it);
 
   if (removing_selected_page) {
     if (!m_queue.empty()) {
@@ -89,41 +87,53 @@ void ProcessingTaskQueue::processingFinished(const BackgroundTaskPtr& task) {
 }  // ProcessingTaskQueue::processingFinished
 
 PageInfo ProcessingTaskQueue::selectedPage() const {
+  const QMutexLocker locker(&m_mutex);
+
   return m_selectedPage;
 }
 
 bool ProcessingTaskQueue::allProcessed() const {
+  const QMutexLocker locker(&m_mutex);
+
   return m_queue.empty();
 }
 
 void ProcessingTaskQueue::cancelAndRemove(const std::set<PageId>& pages) {
-  auto it(m_queue.begin());
-  const auto end(m_queue.end());
-  while (it != end) {
-    if (pages.find(it->pageInfo.id()) == pages.end()) {
-      ++it;
-    } else {
-      if (it->takenForProcessing) {
-        it->task->cancel();
+  const QMutexLocker locker(&m_mutex);
+
+  for (const PageId& page_id : pages) {
+    const auto range(m_tasksByPage.equal_range(page_id));
+    for (auto p_it = range.first; p_it != range.second;) {
+      if (p_it->takenForProcessing) {
+        p_it->task->cancel();
       }
 
-      if (m_selectedPage.id() == it->pageInfo.id()) {
+      if (m_selectedPage.id() == page_id) {
         m_selectedPage = PageInfo();
       }
 
-
-      m_queue.erase(it++);
+      eraseLocked(m_entries.project<QueueTag>(p_it++));
     }
   }
 }
 
 void ProcessingTaskQueue::cancelAndClear() {
-  while (!m_queue.empty()) {
-    Entry& ent = m_queue.front();
-    if (ent.takenForProcessing) {
-      ent.task->cancel();
+  const QMutexLocker locker(&m_mutex);
+
+  for (const Entry& ent : m_queue) {
+    if (!ent.takenForProcessing) {
+      break;
     }
-    m_queue.pop_front();
+    ent.task->cancel();
   }
+  m_entries.clear();
+  m_firstNotTaken = m_queue.end();
   m_selectedPage = m_pageToSelectWhenDone;
 }
+
+void ProcessingTaskQueue::eraseLocked(const Queue::iterator it) {
+  if (it == m_firstNotTaken) {
+    ++m_firstNotTaken;
+  }
+  m_queue.erase(it);
+}
@@ -19,13 +19,24 @@
 #ifndef PROCESSING_TASK_QUEUE_H_
 #define PROCESSING_TASK_QUEUE_H_
 
-#include <list>
+#include <QMutex>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index_container.hpp>
 #include <set>
 #include "BackgroundTask.h"
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "PageInfo.h"
 
+/**
+ * \brief A queue of page processing tasks.
+ *
+ * Tasks are taken in the order they were added, and finished or cancelled
+ * in any order, each in constant time.  All the methods are thread-safe,
+ * so worker threads may take tasks from the queue directly.
+ */
 class ProcessingTaskQueue {
   DECLARE_NON_COPYABLE(ProcessingTaskQueue)
 
@@ -62,12 +73,50 @@ class ProcessingTaskQueue {
   struct Entry {
     PageInfo pageInfo;
     BackgroundTaskPtr task;
-    bool takenForProcessing;
+    mutable bool takenForProcessing;
 
     Entry(const PageInfo& page_info, const BackgroundTaskPtr& task);
+
+    BackgroundTask* taskKey() const { return task.get(); }
+
+    PageId pageKey() const { return pageInfo.id(); }
   };
 
-  std::list<Entry> m_queue;
+  class QueueTag;
+  class TaskTag;
+  class PageTag;
+
+  typedef boost::multi_index::multi_index_container<
+      Entry,
+      boost::multi_index::indexed_by<
+          boost::multi_index::sequenced<boost::multi_index::tag<QueueTag>>,
+          boost::multi_index::hashed_unique<boost::multi_index::tag<TaskTag>,
+                                            boost::multi_index::const_mem_fun<Entry, BackgroundTask*, &Entry::taskKey>>,
+          boost::multi_index::hashed_non_unique<boost::multi_index::tag<PageTag>,
+                                                boost::multi_index::const_mem_fun<Entry, PageId, &Entry::pageKey>,
+                                                std::hash<PageId>>>>
+      Container;
+
+  typedef Container::index<QueueTag>::type Queue;
+  typedef Container::index<TaskTag>::type TasksByKey;
+  typedef Container::index<PageTag>::type TasksByPage;
+
+  /**
+   * Removes an entry, keeping m_firstNotTaken valid.
+   */
+  void eraseLocked(Queue::iterator it);
+
+  mutable QMutex m_mutex;
+  Container m_entries;
+  Queue& m_queue;
+  TasksByKey& m_tasksByKey;
+  TasksByPage& m_tasksByPage;
+  /**
+   * Entries taken for processing always precede the rest of them,
+   * as tasks are taken in order and only entries get removed.
+   * This points to the first entry not taken, or to the end of the queue.
+   */
+  Queue::iterator m_firstNotTaken;
   PageInfo m_selectedPage;
   PageInfo m_pageToSelectWhenDone;
 };
@@ -33,7 +33,6 @@
 #include "ImageLoader.h"
 #include "OutOfMemoryHandler.h"
 #include "RelinkablePath.h"
-#include "imageproc/GrayImage.h"
 #include "imageproc/Scale.h"
 
 using namespace ::boost;
@@ -116,6 +115,8 @@ class ThumbnailPixmapCache::Impl : public QThread {
 
   void recreateThumbnail(const ImageId& image_id, const QImage& image);
 
+  void discardThumbnail(const ImageId& image_id);
+
  protected:
   void run() override;
 
@@ -158,6 +159,11 @@ class ThumbnailPixmapCache::Impl : public QThread {
 
   static QImage makeThumbnail(const QImage& image, const QSize& max_thumb_size);
 
+  /**
+   * Drops a loaded pixmap after its thumbnail file was replaced or removed.
+   */
+  void forgetItem(const ImageId& image_id);
+
   void queuedToInProgress(const LoadQueue::iterator& lq_it);
 
   void postLoadResult(const LoadQueue::iterator& lq_it, const QImage& image, ThumbnailLoadResult::Status status);
@@ -285,6 +291,10 @@ void ThumbnailPixmapCache::recreateThumbnail(const ImageId& image_id, const QIma
   m_impl->recreateThumbnail(image_id, image);
 }
 
+void ThumbnailPixmapCache::discardThumbnail(const ImageId& image_id) {
+  m_impl->discardThumbnail(image_id);
+}
+
 void ThumbnailPixmapCache::setMaxThumbSize(const QSize& max_size) {
   m_impl->setMaxThumbSize(max_size);
 }
@@ -506,7 +516,29 @@ void ThumbnailPixmapCache::Impl::recreateThumbnail(const ImageId& image_id, cons
     return;
   }
 
-  const QMutexLocker locker2(&m_mutex);
+  forgetItem(image_id);
+}  // ThumbnailPixmapCache::Impl::recreateThumbnail
+
+void ThumbnailPixmapCache::Impl::discardThumbnail(const ImageId& image_id) {
+  if (m_shuttingDown) {
+    return;
+  }
+
+  QMutexLocker locker(&m_mutex);
+  const QString thumb_dir(m_thumbDir);
+  const QSize max_thumb_size(m_maxThumbSize);
+  locker.unlock();
+
+  const QString thumb_file_path(getThumbFilePath(image_id, thumb_dir, max_thumb_size));
+  if (QFile::exists(thumb_file_path) && !QFile::remove(thumb_file_path)) {
+    return;
+  }
+
+  forgetItem(image_id);
+}
+
+void ThumbnailPixmapCache::Impl::forgetItem(const ImageId& image_id) {
+  const QMutexLocker locker(&m_mutex);
 
   const ItemsByKey::iterator k_it(m_itemsByKey.find(image_id));
   if (k_it == m_itemsByKey.end()) {
@@ -529,7 +561,7 @@ void ThumbnailPixmapCache::Impl::recreateThumbnail(const ImageId& image_id, cons
       // (or failed to load) before we wrote the new version.
       break;
   }
-}  // ThumbnailPixmapCache::Impl::recreateThumbnail
+}
 
 void ThumbnailPixmapCache::Impl::run() {
   backgroundProcessing();
@@ -658,12 +690,8 @@ QImage ThumbnailPixmapCache::Impl::makeThumbnail(const QImage& image, const QSiz
   QSize to_size(image.size());
   to_size.scale(max_thumb_size, Qt::KeepAspectRatio);
 
-  if ((image.format() == QImage::Format_Indexed8) && image.isGrayscale()) {
-    // This will be faster than QImage::scale().
-    return scaleToGray(GrayImage(image), to_size);
-  }
-
-  return image.scaled(to_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+  // This will be faster than QImage::scaled().
+  return scaleByArea(image, to_size);
 }
 
 void ThumbnailPixmapCache::Impl::queuedToInProgress(const LoadQueue::iterator& lq_it) {
@@ -148,6 +148,16 @@ class ThumbnailPixmapCache : public ref_countable {
    */
   void recreateThumbnail(const ImageId& image_id, const QImage& image);
 
+  /**
+   * \brief Removes the existing thumbnail, so that it's re-created from
+   *        the full size image when requested next time.
+   *
+   * \param image_id The identifier of the full size image and its thumbnail.
+   *
+   * \note This function may be called from any thread, even concurrently.
+   */
+  void discardThumbnail(const ImageId& image_id);
+
  private:
   class Item;
   class Impl;
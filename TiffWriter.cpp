@@ -26,6 +26,7 @@
 #include "Dpm.h"
 #include "imageproc/Constants.h"
 #include "imageproc/Grayscale.h"
+#include "imageproc/ScanlineConversion.h"
 
 /**
  * m_reverseBitsLUT[byte] gives the same byte, but with bit order reversed.
@@ -295,17 +296,9 @@ bool TiffWriter::writeRGB32Image(const TiffHandle& tif, const QImage& image) {
 
   // Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
 
+  const imageproc::ScanlineConverter& converter = imageproc::ScanlineConverter::instance();
   for (int y = 0; y < height; ++y) {
-    const auto* p_src = (const uint32_t*) image.scanLine(y);
-    uint8_t* p_dst = &tmp_line[0];
-    for (int x = 0; x < width; ++x) {
-      const uint32_t ARGB = *p_src;
-      p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-      p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-      p_dst[2] = static_cast<uint8_t>(ARGB);
-      ++p_src;
-      p_dst += 3;
-    }
+    converter.rgb32ToRgb24((const uint32_t*) image.scanLine(y), &tmp_line[0], width);
     if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
       return false;
     }
@@ -330,18 +323,9 @@ bool TiffWriter::writeARGB32Image(const TiffHandle& tif, const QImage& image) {
 
   // Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
 
+  const imageproc::ScanlineConverter& converter = imageproc::ScanlineConverter::instance();
   for (int y = 0; y < height; ++y) {
-    const auto* p_src = (const uint32_t*) image.scanLine(y);
-    uint8_t* p_dst = &tmp_line[0];
-    for (int x = 0; x < width; ++x) {
-      const uint32_t ARGB = *p_src;
-      p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-      p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-      p_dst[2] = static_cast<uint8_t>(ARGB);
-      p_dst[3] = static_cast<uint8_t>(ARGB >> 24);
-      ++p_src;
-      p_dst += 4;
-    }
+    converter.argb32ToRgba32((const uint32_t*) image.scanLine(y), &tmp_line[0], width);
     if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
       return false;
     }
@@ -0,0 +1,133 @@
+
+#include "TilePixmapCache.h"
+#include <QHash>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index_container.hpp>
+
+using namespace ::boost::multi_index;
+
+namespace {
+qint64 pixmapBytes(const QPixmap& pixmap) {
+  return static_cast<qint64>(pixmap.width()) * pixmap.height() * ((pixmap.depth() + 7) / 8);
+}
+}  // namespace
+
+class TilePixmapCache::Impl {
+ public:
+  explicit Impl(qint64 max_bytes);
+
+  const QPixmap* find(const Key& key);
+
+  void insert(const Key& key, const QPixmap& pixmap);
+
+  void clear();
+
+ private:
+  struct Item {
+    Key key;
+    QPixmap pixmap;
+    qint64 bytes;
+
+    Item(const Key& key, const QPixmap& pixmap) : key(key), pixmap(pixmap), bytes(pixmapBytes(pixmap)) {}
+  };
+
+  class ItemsByKeyTag;
+  class LruOrderTag;
+
+  typedef multi_index_container<
+      Item,
+      indexed_by<hashed_unique<tag<ItemsByKeyTag>, member<Item, Key, &Item::key>, KeyHash>, sequenced<tag<LruOrderTag>>>>
+      Container;
+
+  typedef Container::index<ItemsByKeyTag>::type ItemsByKey;
+  typedef Container::index<LruOrderTag>::type LruOrder;
+
+  void removeExcess();
+
+  Container m_items;
+  ItemsByKey& m_itemsByKey;
+
+  /**
+   * Least recently used items go first.
+   */
+  LruOrder& m_lruOrder;
+
+  qint64 m_maxBytes;
+  qint64 m_totalBytes;
+};
+
+
+/*============================= TilePixmapCache =============================*/
+
+std::size_t TilePixmapCache::KeyHash::operator()(const Key& key) const {
+  std::size_t hash = qHash(key.grid) ^ std::hash<qint64>()(key.sourceId);
+  hash = hash * 31 + std::hash<int>()(key.tile.x());
+  hash = hash * 31 + std::hash<int>()(key.tile.y());
+
+  return hash;
+}
+
+TilePixmapCache::TilePixmapCache(const qint64 max_bytes) : m_impl(new Impl(max_bytes)) {}
+
+TilePixmapCache::~TilePixmapCache() = default;
+
+const QPixmap* TilePixmapCache::find(const Key& key) {
+  return m_impl->find(key);
+}
+
+void TilePixmapCache::insert(const Key& key, const QPixmap& pixmap) {
+  m_impl->insert(key, pixmap);
+}
+
+void TilePixmapCache::clear() {
+  m_impl->clear();
+}
+
+/*========================== TilePixmapCache::Impl ==========================*/
+
+TilePixmapCache::Impl::Impl(const qint64 max_bytes)
+    : m_itemsByKey(m_items.get<ItemsByKeyTag>()),
+      m_lruOrder(m_items.get<LruOrderTag>()),
+      m_maxBytes(max_bytes),
+      m_totalBytes(0) {}
+
+const QPixmap* TilePixmapCache::Impl::find(const Key& key) {
+  const ItemsByKey::iterator k_it(m_itemsByKey.find(key));
+  if (k_it == m_itemsByKey.end()) {
+    return nullptr;
+  }
+
+  // Move it to the end of the LRU list.
+  m_lruOrder.relocate(m_lruOrder.end(), m_items.project<LruOrderTag>(k_it));
+
+  return &k_it->pixmap;
+}
+
+void TilePixmapCache::Impl::insert(const Key& key, const QPixmap& pixmap) {
+  const ItemsByKey::iterator k_it(m_itemsByKey.find(key));
+  if (k_it != m_itemsByKey.end()) {
+    m_totalBytes -= k_it->bytes;
+    m_lruOrder.erase(m_items.project<LruOrderTag>(k_it));
+  }
+
+  const Item item(key, pixmap);
+  m_totalBytes += item.bytes;
+  m_lruOrder.push_back(item);
+
+  removeExcess();
+}
+
+void TilePixmapCache::Impl::clear() {
+  m_items.clear();
+  m_totalBytes = 0;
+}
+
+void TilePixmapCache::Impl::removeExcess() {
+  // Never evict the most recently inserted item.
+  while ((m_totalBytes > m_maxBytes) && (m_lruOrder.size() > 1)) {
+    m_totalBytes -= m_lruOrder.front().bytes;
+    m_lruOrder.pop_front();
+  }
+}
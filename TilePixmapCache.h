@@ -0,0 +1,73 @@
+
+#ifndef SCANTAILOR_TILEPIXMAPCACHE_H
+#define SCANTAILOR_TILEPIXMAPCACHE_H
+
+#include <QPixmap>
+#include <QPoint>
+#include <QTransform>
+#include <memory>
+#include "NonCopyable.h"
+
+/**
+ * \brief A least recently used cache of fixed size image tiles.
+ *
+ * Tiles are identified by a tile grid (the transformation from source image
+ * coordinates to the tile grid coordinates) and the tile position within
+ * that grid.  Once the total size of cached pixmaps exceeds the memory budget,
+ * the least recently used tiles are evicted.
+ *
+ * To be used from the GUI thread only.
+ */
+class TilePixmapCache {
+  DECLARE_NON_COPYABLE(TilePixmapCache)
+
+ public:
+  struct Key {
+    qint64 sourceId;
+    QTransform grid;
+    QPoint tile;
+
+    Key(qint64 source_id, const QTransform& grid, const QPoint& tile) : sourceId(source_id), grid(grid), tile(tile) {}
+
+    bool operator==(const Key& other) const {
+      return (sourceId == other.sourceId) && (tile == other.tile) && (grid == other.grid);
+    }
+
+    bool operator!=(const Key& other) const { return !(*this == other); }
+  };
+
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  /**
+   * \param max_bytes The memory budget for all the cached pixmaps together.
+   */
+  explicit TilePixmapCache(qint64 max_bytes);
+
+  ~TilePixmapCache();
+
+  /**
+   * \brief Looks up a tile and marks it as the most recently used one.
+   *
+   * \return A pointer to the cached pixmap or null, if the tile is not cached.
+   *         The pointer stays valid until the next call to insert() or clear().
+   */
+  const QPixmap* find(const Key& key);
+
+  /**
+   * \brief Puts a tile into the cache, evicting the least recently used
+   *        tiles if necessary.
+   */
+  void insert(const Key& key, const QPixmap& pixmap);
+
+  void clear();
+
+ private:
+  class Impl;
+
+  std::unique_ptr<Impl> m_impl;
+};
+
+
+#endif  // SCANTAILOR_TILEPIXMAPCACHE_H
@@ -21,6 +21,7 @@
 #include <QThreadPool>
 #include <utility>
 #include "OutOfMemoryHandler.h"
+#include "ParallelFor.h"
 
 class WorkerThreadPool::TaskResultEvent : public QEvent {
  public:
@@ -65,6 +66,8 @@ void WorkerThreadPool::submitTask(const BackgroundTaskPtr& task) {
         return;
       }
 
+      // Lets parallelFor() calls of the task know this thread is taken already.
+      const ProcessingThreadScope busy;
       try {
         const FilterResultPtr result((*m_task)());
         if (result) {
@@ -107,4 +110,6 @@ void WorkerThreadPool::updateNumberOfThreads() {
   int num_threads = m_settings.value("settings/batch_processing_threads", max_threads).toInt();
   num_threads = std::min<int>(num_threads, max_threads);
   m_pool->setMaxThreadCount(num_threads);
+  // Tasks parallelize internally within the same limit.
+  setProcessingThreadLimit(num_threads);
 }
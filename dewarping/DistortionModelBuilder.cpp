@@ -20,11 +20,13 @@
 #include <QDebug>
 #include <QImage>
 #include <QPainter>
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include "CylindricalSurfaceDewarper.h"
 #include "DebugImages.h"
 #include "DistortionModel.h"
 #include "LineBoundedByRect.h"
+#include "ParallelFor.h"
 #include "SidesOfLine.h"
 #include "ToLineProjector.h"
 #include "spfit/ConstraintSet.h"
@@ -37,6 +39,14 @@
 using namespace imageproc;
 
 namespace dewarping {
+namespace {
+/**
+ * The number of random curve pairs to try, in addition to
+ * combinations of the top-most and the bottom-most curves.
+ */
+const int NUM_RANDOM_PAIRS = 10;
+}  // namespace
+
 struct DistortionModelBuilder::TracedCurve {
   std::vector<QPointF> trimmedPolyline;   // Both are left to right.
   std::vector<QPointF> extendedPolyline;  //
@@ -66,7 +76,20 @@ class DistortionModelBuilder::RansacAlgo {
  public:
   explicit RansacAlgo(const std::vector<TracedCurve>& all_curves) : m_allCurves(all_curves) {}
 
-  void buildAndAssessModel(const TracedCurve* top_curve, const TracedCurve* bottom_curve);
+  /**
+   * \brief Builds a model from a pair of curves and calculates its error.
+   *
+   * Doesn't modify the object, so it may be called concurrently.
+   *
+   * \return The total error of the model, or NumericTraits<double>::max()
+   *         if a model couldn't be built.
+   */
+  double buildAndAssessModel(const TracedCurve* top_curve, const TracedCurve* bottom_curve) const;
+
+  /**
+   * \brief Makes the model the best one if its error is less than that of the current best model.
+   */
+  void considerModel(const TracedCurve* top_curve, const TracedCurve* bottom_curve, double error);
 
   RansacModel& bestModel() { return m_bestModel; }
 
@@ -157,20 +180,30 @@ DistortionModel DistortionModelBuilder::tryBuildModel(DebugImages* dbg, const QI
   std::sort(ordered_curves.begin(), ordered_curves.end());
 
   // Select the best pair using RANSAC.
-  RansacAlgo ransac(ordered_curves);
+  // Candidate pairs are collected first, so that they can be assessed concurrently.
+  // The order of candidates matters, as among models with equal errors the first one wins.
+  std::vector<std::pair<int, int>> candidates;
+
+  const auto add_candidate = [&candidates](const int i, const int j) {
+    const std::pair<int, int> candidate(i, j);
+    // Assessing the same pair again can't change the outcome.
+    if (std::find(candidates.begin(), candidates.end(), candidate) == candidates.end()) {
+      candidates.push_back(candidate);
+    }
+  };
 
   // First let's try to combine each of the 3 top-most lines
   // with each of the 3 bottom-most ones.
   for (int i = 0; i < std::min<int>(3, num_curves); ++i) {
     for (int j = std::max<int>(0, num_curves - 3); j < num_curves; ++j) {
       if (i < j) {
-        ransac.buildAndAssessModel(&ordered_curves[i], &ordered_curves[j]);
+        add_candidate(i, j);
       }
     }
   }
   // Continue by throwing in some random pairs of lines.
   qsrand(0);  // Repeatablity is important.
-  int random_pairs_remaining = 10;
+  int random_pairs_remaining = NUM_RANDOM_PAIRS;
   while (random_pairs_remaining-- > 0) {
     int i = qrand() % num_curves;
     int j = qrand() % num_curves;
@@ -178,10 +211,27 @@ DistortionModel DistortionModelBuilder::tryBuildModel(DebugImages* dbg, const QI
       std::swap(i, j);
     }
     if (i < j) {
-      ransac.buildAndAssessModel(&ordered_curves[i], &ordered_curves[j]);
+      add_candidate(i, j);
     }
   }
 
+  RansacAlgo ransac(ordered_curves);
+
+  const auto num_candidates = static_cast<int>(candidates.size());
+  std::vector<double> errors(candidates.size());
+  parallelFor(0, num_candidates, 1, [&](const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      errors[i] = ransac.buildAndAssessModel(&ordered_curves[candidates[i].first],
+                                             &ordered_curves[candidates[i].second]);
+    }
+  });
+
+  // The reduction is done in the order of candidates, which makes the result
+  // independent of how the work was distributed between threads.
+  for (int i = 0; i < num_candidates; ++i) {
+    ransac.considerModel(&ordered_curves[candidates[i].first], &ordered_curves[candidates[i].second], errors[i]);
+  }
+
   if (dbg && dbg_background) {
     dbg->add(visualizeTrimmedPolylines(*dbg_background, ordered_curves), "trimmed_polylines");
     dbg->add(visualizeModel(*dbg_background, ordered_curves, ransac.bestModel()), "distortion_model");
@@ -417,13 +467,13 @@ XSpline DistortionModelBuilder::fitExtendedSpline(const std::vector<QPointF>& po
 
 /*============================== RansacAlgo ============================*/
 
-void DistortionModelBuilder::RansacAlgo::buildAndAssessModel(const TracedCurve* top_curve,
-                                                             const TracedCurve* bottom_curve) try {
+double DistortionModelBuilder::RansacAlgo::buildAndAssessModel(const TracedCurve* top_curve,
+                                                               const TracedCurve* bottom_curve) const try {
   DistortionModel model;
   model.setTopCurve(Curve(top_curve->extendedPolyline));
   model.setBottomCurve(Curve(bottom_curve->extendedPolyline));
   if (!model.isValid()) {
-    return;
+    return NumericTraits<double>::max();
   }
 
   const double depth_perception = 2.0;  // Doesn't matter much here.
@@ -485,14 +535,21 @@ void DistortionModelBuilder::RansacAlgo::buildAndAssessModel(const TracedCurve*
     }
   }
 
+  return error;
+}  // DistortionModelBuilder::RansacAlgo::buildAndAssessModel
+catch (const std::runtime_error&) {
+  // Probably CylindricalSurfaceDewarper didn't like something.
+  return NumericTraits<double>::max();
+}
+
+void DistortionModelBuilder::RansacAlgo::considerModel(const TracedCurve* top_curve,
+                                                       const TracedCurve* bottom_curve,
+                                                       const double error) {
   if (error < m_bestModel.totalError) {
     m_bestModel.topCurve = top_curve;
     m_bestModel.bottomCurve = bottom_curve;
     m_bestModel.totalError = error;
   }
-}  // DistortionModelBuilder::RansacAlgo::buildAndAssessModel
-catch (const std::runtime_error&) {
-  // Probably CylindricalSurfaceDewarper didn't like something.
 }
 
 #if 0
@@ -25,6 +25,7 @@
 #include <cmath>
 #include "DebugImages.h"
 #include "NumericTraits.h"
+#include "ParallelFor.h"
 #include "imageproc/GaussBlur.h"
 #include "imageproc/Sobel.h"
 
@@ -67,9 +68,9 @@ class TextLineRefiner::Optimizer {
 
   bool thicknessAdjustment(Snake& snake, const Grid<float>& gradient);
 
-  bool tangentMovement(Snake& snake, const Grid<float>& gradient);
+  bool tangentMovement(Snake& snake, const Grid<float>& gradient, Workspace& workspace);
 
-  bool normalMovement(Snake& snake, const Grid<float>& gradient);
+  bool normalMovement(Snake& snake, const Grid<float>& gradient, Workspace& workspace);
 
  private:
   static float calcExternalEnergy(const Grid<float>& gradient, const SnakeNode& node, Vec2f down_normal);
@@ -109,15 +110,15 @@ void TextLineRefiner::refine(std::list<std::vector<QPointF>>& polylines, const i
   }
 
   Grid<float> gradient(m_image.width(), m_image.height(), /*padding=*/0);
+  // Page-sized, so allocated once for both calcBlurredGradient() calls.
+  Grid<float> vert_grad(m_image.width(), m_image.height(), /*padding=*/0);
 
   // Start with a rather strong blur.
   float h_sigma = (4.0f / 200.f) * m_dpi.horizontal();
   float v_sigma = (4.0f / 200.f) * m_dpi.vertical();
-  calcBlurredGradient(gradient, h_sigma, v_sigma);
+  calcBlurredGradient(gradient, vert_grad, h_sigma, v_sigma);
 
-  for (Snake& snake : snakes) {
-    evolveSnake(snake, gradient, ON_CONVERGENCE_STOP);
-  }
+  evolveSnakes(snakes, gradient, ON_CONVERGENCE_STOP);
   if (dbg) {
     dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes1");
   }
@@ -125,11 +126,10 @@ void TextLineRefiner::refine(std::list<std::vector<QPointF>>& polylines, const i
   // Less blurring this time.
   h_sigma *= 0.5f;
   v_sigma *= 0.5f;
-  calcBlurredGradient(gradient, h_sigma, v_sigma);
+  calcBlurredGradient(gradient, vert_grad, h_sigma, v_sigma);
+  Grid<float>().swap(vert_grad);  // Save memory.
 
-  for (Snake& snake : snakes) {
-    evolveSnake(snake, gradient, ON_CONVERGENCE_GO_FINER);
-  }
+  evolveSnakes(snakes, gradient, ON_CONVERGENCE_GO_FINER);
   if (dbg) {
     dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes2");
   }
@@ -146,19 +146,19 @@ void TextLineRefiner::refine(std::list<std::vector<QPointF>>& polylines, const i
   }
 }  // TextLineRefiner::refine
 
-void TextLineRefiner::calcBlurredGradient(Grid<float>& gradient, float h_sigma, float v_sigma) const {
+void TextLineRefiner::calcBlurredGradient(Grid<float>& gradient,
+                                          Grid<float>& vert_grad,
+                                          float h_sigma,
+                                          float v_sigma) const {
   using namespace boost::lambda;
 
   const float downscale = 1.0f / (255.0f * 8.0f);
-  Grid<float> vert_grad(m_image.width(), m_image.height(), /*padding=*/0);
   horizontalSobel<float>(m_image.width(), m_image.height(), m_image.data(), m_image.stride(), _1 * downscale,
                          gradient.data(), gradient.stride(), _1 = _2, _1, gradient.data(), gradient.stride(), _1 = _2);
   verticalSobel<float>(m_image.width(), m_image.height(), m_image.data(), m_image.stride(), _1 * downscale,
                        vert_grad.data(), vert_grad.stride(), _1 = _2, _1, gradient.data(), gradient.stride(),
                        _1 = _1 * m_unitDownVec[0] + _2 * m_unitDownVec[1]);
-  Grid<float>().swap(vert_grad);  // Save memory.
-  gaussBlurGeneric(m_image.size(), h_sigma, v_sigma, gradient.data(), gradient.stride(), _1, gradient.data(),
-                   gradient.stride(), _1 = _2);
+  gaussBlur(gradient, h_sigma, v_sigma);
 }
 
 float TextLineRefiner::externalEnergyAt(const Grid<float>& gradient, const Vec2f& pos, float penalty_if_outside) {
@@ -277,7 +277,23 @@ void TextLineRefiner::calcFrenetFrames(std::vector<FrenetFrame>& frenet_frames,
   }
 }  // TextLineRefiner::calcFrenetFrames
 
-void TextLineRefiner::evolveSnake(Snake& snake, const Grid<float>& gradient, const OnConvergence on_convergence) const {
+void TextLineRefiner::evolveSnakes(std::vector<Snake>& snakes,
+                                   const Grid<float>& gradient,
+                                   const OnConvergence on_convergence) const {
+  // Snakes differ a lot in length and in the number of iterations
+  // they need to converge, so hand them out one by one.
+  parallelFor(0, static_cast<int>(snakes.size()), 1, [&](const int begin, const int end) {
+    Workspace workspace;
+    for (int i = begin; i < end; ++i) {
+      evolveSnake(snakes[i], gradient, on_convergence, workspace);
+    }
+  });
+}
+
+void TextLineRefiner::evolveSnake(Snake& snake,
+                                  const Grid<float>& gradient,
+                                  const OnConvergence on_convergence,
+                                  Workspace& workspace) const {
   float factor = 1.0f;
 
   while (snake.iterationsRemaining > 0) {
@@ -286,8 +302,8 @@ void TextLineRefiner::evolveSnake(Snake& snake, const Grid<float>& gradient, con
     Optimizer optimizer(snake, m_unitDownVec, factor);
     bool changed = false;
     changed |= optimizer.thicknessAdjustment(snake, gradient);
-    changed |= optimizer.tangentMovement(snake, gradient);
-    changed |= optimizer.normalMovement(snake, gradient);
+    changed |= optimizer.tangentMovement(snake, gradient, workspace);
+    changed |= optimizer.normalMovement(snake, gradient, workspace);
 
     if (!changed) {
       // qDebug() << "Converged.  Iterations remaining = " << snake.iterationsRemaining;
@@ -500,7 +516,7 @@ bool TextLineRefiner::Optimizer::thicknessAdjustment(Snake& snake, const Grid<fl
   return rib_adjustments[best_i] != 0 || rib_adjustments[best_j] != 0;
 }  // TextLineRefiner::Optimizer::thicknessAdjustment
 
-bool TextLineRefiner::Optimizer::tangentMovement(Snake& snake, const Grid<float>& gradient) {
+bool TextLineRefiner::Optimizer::tangentMovement(Snake& snake, const Grid<float>& gradient, Workspace& workspace) {
   const size_t num_nodes = snake.nodes.size();
   if (num_nodes < 3) {
     return false;
@@ -509,9 +525,12 @@ bool TextLineRefiner::Optimizer::tangentMovement(Snake& snake, const Grid<float>
   const float tangent_movements[] = {0.0f * m_factor, 1.0f * m_factor, -1.0f * m_factor};
   enum { NUM_TANGENT_MOVEMENTS = sizeof(tangent_movements) / sizeof(tangent_movements[0]) };
 
-  std::vector<uint32_t> paths;
-  std::vector<uint32_t> new_paths;
-  std::vector<Step> step_storage;
+  std::vector<uint32_t>& paths = workspace.paths;
+  std::vector<uint32_t>& new_paths = workspace.newPaths;
+  std::vector<Step>& step_storage = workspace.stepStorage;
+  paths.clear();
+  new_paths.clear();
+  step_storage.clear();
   // Note that we don't move the first and the last node in tangent direction.
   paths.push_back(static_cast<unsigned int&&>(step_storage.size()));
   step_storage.emplace_back();
@@ -587,7 +606,7 @@ bool TextLineRefiner::Optimizer::tangentMovement(Snake& snake, const Grid<float>
   return max_sqdist > std::numeric_limits<float>::epsilon();
 }  // TextLineRefiner::Optimizer::tangentMovement
 
-bool TextLineRefiner::Optimizer::normalMovement(Snake& snake, const Grid<float>& gradient) {
+bool TextLineRefiner::Optimizer::normalMovement(Snake& snake, const Grid<float>& gradient, Workspace& workspace) {
   const size_t num_nodes = snake.nodes.size();
   if (num_nodes < 3) {
     return false;
@@ -596,9 +615,12 @@ bool TextLineRefiner::Optimizer::normalMovement(Snake& snake, const Grid<float>&
   const float normal_movements[] = {0.0f * m_factor, 1.0f * m_factor, -1.0f * m_factor};
   enum { NUM_NORMAL_MOVEMENTS = sizeof(normal_movements) / sizeof(normal_movements[0]) };
 
-  std::vector<uint32_t> paths;
-  std::vector<uint32_t> new_paths;
-  std::vector<Step> step_storage;
+  std::vector<uint32_t>& paths = workspace.paths;
+  std::vector<uint32_t>& new_paths = workspace.newPaths;
+  std::vector<Step>& step_storage = workspace.stepStorage;
+  paths.clear();
+  new_paths.clear();
+  step_storage.clear();
   // The first two nodes pose a problem for us.  These nodes don't have two predecessors,
   // and therefore we can't take bending into the account.  We could take the followers
   // instead of the ancestors, but then this follower is going to move itself, making
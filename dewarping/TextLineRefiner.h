@@ -38,6 +38,12 @@ class TextLineRefiner {
  public:
   TextLineRefiner(const imageproc::GrayImage& image, const Dpi& dpi, const Vec2f& unit_down_vector);
 
+  /**
+   * \brief Fits snakes to the text lines given as polylines.
+   *
+   * Snakes don't interact with each other, so they are evolved concurrently.
+   * The result doesn't depend on the number of threads involved.
+   */
   void refine(std::list<std::vector<QPointF>>& polylines, int iterations, DebugImages* dbg) const;
 
  private:
@@ -67,7 +73,20 @@ class TextLineRefiner {
     float pathCost{0};
   };
 
-  void calcBlurredGradient(Grid<float>& gradient, float h_sigma, float v_sigma) const;
+  /**
+   * Scratch buffers of the Optimizer, reused across iterations and snakes
+   * processed by the same thread.
+   */
+  struct Workspace {
+    std::vector<uint32_t> paths;
+    std::vector<uint32_t> newPaths;
+    std::vector<Step> stepStorage;
+  };
+
+  /**
+   * \param vert_grad Scratch space of the same size as \p gradient.
+   */
+  void calcBlurredGradient(Grid<float>& gradient, Grid<float>& vert_grad, float h_sigma, float v_sigma) const;
 
   static float externalEnergyAt(const Grid<float>& gradient, const Vec2f& pos, float penalty_if_outside);
 
@@ -78,7 +97,9 @@ class TextLineRefiner {
                                const SnakeLength& snake_length,
                                const Vec2f& unit_down_vec);
 
-  void evolveSnake(Snake& snake, const Grid<float>& gradient, OnConvergence on_convergence) const;
+  void evolveSnakes(std::vector<Snake>& snakes, const Grid<float>& gradient, OnConvergence on_convergence) const;
+
+  void evolveSnake(Snake& snake, const Grid<float>& gradient, OnConvergence on_convergence, Workspace& workspace) const;
 
   QImage visualizeGradient(const Grid<float>& gradient) const;
 
@@ -301,8 +301,7 @@ void TextLineTracer::extractTextLines(std::list<std::vector<QPointF>>& out,
     dbg->add(visualizeGradient(image, main_grid), "first_dir_deriv");
   }
 
-  gaussBlurGeneric(size, 6.0f, 6.0f, main_grid.data(), main_grid.stride(), _1, main_grid.data(), main_grid.stride(),
-                   _1 = _2);
+  gaussBlur(main_grid, 6.0f, 6.0f);
   if (dbg) {
     dbg->add(visualizeGradient(image, main_grid), "first_dir_deriv_blurred");
   }
@@ -334,8 +333,7 @@ void TextLineTracer::extractTextLines(std::list<std::vector<QPointF>>& out,
     dbg->add(visualizeGradient(image, aux_grid), "abs");
   }
 
-  gaussBlurGeneric(size, 12.0f, 12.0f, aux_grid.data(), aux_grid.stride(), _1, aux_grid.data(), aux_grid.stride(),
-                   _1 = _2);
+  gaussBlur(aux_grid, 12.0f, 12.0f);
   if (dbg) {
     dbg->add(visualizeGradient(image, aux_grid), "blurred");
   }
@@ -122,15 +122,29 @@ FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
     status.throwIfCancelled();
 
     if (bounded_image_area.isValid()) {
-      BinaryImage rotated_image(orthogonalRotation(
-          BinaryImage(data.isBlackOnWhite() ? data.grayImage() : data.grayImage().inverted(), bounded_image_area,
-                      data.isBlackOnWhite() ? data.bwThreshold() : BinaryThreshold(256 - int(data.bwThreshold()))),
-          data.xform().preRotation().toDegrees()));
+      // Skew detection doesn't benefit from more than 300 DPI, and the page split
+      // stage has most likely binarized the shared 300 DPI level already.
+      QTransform orig_to_300dpi;
+      const BinaryImage bw300(data.pyramid().binaryLevel(300, data.bwThreshold(), &orig_to_300dpi));
+      const QRect level_area(
+          orig_to_300dpi.mapRect(QRectF(bounded_image_area)).toAlignedRect().intersected(bw300.rect()));
+
+      BinaryImage bw_image(level_area.size());
+      rasterOp<RopSrc>(bw_image, bw_image.rect(), bw300, level_area.topLeft());
+      if (!data.isBlackOnWhite()) {
+        // Same as binarizing the inverted image with (256 - threshold).
+        bw_image.invert();
+      }
+
+      BinaryImage rotated_image(orthogonalRotation(bw_image, data.xform().preRotation().toDegrees()));
+      bw_image.release();
       if (m_dbg) {
         m_dbg->add(rotated_image, "bw_rotated");
       }
 
-      const QSize unrotated_dpm(Dpm(data.origImage()).toSize());
+      const QSize orig_dpm(Dpm(data.origImage()).toSize());
+      const QSize unrotated_dpm(qRound(orig_dpm.width() * orig_to_300dpi.m11()),
+                                qRound(orig_dpm.height() * orig_to_300dpi.m22()));
       const Dpm rotated_dpm(data.xform().preRotation().rotate(unrotated_dpm));
       cleanup(status, rotated_image, Dpi(rotated_dpm));
       if (m_dbg) {
@@ -161,7 +175,7 @@ FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
   new_xform.setPostRotation(ui_data.effectiveDeskewAngle());
 
   if (m_nextTask) {
-    return m_nextTask->process(status, FilterData(data, new_xform));
+    return m_nextTask->process(status, FilterData(std::move(data), new_xform));
   } else {
     return make_intrusive<UiUpdater>(m_filter, std::move(m_dbg), data.origImage(), m_pageId, new_xform, ui_data,
                                      m_batchProcessing);
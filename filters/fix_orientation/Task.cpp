@@ -81,7 +81,7 @@ FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
   xform.setPreRotation(m_settings->getRotationFor(m_imageId));
 
   if (m_nextTask) {
-    return m_nextTask->process(status, FilterData(data, xform));
+    return m_nextTask->process(status, FilterData(std::move(data), xform));
   } else {
     return make_intrusive<UiUpdater>(m_filter, data.origImage(), m_imageId, xform, m_batchProcessing);
   }
@@ -55,7 +55,15 @@ DespeckleState DespeckleState::redespeckle(const double level, const TaskStatus&
     return new_state;
   }
 
-  new_state.m_speckles = Despeckle::despeckle(m_everythingBW, m_dpi, level, status, dbg);
+  if (dbg) {
+    // Debugging images are only produced by a complete despeckling.
+    new_state.m_speckles = Despeckle::despeckle(m_everythingBW, m_dpi, level, status, dbg);
+  } else {
+    if (m_analysis.isNull()) {
+      new_state.m_analysis = Despeckle::Analysis(m_everythingBW, m_dpi, status);
+    }
+    new_state.m_speckles = new_state.m_analysis.despeckle(level, status);
+  }
 
   status.throwIfCancelled();
 
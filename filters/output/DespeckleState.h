@@ -21,6 +21,7 @@
 #define OUTPUT_DESPECKLE_STATE_H_
 
 #include <QImage>
+#include "Despeckle.h"
 #include "DespeckleLevel.h"
 #include "Dpi.h"
 #include "imageproc/BinaryImage.h"
@@ -80,6 +81,12 @@ class DespeckleState {
    * m_everythingBW.
    */
   double m_despeckleLevel;
+
+  /**
+   * Built on the first redespeckle() and shared with the resulting states,
+   * so that further level changes don't go through the whole despeckling.
+   */
+  Despeckle::Analysis m_analysis;
 };
 }  // namespace output
 #endif  // ifndef OUTPUT_DESPECKLE_STATE_H_
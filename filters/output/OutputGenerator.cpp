@@ -43,6 +43,7 @@
 #include "dewarping/TopBottomEdgeTracer.h"
 #include "imageproc/AdjustBrightness.h"
 #include "imageproc/Binarize.h"
+#include "imageproc/BitOps.h"
 #include "imageproc/ConnCompEraser.h"
 #include "imageproc/ConnectivityMap.h"
 #include "imageproc/Constants.h"
@@ -65,31 +66,6 @@ using namespace dewarping;
 
 namespace output {
 namespace {
-struct RaiseAboveBackground {
-  static uint8_t transform(uint8_t src, uint8_t dst) {
-    // src: orig
-    // dst: background (dst >= src)
-    if (dst - src < 1) {
-      return 0xff;
-    }
-    const unsigned orig = src;
-    const unsigned background = dst;
-
-    return static_cast<uint8_t>((orig * 255 + background / 2) / background);
-  }
-};
-
-struct CombineInverted {
-  static uint8_t transform(uint8_t src, uint8_t dst) {
-    const unsigned dilated = dst;
-    const unsigned eroded = src;
-    const unsigned res = 255 - (255 - dilated) * eroded / 255;
-
-    return static_cast<uint8_t>(res);
-  }
-};
-
-
 template <typename PixelType>
 PixelType reserveBlackAndWhite(PixelType color);
 
@@ -232,6 +208,56 @@ void fillExcept(BinaryImage& image, const BinaryImage& bw_mask, const BWColor co
   }
 }
 
+/**
+ * \brief Covers white pixels of a picture mask with a few rectangles.
+ *
+ * Every horizontal band of the mask contributes the bounding box of its white pixels,
+ * so that pictures in different parts of the page don't merge into a single huge area.
+ */
+std::vector<QRect> pictureAreas(const BinaryImage& bw_mask) {
+  const int band_height = 32;
+  const int width = bw_mask.width();
+  const int height = bw_mask.height();
+  const int words_per_line = bw_mask.wordsPerLine();
+  const uint32_t* const data = bw_mask.data();
+  const uint32_t last_word_mask = ~uint32_t(0) << (31 - ((width - 1) & 31));
+
+  std::vector<QRect> areas;
+  for (int top = 0; top < height; top += band_height) {
+    const int bottom = std::min(top + band_height, height);  // exclusive
+    int left = width;
+    int right = -1;
+    for (int y = top; y < bottom; ++y) {
+      const uint32_t* const line = data + y * words_per_line;
+      for (int i = 0; i < words_per_line; ++i) {
+        uint32_t white = ~line[i];
+        if (i == words_per_line - 1) {
+          white &= last_word_mask;
+        }
+        if (white) {
+          left = std::min(left, (i << 5) + countMostSignificantZeroes(white));
+          break;
+        }
+      }
+      for (int i = words_per_line - 1; i >= 0; --i) {
+        uint32_t white = ~line[i];
+        if (i == words_per_line - 1) {
+          white &= last_word_mask;
+        }
+        if (white) {
+          right = std::max(right, (i << 5) + 31 - countLeastSignificantZeroes(white));
+          break;
+        }
+      }
+    }
+    if (right >= left) {
+      areas.emplace_back(QPoint(left, top), QPoint(right, bottom - 1));
+    }
+  }
+
+  return areas;
+}
+
 void removeAutoPictureZones(ZoneSet& picture_zones) {
   for (auto it = picture_zones.begin(); it != picture_zones.end();) {
     const Zone& zone = *it;
@@ -260,6 +286,29 @@ bool updateBlackOnWhite(const FilterData& input, const PageId& pageId, const int
   }
 }
 
+/**
+ * Returns the original image in a format we can handle, that is grayscale, RGB32 or ARGB32,
+ * with colors inverted if the page isn't black on white.
+ *
+ * Grayscale originals are always consumed through the corresponding GrayImage, so they
+ * are returned as is, without materializing a converted or inverted copy.
+ */
+QImage prepareOrigImage(const QImage& orig, const bool color_original, const bool isBlackOnWhite) {
+  if (!color_original) {
+    return orig;
+  }
+
+  QImage result = orig;
+  if ((result.format() != QImage::Format_ARGB32) && (result.format() != QImage::Format_RGB32)) {
+    result = result.convertToFormat(QImage::Format_RGB32);
+  }
+  if (!isBlackOnWhite) {
+    result.invertPixels();
+  }
+
+  return result;
+}
+
 BackgroundColorCalculator getBackgroundColorCalculator(const PageId& pageId, const intrusive_ptr<Settings>& settings) {
   QSettings appSettings;
   if (!(appSettings.value("settings/blackOnWhiteDetection", true).toBool()
@@ -374,7 +423,7 @@ GrayImage OutputGenerator::normalizeIlluminationGray(const TaskStatus& status,
 
   status.throwIfCancelled();
 
-  grayRasterOp<RaiseAboveBackground>(bg_img, to_be_normalized);
+  grayRasterOp<GRopRaiseAboveBackground>(bg_img, to_be_normalized);
   if (dbg) {
     dbg->add(bg_img, "normalized_illumination");
   }
@@ -549,22 +598,15 @@ QImage OutputGenerator::processWithoutDewarping(const TaskStatus& status,
   const QPolygonF outCropAreaInOriginalCs(m_xform.transformBack().map(outCropArea));
 
   const bool isBlackOnWhite = updateBlackOnWhite(input, pageId, settings);
+  const bool color_original = !input.origImage().allGray();
   const GrayImage inputGrayImage = isBlackOnWhite ? input.grayImage() : input.grayImage().inverted();
-  const QImage inputOrigImage = [&input, &isBlackOnWhite]() {
-    QImage result = input.origImage();
-    if (!result.allGray() && (result.format() != QImage::Format_ARGB32) && (result.format() != QImage::Format_RGB32)) {
-      result = result.convertToFormat(QImage::Format_RGB32);
-    }
-    if (!isBlackOnWhite) {
-      result.invertPixels();
-    }
-
-    return result;
-  }();
+  const QImage inputOrigImage = prepareOrigImage(input.origImage(), color_original, isBlackOnWhite);
+  // Make sure no stage before us has detached the images the loader produced.
+  assert(input.imagesIntact());
 
   const BackgroundColorCalculator backgroundColorCalculator = getBackgroundColorCalculator(pageId, settings);
   QColor outsideBackgroundColor = backgroundColorCalculator.calcDominantBackgroundColor(
-      inputOrigImage.allGray() ? inputGrayImage : inputOrigImage, outCropAreaInOriginalCs, dbg);
+      color_original ? inputOrigImage : inputGrayImage, outCropAreaInOriginalCs, dbg);
 
   const bool needNormalizeIllumination
       = (render_params.normalizeIllumination() && render_params.needBinarization())
@@ -575,7 +617,7 @@ QImage OutputGenerator::processWithoutDewarping(const TaskStatus& status,
     maybe_normalized = normalizeIlluminationGray(status, inputGrayImage, preCropAreaInOriginalCs, m_xform.transform(),
                                                  workingBoundingRect, nullptr, dbg);
   } else {
-    if (inputOrigImage.allGray()) {
+    if (!color_original) {
       maybe_normalized = transformToGray(inputGrayImage, m_xform.transform(), workingBoundingRect,
                                          OutsidePixels::assumeColor(outsideBackgroundColor));
     } else {
@@ -584,7 +626,7 @@ QImage OutputGenerator::processWithoutDewarping(const TaskStatus& status,
     }
   }
 
-  if (needNormalizeIllumination && !inputOrigImage.allGray()) {
+  if (needNormalizeIllumination && color_original) {
     assert(maybe_normalized.format() == QImage::Format_Indexed8);
     QImage tmp(transform(inputOrigImage, m_xform.transform(), workingBoundingRect,
                          OutsidePixels::assumeColor(outsideBackgroundColor)));
@@ -824,14 +866,28 @@ QImage OutputGenerator::processWithoutDewarping(const TaskStatus& status,
 
       if (needNormalizeIllumination && !render_params.normalizeIlluminationColor()) {
         outsideBackgroundColor = backgroundColorCalculator.calcDominantBackgroundColor(
-            inputOrigImage.allGray() ? inputGrayImage : inputOrigImage, outCropAreaInOriginalCs, dbg);
-
-        if (inputOrigImage.allGray()) {
-          maybe_normalized = transformToGray(inputGrayImage, m_xform.transform(), workingBoundingRect,
-                                             OutsidePixels::assumeColor(outsideBackgroundColor));
+            color_original ? inputOrigImage : inputGrayImage, outCropAreaInOriginalCs, dbg);
+
+        if (render_params.originalBackground() || render_params.needColorSegmentation()) {
+          if (!color_original) {
+            maybe_normalized = transformToGray(inputGrayImage, m_xform.transform(), workingBoundingRect,
+                                               OutsidePixels::assumeColor(outsideBackgroundColor));
+          } else {
+            maybe_normalized = transform(inputOrigImage, m_xform.transform(), workingBoundingRect,
+                                         OutsidePixels::assumeColor(outsideBackgroundColor));
+          }
         } else {
-          maybe_normalized = transform(inputOrigImage, m_xform.transform(), workingBoundingRect,
-                                       OutsidePixels::assumeColor(outsideBackgroundColor));
+          // Everything outside of the pictures is going to be replaced by bw_content,
+          // so there is no point in transforming it.  The normalized image is of the same
+          // size and format, so it's updated in place.
+          const std::vector<QRect> areas(pictureAreas(bw_mask));
+          if (!color_original) {
+            transformAreasToGray(inputGrayImage, maybe_normalized, m_xform.transform(), workingBoundingRect, areas,
+                                 OutsidePixels::assumeColor(outsideBackgroundColor));
+          } else {
+            transformAreas(inputOrigImage, maybe_normalized, m_xform.transform(), workingBoundingRect, areas,
+                           OutsidePixels::assumeColor(outsideBackgroundColor));
+          }
         }
 
         status.throwIfCancelled();
@@ -1054,24 +1110,15 @@ QImage OutputGenerator::processWithDewarping(const TaskStatus& status,
   const QPolygonF outCropAreaInOriginalCs(m_xform.transformBack().map(outCropArea));
 
   const bool isBlackOnWhite = updateBlackOnWhite(input, pageId, settings);
+  const bool color_original = !input.origImage().allGray();
   const GrayImage inputGrayImage = isBlackOnWhite ? input.grayImage() : input.grayImage().inverted();
-  const QImage inputOrigImage = [&input, &isBlackOnWhite]() {
-    QImage result = input.origImage();
-    if (!result.allGray() && (result.format() != QImage::Format_ARGB32) && (result.format() != QImage::Format_RGB32)) {
-      result = result.convertToFormat(QImage::Format_RGB32);
-    }
-    if (!isBlackOnWhite) {
-      result.invertPixels();
-    }
-
-    return result;
-  }();
+  const QImage inputOrigImage = prepareOrigImage(input.origImage(), color_original, isBlackOnWhite);
+  // Make sure no stage before us has detached the images the loader produced.
+  assert(input.imagesIntact());
 
   const BackgroundColorCalculator backgroundColorCalculator = getBackgroundColorCalculator(pageId, settings);
   QColor outsideBackgroundColor = backgroundColorCalculator.calcDominantBackgroundColor(
-      inputOrigImage.allGray() ? inputGrayImage : inputOrigImage, outCropAreaInOriginalCs, dbg);
-
-  const bool color_original = !inputOrigImage.allGray();
+      color_original ? inputOrigImage : inputGrayImage, outCropAreaInOriginalCs, dbg);
 
   const bool needNormalizeIllumination
       = (render_params.normalizeIllumination() && render_params.needBinarization())
@@ -1120,7 +1167,7 @@ QImage OutputGenerator::processWithDewarping(const TaskStatus& status,
 
     status.throwIfCancelled();
     // Turn background into a grayscale, illumination-normalized image.
-    grayRasterOp<RaiseAboveBackground>(warped_gray_background, inputGrayImage);
+    grayRasterOp<GRopRaiseAboveBackground>(warped_gray_background, inputGrayImage);
     if (dbg) {
       dbg->add(warped_gray_background, "norm_illum_gray");
     }
@@ -1638,7 +1685,7 @@ QImage OutputGenerator::processWithDewarping(const TaskStatus& status,
 
       if (needNormalizeIllumination && !render_params.normalizeIlluminationColor()) {
         outsideBackgroundColor = backgroundColorCalculator.calcDominantBackgroundColor(
-            inputOrigImage.allGray() ? inputGrayImage : inputOrigImage, outCropAreaInOriginalCs, dbg);
+            color_original ? inputOrigImage : inputGrayImage, outCropAreaInOriginalCs, dbg);
 
         QImage orig_without_illumination;
         if (color_original) {
@@ -1986,7 +2033,7 @@ GrayImage OutputGenerator::detectPictures(const GrayImage& input_300dpi,
   stretched = GrayImage();  // Save memory.
   status.throwIfCancelled();
 
-  grayRasterOp<CombineInverted>(dilated, eroded);
+  grayRasterOp<GRopCombineInverted>(dilated, eroded);
   GrayImage gray_gradient(dilated);
   dilated = GrayImage();
   eroded = GrayImage();
@@ -2372,6 +2419,17 @@ void OutputGenerator::applyFillZonesInPlace(QImage& img,
     return;
   }
 
+  if ((img.format() == QImage::Format_RGB32) || ((img.format() == QImage::Format_Indexed8) && img.isGrayscale())) {
+    // Fill zones are usually small, so we'd better not convert the whole image back and forth.
+    for (const Zone& zone : zones) {
+      const QColor color(zone.properties().locateOrDefault<FillColorProperty>()->color());
+      const QPolygonF poly(postTransform.map(zone.spline().transformed(orig_to_output).toPolygon()));
+      PolygonRasterizer::colorFill(img, color.rgba(), poly, Qt::WindingFill, antialiasing);
+    }
+
+    return;
+  }
+
   QImage canvas(img.convertToFormat(QImage::Format_ARGB32_Premultiplied));
 
   {
@@ -120,7 +120,7 @@ Task::Task(intrusive_ptr<Filter> filter,
 
 Task::~Task() = default;
 
-FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data, const QPolygonF& content_rect_phys) {
+FilterResultPtr Task::process(const TaskStatus& status, FilterData data, const QPolygonF& content_rect_phys) {
   status.throwIfCancelled();
 
   Params params(m_settings->getParams(m_pageId));
@@ -323,8 +323,12 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
     // The same applies even more to speckles file, as we need it not only
     // for visualization purposes, but also for re-doing despeckling at
     // different levels without going through the whole output generation process.
-    const bool write_automask = render_params.mixedOutput();
-    const bool write_speckles_file = params.despeckleLevel() != DESPECKLE_OFF && render_params.needBinarization();
+    // The headless profile is the exception: there, nobody is expected to view
+    // the results, and the missing files make the GUI reprocess the page on demand.
+    const bool headless = m_batchProcessing && CommandLine::get().isHeadlessProfile();
+    const bool write_automask = render_params.mixedOutput() && !headless;
+    const bool write_speckles_file
+        = params.despeckleLevel() != DESPECKLE_OFF && render_params.needBinarization() && !headless;
 
     automask_img = BinaryImage();
     speckles_img = BinaryImage();
@@ -434,7 +438,12 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data,
       m_settings->setOutputParams(m_pageId, out_params);
     }
 
-    m_thumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
+    if (!headless) {
+      m_thumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
+    } else {
+      // Don't leave a thumbnail of the previous output behind.
+      m_thumbnailCache->discardThumbnail(ImageId(out_file_path));
+    }
   }
 
   const DespeckleState despeckle_state(out_img, speckles_img, params.despeckleLevel(), params.outputDpi());
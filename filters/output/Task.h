@@ -62,7 +62,7 @@ class Task : public ref_countable {
 
   ~Task() override;
 
-  FilterResultPtr process(const TaskStatus& status, const FilterData& data, const QPolygonF& content_rect_phys);
+  FilterResultPtr process(const TaskStatus& status, FilterData data, const QPolygonF& content_rect_phys);
 
  private:
   class UiUpdater;
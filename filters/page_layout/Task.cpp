@@ -79,7 +79,7 @@ Task::Task(intrusive_ptr<Filter> filter,
 Task::~Task() = default;
 
 FilterResultPtr Task::process(const TaskStatus& status,
-                              const FilterData& data,
+                              FilterData data,
                               const QRectF& page_rect,
                               const QRectF& content_rect) {
   status.throwIfCancelled();
@@ -106,7 +106,7 @@ FilterResultPtr Task::process(const TaskStatus& status,
     ImageTransformation new_xform(data.xform());
     new_xform.setPostCropArea(Utils::shiftToRoundedOrigin(new_xform.transform().map(page_rect_phys)));
 
-    return m_nextTask->process(status, FilterData(data, new_xform), content_rect_phys);
+    return m_nextTask->process(status, FilterData(std::move(data), new_xform), content_rect_phys);
   } else {
     return make_intrusive<UiUpdater>(m_filter, m_settings, m_pageId, data.origImage(), data.xform(),
                                      data.isBlackOnWhite() ? data.grayImage() : data.grayImage().inverted(),
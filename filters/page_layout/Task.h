@@ -53,7 +53,7 @@ class Task : public ref_countable {
   ~Task() override;
 
   FilterResultPtr process(const TaskStatus& status,
-                          const FilterData& data,
+                          FilterData data,
                           const QRectF& page_rect,
                           const QRectF& content_rect);
 
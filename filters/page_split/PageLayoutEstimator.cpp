@@ -28,6 +28,7 @@
 #include "ImageTransformation.h"
 #include "OrthogonalRotation.h"
 #include "PageLayout.h"
+#include "PagePyramid.h"
 #include "ProjectPages.h"
 #include "VertLineFinder.h"
 #include "imageproc/Binarize.h"
@@ -189,7 +190,7 @@ int numPages(const LayoutType layout_type, const ImageTransformation& pre_xform)
 }  // anonymous namespace
 
 PageLayout PageLayoutEstimator::estimatePageLayout(const LayoutType layout_type,
-                                                   const QImage& input,
+                                                   const PagePyramid& pyramid,
                                                    const ImageTransformation& pre_xform,
                                                    const BinaryThreshold bw_threshold,
                                                    DebugImages* const dbg) {
@@ -197,12 +198,12 @@ PageLayout PageLayoutEstimator::estimatePageLayout(const LayoutType layout_type,
     return PageLayout(pre_xform.resultingRect());
   }
 
-  std::unique_ptr<PageLayout> layout(tryCutAtFoldingLine(layout_type, input, pre_xform, dbg));
+  std::unique_ptr<PageLayout> layout(tryCutAtFoldingLine(layout_type, pyramid.fullResolution(), pre_xform, dbg));
   if (layout) {
     return *layout;
   }
 
-  return cutAtWhitespace(layout_type, input, pre_xform, bw_threshold, dbg);
+  return cutAtWhitespace(layout_type, pyramid, pre_xform, bw_threshold, dbg);
 }
 
 namespace {
@@ -309,8 +310,7 @@ std::unique_ptr<PageLayout> PageLayoutEstimator::tryCutAtFoldingLine(const Layou
  * \param layout_type The type of a layout to detect.  If set to
  *        something other than AUTO_LAYOUT_TYPE, the returned
  *        layout will have the same type.
- * \param input The input image.  Will be converted to grayscale unless
- *        it's already grayscale.
+ * \param pyramid The input image along with its reduced resolution versions.
  * \param pre_xform The logical transformation applied to the input image.
  *        The resulting page layout will be in transformed coordinates.
  * \param bw_threshold The global binarization threshold for the input image.
@@ -319,14 +319,14 @@ std::unique_ptr<PageLayout> PageLayoutEstimator::tryCutAtFoldingLine(const Layou
  *         will return a PageLayout consistent with the layout_type requested.
  */
 PageLayout PageLayoutEstimator::cutAtWhitespace(const LayoutType layout_type,
-                                                const QImage& input,
+                                                const PagePyramid& pyramid,
                                                 const ImageTransformation& pre_xform,
                                                 const BinaryThreshold bw_threshold,
                                                 DebugImages* const dbg) {
   QTransform xform;
 
   // Convert to B/W and rotate.
-  BinaryImage img(to300DpiBinary(input, xform, bw_threshold));
+  BinaryImage img(to300DpiBinary(pyramid, xform, bw_threshold));
   // Note: here we assume the only transformation applied
   // to the input image is orthogonal rotation.
   img = orthogonalRotation(img, pre_xform.preRotation().toDegrees());
@@ -456,13 +456,20 @@ PageLayout PageLayoutEstimator::cutAtWhitespaceDeskewed150(const LayoutType layo
   }
 }  // PageLayoutEstimator::cutAtWhitespaceDeskewed150
 
-imageproc::BinaryImage PageLayoutEstimator::to300DpiBinary(const QImage& img,
+imageproc::BinaryImage PageLayoutEstimator::to300DpiBinary(const PagePyramid& pyramid,
                                                            QTransform& xform,
                                                            const BinaryThreshold binary_threshold) {
+  const GrayImage& img = pyramid.fullResolution();
   const double xfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterX();
   const double yfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterY();
-  if ((std::fabs(xfactor - 1.0) < 0.1) && (std::fabs(yfactor - 1.0) < 0.1)) {
-    return BinaryImage(img, binary_threshold);
+  const bool near_300dpi = (std::fabs(xfactor - 1.0) < 0.1) && (std::fabs(yfactor - 1.0) < 0.1);
+  if (near_300dpi || ((xfactor <= 0.9) && (yfactor <= 0.9))) {
+    // The pyramid level is what we would have produced ourselves, and other stages reuse it.
+    QTransform orig_to_level;
+    BinaryImage level(pyramid.binaryLevel(300, binary_threshold, &orig_to_level));
+    xform *= orig_to_level;
+
+    return level;
   }
 
   QTransform scale_xform;
@@ -471,7 +478,7 @@ imageproc::BinaryImage PageLayoutEstimator::to300DpiBinary(const QImage& img,
   const QSize new_size(std::max(1, (int) std::ceil(xfactor * img.width())),
                        std::max(1, (int) std::ceil(yfactor * img.height())));
 
-  const GrayImage new_image(scaleToGray(GrayImage(img), new_size));
+  const GrayImage new_image(scaleToGray(img, new_size));
 
   return BinaryImage(new_image, binary_threshold);
 }
@@ -31,6 +31,7 @@ class QImage;
 class QTransform;
 class ImageTransformation;
 class DebugImages;
+class PagePyramid;
 class Span;
 
 namespace imageproc {
@@ -49,8 +50,7 @@ class PageLayoutEstimator {
    * \param layout_type The type of a layout to detect.  If set to
    *        something other than Rule::AUTO_DETECT, the returned
    *        layout will have the same type.
-   * \param input The input image.  Will be converted to grayscale unless
-   *        it's already grayscale.
+   * \param pyramid The input image along with its reduced resolution versions.
    * \param pre_xform The logical transformation applied to the input image.
    *        The resulting page layout will be in transformed coordinates.
    * \param bw_threshold The global binarization threshold for the
@@ -60,7 +60,7 @@ class PageLayoutEstimator {
    *         requested layout type.
    */
   static PageLayout estimatePageLayout(LayoutType layout_type,
-                                       const QImage& input,
+                                       const PagePyramid& pyramid,
                                        const ImageTransformation& pre_xform,
                                        imageproc::BinaryThreshold bw_threshold,
                                        DebugImages* dbg = nullptr);
@@ -72,7 +72,7 @@ class PageLayoutEstimator {
                                                          DebugImages* dbg);
 
   static PageLayout cutAtWhitespace(LayoutType layout_type,
-                                    const QImage& input,
+                                    const PagePyramid& pyramid,
                                     const ImageTransformation& pre_xform,
                                     imageproc::BinaryThreshold bw_threshold,
                                     DebugImages* dbg);
@@ -84,7 +84,7 @@ class PageLayoutEstimator {
                                                bool right_offcut,
                                                DebugImages* dbg);
 
-  static imageproc::BinaryImage to300DpiBinary(const QImage& img,
+  static imageproc::BinaryImage to300DpiBinary(const PagePyramid& pyramid,
                                                QTransform& xform,
                                                imageproc::BinaryThreshold threshold);
 
@@ -99,7 +99,7 @@ Task::Task(intrusive_ptr<Filter> filter,
 
 Task::~Task() = default;
 
-FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data) {
+FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
   status.throwIfCancelled();
 
   Settings::Record record(m_settings->getPageRecord(m_pageInfo.imageId()));
@@ -114,7 +114,7 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data)
 
     if (!params || !deps.compatibleWith(*params)) {
       if (!params || (record.combinedLayoutType() == AUTO_LAYOUT_TYPE)) {
-        new_layout = PageLayoutEstimator::estimatePageLayout(record.combinedLayoutType(), data.grayImage(),
+        new_layout = PageLayoutEstimator::estimatePageLayout(record.combinedLayoutType(), data.pyramid(),
                                                              data.xform(), data.bwThreshold(), m_dbg.get());
 
         status.throwIfCancelled();
@@ -183,7 +183,7 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data)
     ImageTransformation new_xform(data.xform());
     new_xform.setPreCropArea(layout.pageOutline(m_pageInfo.id().subPage()).toPolygon());
 
-    return m_nextTask->process(status, FilterData(data, new_xform));
+    return m_nextTask->process(status, FilterData(std::move(data), new_xform));
   }
 
   return make_intrusive<UiUpdater>(m_filter, m_pages, std::move(m_dbg), data.origImage(), m_pageInfo, data.xform(),
@@ -129,17 +129,25 @@ std::vector<QLineF> VertLineFinder::findLines(const QImage& image,
   const int height = raster_lines.height();
   const uint8_t* line = raster_lines.data();
   const int stride = raster_lines.stride();
+  std::vector<QPoint> points;
+  std::vector<unsigned> weights;
   for (int y = 0; y < height; ++y, line += stride) {
     for (int x = margin; x < x_limit; ++x) {
       const unsigned val = line[x];
       if (val > 1) {
-        line_detector.process(x, y, weight_table[val]);
+        points.emplace_back(x, y);
+        weights.push_back(weight_table[val]);
       }
     }
   }
 
   const unsigned min_quality = (unsigned) (height * line_thickness * 1.8) + 1;
 
+  // Skipping angles that can't reach min_quality would leave holes in the visualized Hough space.
+  line_detector.process(points, weights, dbg ? 0 : min_quality);
+  points = std::vector<QPoint>();
+  weights = std::vector<unsigned>();
+
   if (dbg) {
     dbg->add(line_detector.visualizeHoughSpace(min_quality), "hough_space");
   }
@@ -24,6 +24,7 @@
 #include "DebugImages.h"
 #include "Despeckle.h"
 #include "FilterData.h"
+#include "ParallelFor.h"
 #include "TaskStatus.h"
 #include "imageproc/Binarize.h"
 #include "imageproc/BinaryImage.h"
@@ -90,12 +91,19 @@ QRectF ContentBoxFinder::findContentBox(const TaskStatus& status,
     return QRectF();
   }
 
-  const GrayImage dataGrayImage = data.isBlackOnWhite() ? data.grayImage() : data.grayImage().inverted();
-  const uint8_t darkest_gray_level = darkestGrayLevel(dataGrayImage);
+  // Going through the shared 300 DPI level saves us from inverting
+  // and transforming the full resolution image.
+  QTransform orig_to_300dpi;
+  GrayImage dataGrayImage = data.pyramid().grayLevel(300, &orig_to_300dpi);
+  uint8_t darkest_gray_level = data.pyramid().darkestGrayLevel();
+  if (!data.isBlackOnWhite()) {
+    dataGrayImage = dataGrayImage.inverted();
+    darkest_gray_level = static_cast<uint8_t>(255 - data.pyramid().lightestGrayLevel());
+  }
   const QColor outside_color(darkest_gray_level, darkest_gray_level, darkest_gray_level);
 
-  QImage gray150(transformToGray(dataGrayImage, xform_150dpi.transform(), xform_150dpi.resultingRect().toRect(),
-                                 OutsidePixels::assumeColor(outside_color)));
+  QImage gray150(transformToGray(dataGrayImage, orig_to_300dpi.inverted() * xform_150dpi.transform(),
+                                 xform_150dpi.resultingRect().toRect(), OutsidePixels::assumeColor(outside_color)));
   // Note that we fill new areas that appear as a result of
   // rotation with black, not white.  Filling them with white
   // may be bad for detecting the shadow around the page.
@@ -193,40 +201,56 @@ QRectF ContentBoxFinder::findContentBox(const TaskStatus& status,
   const int area_threshold = std::min(content.width(), content.height());
 
   {
-    MaxWhitespaceFinder hor_ws_finder(PreferHorizontal(), despeckled);
-
-    for (int i = 0; i < 80; ++i) {
-      QRect ws(hor_ws_finder.next(hor_ws_finder.MANUAL_OBSTACLES));
-      if (ws.isNull()) {
-        break;
-      }
-      if (ws.width() * ws.height() < area_threshold) {
-        break;
+    // The horizontal and vertical passes are independent, so run them concurrently.
+    const auto integral_img = MaxWhitespaceFinder::buildIntegralImage(despeckled);
+    std::vector<QRect> hor_whitespace;
+    std::vector<QRect> vert_whitespace;
+
+    parallelFor(0, 2, 1, [&](const int begin, const int end) {
+      for (int pass = begin; pass < end; ++pass) {
+        if (pass == 0) {
+          MaxWhitespaceFinder hor_ws_finder(PreferHorizontal(), integral_img);
+
+          for (int i = 0; i < 80; ++i) {
+            QRect ws(hor_ws_finder.next(hor_ws_finder.MANUAL_OBSTACLES));
+            if (ws.isNull()) {
+              break;
+            }
+            if (ws.width() * ws.height() < area_threshold) {
+              break;
+            }
+            hor_whitespace.push_back(ws);
+            const int height_fraction = ws.height() / 5;
+            ws.setTop(ws.top() + height_fraction);
+            ws.setBottom(ws.bottom() - height_fraction);
+            hor_ws_finder.addObstacle(ws);
+          }
+        } else {
+          MaxWhitespaceFinder vert_ws_finder(PreferVertical(), integral_img);
+
+          for (int i = 0; i < 40; ++i) {
+            QRect ws(vert_ws_finder.next(vert_ws_finder.MANUAL_OBSTACLES));
+            if (ws.isNull()) {
+              break;
+            }
+            if (ws.width() * ws.height() < area_threshold) {
+              break;
+            }
+            vert_whitespace.push_back(ws);
+            const int width_fraction = ws.width() / 5;
+            ws.setLeft(ws.left() + width_fraction);
+            ws.setRight(ws.right() - width_fraction);
+            vert_ws_finder.addObstacle(ws);
+          }
+        }
       }
+    });
+
+    for (const QRect& ws : hor_whitespace) {
       content_blocks.fill(ws, WHITE);
-      const int height_fraction = ws.height() / 5;
-      ws.setTop(ws.top() + height_fraction);
-      ws.setBottom(ws.bottom() - height_fraction);
-      hor_ws_finder.addObstacle(ws);
     }
-  }
-
-  {
-    MaxWhitespaceFinder vert_ws_finder(PreferVertical(), despeckled);
-
-    for (int i = 0; i < 40; ++i) {
-      QRect ws(vert_ws_finder.next(vert_ws_finder.MANUAL_OBSTACLES));
-      if (ws.isNull()) {
-        break;
-      }
-      if (ws.width() * ws.height() < area_threshold) {
-        break;
-      }
+    for (const QRect& ws : vert_whitespace) {
       content_blocks.fill(ws, WHITE);
-      const int width_fraction = ws.width() / 5;
-      ws.setLeft(ws.left() + width_fraction);
-      ws.setRight(ws.right() - width_fraction);
-      vert_ws_finder.addObstacle(ws);
     }
   }
 
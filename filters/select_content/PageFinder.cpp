@@ -55,12 +55,19 @@ QRectF PageFinder::findPageBox(const TaskStatus& status,
   std::cout << "exp_width = " << exp_width << "; exp_height" << exp_height << std::endl;
 #endif
 
-  const GrayImage dataGrayImage = data.isBlackOnWhite() ? data.grayImage() : data.grayImage().inverted();
-  const uint8_t darkest_gray_level = darkestGrayLevel(dataGrayImage);
+  // Going through the shared 300 DPI level saves us from inverting
+  // and transforming the full resolution image.
+  QTransform orig_to_300dpi;
+  GrayImage dataGrayImage = data.pyramid().grayLevel(300, &orig_to_300dpi);
+  uint8_t darkest_gray_level = data.pyramid().darkestGrayLevel();
+  if (!data.isBlackOnWhite()) {
+    dataGrayImage = dataGrayImage.inverted();
+    darkest_gray_level = static_cast<uint8_t>(255 - data.pyramid().lightestGrayLevel());
+  }
   const QColor outside_color(darkest_gray_level, darkest_gray_level, darkest_gray_level);
 
-  QImage gray150(transformToGray(dataGrayImage, xform_150dpi.transform(), xform_150dpi.resultingRect().toRect(),
-                                 OutsidePixels::assumeColor(outside_color)));
+  QImage gray150(transformToGray(dataGrayImage, orig_to_300dpi.inverted() * xform_150dpi.transform(),
+                                 xform_150dpi.resultingRect().toRect(), OutsidePixels::assumeColor(outside_color)));
   if (dbg) {
     dbg->add(gray150, "gray150");
   }
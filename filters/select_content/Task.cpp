@@ -82,7 +82,7 @@ Task::Task(intrusive_ptr<Filter> filter,
 
 Task::~Task() = default;
 
-FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data) {
+FilterResultPtr Task::process(const TaskStatus& status, FilterData data) {
   status.throwIfCancelled();
 
   std::unique_ptr<Params> params(m_settings->getPageParams(m_pageId));
@@ -156,7 +156,7 @@ FilterResultPtr Task::process(const TaskStatus& status, const FilterData& data)
   status.throwIfCancelled();
 
   if (m_nextTask) {
-    return m_nextTask->process(status, FilterData(data, data.xform()), ui_data.pageRect(), ui_data.contentRect());
+    return m_nextTask->process(status, std::move(data), ui_data.pageRect(), ui_data.contentRect());
   } else {
     return make_intrusive<UiUpdater>(m_filter, m_pageId, std::move(m_dbg), data.origImage(), data.xform(),
                                      data.isBlackOnWhite() ? data.grayImage() : data.grayImage().inverted(), ui_data,
@@ -54,7 +54,7 @@ class Task : public ref_countable {
 
   ~Task() override;
 
-  FilterResultPtr process(const TaskStatus& status, const FilterData& data);
+  FilterResultPtr process(const TaskStatus& status, FilterData data);
 
  private:
   class UiUpdater;
@@ -0,0 +1,187 @@
+
+#include "ParallelFor.h"
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace {
+// Zero stands for QThread::idealThreadCount().
+std::atomic<int> thread_limit(0);
+
+// Threads inside parallelFor() or a ProcessingThreadScope, plus reserved helpers.
+std::atomic<int> busy_threads(0);
+
+// The nesting depth of busy scopes on the current thread.
+thread_local int busy_depth = 0;
+
+class HelperPool : public QThreadPool {
+ public:
+  HelperPool() { setMaxThreadCount(processingThreadLimit()); }
+};
+
+QThreadPool& helperPool() {
+  static HelperPool pool;
+
+  return pool;
+}
+
+/**
+ * Reserves up to \p wanted helpers within the limit of busy threads.
+ *
+ * \return The number of helpers reserved.
+ */
+int reserveHelpers(const int wanted) {
+  const int limit = processingThreadLimit();
+  int busy = busy_threads.load();
+  while (true) {
+    const int num_helpers = std::min(wanted, limit - busy);
+    if (num_helpers <= 0) {
+      return 0;
+    }
+    if (busy_threads.compare_exchange_weak(busy, busy + num_helpers)) {
+      return num_helpers;
+    }
+  }
+}
+
+
+class ParallelForJob {
+ public:
+  ParallelForJob(int begin, int end, int grain, const std::function<void(int, int)>& func)
+      : m_func(func),
+        m_begin(begin),
+        m_end(end),
+        m_grain(grain),
+        m_numChunks((end - begin + grain - 1) / grain),
+        m_nextChunk(0),
+        m_chunksDone(0),
+        m_failed(false) {}
+
+  int numChunks() const { return m_numChunks; }
+
+  /**
+   * Processes chunks until there are none left.
+   */
+  void work() {
+    while (true) {
+      const int chunk = m_nextChunk.fetch_add(1);
+      if (chunk >= m_numChunks) {
+        break;
+      }
+
+      if (!m_failed.load()) {
+        const int chunk_begin = m_begin + chunk * m_grain;
+        const int chunk_end = std::min(chunk_begin + m_grain, m_end);
+        try {
+          m_func(chunk_begin, chunk_end);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if (!m_failed.exchange(true)) {
+            m_exception = std::current_exception();
+          }
+        }
+      }
+
+      if (m_chunksDone.fetch_add(1) + 1 == m_numChunks) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_allDone.notify_all();
+      }
+    }
+  }
+
+  /**
+   * Waits for all the chunks to be processed and rethrows
+   * the exception thrown by the functor, if any.
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allDone.wait(lock, [this]() { return m_chunksDone.load() == m_numChunks; });
+
+    if (m_exception) {
+      std::rethrow_exception(m_exception);
+    }
+  }
+
+ private:
+  /**
+   * Only accessed while there are chunks left, which can't outlive
+   * the parallelFor() call.
+   */
+  const std::function<void(int, int)>& m_func;
+  const int m_begin;
+  const int m_end;
+  const int m_grain;
+  const int m_numChunks;
+  std::atomic<int> m_nextChunk;
+  std::atomic<int> m_chunksDone;
+  std::atomic<bool> m_failed;
+  std::exception_ptr m_exception;
+  std::mutex m_mutex;
+  std::condition_variable m_allDone;
+};
+
+
+class ParallelForRunnable : public QRunnable {
+ public:
+  explicit ParallelForRunnable(std::shared_ptr<ParallelForJob> job) : m_job(std::move(job)) { setAutoDelete(true); }
+
+  void run() override {
+    // The reservation made for us counts this thread as busy.
+    ++busy_depth;
+    m_job->work();
+    --busy_depth;
+    busy_threads.fetch_sub(1);
+  }
+
+ private:
+  std::shared_ptr<ParallelForJob> m_job;
+};
+}  // namespace
+
+void parallelFor(const int begin, const int end, int grain, const std::function<void(int, int)>& func) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max(grain, 1);
+
+  // A job may be referenced by runnables that get started after we return.
+  const auto job = std::make_shared<ParallelForJob>(begin, end, grain, func);
+
+  const ProcessingThreadScope caller;
+  const int num_helpers = reserveHelpers(job->numChunks() - 1);
+  for (int i = 0; i < num_helpers; ++i) {
+    helperPool().start(new ParallelForRunnable(job));
+  }
+
+  job->work();
+  job->wait();
+}
+
+void setProcessingThreadLimit(const int limit) {
+  thread_limit = std::max(limit, 1);
+  helperPool().setMaxThreadCount(processingThreadLimit());
+}
+
+int processingThreadLimit() {
+  const int limit = thread_limit.load();
+
+  return (limit > 0) ? limit : std::max(QThread::idealThreadCount(), 1);
+}
+
+ProcessingThreadScope::ProcessingThreadScope() {
+  if (busy_depth++ == 0) {
+    busy_threads.fetch_add(1);
+  }
+}
+
+ProcessingThreadScope::~ProcessingThreadScope() {
+  if (--busy_depth == 0) {
+    busy_threads.fetch_sub(1);
+  }
+}
@@ -0,0 +1,58 @@
+
+#ifndef SCANTAILOR_PARALLELFOR_H
+#define SCANTAILOR_PARALLELFOR_H
+
+#include <functional>
+#include "NonCopyable.h"
+
+/**
+ * \brief Processes the range [begin, end) in chunks, possibly in parallel.
+ *
+ * The range is split into consecutive chunks of at most \p grain elements,
+ * and \p func(chunk_begin, chunk_end) is called once for each of them.
+ * The chunks are distributed between the calling thread and helper threads
+ * of a dedicated pool.  Helpers are only brought in while fewer threads than
+ * processingThreadLimit() are busy.  The calling thread always takes part
+ * in processing, so progress is guaranteed even if no helpers are available,
+ * and it's safe to call this function from a thread pool thread.
+ *
+ * The function returns once all the chunks are processed.  If \p func throws,
+ * the chunks not yet started are skipped and the first exception is rethrown
+ * in the calling thread.
+ *
+ * \param begin The beginning of the range.
+ * \param end The end of the range (exclusive).
+ * \param grain The maximum number of elements in a chunk.  Should be large
+ *        enough for a chunk to outweigh the scheduling overhead.
+ * \param func The functor to call for each chunk.  It will be called
+ *        concurrently from different threads.
+ */
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& func);
+
+/**
+ * \brief Sets how many threads may be busy processing at once.
+ *
+ * Busy threads are the ones inside parallelFor(), its helpers and the ones
+ * marked with ProcessingThreadScope.  Defaults to QThread::idealThreadCount().
+ */
+void setProcessingThreadLimit(int limit);
+
+int processingThreadLimit();
+
+/**
+ * \brief Counts the current thread as busy processing while in scope.
+ *
+ * Meant for worker threads, so that their parallelFor() calls share
+ * processingThreadLimit() rather than each taking all the cores.
+ * Nested scopes on the same thread count once.
+ */
+class ProcessingThreadScope {
+  DECLARE_NON_COPYABLE(ProcessingThreadScope)
+
+ public:
+  ProcessingThreadScope();
+
+  ~ProcessingThreadScope();
+};
+
+#endif  // SCANTAILOR_PARALLELFOR_H
@@ -29,8 +29,11 @@
 #include <memory>
 #include <new>
 #include <stdexcept>
+#include <vector>
 #include "BitOps.h"
 #include "ByteOrder.h"
+#include "ImageBufferAllocator.h"
+#include "ScanlineConversion.h"
 
 namespace imageproc {
 class BinaryImage::SharedData {
@@ -946,45 +949,33 @@ BinaryImage BinaryImage::fromIndexed8(const QImage& image, const QRect& rect, co
   BinaryImage dst(width, height);
   const int dst_wpl = dst.wordsPerLine();
   uint32_t* dst_line = dst.data();
-  const int last_word_idx = (width - 1) >> 5;
-  const int last_word_bits = width - (last_word_idx << 5);
-  const int last_word_unused_bits = 32 - last_word_bits;
 
   const int num_colors = image.colorCount();
   assert(num_colors <= 256);
-  int color_to_gray[256];
+  uint8_t color_to_gray[256];
+  bool gray_palette = (num_colors == 256);
   int color_idx = 0;
   for (; color_idx < num_colors; ++color_idx) {
-    color_to_gray[color_idx] = qGray(image.color(color_idx));
+    color_to_gray[color_idx] = static_cast<uint8_t>(qGray(image.color(color_idx)));
+    gray_palette = gray_palette && (color_to_gray[color_idx] == color_idx);
   }
   for (; color_idx < 256; ++color_idx) {
     color_to_gray[color_idx] = 0;  // just in case
   }
 
-  for (int i = height; i > 0; --i) {
-    for (int j = 0; j < last_word_idx; ++j) {
-      const uint8_t* const src_pos = &src_line[j << 5];
-      uint32_t word = 0;
-      for (int bit = 0; bit < 32; ++bit) {
-        word <<= 1;
-        if (color_to_gray[src_pos[bit]] < threshold) {
-          word |= uint32_t(1);
-        }
-      }
-      dst_line[j] = word;
-    }
+  // With a grayscale palette, which is the common case, pixels are gray levels already.
+  std::vector<uint8_t> gray_line(gray_palette ? 0 : width);
 
-    // Handle the last word.
-    const uint8_t* const src_pos = &src_line[last_word_idx << 5];
-    uint32_t word = 0;
-    for (int bit = 0; bit < last_word_bits; ++bit) {
-      word <<= 1;
-      if (color_to_gray[src_pos[bit]] < threshold) {
-        word |= uint32_t(1);
+  const ScanlineConverter& converter = ScanlineConverter::instance();
+  for (int i = height; i > 0; --i) {
+    const uint8_t* gray = src_line;
+    if (!gray_palette) {
+      for (int x = 0; x < width; ++x) {
+        gray_line[x] = color_to_gray[src_line[x]];
       }
+      gray = gray_line.data();
     }
-    word <<= last_word_unused_bits;
-    dst_line[last_word_idx] = word;
+    converter.grayToBinary(gray, dst_line, width, threshold);
 
     dst_line += dst_wpl;
     src_line += src_bpl;
@@ -993,15 +984,6 @@ BinaryImage BinaryImage::fromIndexed8(const QImage& image, const QRect& rect, co
   return dst;
 }  // BinaryImage::fromIndexed8
 
-static inline uint32_t thresholdRgb32(const QRgb c, const int threshold) {
-  // gray = (R * 11 + G * 16 + B * 5) / 32;
-  // return (gray < threshold) ? 1 : 0;
-
-  const int sum = qRed(c) * 11 + qGreen(c) * 16 + qBlue(c) * 5;
-
-  return (sum < threshold * 32) ? 1 : 0;
-}
-
 BinaryImage BinaryImage::fromRgb32(const QImage& image, const QRect& rect, const int threshold) {
   const int width = rect.width();
   const int height = rect.height();
@@ -1014,30 +996,10 @@ BinaryImage BinaryImage::fromRgb32(const QImage& image, const QRect& rect, const
   BinaryImage dst(width, height);
   const int dst_wpl = dst.wordsPerLine();
   uint32_t* dst_line = dst.data();
-  const int last_word_idx = (width - 1) >> 5;
-  const int last_word_bits = width - (last_word_idx << 5);
-  const int last_word_unused_bits = 32 - last_word_bits;
 
+  const ScanlineConverter& converter = ScanlineConverter::instance();
   for (int i = height; i > 0; --i) {
-    for (int j = 0; j < last_word_idx; ++j) {
-      const QRgb* const src_pos = &src_line[j << 5];
-      uint32_t word = 0;
-      for (int bit = 0; bit < 32; ++bit) {
-        word <<= 1;
-        word |= thresholdRgb32(src_pos[bit], threshold);
-      }
-      dst_line[j] = word;
-    }
-
-    // Handle the last word.
-    const QRgb* const src_pos = &src_line[last_word_idx << 5];
-    uint32_t word = 0;
-    for (int bit = 0; bit < last_word_bits; ++bit) {
-      word <<= 1;
-      word |= thresholdRgb32(src_pos[bit], threshold);
-    }
-    word <<= last_word_unused_bits;
-    dst_line[last_word_idx] = word;
+    converter.rgb32ToBinary(src_line, dst_line, width, threshold);
 
     dst_line += dst_wpl;
     src_line += src_wpl;
@@ -1280,21 +1242,16 @@ bool operator==(const BinaryImage& lhs, const BinaryImage& rhs) {
 void BinaryImage::SharedData::unref() const {
   if (!m_counter.deref()) {
     this->~SharedData();
-    free((void*) this);
+    ImageBufferAllocator::release((void*) this);
   }
 }
 
 void* BinaryImage::SharedData::operator new(size_t, const NumWords num_words) {
   SharedData* sd = nullptr;
-  void* addr = malloc(((char*) &sd->m_data[0] - (char*) sd) + num_words.numWords * 4);
-  if (!addr) {
-    throw std::bad_alloc();
-  }
-
-  return addr;
+  return ImageBufferAllocator::allocate(((char*) &sd->m_data[0] - (char*) sd) + num_words.numWords * 4);
 }
 
 void BinaryImage::SharedData::operator delete(void* addr, NumWords) {
-  free(addr);
+  ImageBufferAllocator::release(addr);
 }
 }  // namespace imageproc
\ No newline at end of file
@@ -1,255 +1,455 @@
-
 #include "ColorTable.h"
+#include <algorithm>
 #include <cassert>
-#include <set>
-#include <unordered_set>
-#include "BinaryImage.h"
+#include <stdexcept>
+#include "ImageBufferAllocator.h"
 
 namespace imageproc {
+namespace {
+/**
+ * Maps colors to the groups posterization merges them into.
+ *
+ * A group is identified by the quantized normalized levels of the color's
+ * channels.  Rows of blue levels are only allocated for the (red, green)
+ * pairs actually present, so the table stays small even for high levels.
+ */
+class ColorGrouper {
+ public:
+  ColorGrouper(const std::vector<uint8_t>& normalizationTable, const int level) {
+    const double levelStride = 255.0 / level;
+    for (int i = 0; i < 256; ++i) {
+      m_levels[i] = static_cast<int>(normalizationTable[i] / levelStride);
+    }
 
-ColorTable::ColorTable(const QImage& image) {
-  if ((image.format() != QImage::Format_Indexed8) && (image.format() != QImage::Format_RGB32)
-      && (image.format() != QImage::Format_ARGB32)) {
-    throw std::invalid_argument("ColorTable: Image format not supported.");
+    m_numLevels = static_cast<int>(255 / levelStride) + 1;
+    m_rows.resize(m_numLevels * m_numLevels, -1);
   }
 
-  this->m_image = image;
-}
-
-QImage ColorTable::getImage() const {
-  return m_image;
-}
-
-QVector<QRgb> ColorTable::getPalette() const {
-  std::unordered_map<uint32_t, int> paletteMap;
-  switch (m_image.format()) {
-    case QImage::Format_Indexed8:
-      paletteMap = paletteFromIndexedWithStatistics();
-      break;
-    case QImage::Format_RGB32:
-    case QImage::Format_ARGB32:
-      paletteMap = paletteFromRgbWithStatistics();
-      break;
-    default:
-      return QVector<QRgb>();
-  }
+  /**
+   * Returns the group of the color, or -1 if no color of that group was added.
+   */
+  int find(const uint32_t color) const {
+    const int row = m_rows[m_levels[qRed(color)] * m_numLevels + m_levels[qGreen(color)]];
+    if (row < 0) {
+      return -1;
+    }
 
-  QVector<QRgb> palette(static_cast<int>(paletteMap.size()));
-  for (const auto& colorAndStat : paletteMap) {
-    palette.push_back(colorAndStat.first);
+    return m_groups[row + m_levels[qBlue(color)]];
   }
 
-  return palette;
-}
-
+  /**
+   * Returns a reference to the group of the color, which is -1 until assigned.
+   */
+  int& group(const uint32_t color) {
+    int& row = m_rows[m_levels[qRed(color)] * m_numLevels + m_levels[qGreen(color)]];
+    if (row < 0) {
+      row = static_cast<int>(m_groups.size());
+      m_groups.resize(m_groups.size() + m_numLevels, -1);
+    }
 
-ColorTable& ColorTable::posterize(const int level,
-                                  bool normalize,
-                                  const bool forceBlackAndWhite,
-                                  const int normalizeBlackLevel,
-                                  const int normalizeWhiteLevel) {
-  if ((level < 2) || (level > 255)) {
-    throw std::invalid_argument("ColorTable: level must be a value between 2 and 255 inclusive");
-  }
-  if ((level == 255) && !normalize && !forceBlackAndWhite) {
-    return *this;
+    return m_groups[row + m_levels[qBlue(color)]];
   }
 
-  std::unordered_map<uint32_t, uint32_t> oldToNewColorMap;
-  size_t newColorTableSize;
+ private:
+  int m_levels[256];
+  int m_numLevels;
+  std::vector<int> m_rows;
+  std::vector<int> m_groups;
+};
+
+
+/**
+ * A color to palette index map for palettes of up to 256 colors.
+ */
+class PaletteIndex {
+ public:
+  PaletteIndex() { std::fill(m_indices, m_indices + SIZE, -1); }
+
+  int find(const uint32_t color) const {
+    for (unsigned slot = hash(color);; slot = (slot + 1) & (SIZE - 1)) {
+      if (m_indices[slot] < 0) {
+        return -1;
+      } else if (m_colors[slot] == color) {
+        return m_indices[slot];
+      }
+    }
+  }
 
-  {
-    // Get the palette with statistics.
-    std::unordered_map<uint32_t, int> paletteStatMap;
-    switch (m_image.format()) {
-      case QImage::Format_Indexed8:
-        paletteStatMap = paletteFromIndexedWithStatistics();
-        break;
-      case QImage::Format_RGB32:
-      case QImage::Format_ARGB32:
-        paletteStatMap = paletteFromRgbWithStatistics();
-        break;
-      default:
-        return *this;
+  void insert(const uint32_t color, const int index) {
+    unsigned slot = hash(color);
+    while ((m_indices[slot] >= 0) && (m_colors[slot] != color)) {
+      slot = (slot + 1) & (SIZE - 1);
     }
+    m_colors[slot] = color;
+    m_indices[slot] = index;
+  }
 
-    // We have to normalize palette in order posterization to work with pale images.
-    std::unordered_map<uint32_t, uint32_t> colorToNormalizedMap
-        = normalizePalette(paletteStatMap, normalizeBlackLevel, normalizeWhiteLevel);
+ private:
+  // Keeps the table at most a quarter full.
+  static const unsigned SIZE = 1024;
 
-    // Build color groups resulted from splitting RGB space
-    std::unordered_map<uint32_t, std::list<uint32_t>> groupMap;
-    const double levelStride = 255.0 / level;
-    for (const auto& colorAndStat : paletteStatMap) {
-      const uint32_t color = colorAndStat.first;
-      const uint32_t normalized_color = colorToNormalizedMap[color];
+  static unsigned hash(const uint32_t color) { return (color * 2654435761u) >> 22; }
+
+  uint32_t m_colors[SIZE];
+  int m_indices[SIZE];
+};
 
-      auto redGroupIdx = static_cast<const int>(qRed(normalized_color) / levelStride);
-      auto blueGroupIdx = static_cast<const int>(qGreen(normalized_color) / levelStride);
-      auto greenGroupIdx = static_cast<const int>(qBlue(normalized_color) / levelStride);
 
-      auto group = static_cast<uint32_t>((redGroupIdx << 16) | (greenGroupIdx << 8) | (blueGroupIdx));
+/**
+ * Counts pixels of each color in an open addressing hash table.
+ *
+ * Unlike a histogram over the RGB cube, its size follows the number
+ * of distinct colors in the image, which is usually small.
+ */
+class ColorCounter {
+ public:
+  ColorCounter() : m_slots(INITIAL_SIZE), m_numColors(0) {}
 
-      groupMap[group].push_back(color);
+  void add(const uint32_t color, const int count) {
+    Slot& slot = m_slots[findSlot(color)];
+    if (slot.count == 0) {
+      slot.color = color;
+      ++m_numColors;
     }
+    slot.count += count;
 
-    // Find the most often occurring color in the group and map the other colors in the group to that.
-    for (const auto& groupAndColors : groupMap) {
-      const std::list<uint32_t>& colors = groupAndColors.second;
-      assert(!colors.empty());
+    // Keeps the table at most half full.
+    if (m_numColors * 2 > m_slots.size()) {
+      grow();
+    }
+  }
 
-      uint32_t mostOftenColorInGroup = *colors.begin();
-      for (auto it = ++colors.begin(); it != colors.end(); ++it) {
-        if (paletteStatMap[*it] > paletteStatMap[mostOftenColorInGroup]) {
-          mostOftenColorInGroup = *it;
-        }
+  template <typename ColorStat>
+  void appendTo(std::vector<ColorStat>& palette) const {
+    palette.reserve(palette.size() + m_numColors);
+    for (const Slot& slot : m_slots) {
+      if (slot.count != 0) {
+        palette.push_back({slot.color, slot.count});
       }
+    }
+  }
 
-      if (forceBlackAndWhite) {
-        if (normalize) {
-          colorToNormalizedMap[0xff000000u] = 0xff000000u;
-          colorToNormalizedMap[0xffffffffu] = 0xffffffffu;
-        }
-        makeGrayBlackOrWhiteInPlace(mostOftenColorInGroup, colorToNormalizedMap[mostOftenColorInGroup]);
-      }
+ private:
+  struct Slot {
+    uint32_t color = 0;
+    int count = 0;
+  };
+
+  static const size_t INITIAL_SIZE = 1024;
+
+  static size_t hash(const uint32_t color) {
+    const uint32_t h = color * 2654435761u;
 
-      for (const uint32_t& color : colors) {
-        oldToNewColorMap[color] = normalize ? colorToNormalizedMap[mostOftenColorInGroup] : mostOftenColorInGroup;
+    return h ^ (h >> 16);
+  }
+
+  size_t findSlot(const uint32_t color) const {
+    const size_t mask = m_slots.size() - 1;
+    for (size_t slot = hash(color) & mask;; slot = (slot + 1) & mask) {
+      if ((m_slots[slot].count == 0) || (m_slots[slot].color == color)) {
+        return slot;
       }
     }
+  }
 
-    newColorTableSize = groupMap.size();
+  void grow() {
+    std::vector<Slot> oldSlots(m_slots.size() * 2);
+    oldSlots.swap(m_slots);
+    for (const Slot& slot : oldSlots) {
+      if (slot.count != 0) {
+        m_slots[findSlot(slot.color)] = slot;
+      }
+    }
   }
 
-  if (m_image.format() == QImage::Format_Indexed8) {
-    remapColorsInIndexedImage(oldToNewColorMap);
-  } else {
-    if (newColorTableSize <= 256) {
-      buildIndexedImageFromRgb(oldToNewColorMap);
+  std::vector<Slot> m_slots;
+  size_t m_numColors;
+};
+
+
+template <typename ColorStat>
+void sortAndMergeDuplicates(std::vector<ColorStat>& palette) {
+  std::sort(palette.begin(), palette.end(),
+            [](const ColorStat& lhs, const ColorStat& rhs) { return lhs.color < rhs.color; });
+
+  auto out = palette.begin();
+  for (auto it = palette.begin(); it != palette.end(); ++it) {
+    if ((out != palette.begin()) && ((out - 1)->color == it->color)) {
+      (out - 1)->count += it->count;
     } else {
-      remapColorsInRgbImage(oldToNewColorMap);
+      *out++ = *it;
     }
   }
-
-  return *this;
+  palette.erase(out, palette.end());
 }
 
-std::unordered_map<uint32_t, int> ColorTable::paletteFromIndexedWithStatistics() const {
-  std::unordered_map<uint32_t, int> palette;
+void remapColorsInIndexedImage(QImage& image, const ColorGrouper& grouper, const std::vector<uint32_t>& groupColors) {
+  // Different groups may end up with the same color, black or white for example.
+  const QVector<QRgb> colorTable = image.colorTable();
+  QVector<QRgb> newColorTable;
+  uint8_t indexMap[256] = {};
+  for (int i = 0; i < std::min(colorTable.size(), 256); ++i) {
+    const int group = grouper.find(colorTable[i]);
+    if (group < 0) {
+      // Not used by the image.
+      continue;
+    }
 
-  const int width = m_image.width();
-  const int height = m_image.height();
+    int newIndex = newColorTable.indexOf(groupColors[group]);
+    if (newIndex < 0) {
+      newIndex = newColorTable.size();
+      newColorTable.push_back(groupColors[group]);
+    }
+    indexMap[i] = static_cast<uint8_t>(newIndex);
+  }
 
-  const uint8_t* img_line = m_image.bits();
-  const int img_stride = m_image.bytesPerLine();
+  const int width = image.width();
+  const int height = image.height();
 
-  QVector<QRgb> colorTable = m_image.colorTable();
+  uint8_t* img_line = image.bits();
+  const int img_stride = image.bytesPerLine();
 
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
-      uint8_t colorIndex = img_line[x];
-      uint32_t color = colorTable[colorIndex];
-
-      ++palette[color];
+      img_line[x] = indexMap[img_line[x]];
     }
     img_line += img_stride;
   }
 
-  return palette;
+  image.setColorTable(newColorTable);
 }
 
-std::unordered_map<uint32_t, int> ColorTable::paletteFromRgbWithStatistics() const {
-  std::unordered_map<uint32_t, int> palette;
+void remapColorsInRgbImage(QImage& image, const ColorGrouper& grouper, const std::vector<uint32_t>& groupColors) {
+  const int width = image.width();
+  const int height = image.height();
 
-  const int width = m_image.width();
-  const int height = m_image.height();
-
-  const auto* img_line = reinterpret_cast<const uint32_t*>(m_image.bits());
-  const int img_stride = m_image.bytesPerLine() / sizeof(uint32_t);
+  auto* img_line = reinterpret_cast<uint32_t*>(image.bits());
+  const int img_stride = image.bytesPerLine() / sizeof(uint32_t);
 
+  // Neighboring pixels tend to have the same color, so remember the last lookup.
+  uint32_t lastColor = 0;
+  uint32_t lastNewColor = 0;
+  bool haveLast = false;
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
-      uint32_t color = img_line[x];
-
-      ++palette[color];
+      const uint32_t color = img_line[x];
+      if (!haveLast || (color != lastColor)) {
+        lastColor = color;
+        lastNewColor = groupColors[grouper.find(color)];
+        haveLast = true;
+      }
+      img_line[x] = lastNewColor;
     }
     img_line += img_stride;
   }
-
-  return palette;
 }
 
-void ColorTable::remapColorsInIndexedImage(const std::unordered_map<uint32_t, uint32_t>& colorMap) {
-  std::unordered_map<uint32_t, uint8_t> colorToIndexMap;
-  uint8_t index = 0;
-  for (const auto& srcAndDstColors : colorMap) {
-    if (colorToIndexMap.find(srcAndDstColors.second) == colorToIndexMap.end()) {
-      colorToIndexMap[srcAndDstColors.second] = index++;
+QImage buildIndexedImageFromRgb(const QImage& image,
+                                const ColorGrouper& grouper,
+                                const std::vector<uint32_t>& groupColors) {
+  // Different groups may end up with the same color, black or white for example.
+  QVector<QRgb> colorTable;
+  std::vector<uint8_t> groupIndices(groupColors.size());
+  for (size_t group = 0; group < groupColors.size(); ++group) {
+    int index = colorTable.indexOf(groupColors[group]);
+    if (index < 0) {
+      index = colorTable.size();
+      colorTable.push_back(groupColors[group]);
     }
+    groupIndices[group] = static_cast<uint8_t>(index);
   }
 
-  {
-    const int width = m_image.width();
-    const int height = m_image.height();
+  QImage dst(ImageBufferAllocator::createIndexed8Image(image.size()));
+  dst.setColorTable(colorTable);
+
+  const int width = image.width();
+  const int height = image.height();
 
-    uint8_t* img_line = m_image.bits();
-    const int img_stride = m_image.bytesPerLine();
+  const auto* img_line = reinterpret_cast<const uint32_t*>(image.bits());
+  const int img_stride = image.bytesPerLine() / sizeof(uint32_t);
 
-    QVector<QRgb> colorTable = m_image.colorTable();
+  uint8_t* dst_line = dst.bits();
+  const int dst_stride = dst.bytesPerLine();
 
-    for (int y = 0; y < height; ++y) {
-      for (int x = 0; x < width; ++x) {
-        uint32_t color = colorTable[img_line[x]];
-        uint32_t newColor = colorMap.at(color);
-        img_line[x] = colorToIndexMap[newColor];
+  uint32_t lastColor = 0;
+  uint8_t lastIndex = 0;
+  bool haveLast = false;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const uint32_t color = img_line[x];
+      if (!haveLast || (color != lastColor)) {
+        lastColor = color;
+        lastIndex = groupIndices[grouper.find(color)];
+        haveLast = true;
       }
-      img_line += img_stride;
+      dst_line[x] = lastIndex;
+    }
+    img_line += img_stride;
+    dst_line += dst_stride;
+  }
+
+  dst.setDotsPerMeterX(image.dotsPerMeterX());
+  dst.setDotsPerMeterY(image.dotsPerMeterY());
+
+  return dst;
+}
+}  // namespace
+
+ColorTable::ColorTable(const QImage& image) {
+  if ((image.format() != QImage::Format_Indexed8) && (image.format() != QImage::Format_RGB32)
+      && (image.format() != QImage::Format_ARGB32)) {
+    throw std::invalid_argument("ColorTable: Image format not supported.");
+  }
+
+  this->m_image = image;
+}
+
+QImage ColorTable::getImage() const {
+  return m_image;
+}
+
+QVector<QRgb> ColorTable::getPalette() const {
+  const std::vector<ColorStat> paletteStats = paletteWithStatistics();
+
+  QVector<QRgb> palette;
+  palette.reserve(static_cast<int>(paletteStats.size()));
+  for (const ColorStat& colorAndStat : paletteStats) {
+    palette.push_back(colorAndStat.color);
+  }
+
+  return palette;
+}
+
+
+ColorTable& ColorTable::posterize(const int level,
+                                  bool normalize,
+                                  const bool forceBlackAndWhite,
+                                  const int normalizeBlackLevel,
+                                  const int normalizeWhiteLevel) {
+  if ((level < 2) || (level > 255)) {
+    throw std::invalid_argument("ColorTable: level must be a value between 2 and 255 inclusive");
+  }
+  if ((level == 255) && !normalize && !forceBlackAndWhite) {
+    return *this;
+  }
+
+  // Get the palette with statistics.
+  const std::vector<ColorStat> paletteStats = paletteWithStatistics();
+
+  // We have to normalize palette in order posterization to work with pale images.
+  const std::vector<uint8_t> normalizationTable
+      = this->normalizationTable(paletteStats, normalizeBlackLevel, normalizeWhiteLevel);
+  const auto normalized = [&normalizationTable](const uint32_t color) -> QRgb {
+    return qRgb(normalizationTable[qRed(color)], normalizationTable[qGreen(color)], normalizationTable[qBlue(color)]);
+  };
+
+  // Split RGB space into groups and find the most often occurring color in each of them.
+  // The palette is sorted by color, so ties go to the lowest color.
+  ColorGrouper grouper(normalizationTable, level);
+  std::vector<ColorStat> mostOftenColors;
+  for (const ColorStat& colorAndStat : paletteStats) {
+    int& group = grouper.group(colorAndStat.color);
+    if (group < 0) {
+      group = static_cast<int>(mostOftenColors.size());
+      mostOftenColors.push_back(colorAndStat);
+    } else if (colorAndStat.count > mostOftenColors[group].count) {
+      mostOftenColors[group] = colorAndStat;
     }
   }
 
-  QVector<QRgb> newColorTable(static_cast<int>(colorToIndexMap.size()));
-  for (const auto& colorAndIndex : colorToIndexMap) {
-    newColorTable[colorAndIndex.second] = colorAndIndex.first;
+  // Map the other colors in each group to that.
+  std::vector<uint32_t> groupColors(mostOftenColors.size());
+  for (size_t group = 0; group < mostOftenColors.size(); ++group) {
+    QRgb mostOftenColorInGroup = mostOftenColors[group].color;
+    if (forceBlackAndWhite) {
+      makeGrayBlackOrWhiteInPlace(mostOftenColorInGroup, normalized(mostOftenColorInGroup));
+    }
+
+    groupColors[group] = normalize ? normalized(mostOftenColorInGroup) : mostOftenColorInGroup;
   }
 
-  m_image.setColorTable(newColorTable);
+  if (m_image.format() == QImage::Format_Indexed8) {
+    remapColorsInIndexedImage(m_image, grouper, groupColors);
+  } else {
+    if (groupColors.size() <= 256) {
+      m_image = buildIndexedImageFromRgb(m_image, grouper, groupColors);
+    } else {
+      remapColorsInRgbImage(m_image, grouper, groupColors);
+    }
+  }
+
+  return *this;
 }
 
-void ColorTable::remapColorsInRgbImage(const std::unordered_map<uint32_t, uint32_t>& colorMap) {
+std::vector<ColorTable::ColorStat> ColorTable::paletteWithStatistics() const {
+  if (m_image.format() == QImage::Format_Indexed8) {
+    return paletteFromIndexedWithStatistics();
+  } else {
+    return paletteFromRgbWithStatistics();
+  }
+}
+
+std::vector<ColorTable::ColorStat> ColorTable::paletteFromIndexedWithStatistics() const {
   const int width = m_image.width();
   const int height = m_image.height();
 
-  auto* img_line = reinterpret_cast<uint32_t*>(m_image.bits());
-  const int img_stride = m_image.bytesPerLine() / sizeof(uint32_t);
+  const uint8_t* img_line = m_image.bits();
+  const int img_stride = m_image.bytesPerLine();
 
+  int indexCounts[256] = {};
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
-      uint32_t color = img_line[x];
-      img_line[x] = colorMap.at(color);
+      ++indexCounts[img_line[x]];
     }
     img_line += img_stride;
   }
-}
 
-void ColorTable::buildIndexedImageFromRgb(const std::unordered_map<uint32_t, uint32_t>& colorMap) {
-  remapColorsInRgbImage(colorMap);
+  const QVector<QRgb> colorTable = m_image.colorTable();
 
-  std::unordered_set<uint32_t> colorSet;
-  for (const auto& srcAndDstColors : colorMap) {
-    colorSet.insert(srcAndDstColors.second);
+  std::vector<ColorStat> palette;
+  for (int i = 0; i < std::min(colorTable.size(), 256); ++i) {
+    if (indexCounts[i] != 0) {
+      palette.push_back({colorTable[i], indexCounts[i]});
+    }
   }
+  // The color table may contain duplicates.
+  sortAndMergeDuplicates(palette);
+
+  return palette;
+}
+
+std::vector<ColorTable::ColorStat> ColorTable::paletteFromRgbWithStatistics() const {
+  const int width = m_image.width();
+  const int height = m_image.height();
+
+  const auto* img_line = reinterpret_cast<const uint32_t*>(m_image.bits());
+  const int img_stride = m_image.bytesPerLine() / sizeof(uint32_t);
 
-  QVector<QRgb> newColorTable(static_cast<int>(colorSet.size()));
-  for (const auto& color : colorSet) {
-    newColorTable.push_back(color);
+  ColorCounter counter;
+  for (int y = 0; y < height; ++y) {
+    // Neighboring pixels tend to have the same color, so count runs rather than pixels.
+    for (int x = 0; x < width;) {
+      const uint32_t color = img_line[x];
+      const int runStart = x;
+      do {
+        ++x;
+      } while ((x < width) && (img_line[x] == color));
+      counter.add(color, x - runStart);
+    }
+    img_line += img_stride;
   }
 
-  m_image = toIndexedImage(&newColorTable);
+  std::vector<ColorStat> palette;
+  counter.appendTo(palette);
+  std::sort(palette.begin(), palette.end(),
+            [](const ColorStat& lhs, const ColorStat& rhs) { return lhs.color < rhs.color; });
+
+  return palette;
 }
 
-std::unordered_map<uint32_t, uint32_t> ColorTable::normalizePalette(const std::unordered_map<uint32_t, int>& palette,
-                                                                    const int normalizeBlackLevel,
-                                                                    const int normalizeWhiteLevel) const {
+std::vector<uint8_t> ColorTable::normalizationTable(const std::vector<ColorStat>& palette,
+                                                    const int normalizeBlackLevel,
+                                                    const int normalizeWhiteLevel) const {
   const int pixelCount = m_image.width() * m_image.height();
   const double threshold = 0.0005;  // mustn't be larger than (1 / 256)
 
@@ -260,9 +460,9 @@ std::unordered_map<uint32_t, uint32_t> ColorTable::normalizePalette(const std::u
     int red_hist[256] = {};
     int green_hist[256] = {};
     int blue_hist[256] = {};
-    for (const auto& colorAndStat : palette) {
-      const uint32_t color = colorAndStat.first;
-      const int statistics = colorAndStat.second;
+    for (const ColorStat& colorAndStat : palette) {
+      const uint32_t color = colorAndStat.color;
+      const int statistics = colorAndStat.count;
 
       if (color == 0xff000000u) {
         red_hist[normalizeBlackLevel] += statistics;
@@ -295,33 +495,21 @@ std::unordered_map<uint32_t, uint32_t> ColorTable::normalizePalette(const std::u
         }
       }
     }
-
-    assert(max_level >= min_level);
   }
 
-  std::unordered_map<uint32_t, uint32_t> colorToNormalizedMap;
-  for (const auto& colorAndStat : palette) {
-    const uint32_t color = colorAndStat.first;
-    if (color == 0xff000000u) {
-      colorToNormalizedMap[0xff000000u] = 0xff000000u;
-      continue;
-    }
-    if (color == 0xffffffffu) {
-      colorToNormalizedMap[0xffffffffu] = 0xffffffffu;
-      continue;
+  // Black and white map to themselves, as they should.
+  std::vector<uint8_t> table(256);
+  for (int level = 0; level < 256; ++level) {
+    if (max_level <= min_level) {
+      // Nothing to stretch.
+      table[level] = static_cast<uint8_t>(level);
+    } else {
+      const int normalizedLevel = qRound((double(level - min_level) / (max_level - min_level)) * 255);
+      table[level] = static_cast<uint8_t>(qBound(0, normalizedLevel, 255));
     }
-
-    int normalizedRed = qRound((double(qRed(color) - min_level) / (max_level - min_level)) * 255);
-    int normalizedGreen = qRound((double(qGreen(color) - min_level) / (max_level - min_level)) * 255);
-    int normalizedBlue = qRound((double(qBlue(color) - min_level) / (max_level - min_level)) * 255);
-    normalizedRed = qBound(0, normalizedRed, 255);
-    normalizedGreen = qBound(0, normalizedGreen, 255);
-    normalizedBlue = qBound(0, normalizedBlue, 255);
-
-    colorToNormalizedMap[color] = qRgb(normalizedRed, normalizedGreen, normalizedBlue);
   }
 
-  return colorToNormalizedMap;
+  return table;
 }
 
 namespace {
@@ -353,14 +541,20 @@ QImage ColorTable::toIndexedImage(const QVector<QRgb>* colorTable) const {
   if (m_image.format() == QImage::Format_Indexed8) {
     return m_image;
   }
-
-  const QVector<QRgb>& palette = (colorTable) ? *colorTable : getPalette();
-  if (palette.size() > 256) {
+  if (colorTable && (colorTable->size() > 256)) {
     return m_image;
   }
 
-  QImage dst(m_image.size(), QImage::Format_Indexed8);
-  dst.setColorTable(palette);
+  PaletteIndex colorToIndex;
+  QVector<QRgb> palette;
+  if (colorTable) {
+    palette = *colorTable;
+    for (int i = 0; i < palette.size(); ++i) {
+      colorToIndex.insert(palette[i], i);
+    }
+  }
+
+  QImage dst(ImageBufferAllocator::createIndexed8Image(m_image.size()));
 
   const int width = m_image.width();
   const int height = m_image.height();
@@ -371,23 +565,40 @@ QImage ColorTable::toIndexedImage(const QVector<QRgb>* colorTable) const {
   uint8_t* dst_line = dst.bits();
   const int dst_stride = dst.bytesPerLine();
 
-  std::unordered_map<uint32_t, uint8_t> colorToIndex;
-  for (int i = 0; i < palette.size(); ++i) {
-    colorToIndex[palette[i]] = static_cast<uint8_t>(i);
-  }
-
+  // Without a color table, we build one as we go, giving up once it's too large.
+  uint32_t lastColor = 0;
+  int lastIndex = 0;
+  bool haveLast = false;
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
-      dst_line[x] = colorToIndex[img_line[x]];
+      const uint32_t color = img_line[x];
+      if (!haveLast || (color != lastColor)) {
+        lastIndex = colorToIndex.find(color);
+        if (lastIndex < 0) {
+          if (colorTable) {
+            lastIndex = 0;
+          } else if (palette.size() == 256) {
+            return m_image;
+          } else {
+            lastIndex = palette.size();
+            palette.push_back(color);
+            colorToIndex.insert(color, lastIndex);
+          }
+        }
+        lastColor = color;
+        haveLast = true;
+      }
+      dst_line[x] = static_cast<uint8_t>(lastIndex);
     }
     img_line += img_stride;
     dst_line += dst_stride;
   }
 
+  dst.setColorTable(palette);
   dst.setDotsPerMeterX(m_image.dotsPerMeterX());
   dst.setDotsPerMeterY(m_image.dotsPerMeterY());
 
   return dst;
 }
 
-}  // namespace imageproc
\ No newline at end of file
+}  // namespace imageproc
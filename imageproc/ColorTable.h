@@ -4,7 +4,8 @@
 
 
 #include <QtGui/QImage>
-#include <unordered_map>
+#include <cstdint>
+#include <vector>
 
 namespace imageproc {
 class ColorTable {
@@ -24,19 +25,26 @@ class ColorTable {
   QImage toIndexedImage(const QVector<QRgb>* colorTable = nullptr) const;
 
  private:
-  std::unordered_map<uint32_t, int> paletteFromIndexedWithStatistics() const;
-
-  std::unordered_map<uint32_t, int> paletteFromRgbWithStatistics() const;
-
-  void remapColorsInIndexedImage(const std::unordered_map<uint32_t, uint32_t>& colorMap);
-
-  void remapColorsInRgbImage(const std::unordered_map<uint32_t, uint32_t>& colorMap);
-
-  void buildIndexedImageFromRgb(const std::unordered_map<uint32_t, uint32_t>& colorMap);
-
-  std::unordered_map<uint32_t, uint32_t> normalizePalette(const std::unordered_map<uint32_t, int>& palette,
-                                                          int normalizeBlackLevel = 0,
-                                                          int normalizeWhiteLevel = 255) const;
+  struct ColorStat {
+    uint32_t color;
+    int count;
+  };
+
+  /**
+   * Distinct colors of the image along with their pixel counts, sorted by color.
+   */
+  std::vector<ColorStat> paletteWithStatistics() const;
+
+  std::vector<ColorStat> paletteFromIndexedWithStatistics() const;
+
+  std::vector<ColorStat> paletteFromRgbWithStatistics() const;
+
+  /**
+   * Builds a lookup table mapping channel levels to normalized ones.
+   */
+  std::vector<uint8_t> normalizationTable(const std::vector<ColorStat>& palette,
+                                          int normalizeBlackLevel = 0,
+                                          int normalizeWhiteLevel = 255) const;
 
   void makeGrayBlackOrWhiteInPlace(QRgb& rgb, const QRgb& normalized) const;
 
@@ -22,9 +22,11 @@
 #include "GaussBlur.h"
 #include <boost/lambda/bind.hpp>
 #include <boost/lambda/lambda.hpp>
+#include <algorithm>
 #include <cmath>
 #include "Constants.h"
 #include "GrayImage.h"
+#include "Grid.h"
 
 namespace imageproc {
 namespace gauss_blur_impl {
@@ -88,6 +90,61 @@ void find_iir_constants(float* n_p, float* n_m, float* d_p, float* d_m, float* b
     bd_m[i] = d_m[i] * b;
   }
 }  // find_iir_constants
+
+IirConstants::IirConstants(const float std_dev) {
+  find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, std_dev);
+}
+
+void filterBatch(const float* const src, float* const dst, float* const tmp, const int length, const IirConstants& c) {
+  // dst accumulates the causal part and tmp the anti-causal one.
+  std::fill(dst, dst + length * BATCH, 0.0f);
+  std::fill(tmp, tmp + length * BATCH, 0.0f);
+
+  const float* const initial_p = src;
+  const float* const initial_m = src + (length - 1) * BATCH;
+
+  for (int pos = 0; pos < length; ++pos) {
+    const int terms = pos < 4 ? pos : 4;
+    float* const vp = dst + pos * BATCH;
+    const float* const sp = src + pos * BATCH;
+    int i = 0;
+    for (; i <= terms; ++i) {
+      const float* const sp_i = sp - i * BATCH;
+      const float* const vp_i = vp - i * BATCH;
+      for (int lane = 0; lane < BATCH; ++lane) {
+        vp[lane] += c.n_p[i] * sp_i[lane] - c.d_p[i] * vp_i[lane];
+      }
+    }
+    for (; i <= 4; ++i) {
+      for (int lane = 0; lane < BATCH; ++lane) {
+        vp[lane] += (c.n_p[i] - c.bd_p[i]) * initial_p[lane];
+      }
+    }
+  }
+
+  for (int pos = length - 1; pos >= 0; --pos) {
+    const int terms = length - 1 - pos < 4 ? length - 1 - pos : 4;
+    float* const vm = tmp + pos * BATCH;
+    const float* const sp = src + pos * BATCH;
+    int i = 0;
+    for (; i <= terms; ++i) {
+      const float* const sp_i = sp + i * BATCH;
+      const float* const vm_i = vm + i * BATCH;
+      for (int lane = 0; lane < BATCH; ++lane) {
+        vm[lane] += c.n_m[i] * sp_i[lane] - c.d_m[i] * vm_i[lane];
+      }
+    }
+    for (; i <= 4; ++i) {
+      for (int lane = 0; lane < BATCH; ++lane) {
+        vm[lane] += (c.n_m[i] - c.bd_m[i]) * initial_m[lane];
+      }
+    }
+  }
+
+  for (int k = 0; k < length * BATCH; ++k) {
+    dst[k] += tmp[k];
+  }
+}  // filterBatch
 }  // namespace gauss_blur_impl
 
 GrayImage gaussBlur(const GrayImage& src, float h_sigma, float v_sigma) {
@@ -103,4 +160,11 @@ GrayImage gaussBlur(const GrayImage& src, float h_sigma, float v_sigma) {
 
   return dst;
 }
+
+void gaussBlur(Grid<float>& grid, const float h_sigma, const float v_sigma) {
+  using namespace boost::lambda;
+
+  gaussBlurGeneric(QSize(grid.width(), grid.height()), h_sigma, v_sigma, grid.data(), grid.stride(), _1, grid.data(),
+                   grid.stride(), _1 = _2);
+}
 }  // namespace imageproc
\ No newline at end of file
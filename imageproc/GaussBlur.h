@@ -23,11 +23,17 @@
 #define IMAGEPROC_GAUSSBLUR_H_
 
 #include <QSize>
+#include <algorithm>
 #include <boost/scoped_array.hpp>
 #include <cstring>
 #include <iterator>
+#include <vector>
+#include "ParallelFor.h"
 #include "ValueConv.h"
 
+template <typename Node>
+class Grid;
+
 namespace imageproc {
 class GrayImage;
 
@@ -41,6 +47,13 @@ class GrayImage;
  */
 GrayImage gaussBlur(const GrayImage& src, float h_sigma, float v_sigma);
 
+/**
+ * \brief Applies gaussian blur on a grid of floats, in place.
+ *
+ * Same as calling gaussBlurGeneric() with identity readers and writers.
+ */
+void gaussBlur(Grid<float>& grid, float h_sigma, float v_sigma);
+
 /**
  * \brief Applies a 2D gaussian filter on an arbitrary data grid.
  *
@@ -82,6 +95,8 @@ GrayImage gaussBlur(const GrayImage& src, float h_sigma, float v_sigma);
  * // Convert to uint8_t, with rounding and clipping.
  * gaussBlurGeneric(..., _1 = bind<uint8_t>(RoundAndClipValueConv<uint8_t>(), _2);
  * \endcode
+ * Both functors may be called from several threads at once,
+ * though never for the same grid cell.
  */
 template <typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
 void gaussBlurGeneric(QSize size,
@@ -97,19 +112,51 @@ void gaussBlurGeneric(QSize size,
 namespace gauss_blur_impl {
 void find_iir_constants(float* n_p, float* n_m, float* d_p, float* d_m, float* bd_p, float* bd_m, float std_dev);
 
-template <typename Src1It, typename Src2It, typename DstIt, typename FloatWriter>
-void save(int num_items, Src1It src1, Src2It src2, DstIt dst, int dst_stride, FloatWriter writer) {
-  while (num_items-- != 0) {
-    writer(*dst, *src1 + *src2);
-    ++src1;
-    ++src2;
-    dst += dst_stride;
-  }
-}
+/**
+ * The number of rows or columns filtered together.
+ *
+ * The recursive filter runs along all of them in lockstep, which lets
+ * the compiler keep them in SIMD lanes.
+ */
+const int BATCH = 8;
 
-class FloatToFloatWriter {
+/**
+ * The number of batches a single parallel task processes.
+ */
+const int BATCH_GRAIN = 4;
+
+class IirConstants {
  public:
-  void operator()(float& dst, float src) const { dst = src; }
+  explicit IirConstants(float std_dev);
+
+  float n_p[5], n_m[5], d_p[5], d_m[5], bd_p[5], bd_m[5];
+};
+
+/**
+ * \brief Filters BATCH sequences of the given length.
+ *
+ * Element \p pos of sequence \p lane is located at [pos * BATCH + lane]
+ * in \p src and \p dst.  \p tmp is scratch space of the same size.
+ * None of the buffers may overlap.
+ */
+void filterBatch(const float* src, float* dst, float* tmp, int length, const IirConstants& constants);
+
+class BatchBuffers {
+ public:
+  explicit BatchBuffers(int length)
+      : m_src(length * BATCH), m_dst(length * BATCH), m_tmp(length * BATCH), m_length(length) {}
+
+  float* src() { return m_src.data(); }
+
+  const float* dst() const { return m_dst.data(); }
+
+  void filter(const IirConstants& constants) { filterBatch(m_src.data(), m_dst.data(), m_tmp.data(), m_length, constants); }
+
+ private:
+  std::vector<float> m_src;
+  std::vector<float> m_dst;
+  std::vector<float> m_tmp;
+  int m_length;
 };
 }  // namespace gauss_blur_impl
 
@@ -123,92 +170,86 @@ void gaussBlurGeneric(const QSize size,
                       const DstIt output,
                       const int output_stride,
                       const FloatWriter float_writer) {
+  using namespace gauss_blur_impl;
+
   if (size.isEmpty()) {
     return;
   }
 
   const int width = size.width();
   const int height = size.height();
-  const int width_height_max = width > height ? width : height;
 
-  boost::scoped_array<float> val_p(new float[width_height_max]);
-  boost::scoped_array<float> val_m(new float[width_height_max]);
+  // The vertical pass stores its results transposed, so that the horizontal
+  // pass can filter batches of adjacent values as well.
   boost::scoped_array<float> intermediate_image(new float[width * height]);
-  const int intermediate_stride = width;
+  const int intermediate_stride = height;
 
-  // IIR parameters.
-  float n_p[5], n_m[5], d_p[5], d_m[5], bd_p[5], bd_m[5];
   // Vertical pass.
-  gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, v_sigma);
-  for (int x = 0; x < width; ++x) {
-    memset(&val_p[0], 0, height * sizeof(val_p[0]));
-    memset(&val_m[0], 0, height * sizeof(val_m[0]));
-
-    SrcIt sp_p(input + x);
-    SrcIt sp_m(sp_p + (height - 1) * input_stride);
-    float* vp = &val_p[0];
-    float* vm = &val_m[0] + height - 1;
-    const float initial_p = float_reader(sp_p[0]);
-    const float initial_m = float_reader(sp_m[0]);
-
-    for (int y = 0; y < height; ++y) {
-      const int terms = y < 4 ? y : 4;
-      int i = 0;
-      int sp_off = 0;
-      for (; i <= terms; ++i, sp_off += input_stride) {
-        *vp += n_p[i] * float_reader(sp_p[-sp_off]) - d_p[i] * vp[-i];
-        *vm += n_m[i] * float_reader(sp_m[sp_off]) - d_m[i] * vm[i];
+  const IirConstants v_constants(v_sigma);
+  parallelFor(0, (width + BATCH - 1) / BATCH, BATCH_GRAIN, [&](const int begin, const int end) {
+    BatchBuffers buffers(height);
+    for (int batch = begin; batch < end; ++batch) {
+      const int x0 = batch * BATCH;
+      const int lanes = std::min(BATCH, width - x0);
+
+      float* src = buffers.src();
+      SrcIt input_line(input + x0);
+      for (int y = 0; y < height; ++y, src += BATCH) {
+        int lane = 0;
+        for (; lane < lanes; ++lane) {
+          src[lane] = float_reader(input_line[lane]);
+        }
+        for (; lane < BATCH; ++lane) {
+          src[lane] = 0.0f;
+        }
+        if (y + 1 < height) {
+          input_line += input_stride;
+        }
       }
-      for (; i <= 4; ++i) {
-        *vp += (n_p[i] - bd_p[i]) * initial_p;
-        *vm += (n_m[i] - bd_m[i]) * initial_m;
+
+      buffers.filter(v_constants);
+
+      for (int lane = 0; lane < lanes; ++lane) {
+        const float* dst = buffers.dst() + lane;
+        float* intermediate_line = &intermediate_image[0] + (x0 + lane) * intermediate_stride;
+        for (int y = 0; y < height; ++y, dst += BATCH) {
+          intermediate_line[y] = *dst;
+        }
       }
-      sp_p += input_stride;
-      sp_m -= input_stride;
-      ++vp;
-      --vm;
     }
+  });
 
-    gauss_blur_impl::save(height, &val_p[0], &val_m[0], &intermediate_image[0] + x, intermediate_stride,
-                          gauss_blur_impl::FloatToFloatWriter());
-  }
   // Horizontal pass.
-  gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, h_sigma);
-  const float* intermediate_line = &intermediate_image[0];
-  DstIt output_line(output);
-  for (int y = 0; y < height; ++y) {
-    memset(&val_p[0], 0, width * sizeof(val_p[0]));
-    memset(&val_m[0], 0, width * sizeof(val_m[0]));
-
-    const float* sp_p = intermediate_line;
-    const float* sp_m = intermediate_line + width - 1;
-    float* vp = &val_p[0];
-    float* vm = &val_m[0] + width - 1;
-    const float initial_p = sp_p[0];
-    const float initial_m = sp_m[0];
-
-    for (int x = 0; x < width; ++x) {
-      const int terms = x < 4 ? x : 4;
-      int i = 0;
-      for (; i <= terms; ++i) {
-        *vp += n_p[i] * sp_p[-i] - d_p[i] * vp[-i];
-        *vm += n_m[i] * sp_m[i] - d_m[i] * vm[i];
-      }
-      for (; i <= 4; ++i) {
-        *vp += (n_p[i] - bd_p[i]) * initial_p;
-        *vm += (n_m[i] - bd_m[i]) * initial_m;
+  const IirConstants h_constants(h_sigma);
+  parallelFor(0, (height + BATCH - 1) / BATCH, BATCH_GRAIN, [&](const int begin, const int end) {
+    BatchBuffers buffers(width);
+    for (int batch = begin; batch < end; ++batch) {
+      const int y0 = batch * BATCH;
+      const int lanes = std::min(BATCH, height - y0);
+
+      float* src = buffers.src();
+      const float* intermediate_line = &intermediate_image[0] + y0;
+      for (int x = 0; x < width; ++x, src += BATCH, intermediate_line += intermediate_stride) {
+        int lane = 0;
+        for (; lane < lanes; ++lane) {
+          src[lane] = intermediate_line[lane];
+        }
+        for (; lane < BATCH; ++lane) {
+          src[lane] = 0.0f;
+        }
       }
-      ++sp_p;
-      --sp_m;
-      ++vp;
-      --vm;
-    }
 
-    gauss_blur_impl::save(width, &val_p[0], &val_m[0], output_line, 1, float_writer);
+      buffers.filter(h_constants);
 
-    intermediate_line += intermediate_stride;
-    output_line += output_stride;
-  }
+      for (int lane = 0; lane < lanes; ++lane) {
+        const float* dst = buffers.dst() + lane;
+        DstIt output_line(output + (y0 + lane) * output_stride);
+        for (int x = 0; x < width; ++x, dst += BATCH) {
+          float_writer(output_line[x], *dst);
+        }
+      }
+    }
+  });
 }  // gaussBlurGeneric
 }  // namespace imageproc
 #endif  // ifndef IMAGEPROC_GAUSSBLUR_H_
@@ -18,6 +18,8 @@
 
 #include "GrayImage.h"
 #include "Grayscale.h"
+#include "ImageBufferAllocator.h"
+#include "ScanlineConversion.h"
 
 namespace imageproc {
 GrayImage::GrayImage(QSize size) {
@@ -25,7 +27,7 @@ GrayImage::GrayImage(QSize size) {
     return;
   }
 
-  m_image = QImage(size, QImage::Format_Indexed8);
+  m_image = ImageBufferAllocator::createIndexed8Image(size);
   m_image.setColorTable(createGrayscalePalette());
   if (m_image.isNull()) {
     throw std::bad_alloc();
@@ -35,8 +37,29 @@ GrayImage::GrayImage(QSize size) {
 GrayImage::GrayImage(const QImage& image) : m_image(toGrayscale(image)) {}
 
 GrayImage GrayImage::inverted() const {
-  GrayImage inverted(*this);
-  inverted.invert();
+  if (isNull()) {
+    return GrayImage();
+  }
+
+  // Inverting into a freshly allocated image takes a single pass, unlike
+  // detaching a shared copy and then inverting it in place.
+  GrayImage inverted(size());
+  inverted.setDotsPerMeterX(dotsPerMeterX());
+  inverted.setDotsPerMeterY(dotsPerMeterY());
+
+  const int w = width();
+  const int h = height();
+  const uint8_t* src_line = data();
+  uint8_t* dst_line = inverted.data();
+  const int src_stride = stride();
+  const int dst_stride = inverted.stride();
+
+  const ScanlineConverter& converter = ScanlineConverter::instance();
+  for (int y = 0; y < h; ++y) {
+    converter.invertGray(src_line, dst_line, w);
+    src_line += src_stride;
+    dst_line += dst_stride;
+  }
 
   return inverted;
 }
@@ -27,6 +27,7 @@
 #include <stdexcept>
 #include "GrayImage.h"
 #include "Grayscale.h"
+#include "RasterOpKernels.h"
 
 namespace imageproc {
 /**
@@ -185,6 +186,139 @@ class GRopLightest {
 };
 
 
+/**
+ * \brief Raster operation that stretches source gray levels to the background levels in destination.
+ *
+ * A source pixel at least as light as its background becomes white.
+ * Others are scaled by 255 / background.
+ *
+ * \see grayRasterOp()
+ */
+class GRopRaiseAboveBackground {
+ public:
+  static uint8_t transform(uint8_t src, uint8_t dst) {
+    // src: orig
+    // dst: background (dst >= src)
+    if (dst - src < 1) {
+      return 0xff;
+    }
+    const unsigned orig = src;
+    const unsigned background = dst;
+
+    return static_cast<uint8_t>((orig * 255 + background / 2) / background);
+  }
+};
+
+
+/**
+ * \brief Raster operation that darkens destination pixels by the inverted source ones.
+ *
+ * Both are treated as inverted intensities in [0, 1], which get multiplied.
+ *
+ * \see grayRasterOp()
+ */
+class GRopCombineInverted {
+ public:
+  static uint8_t transform(uint8_t src, uint8_t dst) {
+    const unsigned dilated = dst;
+    const unsigned eroded = src;
+    const unsigned res = 255 - (255 - dilated) * eroded / 255;
+
+    return static_cast<uint8_t>(res);
+  }
+};
+
+
+namespace detail {
+/**
+ * \brief Maps gray raster operations to their vectorized implementations, if any.
+ */
+template <typename GRop>
+struct GrayRopKernelOf {
+  static constexpr GrayRopKernel value = GrayRopKernel::NONE;
+};
+
+template <>
+struct GrayRopKernelOf<GRopInvert<GRopSrc>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::INVERT_SRC;
+};
+
+template <>
+struct GrayRopKernelOf<GRopClippedSubtract<GRopDst, GRopSrc>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::DST_MINUS_SRC_CLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopClippedSubtract<GRopSrc, GRopDst>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::SRC_MINUS_DST_CLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopUnclippedSubtract<GRopDst, GRopSrc>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::DST_MINUS_SRC_UNCLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopUnclippedSubtract<GRopSrc, GRopDst>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::SRC_MINUS_DST_UNCLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopInvert<GRopClippedSubtract<GRopDst, GRopSrc>>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::INVERT_DST_MINUS_SRC_CLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopClippedAdd<GRopSrc, GRopDst>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::ADD_CLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopClippedAdd<GRopDst, GRopSrc>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::ADD_CLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopUnclippedAdd<GRopSrc, GRopDst>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::ADD_UNCLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopUnclippedAdd<GRopDst, GRopSrc>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::ADD_UNCLIPPED;
+};
+
+template <>
+struct GrayRopKernelOf<GRopDarkest<GRopSrc, GRopDst>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::DARKEST;
+};
+
+template <>
+struct GrayRopKernelOf<GRopDarkest<GRopDst, GRopSrc>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::DARKEST;
+};
+
+template <>
+struct GrayRopKernelOf<GRopLightest<GRopSrc, GRopDst>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::LIGHTEST;
+};
+
+template <>
+struct GrayRopKernelOf<GRopLightest<GRopDst, GRopSrc>> {
+  static constexpr GrayRopKernel value = GrayRopKernel::LIGHTEST;
+};
+
+template <>
+struct GrayRopKernelOf<GRopRaiseAboveBackground> {
+  static constexpr GrayRopKernel value = GrayRopKernel::RAISE_ABOVE_BACKGROUND;
+};
+
+template <>
+struct GrayRopKernelOf<GRopCombineInverted> {
+  static constexpr GrayRopKernel value = GrayRopKernel::COMBINE_INVERTED;
+};
+}  // namespace detail
+
 template <typename GRop>
 void grayRasterOp(GrayImage& dst, const GrayImage& src) {
   if (dst.isNull() || src.isNull()) {
@@ -203,6 +337,18 @@ void grayRasterOp(GrayImage& dst, const GrayImage& src) {
   const int width = src.width();
   const int height = src.height();
 
+  const GrayRopKernel kernel = detail::GrayRopKernelOf<GRop>::value;
+  if (kernel != GrayRopKernel::NONE) {
+    const RasterOpKernels& kernels = RasterOpKernels::instance();
+    for (int y = 0; y < height; ++y) {
+      kernels.gray(kernel, src_line, dst_line, width);
+      src_line += src_stride;
+      dst_line += dst_stride;
+    }
+
+    return;
+  }
+
   for (int y = 0; y < height; ++y) {
     for (int x = 0; x < width; ++x) {
       dst_line[x] = GRop::transform(src_line[x], dst_line[x]);
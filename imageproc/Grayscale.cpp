@@ -17,15 +17,18 @@
  */
 
 #include "Grayscale.h"
+#include <cstring>
 #include "BinaryImage.h"
 #include "BitOps.h"
+#include "ImageBufferAllocator.h"
+#include "ScanlineConversion.h"
 
 namespace imageproc {
 static QImage monoMsbToGrayscale(const QImage& src) {
   const int width = src.width();
   const int height = src.height();
 
-  QImage dst(width, height, QImage::Format_Indexed8);
+  QImage dst(ImageBufferAllocator::createIndexed8Image(src.size()));
   dst.setColorTable(createGrayscalePalette());
   if ((width > 0) && (height > 0) && dst.isNull()) {
     throw std::bad_alloc();
@@ -67,7 +70,7 @@ static QImage monoLsbToGrayscale(const QImage& src) {
   const int width = src.width();
   const int height = src.height();
 
-  QImage dst(width, height, QImage::Format_Indexed8);
+  QImage dst(ImageBufferAllocator::createIndexed8Image(src.size()));
   dst.setColorTable(createGrayscalePalette());
   if ((width > 0) && (height > 0) && dst.isNull()) {
     throw std::bad_alloc();
@@ -109,7 +112,7 @@ static QImage anyToGrayscale(const QImage& src) {
   const int width = src.width();
   const int height = src.height();
 
-  QImage dst(width, height, QImage::Format_Indexed8);
+  QImage dst(ImageBufferAllocator::createIndexed8Image(src.size()));
   dst.setColorTable(createGrayscalePalette());
   if ((width > 0) && (height > 0) && dst.isNull()) {
     throw std::bad_alloc();
@@ -118,11 +121,20 @@ static QImage anyToGrayscale(const QImage& src) {
   uint8_t* dst_line = dst.bits();
   const int dst_bpl = dst.bytesPerLine();
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+  if ((src.format() == QImage::Format_RGB32) || (src.format() == QImage::Format_ARGB32)) {
+    // For these, QImage::pixel() returns the raw pixel value.
+    const ScanlineConverter& converter = ScanlineConverter::instance();
+    for (int y = 0; y < height; ++y) {
+      converter.rgb32ToGray(reinterpret_cast<const uint32_t*>(src.scanLine(y)), dst_line, width);
+      dst_line += dst_bpl;
+    }
+  } else {
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+      }
+      dst_line += dst_bpl;
     }
-    dst_line += dst_bpl;
   }
 
   dst.setDotsPerMeterX(src.dotsPerMeterX());
@@ -155,12 +167,18 @@ QImage toGrayscale(const QImage& src) {
         if (src.colorCount() == 256) {
           return src;
         } else {
-          QImage dst(src);
+          QImage dst(ImageBufferAllocator::createIndexed8Image(src.size()));
           dst.setColorTable(createGrayscalePalette());
-          if (!src.isNull() && dst.isNull()) {
+          if (dst.isNull()) {
             throw std::bad_alloc();
           }
 
+          for (int y = 0; y < src.height(); ++y) {
+            memcpy(dst.scanLine(y), src.scanLine(y), static_cast<size_t>(src.width()));
+          }
+          dst.setDotsPerMeterX(src.dotsPerMeterX());
+          dst.setDotsPerMeterY(src.dotsPerMeterY());
+
           return dst;
         }
       }
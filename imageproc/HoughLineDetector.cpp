@@ -19,17 +19,35 @@
 #include "HoughLineDetector.h"
 #include <QDebug>
 #include <QPainter>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include "BinaryImage.h"
 #include "ConnCompEraser.h"
 #include "Constants.h"
 #include "Grayscale.h"
 #include "Morphology.h"
+#include "ParallelFor.h"
 #include "RasterOp.h"
 #include "SeedFill.h"
 
 namespace imageproc {
+namespace {
+/**
+ * The number of points whose bins are computed in one go, before being
+ * voted for.  Keeping the bin computation in a loop of its own lets the
+ * compiler vectorize it.
+ */
+const int POINT_BLOCK = 512;
+
+/**
+ * Angles are split into groups of that many, each group having one angle
+ * voted for at the coarse stage of processing a batch of points.
+ */
+const int COARSE_ANGLE_STEP = 8;
+}  // namespace
+
 class HoughLineDetector::GreaterQualityFirst {
  public:
   bool operator()(const HoughLine& lhs, const HoughLine& rhs) const { return lhs.quality() > rhs.quality(); }
@@ -93,6 +111,148 @@ void HoughLineDetector::process(int x, int y, unsigned weight) {
   }
 }
 
+void HoughLineDetector::process(const std::vector<QPoint>& points,
+                                const std::vector<unsigned>& weights,
+                                const unsigned quality_lower_bound) {
+  assert(points.size() == weights.size());
+  if (points.empty()) {
+    return;
+  }
+
+  std::vector<double> xs;
+  std::vector<double> ys;
+  xs.reserve(points.size());
+  ys.reserve(points.size());
+  double max_abs_x = 0.0;
+  double max_abs_y = 0.0;
+  for (const QPoint& pt : points) {
+    xs.push_back(pt.x());
+    ys.push_back(pt.y());
+    max_abs_x = std::max(max_abs_x, std::abs(xs.back()));
+    max_abs_y = std::max(max_abs_y, std::abs(ys.back()));
+  }
+
+  if (quality_lower_bound == 0) {
+    parallelFor(0, m_histHeight, 1, [&](const int begin, const int end) {
+      for (int angle_idx = begin; angle_idx < end; ++angle_idx) {
+        voteForAngle(angle_idx, xs, ys, weights, &m_histogram[angle_idx * m_histWidth]);
+      }
+    });
+
+    return;
+  }
+
+  // Coarse stage: the middle angle of every group gets voted for into a separate buffer.
+  const int num_groups = (m_histHeight + COARSE_ANGLE_STEP - 1) / COARSE_ANGLE_STEP;
+  const auto group_first_angle = [](const int group) { return group * COARSE_ANGLE_STEP; };
+  const auto group_end_angle
+      = [this](const int group) { return std::min((group + 1) * COARSE_ANGLE_STEP, m_histHeight); };
+  const auto group_coarse_angle = [&](const int group) {
+    return (group_first_angle(group) + group_end_angle(group) - 1) / 2;
+  };
+
+  std::vector<unsigned> coarse_votes(num_groups * m_histWidth, 0);
+  parallelFor(0, num_groups, 1, [&](const int begin, const int end) {
+    for (int group = begin; group < end; ++group) {
+      voteForAngle(group_coarse_angle(group), xs, ys, weights, &coarse_votes[group * m_histWidth]);
+    }
+  });
+
+  // A point falling into bin b of the coarse angle falls into a bin of another angle
+  // of the group that is at most max_bin_shift away from b.  Therefore, no bin of another
+  // angle gets more new votes than a window of 2 * max_bin_shift + 1 coarse bins does.
+  std::vector<int> fine_angles;
+  fine_angles.reserve(m_histHeight);
+  std::vector<uint64_t> prefix_sums(m_histWidth + 1);
+  for (int group = 0; group < num_groups; ++group) {
+    const int coarse_angle = group_coarse_angle(group);
+    const unsigned* coarse_line = &coarse_votes[group * m_histWidth];
+    unsigned* hist_line = &m_histogram[coarse_angle * m_histWidth];
+    for (int x = 0; x < m_histWidth; ++x) {
+      hist_line[x] += coarse_line[x];
+    }
+
+    double max_distance_deviation = 0.0;
+    unsigned max_old_votes = 0;
+    for (int angle_idx = group_first_angle(group); angle_idx < group_end_angle(group); ++angle_idx) {
+      if (angle_idx == coarse_angle) {
+        continue;
+      }
+      const QPointF uv_deviation(m_angleUnitVectors[angle_idx] - m_angleUnitVectors[coarse_angle]);
+      max_distance_deviation = std::max(
+          max_distance_deviation, std::abs(uv_deviation.x()) * max_abs_x + std::abs(uv_deviation.y()) * max_abs_y);
+
+      const unsigned* line = &m_histogram[angle_idx * m_histWidth];
+      max_old_votes = std::max(max_old_votes, *std::max_element(line, line + m_histWidth));
+    }
+    // Bins are distances rounded down, after adding 0.5 to them.  Rounding down doesn't
+    // increase the difference beyond the next integer, while the small addition takes
+    // care of floating point errors.
+    const auto max_bin_shift
+        = (int) std::ceil(max_distance_deviation * m_recipDistanceResolution * (1.0 + 1e-9) + 1e-6);
+
+    prefix_sums[0] = 0;
+    for (int x = 0; x < m_histWidth; ++x) {
+      prefix_sums[x + 1] = prefix_sums[x] + coarse_line[x];
+    }
+    uint64_t max_new_votes = 0;
+    for (int x = 0; x < m_histWidth; ++x) {
+      const int window_begin = std::max(x - max_bin_shift, 0);
+      const int window_end = std::min(x + max_bin_shift + 1, m_histWidth);
+      max_new_votes = std::max(max_new_votes, prefix_sums[window_end] - prefix_sums[window_begin]);
+    }
+
+    if (max_old_votes + max_new_votes < quality_lower_bound) {
+      continue;
+    }
+
+    for (int angle_idx = group_first_angle(group); angle_idx < group_end_angle(group); ++angle_idx) {
+      if (angle_idx != coarse_angle) {
+        fine_angles.push_back(angle_idx);
+      }
+    }
+  }
+
+  // Fine stage.
+  parallelFor(0, static_cast<int>(fine_angles.size()), 1, [&](const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      voteForAngle(fine_angles[i], xs, ys, weights, &m_histogram[fine_angles[i] * m_histWidth]);
+    }
+  });
+}  // HoughLineDetector::process
+
+void HoughLineDetector::voteForAngle(const int angle_idx,
+                                     const std::vector<double>& xs,
+                                     const std::vector<double>& ys,
+                                     const std::vector<unsigned>& weights,
+                                     unsigned* hist_line) const {
+  const double uv_x = m_angleUnitVectors[angle_idx].x();
+  const double uv_y = m_angleUnitVectors[angle_idx].y();
+  const double distance_bias = m_distanceBias;
+  const double recip_distance_resolution = m_recipDistanceResolution;
+  const auto num_points = static_cast<int>(xs.size());
+
+  int bins[POINT_BLOCK];
+  for (int block_begin = 0; block_begin < num_points; block_begin += POINT_BLOCK) {
+    const int block_size = std::min(POINT_BLOCK, num_points - block_begin);
+    const double* block_xs = &xs[block_begin];
+    const double* block_ys = &ys[block_begin];
+    const unsigned* block_weights = &weights[block_begin];
+
+    // The same arithmetic as in process(x, y, weight), to end up in the same bins.
+    for (int i = 0; i < block_size; ++i) {
+      const double distance = uv_x * block_xs[i] + uv_y * block_ys[i];
+      const double biased_distance = distance + distance_bias;
+      bins[i] = (int) (biased_distance * recip_distance_resolution + 0.5);
+    }
+
+    for (int i = 0; i < block_size; ++i) {
+      assert(bins[i] >= 0 && bins[i] < m_histWidth);
+      hist_line[bins[i]] += block_weights[i];
+    }
+  }
+}
+
 QImage HoughLineDetector::visualizeHoughSpace(const unsigned lower_bound) const {
   QImage intensity(m_histWidth, m_histHeight, QImage::Format_Indexed8);
   intensity.setColorTable(createGrayscalePalette());
@@ -19,6 +19,7 @@
 #ifndef IMAGEPROC_HOUGHLINEDETECTOR_H_
 #define IMAGEPROC_HOUGHLINEDETECTOR_H_
 
+#include <QPoint>
 #include <QPointF>
 #include <vector>
 
@@ -102,6 +103,23 @@ class HoughLineDetector {
    */
   void process(int x, int y, unsigned weight = 1);
 
+  /**
+   * \brief Processes a batch of points with specified weights.
+   *
+   * The result is the same as calling process(x, y, weight) for every
+   * point, but different angles are processed in parallel.
+   *
+   * \param points The points to process.
+   * \param weights The weights of the points, one per point.
+   * \param quality_lower_bound If non-zero, angles are first voted for
+   *        at a coarse step.  The angles between them are then skipped where
+   *        the coarse votes prove no bin can reach this quality.  That doesn't
+   *        change the result of findLines() with a lower bound not below this one,
+   *        but visualizeHoughSpace() will show incomplete votes, and no more points
+   *        may be processed afterwards.
+   */
+  void process(const std::vector<QPoint>& points, const std::vector<unsigned>& weights, unsigned quality_lower_bound = 0);
+
   QImage visualizeHoughSpace(unsigned lower_bound) const;
 
   /**
@@ -117,6 +135,12 @@ class HoughLineDetector {
  private:
   class GreaterQualityFirst;
 
+  void voteForAngle(int angle_idx,
+                    const std::vector<double>& xs,
+                    const std::vector<double>& ys,
+                    const std::vector<unsigned>& weights,
+                    unsigned* hist_line) const;
+
   static BinaryImage findHistogramPeaks(const std::vector<unsigned>& hist, int width, int height, unsigned lower_bound);
 
   static BinaryImage findPeakCandidates(const std::vector<unsigned>& hist, int width, int height, unsigned lower_bound);
@@ -0,0 +1,161 @@
+
+#include "ImageBufferAllocator.h"
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+namespace imageproc {
+namespace {
+/**
+ * Precedes every buffer.  Its alignment keeps the buffer aligned as malloc() would.
+ */
+struct alignas(std::max_align_t) BufferHeader {
+  // The file a spilled buffer is mapped from, or null for heap buffers.
+  QTemporaryFile* file;
+};
+
+QMutex spill_directory_mutex;
+QString spill_directory;
+std::atomic<bool> spill_enabled(false);
+std::atomic<size_t> spill_threshold(ImageBufferAllocator::DEFAULT_SPILL_THRESHOLD);
+
+BufferHeader* allocateOnHeap(const size_t total_bytes) {
+  auto* header = static_cast<BufferHeader*>(malloc(total_bytes));
+  if (!header) {
+    throw std::bad_alloc();
+  }
+  header->file = nullptr;
+
+  return header;
+}
+
+/**
+ * \return The mapped file, or null on failure.
+ */
+BufferHeader* allocateInFile(const size_t total_bytes) {
+  QString directory;
+  {
+    QMutexLocker locker(&spill_directory_mutex);
+    directory = spill_directory;
+  }
+  if (directory.isEmpty()) {
+    return nullptr;
+  }
+
+  // Removes the file, unless released.
+  auto file = std::make_unique<QTemporaryFile>(QDir(directory).filePath("scantailor-spill-XXXXXX"));
+  if (!file->open() || !file->resize(static_cast<qint64>(total_bytes))) {
+    return nullptr;
+  }
+
+#ifdef Q_OS_LINUX
+  // Writing to a page of a sparse file there is no disk space for kills the process.
+  // Reserving the space upfront turns that into a mere allocation failure.
+  if (posix_fallocate(file->handle(), 0, static_cast<off_t>(total_bytes)) != 0) {
+    return nullptr;
+  }
+#endif
+
+  auto* header = reinterpret_cast<BufferHeader*>(file->map(0, static_cast<qint64>(total_bytes)));
+  if (!header) {
+    return nullptr;
+  }
+  header->file = file.release();
+
+  return header;
+}
+}  // namespace
+
+void ImageBufferAllocator::setSpillDirectory(const QString& path) {
+  if (!path.isEmpty()) {
+    QDir().mkpath(path);
+  }
+
+  QMutexLocker locker(&spill_directory_mutex);
+  spill_directory = path;
+  spill_enabled = !path.isEmpty();
+}
+
+QString ImageBufferAllocator::spillDirectory() {
+  QMutexLocker locker(&spill_directory_mutex);
+
+  return spill_directory;
+}
+
+void ImageBufferAllocator::setSpillThreshold(const size_t bytes) {
+  spill_threshold = bytes;
+}
+
+size_t ImageBufferAllocator::spillThreshold() {
+  return spill_threshold;
+}
+
+bool ImageBufferAllocator::isSpilled(const size_t bytes) {
+  return spill_enabled && (bytes >= spill_threshold);
+}
+
+void* ImageBufferAllocator::allocate(const size_t bytes) {
+  const size_t total_bytes = sizeof(BufferHeader) + bytes;
+  if (total_bytes < bytes) {
+    throw std::bad_alloc();
+  }
+
+  BufferHeader* header = nullptr;
+  if (isSpilled(bytes)) {
+    header = allocateInFile(total_bytes);
+  }
+  if (!header) {
+    header = allocateOnHeap(total_bytes);
+  }
+
+  return header + 1;
+}
+
+void ImageBufferAllocator::release(void* const buffer) {
+  if (!buffer) {
+    return;
+  }
+
+  BufferHeader* const header = static_cast<BufferHeader*>(buffer) - 1;
+  if (QTemporaryFile* const file = header->file) {
+    file->unmap(reinterpret_cast<uchar*>(header));
+    delete file;
+  } else {
+    free(header);
+  }
+}
+
+QImage ImageBufferAllocator::createIndexed8Image(const QSize& size) {
+  // QImage requires scanlines to be 32-bit aligned.
+  const int stride = (size.width() + 3) & ~3;
+  const size_t num_bytes = static_cast<size_t>(stride) * static_cast<size_t>(size.height());
+  if (size.isEmpty() || !isSpilled(num_bytes)) {
+    return QImage(size, QImage::Format_Indexed8);
+  }
+
+  void* buffer = nullptr;
+  try {
+    buffer = allocate(num_bytes);
+  } catch (const std::bad_alloc&) {
+    return QImage();
+  }
+
+  QImage image(static_cast<uchar*>(buffer), size.width(), size.height(), stride, QImage::Format_Indexed8, &release,
+               buffer);
+  if (image.isNull()) {
+    // The cleanup function is only called for images that were created.
+    release(buffer);
+  }
+
+  return image;
+}
+}  // namespace imageproc
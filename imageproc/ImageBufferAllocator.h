@@ -0,0 +1,71 @@
+
+#ifndef SCANTAILOR_IMAGEBUFFERALLOCATOR_H
+#define SCANTAILOR_IMAGEBUFFERALLOCATOR_H
+
+#include <QImage>
+#include <QString>
+#include <cstddef>
+
+namespace imageproc {
+/**
+ * \brief Allocates pixel buffers of BinaryImage, GrayImage and other large 8-bit images.
+ *
+ * Buffers normally come from the heap.  Once a spill directory is set,
+ * buffers of at least the spill threshold go to memory-mapped temporary
+ * files in that directory instead.  The OS is then free to page them out,
+ * so pages larger than the available memory still get processed, if slowly.
+ * Such a file is removed as soon as its buffer is released.  If a file
+ * can't be created, the buffer comes from the heap after all.
+ *
+ * Spilling is meant to be configured once, before any processing starts.
+ * Allocating and releasing buffers is thread-safe.
+ */
+class ImageBufferAllocator {
+ public:
+  static const size_t DEFAULT_SPILL_THRESHOLD = size_t(64) << 20;
+
+  /**
+   * \brief Sets the directory for spilled buffers.  An empty path disables spilling.
+   */
+  static void setSpillDirectory(const QString& path);
+
+  static QString spillDirectory();
+
+  /**
+   * \brief Sets the buffer size in bytes, starting from which buffers get spilled.
+   */
+  static void setSpillThreshold(size_t bytes);
+
+  static size_t spillThreshold();
+
+  /**
+   * \brief Whether a buffer of that many bytes would be spilled.
+   */
+  static bool isSpilled(size_t bytes);
+
+  /**
+   * \brief Allocates an uninitialized buffer, aligned as malloc() would align it.
+   *
+   * \throw std::bad_alloc
+   */
+  static void* allocate(size_t bytes);
+
+  /**
+   * \brief Releases a buffer returned by allocate().  Null pointers are ignored.
+   *
+   * The signature makes it usable as a QImageCleanupFunction.
+   */
+  static void release(void* buffer);
+
+  /**
+   * \brief Creates an uninitialized Format_Indexed8 image without a color table,
+   *        whose pixels are spilled like allocate() would spill them.
+   *
+   * Like the QImage constructor, returns a null image if \p size is empty
+   * or the pixels couldn't be allocated.
+   */
+  static QImage createIndexed8Image(const QSize& size);
+};
+}  // namespace imageproc
+
+#endif  // SCANTAILOR_IMAGEBUFFERALLOCATOR_H
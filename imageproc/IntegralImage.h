@@ -48,6 +48,11 @@ class IntegralImage {
 
   ~IntegralImage();
 
+  /**
+   * \brief The dimensions of the array this integral image was built for.
+   */
+  QSize size() const { return QSize(m_width - 1, m_height - 1); }
+
   /**
    * \brief To be called before pushing new row data.
    */
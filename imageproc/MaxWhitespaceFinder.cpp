@@ -18,6 +18,7 @@
 
 #include "MaxWhitespaceFinder.h"
 #include <QDebug>
+#include <algorithm>
 #include <cassert>
 
 namespace imageproc {
@@ -36,27 +37,38 @@ class AreaCompare {
 }  // anonymous namespace
 
 MaxWhitespaceFinder::MaxWhitespaceFinder(const BinaryImage& img, QSize min_size)
-    : m_integralImg(img.size()),
+    : MaxWhitespaceFinder(buildIntegralImage(img), min_size) {}
+
+MaxWhitespaceFinder::MaxWhitespaceFinder(std::shared_ptr<const IntegralImage<unsigned>> integral_img, QSize min_size)
+    : m_integralImg(std::move(integral_img)),
       m_queuedRegions(new PriorityStorageImpl<AreaCompare>(AreaCompare())),
       m_minSize(min_size) {
-  init(img);
+  init();
 }
 
-void MaxWhitespaceFinder::init(const BinaryImage& img) {
+std::shared_ptr<const IntegralImage<unsigned>> MaxWhitespaceFinder::buildIntegralImage(const BinaryImage& img) {
   const int width = img.width();
   const int height = img.height();
   const uint32_t* line = img.data();
   const int wpl = img.wordsPerLine();
 
+  auto integral_img = std::make_shared<IntegralImage<unsigned>>(img.size());
   for (int y = 0; y < height; ++y, line += wpl) {
-    m_integralImg.beginRow();
-    for (int x = 0; x < width; ++x) {
-      const int shift = 31 - (x & 31);
-      m_integralImg.push((line[x >> 5] >> shift) & 1);
+    integral_img->beginRow();
+    for (int x = 0; x < width; x += 32) {
+      const uint32_t word = line[x >> 5];
+      const int end = std::min(width - x, 32);
+      for (int i = 0; i < end; ++i) {
+        integral_img->push((word >> (31 - i)) & 1);
+      }
     }
   }
 
-  Region region(0, img.rect());
+  return integral_img;
+}
+
+void MaxWhitespaceFinder::init() {
+  Region region(0, QRect(QPoint(0, 0), m_integralImg->size()));
   m_queuedRegions->push(region);
 }
 
@@ -82,7 +94,7 @@ QRect MaxWhitespaceFinder::next(const ObstacleMode obstacle_mode, int max_iterat
       continue;
     }
 
-    if (m_integralImg.sum(region.bounds()) != 0) {
+    if (m_integralImg->sum(region.bounds()) != 0) {
       subdivideUsingRaster(region);
       continue;
     }
@@ -169,13 +181,13 @@ QRect MaxWhitespaceFinder::findPivotObstacle(const Region& region) const {
 }
 
 QPoint MaxWhitespaceFinder::findBlackPixelCloseToCenter(const QRect non_white_rect) const {
-  assert(m_integralImg.sum(non_white_rect) != 0);
+  assert(m_integralImg->sum(non_white_rect) != 0);
 
   const QPoint center(non_white_rect.center());
   QRect outer_rect(non_white_rect);
   QRect inner_rect(center.x(), center.y(), 1, 1);
 
-  if (m_integralImg.sum(inner_rect) != 0) {
+  if (m_integralImg->sum(inner_rect) != 0) {
     return center;
   }
 
@@ -206,7 +218,7 @@ QPoint MaxWhitespaceFinder::findBlackPixelCloseToCenter(const QRect non_white_re
     assert(outer_rect.contains(middle_rect));
     assert(middle_rect.contains(inner_rect));
 
-    if (m_integralImg.sum(middle_rect) == 0) {
+    if (m_integralImg->sum(middle_rect) == 0) {
       inner_rect = middle_rect;
     } else {
       outer_rect = middle_rect;
@@ -217,7 +229,7 @@ QPoint MaxWhitespaceFinder::findBlackPixelCloseToCenter(const QRect non_white_re
   if (outer_rect.left() != inner_rect.left()) {
     QRect rect(outer_rect);
     rect.setRight(rect.left());  // Right is inclusive.
-    const unsigned sum = m_integralImg.sum(rect);
+    const unsigned sum = m_integralImg->sum(rect);
     if (outer_rect.height() == 1) {
       // This means we are dealing with a horizontal line
       // and that we only have to check at most two pixels
@@ -237,7 +249,7 @@ QPoint MaxWhitespaceFinder::findBlackPixelCloseToCenter(const QRect non_white_re
   if (outer_rect.right() != inner_rect.right()) {
     QRect rect(outer_rect);
     rect.setLeft(rect.right());  // Right is inclusive.
-    const unsigned sum = m_integralImg.sum(rect);
+    const unsigned sum = m_integralImg->sum(rect);
     if (outer_rect.height() == 1) {
       // Same as above, except rect now points to the
       // right endpoint.
@@ -255,7 +267,7 @@ QPoint MaxWhitespaceFinder::findBlackPixelCloseToCenter(const QRect non_white_re
   if (outer_rect.top() != inner_rect.top()) {
     QRect rect(outer_rect);
     rect.setBottom(rect.top());  // Bottom is inclusive.
-    const unsigned sum = m_integralImg.sum(rect);
+    const unsigned sum = m_integralImg->sum(rect);
     if (outer_rect.width() == 1) {
       // Same as above, except rect now points to the
       // top endpoint.
@@ -272,7 +284,7 @@ QPoint MaxWhitespaceFinder::findBlackPixelCloseToCenter(const QRect non_white_re
   assert(outer_rect.bottom() != inner_rect.bottom());
   QRect rect(outer_rect);
   rect.setTop(rect.bottom());  // Bottom is inclusive.
-  assert(m_integralImg.sum(rect) != 0);
+  assert(m_integralImg->sum(rect) != 0);
   if (outer_rect.width() == 1) {
     return outer_rect.bottomLeft();
   } else {
@@ -286,7 +298,7 @@ QRect MaxWhitespaceFinder::extendBlackPixelToBlackBox(const QPoint pixel, const
   QRect outer_rect(bounds);
   QRect inner_rect(pixel.x(), pixel.y(), 1, 1);
 
-  if (m_integralImg.sum(outer_rect) == unsigned(outer_rect.width() * outer_rect.height())) {
+  if (m_integralImg->sum(outer_rect) == unsigned(outer_rect.width() * outer_rect.height())) {
     return outer_rect;
   }
 
@@ -318,7 +330,7 @@ QRect MaxWhitespaceFinder::extendBlackPixelToBlackBox(const QPoint pixel, const
     assert(middle_rect.contains(inner_rect));
 
     const unsigned area = middle_rect.width() * middle_rect.height();
-    if (m_integralImg.sum(middle_rect) == area) {
+    if (m_integralImg->sum(middle_rect) == area) {
       inner_rect = middle_rect;
     } else {
       outer_rect = middle_rect;
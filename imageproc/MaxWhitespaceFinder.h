@@ -24,6 +24,7 @@
 #include <cstddef>
 #include <deque>
 #include <memory>
+#include <utility>
 #include <vector>
 #include "BinaryImage.h"
 #include "IntegralImage.h"
@@ -56,6 +57,15 @@ class MaxWhitespaceFinder {
    */
   explicit MaxWhitespaceFinder(const BinaryImage& img, QSize min_size = QSize(1, 1));
 
+  /**
+   * \brief Constructor taking an integral image built by buildIntegralImage().
+   *
+   * Finders working on the same image may share the integral image,
+   * which saves rebuilding it and allows them to run concurrently.
+   */
+  explicit MaxWhitespaceFinder(std::shared_ptr<const IntegralImage<unsigned>> integral_img,
+                               QSize min_size = QSize(1, 1));
+
   /**
    * \brief Constructor with customized rectangle ordering.
    *
@@ -84,6 +94,20 @@ class MaxWhitespaceFinder {
   template <typename QualityCompare>
   MaxWhitespaceFinder(QualityCompare comp, const BinaryImage& img, QSize min_size = QSize(1, 1));
 
+  /**
+   * \brief Constructor with customized rectangle ordering, taking
+   *        an integral image built by buildIntegralImage().
+   */
+  template <typename QualityCompare>
+  MaxWhitespaceFinder(QualityCompare comp,
+                      std::shared_ptr<const IntegralImage<unsigned>> integral_img,
+                      QSize min_size = QSize(1, 1));
+
+  /**
+   * \brief Builds the integral image of black pixels the finder works on.
+   */
+  static std::shared_ptr<const IntegralImage<unsigned>> buildIntegralImage(const BinaryImage& img);
+
   /**
    * \brief Mark a region as black.
    *
@@ -151,7 +175,7 @@ class MaxWhitespaceFinder {
   };
 
 
-  void init(const BinaryImage& img);
+  void init();
 
   void subdivideUsingObstacles(const Region& region);
 
@@ -165,7 +189,7 @@ class MaxWhitespaceFinder {
 
   QRect extendBlackPixelToBlackBox(QPoint pixel, QRect bounds) const;
 
-  IntegralImage<unsigned> m_integralImg;
+  std::shared_ptr<const IntegralImage<unsigned>> m_integralImg;
   std::unique_ptr<max_whitespace_finder::PriorityStorage> m_queuedRegions;
   std::vector<QRect> m_newObstacles;
   QSize m_minSize;
@@ -307,10 +331,16 @@ void PriorityStorageImpl<QualityCompare>::popHeap(const std::deque<Region>::iter
 
 template <typename QualityCompare>
 MaxWhitespaceFinder::MaxWhitespaceFinder(const QualityCompare comp, const BinaryImage& img, const QSize min_size)
-    : m_integralImg(img.size()),
+    : MaxWhitespaceFinder(comp, buildIntegralImage(img), min_size) {}
+
+template <typename QualityCompare>
+MaxWhitespaceFinder::MaxWhitespaceFinder(const QualityCompare comp,
+                                         std::shared_ptr<const IntegralImage<unsigned>> integral_img,
+                                         const QSize min_size)
+    : m_integralImg(std::move(integral_img)),
       m_queuedRegions(new max_whitespace_finder::PriorityStorageImpl<QualityCompare>(comp)),
       m_minSize(min_size) {
-  init(img);
+  init();
 }
 }  // namespace imageproc
 #endif  // ifndef IMAGEPROC_MAX_WHITESPACE_FINDER_H_
@@ -21,7 +21,9 @@
 #include <QPainterPath>
 #include <QPolygonF>
 #include <boost/foreach.hpp>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include "BinaryImage.h"
 #include "PolygonUtils.h"
 
@@ -107,9 +109,17 @@ class PolygonRasterizer::Rasterizer {
 
   void fillGrayscale(QImage& image, uint8_t color) const;
 
+  void fillColor(QImage& image, QRgb color, bool antialiasing) const;
+
  private:
   void prepareEdges();
 
+  /**
+   * Calls handler(x_from, x_to) for every filled span of a horizontal line at \p y.
+   */
+  template <typename SpanHandler>
+  void forEachSpan(double y, std::vector<EdgeComponent>& edges_for_line, SpanHandler handler) const;
+
   static void oddEvenLineBinary(const EdgeComponent* edges, int num_edges, uint32_t* line, uint32_t pattern);
 
   static void oddEvenLineGrayscale(const EdgeComponent* edges, int num_edges, uint8_t* line, uint8_t color);
@@ -194,6 +204,23 @@ void PolygonRasterizer::grayFillExcept(QImage& image,
   rasterizer.fillGrayscale(image, color);
 }
 
+void PolygonRasterizer::colorFill(QImage& image,
+                                  const QRgb color,
+                                  const QPolygonF& poly,
+                                  const Qt::FillRule fill_rule,
+                                  const bool antialiasing) {
+  if (image.isNull()) {
+    throw std::invalid_argument("PolygonRasterizer: target image is null");
+  }
+  if ((image.format() != QImage::Format_RGB32)
+      && ((image.format() != QImage::Format_Indexed8) || !image.isGrayscale())) {
+    throw std::invalid_argument("PolygonRasterizer: target image is neither grayscale nor RGB32");
+  }
+
+  Rasterizer rasterizer(image.rect(), poly, fill_rule, false);
+  rasterizer.fillColor(image, color, antialiasing);
+}
+
 /*======================= PolygonRasterizer::Edge ==========================*/
 
 PolygonRasterizer::Edge::Edge(const QPointF& top, const QPointF& bottom, const int vert_direction)
@@ -390,6 +417,146 @@ void PolygonRasterizer::Rasterizer::fillGrayscale(QImage& image, const uint8_t c
   }
 }  // PolygonRasterizer::Rasterizer::fillGrayscale
 
+template <typename SpanHandler>
+void PolygonRasterizer::Rasterizer::forEachSpan(const double y,
+                                                std::vector<EdgeComponent>& edges_for_line,
+                                                SpanHandler handler) const {
+  typedef std::vector<EdgeComponent>::const_iterator EdgeIter;
+
+  // Get edges intersecting this horizontal line.
+  const std::pair<EdgeIter, EdgeIter> range(
+      std::equal_range(m_edgeComponents.begin(), m_edgeComponents.end(), y, EdgeOrderY()));
+
+  if (range.first == range.second) {
+    return;
+  }
+
+  edges_for_line.assign(range.first, range.second);
+
+  for (EdgeComponent& ecomp : edges_for_line) {
+    ecomp.setX(ecomp.edge().xForY(y));
+  }
+  std::sort(edges_for_line.begin(), edges_for_line.end(), EdgeOrderX());
+
+  const int num_edges = static_cast<int>(edges_for_line.size());
+  if (m_fillRule == Qt::OddEvenFill) {
+    for (int i = 0; i < num_edges - 1; i += 2) {
+      handler(edges_for_line[i].x(), edges_for_line[i + 1].x());
+    }
+  } else {
+    int dir_sum = 0;
+    for (int i = 0; i < num_edges - 1; ++i) {
+      dir_sum += edges_for_line[i].edge().vertDirection();
+      if ((dir_sum == 0) == m_invert) {
+        handler(edges_for_line[i].x(), edges_for_line[i + 1].x());
+      }
+    }
+  }
+}
+
+namespace {
+inline uint8_t blendChannel(const unsigned dst, const unsigned src, const unsigned alpha) {
+  return static_cast<uint8_t>((dst * (255 - alpha) + src * alpha + 127) / 255);
+}
+}  // namespace
+
+void PolygonRasterizer::Rasterizer::fillColor(QImage& image, const QRgb color, const bool antialiasing) const {
+  // The number of horizontal lines sampled within a pixel row when anti-aliasing.
+  const int subsamples = 16;
+
+  const int left = std::max(0, static_cast<int>(std::floor(m_boundingBox.left())));
+  const int right = std::min(m_imageRect.width(), static_cast<int>(std::ceil(m_boundingBox.right())));
+  if (left >= right) {
+    return;
+  }
+  const int width = right - left;
+
+  int top;
+  int bottom;  // exclusive
+  if (antialiasing) {
+    top = std::max(0, static_cast<int>(std::floor(m_boundingBox.top())));
+    bottom = std::min(m_imageRect.height(), static_cast<int>(std::ceil(m_boundingBox.bottom())));
+  } else {
+    top = qRound(m_boundingBox.top());
+    bottom = qRound(m_boundingBox.bottom());
+  }
+
+  // Coverage of the pixels in a row, relative to the left of the bounding box.
+  // Fully covered runs of pixels are accumulated as a start and an end in coverage_delta,
+  // while partially covered pixels at the ends of spans go to partial_coverage.
+  std::vector<float> coverage_delta(width + 1, 0.0f);
+  std::vector<float> partial_coverage(width + 1, 0.0f);
+  std::vector<EdgeComponent> edges_for_line;
+
+  const float weight = 1.0f / subsamples;
+  auto add_aa_span = [&](double x_from, double x_to) {
+    x_from = qBound(0.0, x_from - left, double(width));
+    x_to = qBound(0.0, x_to - left, double(width));
+    if (x_from >= x_to) {
+      return;
+    }
+
+    const int first = static_cast<int>(x_from);
+    const int last = static_cast<int>(x_to);
+    if (first == last) {
+      partial_coverage[first] += static_cast<float>((x_to - x_from) * weight);
+
+      return;
+    }
+
+    partial_coverage[first] += static_cast<float>((first + 1 - x_from) * weight);
+    coverage_delta[first + 1] += weight;
+    coverage_delta[last] -= weight;
+    partial_coverage[last] += static_cast<float>((x_to - last) * weight);
+  };
+  auto add_span = [&](const double x_from, const double x_to) {
+    const int first = qBound(0, qRound(x_from) - left, width);
+    const int last = qBound(0, qRound(x_to) - left, width);
+    if (first < last) {
+      coverage_delta[first] += 1.0f;
+      coverage_delta[last] -= 1.0f;
+    }
+  };
+
+  const bool gray = (image.format() == QImage::Format_Indexed8);
+  const auto gray_level = static_cast<unsigned>(qGray(color));
+  const auto color_alpha = static_cast<float>(qAlpha(color));
+  const int bpl = image.bytesPerLine();
+  uint8_t* line = image.bits() + top * bpl;
+
+  for (int y = top; y < bottom; ++y, line += bpl) {
+    if (antialiasing) {
+      for (int i = 0; i < subsamples; ++i) {
+        forEachSpan(y + (i + 0.5) / subsamples, edges_for_line, add_aa_span);
+      }
+    } else {
+      forEachSpan(y + 0.5, edges_for_line, add_span);
+    }
+
+    float full_coverage = 0.0f;
+    for (int x = 0; x < width; ++x) {
+      full_coverage += coverage_delta[x];
+      const float coverage = std::min(full_coverage + partial_coverage[x], 1.0f);
+      const auto alpha = static_cast<int>(coverage * color_alpha + 0.5f);
+      if (alpha <= 0) {
+        continue;
+      }
+
+      if (gray) {
+        uint8_t& pixel = line[left + x];
+        pixel = blendChannel(pixel, gray_level, alpha);
+      } else {
+        QRgb& pixel = reinterpret_cast<QRgb*>(line)[left + x];
+        pixel = qRgb(blendChannel(qRed(pixel), qRed(color), alpha), blendChannel(qGreen(pixel), qGreen(color), alpha),
+                     blendChannel(qBlue(pixel), qBlue(color), alpha));
+      }
+    }
+
+    std::fill(coverage_delta.begin(), coverage_delta.end(), 0.0f);
+    std::fill(partial_coverage.begin(), partial_coverage.end(), 0.0f);
+  }
+}  // PolygonRasterizer::Rasterizer::fillColor
+
 void PolygonRasterizer::Rasterizer::oddEvenLineBinary(const EdgeComponent* const edges,
                                                       const int num_edges,
                                                       uint32_t* const line,
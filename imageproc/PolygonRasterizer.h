@@ -19,6 +19,7 @@
 #ifndef IMAGEPROC_POLYGONRASTERIZER_H_
 #define IMAGEPROC_POLYGONRASTERIZER_H_
 
+#include <QRgb>
 #include <Qt>
 #include "BWColor.h"
 
@@ -39,6 +40,16 @@ class PolygonRasterizer {
 
   static void grayFillExcept(QImage& image, unsigned char color, const QPolygonF& poly, Qt::FillRule fill_rule);
 
+  /**
+   * \brief Fills a polygon in a grayscale or an RGB32 image.
+   *
+   * Only the pixels inside the polygon's bounding box are touched.  With anti-aliasing,
+   * pixels partially covered by the polygon are blended with \p color in proportion
+   * to the covered area.  Translucent colors are blended as well.  Grayscale images
+   * get qGray() of \p color.
+   */
+  static void colorFill(QImage& image, QRgb color, const QPolygonF& poly, Qt::FillRule fill_rule, bool antialiasing);
+
  private:
   class Edge;
   class EdgeComponent;
@@ -22,9 +22,39 @@
 #include <cassert>
 #include <cmath>
 #include "Constants.h"
+#include "ParallelFor.h"
 #include "VecNT.h"
 
 namespace imageproc {
+namespace {
+/**
+ * Search spaces with fewer points than that are subdivided sequentially,
+ * as filtering their points takes less time than dispatching it to a thread.
+ */
+const size_t MIN_POINTS_FOR_PARALLEL_SUBDIVISION = 4096;
+
+/**
+ * Calls both functors, concurrently if there are enough points to process.
+ */
+template <typename F1, typename F2>
+void runBoth(const size_t num_points, const F1& f1, const F2& f2) {
+  if (num_points < MIN_POINTS_FOR_PARALLEL_SUBDIVISION) {
+    f1();
+    f2();
+
+    return;
+  }
+
+  parallelFor(0, 2, 1, [&f1, &f2](const int begin, int) {
+    if (begin == 0) {
+      f1();
+    } else {
+      f2();
+    }
+  });
+}
+}  // namespace
+
 /*========================= RastLineFinderParams ===========================*/
 
 RastLineFinderParams::RastLineFinderParams()
@@ -128,8 +158,15 @@ QLineF RastLineFinder::findNext(std::vector<unsigned>* point_idxs) {
     SearchSpace ssp;
     m_orderedSearchSpaces.retrieveFront(ssp);
 
-    if (!ssp.subdivideDist(*this, dist_ssp1, dist_ssp2)) {
-      if (!ssp.subdivideAngle(*this, angle_ssp1, angle_ssp2)) {
+    // Subdivisions by distance and by angle are independent of each other,
+    // and we need both of them to choose between them.
+    bool dist_subdivided = false;
+    bool angle_subdivided = false;
+    runBoth(ssp.pointIdxs().size(), [&]() { dist_subdivided = ssp.subdivideDist(*this, dist_ssp1, dist_ssp2); },
+            [&]() { angle_subdivided = ssp.subdivideAngle(*this, angle_ssp1, angle_ssp2); });
+
+    if (!dist_subdivided) {
+      if (!angle_subdivided) {
         // Can't subdivide at all - return what we've got then.
         markPointsUnavailable(ssp.pointIdxs());
         if (point_idxs) {
@@ -143,7 +180,7 @@ QLineF RastLineFinder::findNext(std::vector<unsigned>* point_idxs) {
         pushIfGoodEnough(angle_ssp2);
       }
     } else {
-      if (!ssp.subdivideAngle(*this, angle_ssp1, angle_ssp2)) {
+      if (!angle_subdivided) {
         // Can only subdivide by distance.
         pushIfGoodEnough(dist_ssp1);
         pushIfGoodEnough(dist_ssp2);
@@ -276,20 +313,30 @@ bool RastLineFinder::SearchSpace::subdivideDist(const RastLineFinder& owner,
 
   if (m_maxDist - m_minDist <= owner.m_angleToleranceRad * 3) {
     // This branch prevents near-infinite subdivision that would have happened without it.
-    SearchSpace ssp1(owner, m_minDist, static_cast<float>(m_minDist + owner.m_maxDistFromLine * 2), m_minAngleRad,
-                     m_maxAngleRad, m_pointIdxs);
-    SearchSpace ssp2(owner, static_cast<float>(m_maxDist - owner.m_maxDistFromLine * 2), m_maxDist, m_minAngleRad,
-                     m_maxAngleRad, m_pointIdxs);
-    ssp1.swap(subspace1);
-    ssp2.swap(subspace2);
+    runBoth(m_pointIdxs.size(),
+            [&]() {
+              SearchSpace(owner, m_minDist, static_cast<float>(m_minDist + owner.m_maxDistFromLine * 2), m_minAngleRad,
+                          m_maxAngleRad, m_pointIdxs)
+                  .swap(subspace1);
+            },
+            [&]() {
+              SearchSpace(owner, static_cast<float>(m_maxDist - owner.m_maxDistFromLine * 2), m_maxDist, m_minAngleRad,
+                          m_maxAngleRad, m_pointIdxs)
+                  .swap(subspace2);
+            });
   } else {
     const float mid_dist = 0.5f * (m_maxDist + m_minDist);
-    SearchSpace ssp1(owner, m_minDist, static_cast<float>(mid_dist + owner.m_maxDistFromLine), m_minAngleRad,
-                     m_maxAngleRad, m_pointIdxs);
-    SearchSpace ssp2(owner, static_cast<float>(mid_dist - owner.m_maxDistFromLine), m_maxDist, m_minAngleRad,
-                     m_maxAngleRad, m_pointIdxs);
-    ssp1.swap(subspace1);
-    ssp2.swap(subspace2);
+    runBoth(m_pointIdxs.size(),
+            [&]() {
+              SearchSpace(owner, m_minDist, static_cast<float>(mid_dist + owner.m_maxDistFromLine), m_minAngleRad,
+                          m_maxAngleRad, m_pointIdxs)
+                  .swap(subspace1);
+            },
+            [&]() {
+              SearchSpace(owner, static_cast<float>(mid_dist - owner.m_maxDistFromLine), m_maxDist, m_minAngleRad,
+                          m_maxAngleRad, m_pointIdxs)
+                  .swap(subspace2);
+            });
   }
 
   return true;
@@ -306,11 +353,9 @@ bool RastLineFinder::SearchSpace::subdivideAngle(const RastLineFinder& owner,
 
   const float mid_angle_rad = 0.5f * (m_maxAngleRad + m_minAngleRad);
 
-  SearchSpace ssp1(owner, m_minDist, m_maxDist, m_minAngleRad, mid_angle_rad, m_pointIdxs);
-  SearchSpace ssp2(owner, m_minDist, m_maxDist, mid_angle_rad, m_maxAngleRad, m_pointIdxs);
-
-  ssp1.swap(subspace1);
-  ssp2.swap(subspace2);
+  runBoth(m_pointIdxs.size(),
+          [&]() { SearchSpace(owner, m_minDist, m_maxDist, m_minAngleRad, mid_angle_rad, m_pointIdxs).swap(subspace1); },
+          [&]() { SearchSpace(owner, m_minDist, m_maxDist, mid_angle_rad, m_maxAngleRad, m_pointIdxs).swap(subspace2); });
 
   return true;
 }
@@ -127,6 +127,9 @@ class RastLineFinderParams {
  * Thomas M. Breuel. Finding Lines under Bounded Error.\n
  * Pattern Recognition, 29(1):167-178, 1996.\n
  * http://infoscience.epfl.ch/record/82286/files/93-11.pdf?version=1
+ *
+ * Search spaces with many points are subdivided on several threads.
+ * That doesn't affect the results.
  */
 class RastLineFinder {
  private:
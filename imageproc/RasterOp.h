@@ -26,6 +26,7 @@
 #include <cassert>
 #include <stdexcept>
 #include "BinaryImage.h"
+#include "RasterOpKernels.h"
 
 namespace imageproc {
 /**
@@ -193,6 +194,69 @@ class TemplateRasterOp : public AbstractRasterOp {
 
 
 namespace detail {
+/**
+ * \brief Maps raster operations to their vectorized implementations, if any.
+ */
+template <typename Rop>
+struct BinaryRopKernelOf {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::NONE;
+};
+
+template <>
+struct BinaryRopKernelOf<RopSrc> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::SRC;
+};
+
+template <>
+struct BinaryRopKernelOf<RopNot<RopSrc>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::NOT_SRC;
+};
+
+template <>
+struct BinaryRopKernelOf<RopAnd<RopSrc, RopDst>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::AND;
+};
+
+template <>
+struct BinaryRopKernelOf<RopAnd<RopDst, RopSrc>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::AND;
+};
+
+template <>
+struct BinaryRopKernelOf<RopOr<RopSrc, RopDst>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::OR;
+};
+
+template <>
+struct BinaryRopKernelOf<RopOr<RopDst, RopSrc>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::OR;
+};
+
+template <>
+struct BinaryRopKernelOf<RopXor<RopSrc, RopDst>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::XOR;
+};
+
+template <>
+struct BinaryRopKernelOf<RopXor<RopDst, RopSrc>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::XOR;
+};
+
+template <>
+struct BinaryRopKernelOf<RopSubtract<RopDst, RopSrc>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::DST_AND_NOT_SRC;
+};
+
+template <>
+struct BinaryRopKernelOf<RopAnd<RopNot<RopSrc>, RopDst>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::DST_AND_NOT_SRC;
+};
+
+template <>
+struct BinaryRopKernelOf<RopSubtract<RopSrc, RopDst>> {
+  static constexpr BinaryRopKernel value = BinaryRopKernel::SRC_AND_NOT_DST;
+};
+
 template <typename Rop>
 void rasterOpInDirection(BinaryImage& dst,
                          const QRect& dr,
@@ -242,6 +306,15 @@ void rasterOpInDirection(BinaryImage& dst,
     src_span = src.data() - (sp.y() + dr.height() - 1) * src_span_delta + sp.x() / 32;
   }
 
+  // Full words in the middle of long enough lines go through a vectorized kernel, if there is one.
+  // Kernels process words left to right and can't deal with a line overlapping itself.
+  // They are only used where source and destination words line up.  Shifting source words is limited
+  // by memory bandwidth, so a kernel for that isn't any faster than the generic loop.
+  const BinaryRopKernel kernel = BinaryRopKernelOf<Rop>::value;
+  const bool use_kernel = (kernel != BinaryRopKernel::NONE) && (dx == 1) && (rightmost_dst_word > 8)
+                          && !((&dst == &src) && (dr.y() == sp.y()));
+  const RasterOpKernels& kernels = RasterOpKernels::instance();
+
   int src_word1_shift;
   int src_word2_shift;
   if (src_start_bit > dst_start_bit) {
@@ -274,10 +347,15 @@ void rasterOpInDirection(BinaryImage& dst,
         uint32_t new_dst_word = Rop::transform(src_word, dst_word);
         dst_span[widx] = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
 
-        while ((widx += dx) != last_dst_word) {
-          src_word = src_span[widx];
-          dst_word = dst_span[widx];
-          dst_span[widx] = Rop::transform(src_word, dst_word);
+        if (use_kernel) {
+          kernels.binary(kernel, src_span + 1, dst_span + 1, last_dst_word - 1);
+          widx = last_dst_word;
+        } else {
+          while ((widx += dx) != last_dst_word) {
+            src_word = src_span[widx];
+            dst_word = dst_span[widx];
+            dst_span[widx] = Rop::transform(src_word, dst_word);
+          }
         }
 
         // Handle the last (possibly incomplete) dst word in the line.
@@ -0,0 +1,423 @@
+
+#include "RasterOpKernels.h"
+#include <algorithm>
+#include "GrayRasterOp.h"
+#include "RasterOp.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RASTER_OP_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only allow intrinsics in functions explicitly targeting
+// the corresponding instruction set, while MSVC allows them anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace imageproc {
+namespace {
+typedef void (*BinaryFunc)(const uint32_t* src, uint32_t* dst, int num_words);
+typedef void (*GrayFunc)(const uint8_t* src, uint8_t* dst, int width);
+
+/*================================== Scalar ==================================*/
+
+template <typename Rop>
+void binaryScalar(const uint32_t* src, uint32_t* dst, const int num_words) {
+  for (int i = 0; i < num_words; ++i) {
+    dst[i] = Rop::transform(src[i], dst[i]);
+  }
+}
+
+template <typename GRop>
+void grayScalar(const uint8_t* src, uint8_t* dst, const int width) {
+  for (int x = 0; x < width; ++x) {
+    dst[x] = GRop::transform(src[x], dst[x]);
+  }
+}
+
+/*========================== Vectorized operations ===========================*/
+
+// Every operation works on 128-bit and on 256-bit vectors of source and destination
+// words or pixels.  They are only defined where the intrinsics are available.
+
+struct SrcVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, __m128i) { return src; }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, __m256i) { return src; }
+#endif
+};
+
+struct NotSrcVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, __m128i) { return _mm_xor_si128(src, _mm_set1_epi32(-1)); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, __m256i) { return _mm256_xor_si256(src, _mm256_set1_epi32(-1)); }
+#endif
+};
+
+struct AndVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_and_si128(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_and_si256(src, dst); }
+#endif
+};
+
+struct OrVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_or_si128(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_or_si256(src, dst); }
+#endif
+};
+
+struct XorVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_xor_si128(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_xor_si256(src, dst); }
+#endif
+};
+
+struct DstAndNotSrcVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_andnot_si128(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_andnot_si256(src, dst); }
+#endif
+};
+
+struct SrcAndNotDstVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_andnot_si128(dst, src); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_andnot_si256(dst, src); }
+#endif
+};
+
+struct InvertSrcVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, __m128i) { return _mm_xor_si128(src, _mm_set1_epi8(-1)); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, __m256i) { return _mm256_xor_si256(src, _mm256_set1_epi8(-1)); }
+#endif
+};
+
+struct DstMinusSrcClippedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_subs_epu8(dst, src); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_subs_epu8(dst, src); }
+#endif
+};
+
+struct SrcMinusDstClippedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_subs_epu8(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_subs_epu8(src, dst); }
+#endif
+};
+
+struct DstMinusSrcUnclippedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_sub_epi8(dst, src); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_sub_epi8(dst, src); }
+#endif
+};
+
+struct SrcMinusDstUnclippedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_sub_epi8(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_sub_epi8(src, dst); }
+#endif
+};
+
+struct InvertDstMinusSrcClippedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) {
+    return _mm_xor_si128(_mm_subs_epu8(dst, src), _mm_set1_epi8(-1));
+  }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) {
+    return _mm256_xor_si256(_mm256_subs_epu8(dst, src), _mm256_set1_epi8(-1));
+  }
+#endif
+};
+
+struct AddClippedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_adds_epu8(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_adds_epu8(src, dst); }
+#endif
+};
+
+struct AddUnclippedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_add_epi8(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_add_epi8(src, dst); }
+#endif
+};
+
+struct DarkestVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_min_epu8(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_min_epu8(src, dst); }
+#endif
+};
+
+struct LightestVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) { return _mm_max_epu8(src, dst); }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) { return _mm256_max_epu8(src, dst); }
+#endif
+};
+
+/**
+ * GRopRaiseAboveBackground, with the division done in single precision.
+ * Both the dividend and the divisor are exact integers below 2^24, and a quotient
+ * that isn't an integer is at least 1 / 255 away from the nearest one, which
+ * is way above the rounding error.  So truncating the quotient gives the same
+ * result as integer division.
+ */
+struct RaiseAboveBackgroundVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i divide(const __m128i orig, const __m128i background) {
+    const __m128i dividend = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(orig, 8), orig), _mm_srli_epi32(background, 1));
+
+    return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(dividend), _mm_cvtepi32_ps(background)));
+  }
+
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i src_lo = _mm_unpacklo_epi8(src, zero);
+    const __m128i src_hi = _mm_unpackhi_epi8(src, zero);
+    const __m128i dst_lo = _mm_unpacklo_epi8(dst, zero);
+    const __m128i dst_hi = _mm_unpackhi_epi8(dst, zero);
+    const __m128i res_lo = _mm_packs_epi32(divide(_mm_unpacklo_epi16(src_lo, zero), _mm_unpacklo_epi16(dst_lo, zero)),
+                                           divide(_mm_unpackhi_epi16(src_lo, zero), _mm_unpackhi_epi16(dst_lo, zero)));
+    const __m128i res_hi = _mm_packs_epi32(divide(_mm_unpacklo_epi16(src_hi, zero), _mm_unpacklo_epi16(dst_hi, zero)),
+                                           divide(_mm_unpackhi_epi16(src_hi, zero), _mm_unpackhi_epi16(dst_hi, zero)));
+    // Pixels not darker than their background become white.  That includes
+    // a zero background, where the division above produces garbage.
+    const __m128i white = _mm_cmpeq_epi8(_mm_max_epu8(src, dst), src);
+
+    return _mm_or_si128(_mm_packus_epi16(res_lo, res_hi), white);
+  }
+
+  TARGET_AVX2 static __m256i divide(const __m256i orig, const __m256i background) {
+    const __m256i dividend
+        = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(orig, 8), orig), _mm256_srli_epi32(background, 1));
+
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(dividend), _mm256_cvtepi32_ps(background)));
+  }
+
+  // Unpacking and packing work within 128-bit lanes, so the order of pixels is preserved.
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i src_lo = _mm256_unpacklo_epi8(src, zero);
+    const __m256i src_hi = _mm256_unpackhi_epi8(src, zero);
+    const __m256i dst_lo = _mm256_unpacklo_epi8(dst, zero);
+    const __m256i dst_hi = _mm256_unpackhi_epi8(dst, zero);
+    const __m256i res_lo
+        = _mm256_packs_epi32(divide(_mm256_unpacklo_epi16(src_lo, zero), _mm256_unpacklo_epi16(dst_lo, zero)),
+                             divide(_mm256_unpackhi_epi16(src_lo, zero), _mm256_unpackhi_epi16(dst_lo, zero)));
+    const __m256i res_hi
+        = _mm256_packs_epi32(divide(_mm256_unpacklo_epi16(src_hi, zero), _mm256_unpacklo_epi16(dst_hi, zero)),
+                             divide(_mm256_unpackhi_epi16(src_hi, zero), _mm256_unpackhi_epi16(dst_hi, zero)));
+    const __m256i white = _mm256_cmpeq_epi8(_mm256_max_epu8(src, dst), src);
+
+    return _mm256_or_si256(_mm256_packus_epi16(res_lo, res_hi), white);
+  }
+#endif
+};
+
+/**
+ * GRopCombineInverted.  For x in [0, 255 * 255], x / 255 equals (x + 1 + (x >> 8)) >> 8,
+ * which fits into 16 bits.
+ */
+struct CombineInvertedVec {
+#ifdef RASTER_OP_KERNELS_X86
+  TARGET_SSE2 static __m128i divideBy255(const __m128i x) {
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+  }
+
+  TARGET_SSE2 static __m128i apply(const __m128i src, const __m128i dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8(-1);
+    const __m128i inv_dst = _mm_xor_si128(dst, ones);
+    const __m128i lo = divideBy255(_mm_mullo_epi16(_mm_unpacklo_epi8(inv_dst, zero), _mm_unpacklo_epi8(src, zero)));
+    const __m128i hi = divideBy255(_mm_mullo_epi16(_mm_unpackhi_epi8(inv_dst, zero), _mm_unpackhi_epi8(src, zero)));
+
+    return _mm_xor_si128(_mm_packus_epi16(lo, hi), ones);
+  }
+
+  TARGET_AVX2 static __m256i divideBy255(const __m256i x) {
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8)), 8);
+  }
+
+  TARGET_AVX2 static __m256i apply(const __m256i src, const __m256i dst) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8(-1);
+    const __m256i inv_dst = _mm256_xor_si256(dst, ones);
+    const __m256i lo
+        = divideBy255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(inv_dst, zero), _mm256_unpacklo_epi8(src, zero)));
+    const __m256i hi
+        = divideBy255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(inv_dst, zero), _mm256_unpackhi_epi8(src, zero)));
+
+    return _mm256_xor_si256(_mm256_packus_epi16(lo, hi), ones);
+  }
+#endif
+};
+
+#ifdef RASTER_OP_KERNELS_X86
+
+/*=================================== SSE2 ===================================*/
+
+template <typename Rop, typename Vec>
+TARGET_SSE2 void binarySse2(const uint32_t* src, uint32_t* dst, const int num_words) {
+  int i = 0;
+  for (; i + 4 <= num_words; i += 4) {
+    const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), Vec::apply(s, d));
+  }
+  binaryScalar<Rop>(src + i, dst + i, num_words - i);
+}
+
+template <typename GRop, typename Vec>
+TARGET_SSE2 void graySse2(const uint8_t* src, uint8_t* dst, const int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), Vec::apply(s, d));
+  }
+  grayScalar<GRop>(src + x, dst + x, width - x);
+}
+
+/*=================================== AVX2 ===================================*/
+
+template <typename Rop, typename Vec>
+TARGET_AVX2 void binaryAvx2(const uint32_t* src, uint32_t* dst, const int num_words) {
+  int i = 0;
+  for (; i + 8 <= num_words; i += 8) {
+    const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), Vec::apply(s, d));
+  }
+  binarySse2<Rop, Vec>(src + i, dst + i, num_words - i);
+}
+
+template <typename GRop, typename Vec>
+TARGET_AVX2 void grayAvx2(const uint8_t* src, uint8_t* dst, const int width) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), Vec::apply(s, d));
+  }
+  graySse2<GRop, Vec>(src + x, dst + x, width - x);
+}
+
+#endif  // RASTER_OP_KERNELS_X86
+
+/*============================ Kernel selection ==============================*/
+
+template <typename Rop, typename Vec>
+BinaryFunc binaryFunc(const SimdLevel level) {
+#ifdef RASTER_OP_KERNELS_X86
+  if (level >= SimdLevel::AVX2) {
+    return &binaryAvx2<Rop, Vec>;
+  } else if (level >= SimdLevel::SSE2) {
+    return &binarySse2<Rop, Vec>;
+  }
+#endif
+
+  return &binaryScalar<Rop>;
+}
+
+template <typename GRop, typename Vec>
+GrayFunc grayFunc(const SimdLevel level) {
+#ifdef RASTER_OP_KERNELS_X86
+  if (level >= SimdLevel::AVX2) {
+    return &grayAvx2<GRop, Vec>;
+  } else if (level >= SimdLevel::SSE2) {
+    return &graySse2<GRop, Vec>;
+  }
+#endif
+
+  return &grayScalar<GRop>;
+}
+
+inline int index(const BinaryRopKernel op) {
+  return static_cast<int>(op) - 1;
+}
+
+inline int index(const GrayRopKernel op) {
+  return static_cast<int>(op) - 1;
+}
+}  // namespace
+
+/*============================= RasterOpKernels ==============================*/
+
+RasterOpKernels::RasterOpKernels(const SimdLevel level) : m_level(level) {
+  m_binary[index(BinaryRopKernel::SRC)] = binaryFunc<RopSrc, SrcVec>(level);
+  m_binary[index(BinaryRopKernel::NOT_SRC)] = binaryFunc<RopNot<RopSrc>, NotSrcVec>(level);
+  m_binary[index(BinaryRopKernel::AND)] = binaryFunc<RopAnd<RopSrc, RopDst>, AndVec>(level);
+  m_binary[index(BinaryRopKernel::OR)] = binaryFunc<RopOr<RopSrc, RopDst>, OrVec>(level);
+  m_binary[index(BinaryRopKernel::XOR)] = binaryFunc<RopXor<RopSrc, RopDst>, XorVec>(level);
+  m_binary[index(BinaryRopKernel::DST_AND_NOT_SRC)] = binaryFunc<RopSubtract<RopDst, RopSrc>, DstAndNotSrcVec>(level);
+  m_binary[index(BinaryRopKernel::SRC_AND_NOT_DST)] = binaryFunc<RopSubtract<RopSrc, RopDst>, SrcAndNotDstVec>(level);
+
+  m_gray[index(GrayRopKernel::INVERT_SRC)] = grayFunc<GRopInvert<GRopSrc>, InvertSrcVec>(level);
+  m_gray[index(GrayRopKernel::DST_MINUS_SRC_CLIPPED)]
+      = grayFunc<GRopClippedSubtract<GRopDst, GRopSrc>, DstMinusSrcClippedVec>(level);
+  m_gray[index(GrayRopKernel::SRC_MINUS_DST_CLIPPED)]
+      = grayFunc<GRopClippedSubtract<GRopSrc, GRopDst>, SrcMinusDstClippedVec>(level);
+  m_gray[index(GrayRopKernel::DST_MINUS_SRC_UNCLIPPED)]
+      = grayFunc<GRopUnclippedSubtract<GRopDst, GRopSrc>, DstMinusSrcUnclippedVec>(level);
+  m_gray[index(GrayRopKernel::SRC_MINUS_DST_UNCLIPPED)]
+      = grayFunc<GRopUnclippedSubtract<GRopSrc, GRopDst>, SrcMinusDstUnclippedVec>(level);
+  m_gray[index(GrayRopKernel::INVERT_DST_MINUS_SRC_CLIPPED)]
+      = grayFunc<GRopInvert<GRopClippedSubtract<GRopDst, GRopSrc>>, InvertDstMinusSrcClippedVec>(level);
+  m_gray[index(GrayRopKernel::ADD_CLIPPED)] = grayFunc<GRopClippedAdd<GRopSrc, GRopDst>, AddClippedVec>(level);
+  m_gray[index(GrayRopKernel::ADD_UNCLIPPED)] = grayFunc<GRopUnclippedAdd<GRopSrc, GRopDst>, AddUnclippedVec>(level);
+  m_gray[index(GrayRopKernel::DARKEST)] = grayFunc<GRopDarkest<GRopSrc, GRopDst>, DarkestVec>(level);
+  m_gray[index(GrayRopKernel::LIGHTEST)] = grayFunc<GRopLightest<GRopSrc, GRopDst>, LightestVec>(level);
+  m_gray[index(GrayRopKernel::RAISE_ABOVE_BACKGROUND)]
+      = grayFunc<GRopRaiseAboveBackground, RaiseAboveBackgroundVec>(level);
+  m_gray[index(GrayRopKernel::COMBINE_INVERTED)] = grayFunc<GRopCombineInverted, CombineInvertedVec>(level);
+}
+
+const RasterOpKernels& RasterOpKernels::instance() {
+  return forLevel(ScanlineConverter::supportedLevel());
+}
+
+const RasterOpKernels& RasterOpKernels::forLevel(const SimdLevel level) {
+  static const RasterOpKernels scalar(SimdLevel::SCALAR);
+  static const RasterOpKernels sse2(SimdLevel::SSE2);
+  static const RasterOpKernels avx2(SimdLevel::AVX2);
+
+  const SimdLevel supported = std::min(level, ScanlineConverter::supportedLevel());
+  if (supported >= SimdLevel::AVX2) {
+    return avx2;
+  } else if (supported >= SimdLevel::SSE2) {
+    return sse2;
+  } else {
+    return scalar;
+  }
+}
+}  // namespace imageproc
@@ -0,0 +1,97 @@
+
+#ifndef SCANTAILOR_RASTEROPKERNELS_H
+#define SCANTAILOR_RASTEROPKERNELS_H
+
+#include <cstdint>
+#include "ScanlineConversion.h"
+
+namespace imageproc {
+/**
+ * \brief Binary raster operations having vectorized implementations.
+ *
+ * NONE stands for any other operation.
+ */
+enum class BinaryRopKernel { NONE, SRC, NOT_SRC, AND, OR, XOR, DST_AND_NOT_SRC, SRC_AND_NOT_DST };
+
+/**
+ * \brief Gray raster operations having vectorized implementations.
+ *
+ * NONE stands for any other operation.
+ */
+enum class GrayRopKernel {
+  NONE,
+  INVERT_SRC,
+  DST_MINUS_SRC_CLIPPED,
+  SRC_MINUS_DST_CLIPPED,
+  DST_MINUS_SRC_UNCLIPPED,
+  SRC_MINUS_DST_UNCLIPPED,
+  INVERT_DST_MINUS_SRC_CLIPPED,
+  ADD_CLIPPED,
+  ADD_UNCLIPPED,
+  DARKEST,
+  LIGHTEST,
+  RAISE_ABOVE_BACKGROUND,
+  COMBINE_INVERTED
+};
+
+/**
+ * \brief The inner loops of rasterOp() and grayRasterOp() for the most common operations.
+ *
+ * Every kernel has a scalar version and vectorized ones, the best one the CPU
+ * supports being picked at runtime, just like with ScanlineConverter.  All versions
+ * produce identical results.  Vectorized versions use unaligned loads and stores
+ * and finish partial vectors with the scalar code, so any pointers and lengths will do.
+ */
+class RasterOpKernels {
+ public:
+  /**
+   * \brief Returns the kernels for the best SIMD level supported.
+   */
+  static const RasterOpKernels& instance();
+
+  /**
+   * \brief Returns the kernels for the given SIMD level, or for the best
+   *        supported one if the CPU doesn't support the requested level.
+   *
+   * Level SCALAR gives the plain loops rasterOp() and grayRasterOp()
+   * would run for other operations.
+   */
+  static const RasterOpKernels& forLevel(SimdLevel level);
+
+  SimdLevel level() const { return m_level; }
+
+  /**
+   * \brief dst[i] = op(src[i], dst[i]) for \p num_words words.
+   *
+   * \p src and \p dst may either point to the same words or not overlap at all.
+   */
+  void binary(BinaryRopKernel op, const uint32_t* src, uint32_t* dst, int num_words) const {
+    m_binary[static_cast<int>(op) - 1](src, dst, num_words);
+  }
+
+  /**
+   * \brief dst[x] = op(src[x], dst[x]) for \p width pixels.
+   *
+   * \p src and \p dst may either point to the same pixels or not overlap at all.
+   */
+  void gray(GrayRopKernel op, const uint8_t* src, uint8_t* dst, int width) const {
+    m_gray[static_cast<int>(op) - 1](src, dst, width);
+  }
+
+ private:
+  typedef void (*BinaryFunc)(const uint32_t* src, uint32_t* dst, int num_words);
+  typedef void (*GrayFunc)(const uint8_t* src, uint8_t* dst, int width);
+
+  // NONE has no kernel.
+  static const int NUM_BINARY_KERNELS = static_cast<int>(BinaryRopKernel::SRC_AND_NOT_DST);
+  static const int NUM_GRAY_KERNELS = static_cast<int>(GrayRopKernel::COMBINE_INVERTED);
+
+  explicit RasterOpKernels(SimdLevel level);
+
+  SimdLevel m_level;
+  BinaryFunc m_binary[NUM_BINARY_KERNELS];
+  GrayFunc m_gray[NUM_GRAY_KERNELS];
+};
+}  // namespace imageproc
+
+#endif  // SCANTAILOR_RASTEROPKERNELS_H
@@ -20,13 +20,29 @@
  */
 
 #include "SEDM.h"
+#include <algorithm>
 #include "BinaryImage.h"
 #include "ConnectivityMap.h"
 #include "Morphology.h"
+#include "ParallelFor.h"
 #include "RasterOp.h"
 #include "SeedFill.h"
 
 namespace imageproc {
+namespace {
+/**
+ * The number of adjacent columns the column passes process together.
+ * Walking such a block row by row touches memory sequentially, unlike
+ * walking the columns one by one.
+ */
+const int COLUMN_BLOCK = 64;
+
+/**
+ * The number of rows a single task of the row passes processes.
+ */
+const int ROW_GRAIN = 32;
+}  // namespace
+
 // Note that -1 is an implementation detail.
 // It exists to make sure INF_DIST + 1 doesn't overflow.
 const uint32_t SEDM::INF_DIST = ~uint32_t(0) - 1;
@@ -193,173 +209,185 @@ inline uint32_t SEDM::distSq(const int x1, const int x2, const uint32_t dy_sq) {
 void SEDM::processColumns() {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
+  uint32_t* const data = &m_data[0];
 
-  uint32_t* p_sqd = &m_data[0];
-  for (int x = 0; x < width; ++x, ++p_sqd) {
+  parallelFor(0, width, COLUMN_BLOCK, [data, width, height](const int begin, const int end) {
+    const int block_width = end - begin;
     // (d + 1)^2 = d^2 + 2d + 1
-    uint32_t b = 1;  // 2d + 1 in the above formula.
+    uint32_t b[COLUMN_BLOCK];  // 2d + 1 in the above formula, for each column.
+
+    std::fill(b, b + block_width, 1);
+    uint32_t* line = data + begin;
     for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *p_sqd + b;
-      p_sqd += width;
-      if (*p_sqd > sqd) {
-        *p_sqd = sqd;
-        b += 2;
-      } else {
-        b = 1;
+      uint32_t* const next_line = line + width;
+      for (int i = 0; i < block_width; ++i) {
+        const uint32_t sqd = line[i] + b[i];
+        if (next_line[i] > sqd) {
+          next_line[i] = sqd;
+          b[i] += 2;
+        } else {
+          b[i] = 1;
+        }
       }
+      line = next_line;
     }
 
-    b = 1;
+    std::fill(b, b + block_width, 1);
     for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *p_sqd + b;
-      p_sqd -= width;
-      if (*p_sqd > sqd) {
-        *p_sqd = sqd;
-        b += 2;
-      } else {
-        b = 1;
+      uint32_t* const prev_line = line - width;
+      for (int i = 0; i < block_width; ++i) {
+        const uint32_t sqd = line[i] + b[i];
+        if (prev_line[i] > sqd) {
+          prev_line[i] = sqd;
+          b[i] += 2;
+        } else {
+          b[i] = 1;
+        }
       }
+      line = prev_line;
     }
-  }
+  });
 }  // SEDM::processColumns
 
 void SEDM::processColumns(ConnectivityMap& cmap) {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
+  uint32_t* const data = &m_data[0];
+  uint32_t* const labels = cmap.paddedData();
 
-  uint32_t* p_sqd = &m_data[0];
-  uint32_t* p_label = cmap.paddedData();
-  for (int x = 0; x < width; ++x, ++p_sqd, ++p_label) {
+  parallelFor(0, width, COLUMN_BLOCK, [data, labels, width, height](const int begin, const int end) {
+    const int block_width = end - begin;
     // (d + 1)^2 = d^2 + 2d + 1
-    uint32_t b = 1;  // 2d + 1 in the above formula.
+    uint32_t b[COLUMN_BLOCK];  // 2d + 1 in the above formula, for each column.
+
+    std::fill(b, b + block_width, 1);
+    uint32_t* line = data + begin;
+    uint32_t* label_line = labels + begin;
     for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *p_sqd + b;
-      p_sqd += width;
-      p_label += width;
-      if (sqd < *p_sqd) {
-        *p_sqd = sqd;
-        *p_label = p_label[-width];
-        b += 2;
-      } else {
-        b = 1;
+      uint32_t* const next_line = line + width;
+      uint32_t* const next_label_line = label_line + width;
+      for (int i = 0; i < block_width; ++i) {
+        const uint32_t sqd = line[i] + b[i];
+        if (sqd < next_line[i]) {
+          next_line[i] = sqd;
+          next_label_line[i] = label_line[i];
+          b[i] += 2;
+        } else {
+          b[i] = 1;
+        }
       }
+      line = next_line;
+      label_line = next_label_line;
     }
 
-    b = 1;
+    std::fill(b, b + block_width, 1);
     for (int todo = height - 1; todo > 0; --todo) {
-      const uint32_t sqd = *p_sqd + b;
-      p_sqd -= width;
-      p_label -= width;
-      if (sqd < *p_sqd) {
-        *p_sqd = sqd;
-        *p_label = p_label[width];
-        b += 2;
-      } else {
-        b = 1;
+      uint32_t* const prev_line = line - width;
+      uint32_t* const prev_label_line = label_line - width;
+      for (int i = 0; i < block_width; ++i) {
+        const uint32_t sqd = line[i] + b[i];
+        if (sqd < prev_line[i]) {
+          prev_line[i] = sqd;
+          prev_label_line[i] = label_line[i];
+          b[i] += 2;
+        } else {
+          b[i] = 1;
+        }
       }
+      line = prev_line;
+      label_line = prev_label_line;
     }
-  }
+  });
 }  // SEDM::processColumns
 
 void SEDM::processRows() {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
+  uint32_t* const data = &m_data[0];
 
-  std::vector<int> s(width, 0);
-  std::vector<int> t(width, 0);
-  std::vector<uint32_t> row_copy(width, 0);
-
-  uint32_t* line = &m_data[0];
-  for (int y = 0; y < height; ++y, line += width) {
-    int q = 0;
-    s[0] = 0;
-    t[0] = 0;
-    for (int x = 1; x < width; ++x) {
-      while (q >= 0 && distSq(t[q], s[q], line[s[q]]) > distSq(t[q], x, line[x])) {
-        --q;
-      }
+  parallelFor(0, height, ROW_GRAIN, [data, width](const int begin, const int end) {
+    std::vector<int> s(width, 0);
+    std::vector<int> t(width, 0);
+    std::vector<uint32_t> row_copy(width, 0);
 
-      if (q < 0) {
-        q = 0;
-        s[0] = x;
-      } else {
-        const int x2 = s[q];
-        if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
-          int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-          w /= (x - x2) << 1;
-          ++w;
-          if ((unsigned) w < (unsigned) width) {
-            ++q;
-            s[q] = x;
-            t[q] = w;
-          }
-        }
-      }
-    }
+    uint32_t* line = data + begin * width;
+    for (int y = begin; y < end; ++y, line += width) {
+      const int q = findLowerEnvelope(line, width, &s[0], &t[0]);
 
-    memcpy(&row_copy[0], line, width * sizeof(*line));
+      memcpy(&row_copy[0], line, width * sizeof(*line));
 
-    for (int x = width - 1; x >= 0; --x) {
-      const int x2 = s[q];
-      line[x] = distSq(x, x2, row_copy[x2]);
-      if (x == t[q]) {
-        --q;
+      for (int x = width - 1, qq = q; x >= 0; --x) {
+        const int x2 = s[qq];
+        line[x] = distSq(x, x2, row_copy[x2]);
+        if (x == t[qq]) {
+          --qq;
+        }
       }
     }
-  }
+  });
 }  // SEDM::processRows
 
 void SEDM::processRows(ConnectivityMap& cmap) {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
-
-  std::vector<int> s(width, 0);
-  std::vector<int> t(width, 0);
-  std::vector<uint32_t> row_copy(width, 0);
-  std::vector<uint32_t> cmap_row_copy(width, 0);
-
-  uint32_t* line = &m_data[0];
-  uint32_t* cmap_line = cmap.paddedData();
-  for (int y = 0; y < height; ++y, line += width, cmap_line += width) {
-    int q = 0;
-    s[0] = 0;
-    t[0] = 0;
-    for (int x = 1; x < width; ++x) {
-      while (q >= 0 && distSq(t[q], s[q], line[s[q]]) > distSq(t[q], x, line[x])) {
-        --q;
-      }
-
-      if (q < 0) {
-        q = 0;
-        s[0] = x;
-      } else {
-        const int x2 = s[q];
-        if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
-          int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-          w /= (x - x2) << 1;
-          ++w;
-          if ((unsigned) w < (unsigned) width) {
-            ++q;
-            s[q] = x;
-            t[q] = w;
-          }
+  uint32_t* const data = &m_data[0];
+  uint32_t* const labels = cmap.paddedData();
+
+  parallelFor(0, height, ROW_GRAIN, [data, labels, width](const int begin, const int end) {
+    std::vector<int> s(width, 0);
+    std::vector<int> t(width, 0);
+    std::vector<uint32_t> row_copy(width, 0);
+    std::vector<uint32_t> cmap_row_copy(width, 0);
+
+    uint32_t* line = data + begin * width;
+    uint32_t* cmap_line = labels + begin * width;
+    for (int y = begin; y < end; ++y, line += width, cmap_line += width) {
+      const int q = findLowerEnvelope(line, width, &s[0], &t[0]);
+
+      memcpy(&row_copy[0], line, width * sizeof(*line));
+      memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
+
+      for (int x = width - 1, qq = q; x >= 0; --x) {
+        const int x2 = s[qq];
+        line[x] = distSq(x, x2, row_copy[x2]);
+        cmap_line[x] = cmap_row_copy[x2];
+        if (x == t[qq]) {
+          --qq;
         }
       }
     }
+  });
+}  // SEDM::processRows
 
-    memcpy(&row_copy[0], line, width * sizeof(*line));
-    memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
+int SEDM::findLowerEnvelope(const uint32_t* line, const int width, int* s, int* t) {
+  int q = 0;
+  s[0] = 0;
+  t[0] = 0;
+  for (int x = 1; x < width; ++x) {
+    while (q >= 0 && distSq(t[q], s[q], line[s[q]]) > distSq(t[q], x, line[x])) {
+      --q;
+    }
 
-    for (int x = width - 1; x >= 0; --x) {
+    if (q < 0) {
+      q = 0;
+      s[0] = x;
+    } else {
       const int x2 = s[q];
-      line[x] = distSq(x, x2, row_copy[x2]);
-      cmap_line[x] = cmap_row_copy[x2];
-      if (x == t[q]) {
-        --q;
+      if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
+        int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+        w /= (x - x2) << 1;
+        ++w;
+        if ((unsigned) w < (unsigned) width) {
+          ++q;
+          s[q] = x;
+          t[q] = w;
+        }
       }
     }
   }
-}  // SEDM::processRows
+
+  return q;
+}
 
 /*====================== Peak finding stuff goes below ====================*/
 
@@ -408,59 +436,48 @@ void SEDM::max3x1(const uint32_t* src, uint32_t* dst) const {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
 
-  const uint32_t* src_line = &src[0];
-  uint32_t* dst_line = &dst[0];
+  parallelFor(0, height, ROW_GRAIN, [src, dst, width](const int begin, const int end) {
+    const uint32_t* src_line = src + begin * width;
+    uint32_t* dst_line = dst + begin * width;
 
-  for (int y = 0; y < height; ++y) {
-    // First column (no left neighbors).
-    int x = 0;
-    dst_line[x] = std::max(src_line[x], src_line[x + 1]);
-
-    for (++x; x < width - 1; ++x) {
-      const uint32_t prev = src_line[x - 1];
-      const uint32_t cur = src_line[x];
-      const uint32_t next = src_line[x + 1];
-      dst_line[x] = std::max(prev, std::max(cur, next));
-    }
+    for (int y = begin; y < end; ++y) {
+      // First column (no left neighbors).
+      int x = 0;
+      dst_line[x] = std::max(src_line[x], src_line[x + 1]);
 
-    // Last column (no right neighbors).
-    dst_line[x] = std::max(src_line[x], src_line[x - 1]);
+      for (++x; x < width - 1; ++x) {
+        const uint32_t prev = src_line[x - 1];
+        const uint32_t cur = src_line[x];
+        const uint32_t next = src_line[x + 1];
+        dst_line[x] = std::max(prev, std::max(cur, next));
+      }
 
-    src_line += width;
-    dst_line += width;
-  }
+      // Last column (no right neighbors).
+      dst_line[x] = std::max(src_line[x], src_line[x - 1]);
+
+      src_line += width;
+      dst_line += width;
+    }
+  });
 }
 
 void SEDM::max1x3(const uint32_t* src, uint32_t* dst) const {
   const int width = m_size.width() + 2;
   const int height = m_size.height() + 2;
-  // First row (no top neighbors).
-  const uint32_t* p_src = &src[0];
-  uint32_t* p_dst = &dst[0];
-  for (int x = 0; x < width; ++x) {
-    *p_dst = std::max(p_src[0], p_src[width]);
-    ++p_src;
-    ++p_dst;
-  }
-
-  for (int y = 1; y < height - 1; ++y) {
-    for (int x = 0; x < width; ++x) {
-      const uint32_t prev = p_src[x - width];
-      const uint32_t cur = p_src[x];
-      const uint32_t next = p_src[x + width];
-      p_dst[x] = std::max(prev, std::max(cur, next));
-    }
 
-    p_src += width;
-    p_dst += width;
-  }
+  parallelFor(0, height, ROW_GRAIN, [src, dst, width, height](const int begin, const int end) {
+    for (int y = begin; y < end; ++y) {
+      const uint32_t* src_line = src + y * width;
+      uint32_t* dst_line = dst + y * width;
+      // The first and the last rows have no top and bottom neighbors respectively.
+      const uint32_t* prev_line = (y > 0) ? src_line - width : src_line;
+      const uint32_t* next_line = (y < height - 1) ? src_line + width : src_line;
 
-  // Last row (no bottom neighbors).
-  for (int x = 0; x < width; ++x) {
-    *p_dst = std::max(p_src[0], p_src[-width]);
-    ++p_src;
-    ++p_dst;
-  }
+      for (int x = 0; x < width; ++x) {
+        dst_line[x] = std::max(prev_line[x], std::max(src_line[x], next_line[x]));
+      }
+    }
+  });
 }
 
 void SEDM::incrementMaskedPadded(const BinaryImage& mask) {
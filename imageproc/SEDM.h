@@ -178,6 +178,12 @@ class SEDM {
 
   void processRows(ConnectivityMap& cmap);
 
+  /**
+   * Computes the lower envelope of parabolas for a single row.
+   * Returns the index of the last parabola in \p s and \p t.
+   */
+  static int findLowerEnvelope(const uint32_t* line, int width, int* s, int* t);
+
   BinaryImage findPeakCandidatesNonPadded() const;
 
   BinaryImage buildEqualMapNonPadded(const uint32_t* src1, const uint32_t* src2) const;
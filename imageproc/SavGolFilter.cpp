@@ -17,33 +17,120 @@
  */
 
 #include "SavGolFilter.h"
+#include <QImage>
+#include <QPoint>
+#include <QSize>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
 #include "Grayscale.h"
+#include "ImageBufferAllocator.h"
+#include "ParallelFor.h"
 #include "SavGolKernel.h"
 
 namespace imageproc {
 namespace {
+/**
+ * Output rows processed by a single parallelFor() chunk.  Each chunk
+ * recomputes the horizontal pass for window_height - 1 rows around it.
+ */
+const int ROW_GRAIN = 64;
+
 int calcNumTerms(const int hor_degree, const int vert_degree) {
   return (hor_degree + 1) * (vert_degree + 1);
 }
 
-class Kernel : public SavGolKernel {
+/**
+ * \brief All the kernels needed to filter an image with a particular
+ *        window size and polynomial degrees.
+ *
+ * Calculating kernels involves a QR factorization and a back-substitution
+ * per origin, so they are computed once and shared between calls.
+ */
+class KernelSet {
  public:
-  Kernel(const QSize& size, const QPoint& origin, int hor_degree, int vert_degree)
-      : SavGolKernel(size, origin, hor_degree, vert_degree) {}
+  KernelSet(const QSize& window_size, int hor_degree, int vert_degree);
+
+  int width() const { return m_width; }
 
-  void convolve(uint8_t* dst, const uint8_t* src_top_left, int src_bpl) const;
+  int height() const { return m_height; }
+
+  /**
+   * \brief The 2D kernel producing the value at \p origin within the window.
+   */
+  const float* kernelForOrigin(const QPoint& origin) const {
+    return m_kernels.data() + (origin.y() * m_width + origin.x()) * m_width * m_height;
+  }
+
+  /**
+   * \brief The horizontal part of the kernel centered within the window.
+   */
+  const float* horKernel() const { return m_horKernel.data(); }
+
+  /**
+   * \brief The vertical part of the kernel centered within the window.
+   */
+  const float* vertKernel() const { return m_vertKernel.data(); }
+
+ private:
+  int m_width;
+  int m_height;
+  std::vector<float> m_kernels;
+  std::vector<float> m_horKernel;
+  std::vector<float> m_vertKernel;
 };
 
 
-inline void Kernel::convolve(uint8_t* dst, const uint8_t* src_top_left, int src_bpl) const {
+KernelSet::KernelSet(const QSize& window_size, const int hor_degree, const int vert_degree)
+    : m_width(window_size.width()), m_height(window_size.height()) {
+  const int kernel_size = m_width * m_height;
+
+  SavGolKernel kernel(window_size, QPoint(0, 0), hor_degree, vert_degree);
+  m_kernels.reserve(kernel_size * kernel_size);
+  for (int y = 0; y < m_height; ++y) {
+    for (int x = 0; x < m_width; ++x) {
+      kernel.recalcForOrigin(QPoint(x, y));
+      m_kernels.insert(m_kernels.end(), kernel.data(), kernel.data() + kernel_size);
+    }
+  }
+
+  const SavGolKernel hor_kernel(QSize(m_width, 1), QPoint(m_width / 2, 0), hor_degree, 0);
+  m_horKernel.assign(hor_kernel.data(), hor_kernel.data() + m_width);
+
+  const SavGolKernel vert_kernel(QSize(1, m_height), QPoint(0, m_height / 2), 0, vert_degree);
+  m_vertKernel.assign(vert_kernel.data(), vert_kernel.data() + m_height);
+}
+
+std::shared_ptr<const KernelSet> cachedKernelSet(const QSize& window_size,
+                                                 const int hor_degree,
+                                                 const int vert_degree) {
+  typedef std::tuple<int, int, int, int> Key;
+
+  static std::mutex mutex;
+  static std::map<Key, std::shared_ptr<const KernelSet>> cache;
+
+  const Key key(window_size.width(), window_size.height(), hor_degree, vert_degree);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<const KernelSet>& kernel_set = cache[key];
+  if (!kernel_set) {
+    kernel_set = std::make_shared<KernelSet>(window_size, hor_degree, vert_degree);
+  }
+
+  return kernel_set;
+}
+
+inline void convolve(uint8_t* dst, const uint8_t* src_top_left, int src_bpl, const float* kernel, int kw, int kh) {
   const uint8_t* p_src = src_top_left;
-  const float* p_kernel = data();
+  const float* p_kernel = kernel;
   float sum = 0.5;  // For rounding purposes.
-  const int w = width();
-  const int h = height();
 
-  for (int y = 0; y < h; ++y, p_src += src_bpl) {
-    for (int x = 0; x < w; ++x) {
+  for (int y = 0; y < kh; ++y, p_src += src_bpl) {
+    for (int x = 0; x < kw; ++x) {
       sum += p_src[x] * *p_kernel;
       ++p_kernel;
     }
@@ -53,6 +140,82 @@ inline void Kernel::convolve(uint8_t* dst, const uint8_t* src_top_left, int src_
   *dst = static_cast<uint8_t>(qBound(0, val, 255));
 }
 
+/**
+ * \brief Filters the rows where the whole window fits the image vertically,
+ *        skipping the columns where it doesn't fit horizontally.
+ *
+ * Takes advantage of the Savitzky-Golay filter being separable.
+ * Both passes run over a whole line for every kernel element,
+ * so that they vectorize well.
+ */
+void filterCentralArea(const uint8_t* const src_data,
+                       const int src_bpl,
+                       uint8_t* const dst_data,
+                       const int dst_bpl,
+                       const int width,
+                       const int height,
+                       const KernelSet& kernels) {
+  const int kw = kernels.width();
+  const int kh = kernels.height();
+  const int k_top = kh / 2;
+  const int k_bottom = kh - k_top - 1;
+  const int k_left = kw / 2;
+  const float* const hor_kernel = kernels.horKernel();
+  const float* const vert_kernel = kernels.vertKernel();
+
+  // The number of pixels the horizontal pass produces per line.
+  const int temp_width = width - (kw - 1);
+
+  parallelFor(k_top, height - k_bottom, ROW_GRAIN, [&](const int begin, const int end) {
+    // The results of the horizontal pass for the last kh lines.
+    // Line y goes to slot y % kh.
+    std::vector<float> temp(temp_width * kh);
+    std::vector<float> sums(temp_width);
+
+    const auto horizontal_pass = [&](const int y) {
+      const uint8_t* const src_line = src_data + y * src_bpl;
+      float* const temp_line = temp.data() + (y % kh) * temp_width;
+      for (int x = 0; x < temp_width; ++x) {
+        temp_line[x] = src_line[x] * hor_kernel[0];
+      }
+      for (int j = 1; j < kw; ++j) {
+        const uint8_t* const src = src_line + j;
+        const float k = hor_kernel[j];
+        for (int x = 0; x < temp_width; ++x) {
+          temp_line[x] += src[x] * k;
+        }
+      }
+    };
+
+    for (int y = begin - k_top; y < begin + k_bottom; ++y) {
+      horizontal_pass(y);
+    }
+
+    for (int y = begin; y < end; ++y) {
+      horizontal_pass(y + k_bottom);
+
+      // Vertical pass.
+      const float* temp_line = temp.data() + ((y - k_top) % kh) * temp_width;
+      for (int x = 0; x < temp_width; ++x) {
+        sums[x] = temp_line[x] * vert_kernel[0];
+      }
+      for (int j = 1; j < kh; ++j) {
+        temp_line = temp.data() + ((y - k_top + j) % kh) * temp_width;
+        const float k = vert_kernel[j];
+        for (int x = 0; x < temp_width; ++x) {
+          sums[x] += temp_line[x] * k;
+        }
+      }
+
+      uint8_t* const dst_line = dst_data + y * dst_bpl + k_left;
+      for (int x = 0; x < temp_width; ++x) {
+        const auto val = static_cast<int>(sums[x]);
+        dst_line[x] = static_cast<uint8_t>(qBound(0, val, 255));
+      }
+    }
+  });
+}  // filterCentralArea
+
 QImage savGolFilterGrayToGray(const QImage& src,
                               const QSize& window_size,
                               const int hor_degree,
@@ -68,6 +231,8 @@ QImage savGolFilterGrayToGray(const QImage& src,
     return src;
   }
 
+  const std::shared_ptr<const KernelSet> kernels(cachedKernelSet(window_size, hor_degree, vert_degree));
+
   /*
    * Consider a 5x5 kernel:
    * |x|x|T|x|x|
@@ -100,7 +265,7 @@ QImage savGolFilterGrayToGray(const QImage& src,
   const uint8_t* const src_data = src.bits();
   const int src_bpl = src.bytesPerLine();
 
-  QImage dst(width, height, QImage::Format_Indexed8);
+  QImage dst(ImageBufferAllocator::createIndexed8Image(QSize(width, height)));
   dst.setColorTable(createGrayscalePalette());
   if ((width > 0) && (height > 0) && dst.isNull()) {
     throw std::bad_alloc();
@@ -111,13 +276,11 @@ QImage savGolFilterGrayToGray(const QImage& src,
   // Top-left corner.
   const uint8_t* src_line = src_data;
   uint8_t* dst_line = dst_data;
-  Kernel kernel(window_size, QPoint(0, 0), hor_degree, vert_degree);
   for (int y = 0; y < k_top; ++y, dst_line += dst_bpl) {
     k_origin.setY(y);
     for (int x = 0; x < k_left; ++x) {
       k_origin.setX(x);
-      kernel.recalcForOrigin(k_origin);
-      kernel.convolve(dst_line + x, src_line, src_bpl);
+      convolve(dst_line + x, src_line, src_bpl, kernels->kernelForOrigin(k_origin), kw, kh);
     }
   }
 
@@ -127,9 +290,9 @@ QImage savGolFilterGrayToGray(const QImage& src,
   dst_line = dst_data;
   for (int y = 0; y < k_top; ++y, dst_line += dst_bpl) {
     k_origin.setY(y);
-    kernel.recalcForOrigin(k_origin);
+    const float* const kernel = kernels->kernelForOrigin(k_origin);
     for (int x = k_left; x < width - k_right; ++x) {
-      kernel.convolve(dst_line + x, src_line + x, src_bpl);
+      convolve(dst_line + x, src_line + x, src_bpl, kernel, kw, kh);
     }
   }
   // Top-right corner.
@@ -139,82 +302,26 @@ QImage savGolFilterGrayToGray(const QImage& src,
   for (int y = 0; y < k_top; ++y, dst_line += dst_bpl) {
     k_origin.setX(k_center.x() + 1);
     for (int x = width - k_right; x < width; ++x) {
-      kernel.recalcForOrigin(k_origin);
-      kernel.convolve(dst_line + x, src_line, src_bpl);
+      convolve(dst_line + x, src_line, src_bpl, kernels->kernelForOrigin(k_origin), kw, kh);
       k_origin.rx() += 1;
     }
     k_origin.ry() += 1;
   }
-  // Central area.
-#if 0
-            // Simple but slow implementation.
-                    kernel.recalcForOrigin(k_center);
-                    src_line = src_data - k_left;
-                    dst_line = dst_data + dst_bpl * k_top;
-                    for (int y = k_top; y < height - k_bottom; ++y) {
-                        for (int x = k_left; x < width - k_right; ++x) {
-                            kernel.convolve(dst_line + x, src_line + x, src_bpl);
-                        }
-                        src_line += src_bpl;
-                        dst_line += dst_bpl;
-                    }
-#else
-  // Take advantage of Savitzky-Golay filter being separable.
-  const SavGolKernel hor_kernel(QSize(window_size.width(), 1), QPoint(k_center.x(), 0), hor_degree, 0);
-  const SavGolKernel vert_kernel(QSize(1, window_size.height()), QPoint(0, k_center.y()), 0, vert_degree);
-
-  const int shift = kw - 1;
-
-  // Allocate a 16-byte aligned temporary storage.
-  // That may help the compiler to emit efficient SSE code.
-  const int temp_stride = (width - shift + 3) & ~3;
-  AlignedArray<float, 4> temp_array(temp_stride * height);
-  // Horizontal pass.
-  src_line = src_data - shift;
-  float* temp_line = temp_array.data() - shift;
-  for (int y = 0; y < height; ++y) {
-    for (int i = shift; i < width; ++i) {
-      float sum = 0.0f;
-
-      const uint8_t* src = src_line + i;
-      for (int j = 0; j < kw; ++j) {
-        sum += src[j] * hor_kernel[j];
-      }
-      temp_line[i] = sum;
-    }
-    temp_line += temp_stride;
-    src_line += src_bpl;
-  }
-  // Vertical pass.
-  dst_line = dst_data + k_top * dst_bpl + k_left - shift;
-  temp_line = temp_array.data() - shift;
-  for (int y = k_top; y < height - k_bottom; ++y) {
-    for (int i = shift; i < width; ++i) {
-      float sum = 0.0f;
-
-      float* tmp = temp_line + i;
-      for (int j = 0; j < kh; ++j, tmp += temp_stride) {
-        sum += *tmp * vert_kernel[j];
-      }
-      const auto val = static_cast<int>(sum);
-      dst_line[i] = static_cast<uint8_t>(qBound(0, val, 255));
-    }
 
-    temp_line += temp_stride;
-    dst_line += dst_bpl;
-  }
-#endif  // if 0
+  // Central area.
+  filterCentralArea(src_data, src_bpl, dst_data, dst_bpl, width, height, *kernels);
 
   // Left area between two corners.
   k_origin.setX(0);
-  k_origin.setY(k_center.y() + 1);
+  // Stay within the window for window heights below 3.
+  k_origin.setY(std::min(k_center.y() + 1, kh - 1));
   for (int x = 0; x < k_left; ++x) {
     src_line = src_data;
     dst_line = dst_data + dst_bpl * k_top;
 
-    kernel.recalcForOrigin(k_origin);
+    const float* const kernel = kernels->kernelForOrigin(k_origin);
     for (int y = k_top; y < height - k_bottom; ++y) {
-      kernel.convolve(dst_line + x, src_line, src_bpl);
+      convolve(dst_line + x, src_line, src_bpl, kernel, kw, kh);
       src_line += src_bpl;
       dst_line += dst_bpl;
     }
@@ -227,9 +334,9 @@ QImage savGolFilterGrayToGray(const QImage& src,
     src_line = src_data + width - kw;
     dst_line = dst_data + dst_bpl * k_top;
 
-    kernel.recalcForOrigin(k_origin);
+    const float* const kernel = kernels->kernelForOrigin(k_origin);
     for (int y = k_top; y < height - k_bottom; ++y) {
-      kernel.convolve(dst_line + x, src_line, src_bpl);
+      convolve(dst_line + x, src_line, src_bpl, kernel, kw, kh);
       src_line += src_bpl;
       dst_line += dst_bpl;
     }
@@ -243,8 +350,7 @@ QImage savGolFilterGrayToGray(const QImage& src,
   for (int y = height - k_bottom; y < height; ++y, dst_line += dst_bpl) {
     for (int x = 0; x < k_left; ++x) {
       k_origin.setX(x);
-      kernel.recalcForOrigin(k_origin);
-      kernel.convolve(dst_line + x, src_line, src_bpl);
+      convolve(dst_line + x, src_line, src_bpl, kernels->kernelForOrigin(k_origin), kw, kh);
     }
     k_origin.ry() += 1;
   }
@@ -255,9 +361,9 @@ QImage savGolFilterGrayToGray(const QImage& src,
   src_line = src_data + src_bpl * (height - kh) - k_left;
   dst_line = dst_data + dst_bpl * (height - k_bottom);
   for (int y = height - k_bottom; y < height; ++y, dst_line += dst_bpl) {
-    kernel.recalcForOrigin(k_origin);
+    const float* const kernel = kernels->kernelForOrigin(k_origin);
     for (int x = k_left; x < width - k_right; ++x) {
-      kernel.convolve(dst_line + x, src_line + x, src_bpl);
+      convolve(dst_line + x, src_line + x, src_bpl, kernel, kw, kh);
     }
     k_origin.ry() += 1;
   }
@@ -268,8 +374,7 @@ QImage savGolFilterGrayToGray(const QImage& src,
   for (int y = height - k_bottom; y < height; ++y, dst_line += dst_bpl) {
     k_origin.setX(k_center.x() + 1);
     for (int x = width - k_right; x < width; ++x) {
-      kernel.recalcForOrigin(k_origin);
-      kernel.convolve(dst_line + x, src_line, src_bpl);
+      convolve(dst_line + x, src_line, src_bpl, kernels->kernelForOrigin(k_origin), kw, kh);
       k_origin.rx() += 1;
     }
     k_origin.ry() += 1;
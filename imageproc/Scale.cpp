@@ -17,59 +17,17 @@
  */
 
 #include "Scale.h"
+#include <QImage>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "BadAllocIfNull.h"
 #include "GrayImage.h"
+#include "ParallelFor.h"
 
 namespace imageproc {
-/**
- * This is an optimized implementation for the case when every destination
- * pixel maps exactly to a M x N block of source pixels.
- */
-static GrayImage scaleDownIntGrayToGray(const GrayImage& src, const QSize& dst_size) {
-  const int sw = src.width();
-  const int sh = src.height();
-  const int dw = dst_size.width();
-  const int dh = dst_size.height();
-
-  const int xscale = sw / dw;
-  const int yscale = sh / dh;
-  const int total_area = xscale * yscale;
-
-  GrayImage dst(dst_size);
-
-  const uint8_t* src_line = src.data();
-  uint8_t* dst_line = dst.data();
-  const int src_stride = src.stride();
-  const int src_stride_scaled = src_stride * yscale;
-  const int dst_stride = dst.stride();
-
-  int sy = 0;
-  int dy = 0;
-  for (; dy < dh; ++dy, sy += yscale) {
-    int sx = 0;
-    int dx = 0;
-    for (; dx < dw; ++dx, sx += xscale) {
-      unsigned gray_level = 0;
-      const uint8_t* psrc = src_line + sx;
-
-      for (int i = 0; i < yscale; ++i, psrc += src_stride) {
-        for (int j = 0; j < xscale; ++j) {
-          gray_level += psrc[j];
-        }
-      }
-
-      const unsigned pix_value = (gray_level + (total_area >> 1)) / total_area;
-      assert(pix_value < 256);
-      dst_line[dx] = static_cast<uint8_t>(pix_value);
-    }
-
-    src_line += src_stride_scaled;
-    dst_line += dst_stride;
-  }
-
-  return dst;
-}  // scaleDownIntGrayToGray
-
 /**
  * This is an optimized implementation for the case when every destination
  * pixel maps to a single source pixel (possibly to a part of it).
@@ -212,153 +170,237 @@ static double calc32xRatio2(const int dst, const int src) {
   return ratio;
 }
 
+namespace {
 /**
- * This is a generic implementation of the scaling algorithm.
+ * Rows processed by a single parallelFor() chunk.
  */
-static GrayImage scaleGrayToGray(const GrayImage& src, const QSize& dst_size) {
-  const int sw = src.width();
-  const int sh = src.height();
-  const int dw = dst_size.width();
-  const int dh = dst_size.height();
+const int ROW_GRAIN = 16;
 
-  // Try versions optimized for a particular case.
-  if ((sw == dw) && (sh == dh)) {
-    return src;
-  } else if ((sw % dw == 0) && (sh % dh == 0)) {
-    return scaleDownIntGrayToGray(src, dst_size);
-  } else if ((dw % sw == 0) && (dh % sh == 0)) {
-    return scaleUpIntGrayToGray(src, dst_size);
-  } else if ((dw > sw) && (dh > sh)) {
-    return scaleUpGrayToGray(src, dst_size);
+/**
+ * \brief The range of source pixels a destination pixel maps to along one axis.
+ *
+ * Weights are in 1/32 pixel units.  Pixels strictly between the first
+ * and the last one have the weight of 32.  If first == last, lastWeight
+ * is not used and firstWeight equals total.
+ */
+struct AreaSpan {
+  int first;
+  int last;
+  unsigned firstWeight;
+  unsigned lastWeight;
+  unsigned total;
+};
+
+std::vector<AreaSpan> calcAreaSpans(const int dst_len, const int src_len) {
+  const double d2s32 = calc32xRatio2(dst_len, src_len);
+
+  std::vector<AreaSpan> spans(dst_len);
+  int s32end = 0;
+  for (int d = 0; d < dst_len; ++d) {
+    const int s32begin = s32end;
+    s32end = (int) ((d + 1) * d2s32);
+
+    AreaSpan& span = spans[d];
+    span.first = s32begin >> 5;
+    span.last = (s32end - 1) >> 5;
+    assert(span.last < src_len);  // calc32xRatio2() ensures that.
+    span.total = s32end - s32begin;
+    if (span.first == span.last) {
+      span.firstWeight = span.total;
+      span.lastWeight = 0;
+    } else {
+      span.firstWeight = 32 - (s32begin & 31);
+      span.lastWeight = s32end - (span.last << 5);
+    }
   }
 
-  const double dx2sx32 = calc32xRatio2(dw, sw);
-  const double dy2sy32 = calc32xRatio2(dh, sh);
-
-  GrayImage dst(dst_size);
-
-  const uint8_t* const src_data = src.data();
-  uint8_t* dst_line = dst.data();
-  const int src_stride = src.stride();
-  const int dst_stride = dst.stride();
-
-  int sy32bottom = 0;
-  for (int dy1 = 1; dy1 <= dh; ++dy1, dst_line += dst_stride) {
-    const int sy32top = sy32bottom;
-    sy32bottom = (int) (dy1 * dy2sy32);
-    const int sytop = sy32top >> 5;
-    const int sybottom = (sy32bottom - 1) >> 5;
-    const unsigned top_fraction = 32 - (sy32top & 31);
-    const unsigned bottom_fraction = sy32bottom - (sybottom << 5);
-    assert(sybottom < sh);  // calc32xRatio2() ensures that.
-    const unsigned top_area = top_fraction << 5;
-    const unsigned bottom_area = bottom_fraction << 5;
-
-    const uint8_t* const src_line_const = src_data + sytop * src_stride;
-
-    int sx32right = 0;
-    for (int dx = 0; dx < dw; ++dx) {
-      const int sx32left = sx32right;
-      sx32right = (int) ((dx + 1) * dx2sx32);
-      const int sxleft = sx32left >> 5;
-      const int sxright = (sx32right - 1) >> 5;
-      const unsigned left_fraction = 32 - (sx32left & 31);
-      const unsigned right_fraction = sx32right - (sxright << 5);
-      assert(sxright < sw);  // calc32xRatio2() ensures that.
-      const uint8_t* src_line = src_line_const;
-      unsigned gray_level = 0;
-
-      if (sytop == sybottom) {
-        if (sxleft == sxright) {
-          // dst pixel maps to a single src pixel
-          dst_line[dx] = src_line[sxleft];
-          continue;
-        } else {
-          // dst pixel maps to a horizontal line of src pixels
-          const unsigned vert_fraction = sy32bottom - sy32top;
-          const unsigned left_area = vert_fraction * left_fraction;
-          const unsigned middle_area = vert_fraction << 5;
-          const unsigned right_area = vert_fraction * right_fraction;
-
-          gray_level += src_line[sxleft] * left_area;
-
-          for (int sx = sxleft + 1; sx < sxright; ++sx) {
-            gray_level += src_line[sx] * middle_area;
-          }
+  return spans;
+}
 
-          gray_level += src_line[sxright] * right_area;
-        }
-      } else if (sxleft == sxright) {
-        // dst pixel maps to a vertical line of src pixels
-        const unsigned hor_fraction = sx32right - sx32left;
-        const unsigned top_area = hor_fraction * top_fraction;
-        const unsigned middle_area = hor_fraction << 5;
-        const unsigned bottom_area = hor_fraction * bottom_fraction;
+unsigned maxSpanTotal(const std::vector<AreaSpan>& spans) {
+  unsigned max_total = 0;
+  for (const AreaSpan& span : spans) {
+    max_total = std::max(max_total, span.total);
+  }
 
-        gray_level += src_line[sxleft] * top_area;
+  return max_total;
+}
 
+/**
+ * \brief The generic separable area averaging.
+ *
+ * The vertical pass sums up the source lines a destination line maps to,
+ * and the horizontal one sums up the resulting column sums.  Channels
+ * of interleaved pixels are processed independently.
+ *
+ * Column sums are kept in 16 bits when they fit, as that's what makes
+ * the vertical pass vectorize well.
+ */
+template <int Channels, typename ColumnSumType, typename AccumType>
+void scaleByAreaGeneric(const uint8_t* const src_data,
+                        const int src_stride,
+                        const int sw,
+                        uint8_t* const dst_data,
+                        const int dst_stride,
+                        const std::vector<AreaSpan>& h_spans,
+                        const std::vector<AreaSpan>& v_spans) {
+  const int dw = static_cast<int>(h_spans.size());
+  const int row_len = sw * Channels;
+
+  parallelFor(0, static_cast<int>(v_spans.size()), ROW_GRAIN, [&](const int begin, const int end) {
+    std::vector<ColumnSumType> column_sums(row_len);
+    ColumnSumType* const sums = column_sums.data();
+
+    for (int dy = begin; dy < end; ++dy) {
+      const AreaSpan& v_span = v_spans[dy];
+      const uint8_t* src_line = src_data + v_span.first * src_stride;
+
+      const auto first_weight = static_cast<ColumnSumType>(v_span.firstWeight);
+      for (int i = 0; i < row_len; ++i) {
+        sums[i] = static_cast<ColumnSumType>(src_line[i] * first_weight);
+      }
+      for (int sy = v_span.first + 1; sy < v_span.last; ++sy) {
         src_line += src_stride;
-
-        for (int sy = sytop + 1; sy < sybottom; ++sy) {
-          gray_level += src_line[sxleft] * middle_area;
-          src_line += src_stride;
+        for (int i = 0; i < row_len; ++i) {
+          sums[i] += static_cast<ColumnSumType>(src_line[i] << 5);
         }
-
-        gray_level += src_line[sxleft] * bottom_area;
-      } else {
-        // dst pixel maps to a block of src pixels
-        const unsigned left_area = left_fraction << 5;
-        const unsigned right_area = right_fraction << 5;
-        const unsigned topleft_area = top_fraction * left_fraction;
-        const unsigned topright_area = top_fraction * right_fraction;
-        const unsigned bottomleft_area = bottom_fraction * left_fraction;
-        const unsigned bottomright_area = bottom_fraction * right_fraction;
-
-        // process the top-left corner
-        gray_level += src_line[sxleft] * topleft_area;
-
-        // process the top line (without corners)
-        for (int sx = sxleft + 1; sx < sxright; ++sx) {
-          gray_level += src_line[sx] * top_area;
-        }
-
-        // process the top-right corner
-        gray_level += src_line[sxright] * topright_area;
-
+      }
+      if (v_span.last > v_span.first) {
         src_line += src_stride;
-        // process middle lines
-        for (int sy = sytop + 1; sy < sybottom; ++sy) {
-          gray_level += src_line[sxleft] * left_area;
+        const auto last_weight = static_cast<ColumnSumType>(v_span.lastWeight);
+        for (int i = 0; i < row_len; ++i) {
+          sums[i] += static_cast<ColumnSumType>(src_line[i] * last_weight);
+        }
+      }
 
-          for (int sx = sxleft + 1; sx < sxright; ++sx) {
-            gray_level += src_line[sx] << (5 + 5);
+      uint8_t* const dst_line = dst_data + dy * dst_stride;
+      for (int dx = 0; dx < dw; ++dx) {
+        const AreaSpan& h_span = h_spans[dx];
+        const AccumType total_area = static_cast<AccumType>(h_span.total) * v_span.total;
+        for (int c = 0; c < Channels; ++c) {
+          AccumType sum = static_cast<AccumType>(sums[h_span.first * Channels + c]) * h_span.firstWeight;
+          for (int sx = h_span.first + 1; sx < h_span.last; ++sx) {
+            sum += static_cast<AccumType>(sums[sx * Channels + c]) << 5;
+          }
+          if (h_span.last > h_span.first) {
+            sum += static_cast<AccumType>(sums[h_span.last * Channels + c]) * h_span.lastWeight;
           }
 
-          gray_level += src_line[sxright] * right_area;
-
-          src_line += src_stride;
+          const AccumType pix_value = (sum + (total_area >> 1)) / total_area;
+          assert(pix_value < 256);
+          dst_line[dx * Channels + c] = static_cast<uint8_t>(pix_value);
         }
+      }
+    }
+  });
+}  // scaleByAreaGeneric
 
-        // process bottom-left corner
-        gray_level += src_line[sxleft] * bottomleft_area;
-
-        // process the bottom line (without corners)
-        for (int sx = sxleft + 1; sx < sxright; ++sx) {
-          gray_level += src_line[sx] * bottom_area;
+/**
+ * \brief Downscaling by a power of two factor in both directions.
+ *
+ * Gives the same results as scaleByAreaGeneric(), but all the weights
+ * are known to be equal, so sums fit 16 bits and the division is a shift.
+ */
+template <int Factor, int Channels>
+void scaleDownByPow2(const uint8_t* const src_data,
+                     const int src_stride,
+                     uint8_t* const dst_data,
+                     const int dst_stride,
+                     const int dw,
+                     const int dh) {
+  static_assert((Factor & (Factor - 1)) == 0, "Factor must be a power of two");
+  static_assert(Factor * Factor * 255 <= 0xffff, "Sums must fit 16 bits");
+  enum { AREA = Factor * Factor };
+  const int row_len = dw * Factor * Channels;
+
+  parallelFor(0, dh, ROW_GRAIN, [&](const int begin, const int end) {
+    std::vector<uint16_t> column_sums(row_len);
+    uint16_t* const sums = column_sums.data();
+
+    for (int dy = begin; dy < end; ++dy) {
+      const uint8_t* src_line = src_data + dy * Factor * src_stride;
+      for (int i = 0; i < row_len; ++i) {
+        sums[i] = src_line[i];
+      }
+      for (int j = 1; j < Factor; ++j) {
+        src_line += src_stride;
+        for (int i = 0; i < row_len; ++i) {
+          sums[i] += src_line[i];
         }
-        // process the bottom-right corner
-        gray_level += src_line[sxright] * bottomright_area;
       }
 
-      const unsigned total_area = (sy32bottom - sy32top) * (sx32right - sx32left);
-      const unsigned pix_value = (gray_level + (total_area >> 1)) / total_area;
-      assert(pix_value < 256);
-      dst_line[dx] = static_cast<uint8_t>(pix_value);
+      uint8_t* const dst_line = dst_data + dy * dst_stride;
+      for (int dx = 0; dx < dw; ++dx) {
+        const uint16_t* const block = sums + dx * Factor * Channels;
+        for (int c = 0; c < Channels; ++c) {
+          unsigned sum = 0;
+          for (int i = 0; i < Factor; ++i) {
+            sum += block[i * Channels + c];
+          }
+          dst_line[dx * Channels + c] = static_cast<uint8_t>((sum + (AREA >> 1)) / AREA);
+        }
+      }
+    }
+  });
+}  // scaleDownByPow2
+
+template <int Channels>
+void scaleBufferByArea(const uint8_t* const src_data,
+                       const int src_stride,
+                       const int sw,
+                       const int sh,
+                       uint8_t* const dst_data,
+                       const int dst_stride,
+                       const int dw,
+                       const int dh) {
+  if ((sw == dw * 2) && (sh == dh * 2)) {
+    scaleDownByPow2<2, Channels>(src_data, src_stride, dst_data, dst_stride, dw, dh);
+  } else if ((sw == dw * 4) && (sh == dh * 4)) {
+    scaleDownByPow2<4, Channels>(src_data, src_stride, dst_data, dst_stride, dw, dh);
+  } else if ((sw == dw * 8) && (sh == dh * 8)) {
+    scaleDownByPow2<8, Channels>(src_data, src_stride, dst_data, dst_stride, dw, dh);
+  } else {
+    const std::vector<AreaSpan> h_spans(calcAreaSpans(dw, sw));
+    const std::vector<AreaSpan> v_spans(calcAreaSpans(dh, sh));
+    const uint64_t max_column_sum = uint64_t(255) * maxSpanTotal(v_spans);
+    const uint64_t max_sum = max_column_sum * maxSpanTotal(h_spans);
+    if (max_column_sum <= 0xffffu) {
+      scaleByAreaGeneric<Channels, uint16_t, uint32_t>(src_data, src_stride, sw, dst_data, dst_stride, h_spans,
+                                                       v_spans);
+    } else if (max_sum + (max_sum >> 1) <= 0xffffffffu) {
+      scaleByAreaGeneric<Channels, uint32_t, uint32_t>(src_data, src_stride, sw, dst_data, dst_stride, h_spans,
+                                                       v_spans);
+    } else {
+      scaleByAreaGeneric<Channels, uint32_t, uint64_t>(src_data, src_stride, sw, dst_data, dst_stride, h_spans,
+                                                       v_spans);
     }
   }
+}
+}  // namespace
+
+/**
+ * This is a generic implementation of the scaling algorithm.
+ */
+static GrayImage scaleGrayToGray(const GrayImage& src, const QSize& dst_size) {
+  const int sw = src.width();
+  const int sh = src.height();
+  const int dw = dst_size.width();
+  const int dh = dst_size.height();
+
+  // Try versions optimized for a particular case.
+  if ((sw == dw) && (sh == dh)) {
+    return src;
+  } else if ((dw % sw == 0) && (dh % sh == 0)) {
+    return scaleUpIntGrayToGray(src, dst_size);
+  } else if ((dw > sw) && (dh > sh)) {
+    return scaleUpGrayToGray(src, dst_size);
+  }
+
+  GrayImage dst(dst_size);
+  scaleBufferByArea<1>(src.data(), src.stride(), sw, sh, dst.data(), dst.stride(), dw, dh);
 
   return dst;
-}  // scaleGrayToGray
+}
 
 GrayImage scaleToGray(const GrayImage& src, const QSize& dst_size) {
   if (src.isNull()) {
@@ -375,4 +417,60 @@ GrayImage scaleToGray(const GrayImage& src, const QSize& dst_size) {
 
   return scaleGrayToGray(src, dst_size);
 }
-}  // namespace imageproc
\ No newline at end of file
+
+QImage scaleByArea(const QImage& src, const QSize& dst_size) {
+  if (src.isNull()) {
+    return QImage();
+  }
+
+  if (!dst_size.isValid()) {
+    throw std::invalid_argument("scaleByArea: dst_size is invalid");
+  }
+
+  if (dst_size.isEmpty()) {
+    return QImage();
+  }
+
+  // Area averaging only works for downscaling.  Beyond 32x upscaling, a destination
+  // pixel would even map to an empty area, so upscaling is left to Qt.
+  const bool upscaling = (dst_size.width() > src.width()) || (dst_size.height() > src.height());
+
+  QImage dst;
+  const QImage::Format format = src.format();
+  if (((format == QImage::Format_Indexed8) || (format == QImage::Format_Mono) || (format == QImage::Format_MonoLSB))
+      && src.allGray()) {
+    // The palette of src may be non-standard, so we go through a GrayImage,
+    // which is guaranteed to have a standard palette.
+    const GrayImage gray_src(src);
+    if (upscaling) {
+      const QImage scaled(
+          badAllocIfNull(gray_src.toQImage().scaled(dst_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)));
+      dst = GrayImage(scaled).toQImage();
+    } else {
+      GrayImage gray_dst(dst_size);
+      scaleBufferByArea<1>(gray_src.data(), gray_src.stride(), src.width(), src.height(), gray_dst.data(),
+                           gray_dst.stride(), dst_size.width(), dst_size.height());
+      dst = gray_dst.toQImage();
+    }
+  } else {
+    // Channels are averaged independently, which is only correct for
+    // premultiplied alpha.
+    const QImage::Format dst_format
+        = src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    const QImage src_32(badAllocIfNull(src.convertToFormat(dst_format)));
+    if (upscaling) {
+      dst = badAllocIfNull(src_32.scaled(dst_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    } else {
+      dst = QImage(dst_size, dst_format);
+      badAllocIfNull(dst);
+      scaleBufferByArea<4>(src_32.bits(), src_32.bytesPerLine(), src.width(), src.height(), dst.bits(),
+                           dst.bytesPerLine(), dst_size.width(), dst_size.height());
+    }
+  }
+
+  dst.setDotsPerMeterX(qRound((double) src.dotsPerMeterX() * dst_size.width() / src.width()));
+  dst.setDotsPerMeterY(qRound((double) src.dotsPerMeterY() * dst_size.height() / src.height()));
+
+  return dst;
+}
+}  // namespace imageproc
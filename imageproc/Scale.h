@@ -19,6 +19,7 @@
 #ifndef IMAGEPROC_SCALE_H_
 #define IMAGEPROC_SCALE_H_
 
+class QImage;
 class QSize;
 
 namespace imageproc {
@@ -35,5 +36,22 @@ class GrayImage;
  * dealing with grayscale images.
  */
 GrayImage scaleToGray(const GrayImage& src, const QSize& dst_size);
+
+/**
+ * \brief Scales an image to dst_size, averaging the source area
+ *        each destination pixel maps to.
+ *
+ * Unlike transform(), this one only handles axis-aligned scaling,
+ * which makes it a lot faster.  It's meant for downscaling, such as
+ * building previews and thumbnails.  If dst_size is larger than the
+ * source along either axis, QImage::scaled() does the job instead.
+ *
+ * \param src The source image.
+ * \param dst_size The size to scale the image to.
+ * \return The scaled image.  Mono and indexed images with a gray palette
+ *         produce a grayscale image, other images produce Format_RGB32
+ *         or, if they have an alpha channel, Format_ARGB32_Premultiplied.
+ */
+QImage scaleByArea(const QImage& src, const QSize& dst_size);
 }  // namespace imageproc
 #endif
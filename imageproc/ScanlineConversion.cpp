@@ -0,0 +1,512 @@
+
+#include "ScanlineConversion.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCANLINE_CONVERSION_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only allow intrinsics in functions explicitly targeting
+// the corresponding instruction set, while MSVC allows them anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#endif
+
+namespace imageproc {
+namespace {
+/*================================== Scalar ==================================*/
+
+/**
+ * Same as qGray() multiplied by 32, but without the rounding.
+ */
+inline int graySum(const uint32_t c) {
+  return static_cast<int>(((c >> 16) & 0xff) * 11 + ((c >> 8) & 0xff) * 16 + (c & 0xff) * 5);
+}
+
+void rgb32ToGrayScalar(const uint32_t* src, uint8_t* dst, const int width) {
+  for (int x = 0; x < width; ++x) {
+    dst[x] = static_cast<uint8_t>(graySum(src[x]) >> 5);
+  }
+}
+
+/**
+ * Converts pixels starting from \p x, which has to be a multiple of 32.
+ */
+void grayToBinaryFrom(const uint8_t* src, uint32_t* dst, int x, const int width, const int threshold) {
+  for (; x < width; x += 32) {
+    const int end = std::min(x + 32, width);
+    uint32_t word = 0;
+    for (int i = x; i < end; ++i) {
+      word <<= 1;
+      word |= (src[i] < threshold) ? 1 : 0;
+    }
+    word <<= 32 - (end - x);
+    dst[x >> 5] = word;
+  }
+}
+
+void grayToBinaryScalar(const uint8_t* src, uint32_t* dst, const int width, const int threshold) {
+  grayToBinaryFrom(src, dst, 0, width, threshold);
+}
+
+/**
+ * Converts pixels starting from \p x, which has to be a multiple of 32.
+ */
+void rgb32ToBinaryFrom(const uint32_t* src, uint32_t* dst, int x, const int width, const int threshold) {
+  const int threshold_sum = threshold * 32;
+  for (; x < width; x += 32) {
+    const int end = std::min(x + 32, width);
+    uint32_t word = 0;
+    for (int i = x; i < end; ++i) {
+      word <<= 1;
+      word |= (graySum(src[i]) < threshold_sum) ? 1 : 0;
+    }
+    word <<= 32 - (end - x);
+    dst[x >> 5] = word;
+  }
+}
+
+void rgb32ToBinaryScalar(const uint32_t* src, uint32_t* dst, const int width, const int threshold) {
+  rgb32ToBinaryFrom(src, dst, 0, width, threshold);
+}
+
+void invertGrayScalar(const uint8_t* src, uint8_t* dst, const int width) {
+  for (int x = 0; x < width; ++x) {
+    dst[x] = static_cast<uint8_t>(~src[x]);
+  }
+}
+
+void rgb32ToRgb24Scalar(const uint32_t* src, uint8_t* dst, const int width) {
+  for (int x = 0; x < width; ++x, dst += 3) {
+    const uint32_t argb = src[x];
+    dst[0] = static_cast<uint8_t>(argb >> 16);
+    dst[1] = static_cast<uint8_t>(argb >> 8);
+    dst[2] = static_cast<uint8_t>(argb);
+  }
+}
+
+void argb32ToRgba32Scalar(const uint32_t* src, uint8_t* dst, const int width) {
+  for (int x = 0; x < width; ++x, dst += 4) {
+    const uint32_t argb = src[x];
+    dst[0] = static_cast<uint8_t>(argb >> 16);
+    dst[1] = static_cast<uint8_t>(argb >> 8);
+    dst[2] = static_cast<uint8_t>(argb);
+    dst[3] = static_cast<uint8_t>(argb >> 24);
+  }
+}
+
+#ifdef SCANLINE_CONVERSION_X86
+
+/*=================================== SSE2 ===================================*/
+
+/**
+ * Computes graySum() for 4 pixels.
+ */
+TARGET_SSE2 inline __m128i graySums(const __m128i pixels) {
+  const __m128i byte_mask = _mm_set1_epi32(0xff);
+  const __m128i b = _mm_and_si128(pixels, byte_mask);
+  const __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), byte_mask);
+  const __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), byte_mask);
+
+  // The upper halves of 32-bit lanes are zero and the products
+  // fit into 16 bits, so 16-bit multiplication will do.
+  const __m128i rb = _mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(11)), _mm_mullo_epi16(b, _mm_set1_epi32(5)));
+
+  return _mm_add_epi32(rb, _mm_slli_epi32(g, 4));
+}
+
+/**
+ * Takes 16 bytes of 0x00 or 0xff and turns them into the lower 16 bits of
+ * the result, with the first byte going to the most significant of those bits.
+ */
+TARGET_SSE2 inline uint32_t byteMaskToBitsMsbFirst(const __m128i mask) {
+  auto bits = static_cast<uint32_t>(_mm_movemask_epi8(mask));
+  // movemask puts the first byte into the least significant bit.
+  bits = ((bits >> 1) & 0x5555) | ((bits & 0x5555) << 1);
+  bits = ((bits >> 2) & 0x3333) | ((bits & 0x3333) << 2);
+  bits = ((bits >> 4) & 0x0f0f) | ((bits & 0x0f0f) << 4);
+  bits = ((bits >> 8) & 0x00ff) | ((bits & 0x00ff) << 8);
+
+  return bits;
+}
+
+/**
+ * Returns a mask of 0xff for every byte of \p pixels that is below or equal to \p max_black.
+ */
+TARGET_SSE2 inline __m128i darkMask(const __m128i pixels, const __m128i max_black) {
+  return _mm_cmpeq_epi8(_mm_min_epu8(pixels, max_black), pixels);
+}
+
+/**
+ * Returns a mask of 0xff for every pixel with graySum() below \p threshold_sum,
+ * for 16 pixels starting at \p src.
+ */
+TARGET_SSE2 inline __m128i darkMask(const uint32_t* src, const __m128i threshold_sum) {
+  const auto* p = reinterpret_cast<const __m128i*>(src);
+  const __m128i d0 = _mm_cmplt_epi32(graySums(_mm_loadu_si128(p)), threshold_sum);
+  const __m128i d1 = _mm_cmplt_epi32(graySums(_mm_loadu_si128(p + 1)), threshold_sum);
+  const __m128i d2 = _mm_cmplt_epi32(graySums(_mm_loadu_si128(p + 2)), threshold_sum);
+  const __m128i d3 = _mm_cmplt_epi32(graySums(_mm_loadu_si128(p + 3)), threshold_sum);
+
+  return _mm_packs_epi16(_mm_packs_epi32(d0, d1), _mm_packs_epi32(d2, d3));
+}
+
+TARGET_SSE2 void rgb32ToGraySse2(const uint32_t* src, uint8_t* dst, const int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const auto* p = reinterpret_cast<const __m128i*>(src + x);
+    const __m128i g0 = _mm_srli_epi32(graySums(_mm_loadu_si128(p)), 5);
+    const __m128i g1 = _mm_srli_epi32(graySums(_mm_loadu_si128(p + 1)), 5);
+    const __m128i g2 = _mm_srli_epi32(graySums(_mm_loadu_si128(p + 2)), 5);
+    const __m128i g3 = _mm_srli_epi32(graySums(_mm_loadu_si128(p + 3)), 5);
+    const __m128i gray = _mm_packus_epi16(_mm_packs_epi32(g0, g1), _mm_packs_epi32(g2, g3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), gray);
+  }
+  rgb32ToGrayScalar(src + x, dst + x, width - x);
+}
+
+/**
+ * \p threshold has to be within [1, 255].
+ */
+TARGET_SSE2 void grayToBinarySse2(const uint8_t* src, uint32_t* dst, const int width, const int threshold) {
+  const __m128i max_black = _mm_set1_epi8(static_cast<char>(threshold - 1));
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const auto* p = reinterpret_cast<const __m128i*>(src + x);
+    const uint32_t hi = byteMaskToBitsMsbFirst(darkMask(_mm_loadu_si128(p), max_black));
+    const uint32_t lo = byteMaskToBitsMsbFirst(darkMask(_mm_loadu_si128(p + 1), max_black));
+    dst[x >> 5] = (hi << 16) | lo;
+  }
+  grayToBinaryFrom(src, dst, x, width, threshold);
+}
+
+TARGET_SSE2 void rgb32ToBinarySse2(const uint32_t* src, uint32_t* dst, const int width, const int threshold) {
+  const __m128i threshold_sum = _mm_set1_epi32(threshold * 32);
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const uint32_t hi = byteMaskToBitsMsbFirst(darkMask(src + x, threshold_sum));
+    const uint32_t lo = byteMaskToBitsMsbFirst(darkMask(src + x + 16, threshold_sum));
+    dst[x >> 5] = (hi << 16) | lo;
+  }
+  rgb32ToBinaryFrom(src, dst, x, width, threshold);
+}
+
+TARGET_SSE2 void invertGraySse2(const uint8_t* src, uint8_t* dst, const int width) {
+  const __m128i all_ones = _mm_set1_epi8(-1);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_xor_si128(pixels, all_ones));
+  }
+  invertGrayScalar(src + x, dst + x, width - x);
+}
+
+TARGET_SSE2 void argb32ToRgba32Sse2(const uint32_t* src, uint8_t* dst, const int width) {
+  // In memory, a pixel is "BB GG RR AA", so we just need to swap red and blue.
+  const __m128i ga_mask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+  const __m128i b_mask = _mm_set1_epi32(0xff);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    const __m128i ga = _mm_and_si128(pixels, ga_mask);
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), b_mask);
+    const __m128i b = _mm_slli_epi32(_mm_and_si128(pixels, b_mask), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_or_si128(ga, _mm_or_si128(r, b)));
+  }
+  argb32ToRgba32Scalar(src + x, dst + x * 4, width - x);
+}
+
+/*================================== SSSE3 ===================================*/
+
+TARGET_SSSE3 inline uint32_t byteMaskToBitsMsbFirstSsse3(const __m128i mask) {
+  const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_shuffle_epi8(mask, reverse)));
+}
+
+/**
+ * \p threshold has to be within [1, 255].
+ */
+TARGET_SSSE3 void grayToBinarySsse3(const uint8_t* src, uint32_t* dst, const int width, const int threshold) {
+  const __m128i max_black = _mm_set1_epi8(static_cast<char>(threshold - 1));
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const auto* p = reinterpret_cast<const __m128i*>(src + x);
+    const uint32_t hi = byteMaskToBitsMsbFirstSsse3(darkMask(_mm_loadu_si128(p), max_black));
+    const uint32_t lo = byteMaskToBitsMsbFirstSsse3(darkMask(_mm_loadu_si128(p + 1), max_black));
+    dst[x >> 5] = (hi << 16) | lo;
+  }
+  grayToBinaryFrom(src, dst, x, width, threshold);
+}
+
+TARGET_SSSE3 void rgb32ToBinarySsse3(const uint32_t* src, uint32_t* dst, const int width, const int threshold) {
+  const __m128i threshold_sum = _mm_set1_epi32(threshold * 32);
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const uint32_t hi = byteMaskToBitsMsbFirstSsse3(darkMask(src + x, threshold_sum));
+    const uint32_t lo = byteMaskToBitsMsbFirstSsse3(darkMask(src + x + 16, threshold_sum));
+    dst[x >> 5] = (hi << 16) | lo;
+  }
+  rgb32ToBinaryFrom(src, dst, x, width, threshold);
+}
+
+TARGET_SSSE3 void rgb32ToRgb24Ssse3(const uint32_t* src, uint8_t* dst, const int width) {
+  // "BB GG RR AA" x 4 -> "RR GG BB" x 4, followed by 4 zero bytes.
+  const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  int x = 0;
+  // Each store writes 16 bytes, of which only 12 are meaningful.
+  // The loop condition makes sure we don't write past the end of the line.
+  for (; x + 6 <= width; x += 4) {
+    const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3), _mm_shuffle_epi8(pixels, shuffle));
+  }
+  rgb32ToRgb24Scalar(src + x, dst + x * 3, width - x);
+}
+
+TARGET_SSSE3 void argb32ToRgba32Ssse3(const uint32_t* src, uint8_t* dst, const int width) {
+  const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_shuffle_epi8(pixels, shuffle));
+  }
+  argb32ToRgba32Scalar(src + x, dst + x * 4, width - x);
+}
+
+/*=================================== AVX2 ===================================*/
+
+/**
+ * Computes graySum() for 8 pixels.
+ */
+TARGET_AVX2 inline __m256i graySums(const __m256i pixels) {
+  const __m256i byte_mask = _mm256_set1_epi32(0xff);
+  const __m256i b = _mm256_and_si256(pixels, byte_mask);
+  const __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byte_mask);
+  const __m256i r = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byte_mask);
+
+  const __m256i rb
+      = _mm256_add_epi32(_mm256_mullo_epi16(r, _mm256_set1_epi32(11)), _mm256_mullo_epi16(b, _mm256_set1_epi32(5)));
+
+  return _mm256_add_epi32(rb, _mm256_slli_epi32(g, 4));
+}
+
+/**
+ * Packing instructions work within 128-bit lanes.  After packing 4 vectors
+ * of 8 dwords into bytes, the dword at position i has to go to order[i].
+ */
+TARGET_AVX2 inline __m256i fixPackOrder(const __m256i packed) {
+  return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+/**
+ * Takes 32 bytes of 0x00 or 0xff and turns them into a word,
+ * with the first byte going to the most significant bit.
+ */
+TARGET_AVX2 inline uint32_t byteMaskToBitsMsbFirst(const __m256i mask) {
+  const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11,
+                                           10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  const __m256i reversed_lanes = _mm256_shuffle_epi8(mask, reverse);
+
+  return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_permute4x64_epi64(reversed_lanes, 0x4e)));
+}
+
+TARGET_AVX2 void rgb32ToGrayAvx2(const uint32_t* src, uint8_t* dst, const int width) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const auto* p = reinterpret_cast<const __m256i*>(src + x);
+    const __m256i g0 = _mm256_srli_epi32(graySums(_mm256_loadu_si256(p)), 5);
+    const __m256i g1 = _mm256_srli_epi32(graySums(_mm256_loadu_si256(p + 1)), 5);
+    const __m256i g2 = _mm256_srli_epi32(graySums(_mm256_loadu_si256(p + 2)), 5);
+    const __m256i g3 = _mm256_srli_epi32(graySums(_mm256_loadu_si256(p + 3)), 5);
+    const __m256i gray = _mm256_packus_epi16(_mm256_packs_epi32(g0, g1), _mm256_packs_epi32(g2, g3));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), fixPackOrder(gray));
+  }
+  rgb32ToGraySse2(src + x, dst + x, width - x);
+}
+
+/**
+ * \p threshold has to be within [1, 255].
+ */
+TARGET_AVX2 void grayToBinaryAvx2(const uint8_t* src, uint32_t* dst, const int width, const int threshold) {
+  const __m256i max_black = _mm256_set1_epi8(static_cast<char>(threshold - 1));
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    const __m256i dark = _mm256_cmpeq_epi8(_mm256_min_epu8(pixels, max_black), pixels);
+    dst[x >> 5] = byteMaskToBitsMsbFirst(dark);
+  }
+  grayToBinaryFrom(src, dst, x, width, threshold);
+}
+
+TARGET_AVX2 void rgb32ToBinaryAvx2(const uint32_t* src, uint32_t* dst, const int width, const int threshold) {
+  const __m256i threshold_sum = _mm256_set1_epi32(threshold * 32);
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const auto* p = reinterpret_cast<const __m256i*>(src + x);
+    const __m256i d0 = _mm256_cmpgt_epi32(threshold_sum, graySums(_mm256_loadu_si256(p)));
+    const __m256i d1 = _mm256_cmpgt_epi32(threshold_sum, graySums(_mm256_loadu_si256(p + 1)));
+    const __m256i d2 = _mm256_cmpgt_epi32(threshold_sum, graySums(_mm256_loadu_si256(p + 2)));
+    const __m256i d3 = _mm256_cmpgt_epi32(threshold_sum, graySums(_mm256_loadu_si256(p + 3)));
+    const __m256i dark = _mm256_packs_epi16(_mm256_packs_epi32(d0, d1), _mm256_packs_epi32(d2, d3));
+    dst[x >> 5] = byteMaskToBitsMsbFirst(fixPackOrder(dark));
+  }
+  rgb32ToBinaryFrom(src, dst, x, width, threshold);
+}
+
+TARGET_AVX2 void invertGrayAvx2(const uint8_t* src, uint8_t* dst, const int width) {
+  const __m256i all_ones = _mm256_set1_epi8(-1);
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_xor_si256(pixels, all_ones));
+  }
+  invertGraySse2(src + x, dst + x, width - x);
+}
+
+TARGET_AVX2 void argb32ToRgba32Avx2(const uint32_t* src, uint8_t* dst, const int width) {
+  const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7,
+                                           10, 9, 8, 11, 14, 13, 12, 15);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_shuffle_epi8(pixels, shuffle));
+  }
+  argb32ToRgba32Ssse3(src + x, dst + x * 4, width - x);
+}
+
+/*============================== CPU detection ===============================*/
+
+SimdLevel detectSimdLevel() {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::AVX2;
+  } else if (__builtin_cpu_supports("ssse3")) {
+    return SimdLevel::SSSE3;
+  } else if (__builtin_cpu_supports("sse2")) {
+    return SimdLevel::SSE2;
+  }
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+
+  __cpuid(info, 1);
+  const bool sse2 = (info[3] & (1 << 26)) != 0;
+  const bool ssse3 = (info[2] & (1 << 9)) != 0;
+  // AVX2 also requires the OS to preserve the YMM registers.
+  const bool os_avx = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) && ((_xgetbv(0) & 6) == 6);
+  bool avx2 = false;
+  if (os_avx && (max_leaf >= 7)) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+
+  if (avx2) {
+    return SimdLevel::AVX2;
+  } else if (ssse3) {
+    return SimdLevel::SSSE3;
+  } else if (sse2) {
+    return SimdLevel::SSE2;
+  }
+#endif
+
+  return SimdLevel::SCALAR;
+}  // detectSimdLevel
+
+#else  // SCANLINE_CONVERSION_X86
+
+SimdLevel detectSimdLevel() {
+  return SimdLevel::SCALAR;
+}
+
+#endif  // SCANLINE_CONVERSION_X86
+}  // namespace
+
+/*============================ ScanlineConverter =============================*/
+
+ScanlineConverter::ScanlineConverter(const SimdLevel level)
+    : m_level(level),
+      m_rgb32ToGray(&rgb32ToGrayScalar),
+      m_grayToBinary(&grayToBinaryScalar),
+      m_rgb32ToBinary(&rgb32ToBinaryScalar),
+      m_invertGray(&invertGrayScalar),
+      m_rgb32ToRgb24(&rgb32ToRgb24Scalar),
+      m_argb32ToRgba32(&argb32ToRgba32Scalar) {
+#ifdef SCANLINE_CONVERSION_X86
+  if (level >= SimdLevel::SSE2) {
+    m_rgb32ToGray = &rgb32ToGraySse2;
+    m_grayToBinary = &grayToBinarySse2;
+    m_rgb32ToBinary = &rgb32ToBinarySse2;
+    m_invertGray = &invertGraySse2;
+    m_argb32ToRgba32 = &argb32ToRgba32Sse2;
+  }
+  if (level >= SimdLevel::SSSE3) {
+    m_grayToBinary = &grayToBinarySsse3;
+    m_rgb32ToBinary = &rgb32ToBinarySsse3;
+    m_rgb32ToRgb24 = &rgb32ToRgb24Ssse3;
+    m_argb32ToRgba32 = &argb32ToRgba32Ssse3;
+  }
+  if (level >= SimdLevel::AVX2) {
+    m_rgb32ToGray = &rgb32ToGrayAvx2;
+    m_grayToBinary = &grayToBinaryAvx2;
+    m_rgb32ToBinary = &rgb32ToBinaryAvx2;
+    m_invertGray = &invertGrayAvx2;
+    m_argb32ToRgba32 = &argb32ToRgba32Avx2;
+  }
+#endif
+}
+
+SimdLevel ScanlineConverter::supportedLevel() {
+  static const SimdLevel level = detectSimdLevel();
+
+  return level;
+}
+
+const ScanlineConverter& ScanlineConverter::instance() {
+  return forLevel(supportedLevel());
+}
+
+const ScanlineConverter& ScanlineConverter::forLevel(SimdLevel level) {
+  static const ScanlineConverter scalar(SimdLevel::SCALAR);
+  static const ScanlineConverter sse2(SimdLevel::SSE2);
+  static const ScanlineConverter ssse3(SimdLevel::SSSE3);
+  static const ScanlineConverter avx2(SimdLevel::AVX2);
+
+  switch (std::min(level, supportedLevel())) {
+    case SimdLevel::AVX2:
+      return avx2;
+    case SimdLevel::SSSE3:
+      return ssse3;
+    case SimdLevel::SSE2:
+      return sse2;
+    default:
+      return scalar;
+  }
+}
+
+void ScanlineConverter::grayToBinary(const uint8_t* src, uint32_t* dst, const int width, const int threshold) const {
+  if ((threshold <= 0) || (threshold > 255)) {
+    // All white or all black.  Vectorized versions don't handle these.
+    grayToBinaryScalar(src, dst, width, threshold);
+  } else {
+    m_grayToBinary(src, dst, width, threshold);
+  }
+}
+
+void ScanlineConverter::rgb32ToBinary(const uint32_t* src, uint32_t* dst, const int width, const int threshold) const {
+  // Thresholds outside of [0, 256] give the same results as the nearest one
+  // within, and with those the vectorized versions can't overflow.
+  m_rgb32ToBinary(src, dst, width, std::max(0, std::min(threshold, 256)));
+}
+}  // namespace imageproc
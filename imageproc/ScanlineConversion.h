@@ -0,0 +1,100 @@
+
+#ifndef SCANTAILOR_SCANLINECONVERSION_H
+#define SCANTAILOR_SCANLINECONVERSION_H
+
+#include <cstdint>
+
+namespace imageproc {
+/**
+ * \brief Instruction set extensions the scanline conversion routines can take advantage of.
+ */
+enum class SimdLevel { SCALAR, SSE2, SSSE3, AVX2 };
+
+/**
+ * \brief Pixel format conversion routines working on a single scanline.
+ *
+ * Each routine has a scalar version and possibly several vectorized ones.
+ * The best version the CPU supports is picked at runtime.  All versions
+ * produce bit-exact results, so the choice never affects the output.
+ *
+ * 32-bit pixels are QRgb values, that is 0xAARRGGBB in native byte order.
+ * Binary scanlines use the BinaryImage layout: the leftmost pixel goes to
+ * the most significant bit of the first word, a set bit means black and
+ * the unused bits of the last word are cleared.
+ */
+class ScanlineConverter {
+ public:
+  /**
+   * \brief Returns the converter for the best SIMD level supported.
+   */
+  static const ScanlineConverter& instance();
+
+  /**
+   * \brief Returns the converter for the given SIMD level, or for the best
+   *        supported one if the CPU doesn't support the requested level.
+   *
+   * Mostly useful for testing.
+   */
+  static const ScanlineConverter& forLevel(SimdLevel level);
+
+  /**
+   * \brief The best SIMD level supported both by the build and by the CPU.
+   */
+  static SimdLevel supportedLevel();
+
+  SimdLevel level() const { return m_level; }
+
+  /**
+   * \brief dst[x] = qGray(src[x]).  Alpha is ignored.
+   */
+  void rgb32ToGray(const uint32_t* src, uint8_t* dst, int width) const { m_rgb32ToGray(src, dst, width); }
+
+  /**
+   * \brief Pixels darker than \p threshold become black.
+   *
+   * Writes (width + 31) / 32 words.
+   */
+  void grayToBinary(const uint8_t* src, uint32_t* dst, int width, int threshold) const;
+
+  /**
+   * \brief Pixels for which qGray() is less than \p threshold become black.  Alpha is ignored.
+   *
+   * Writes (width + 31) / 32 words.
+   */
+  void rgb32ToBinary(const uint32_t* src, uint32_t* dst, int width, int threshold) const;
+
+  /**
+   * \brief dst[x] = 255 - src[x].  Works in place as well.
+   */
+  void invertGray(const uint8_t* src, uint8_t* dst, int width) const { m_invertGray(src, dst, width); }
+
+  /**
+   * \brief Converts pixels to "RR GG BB" byte sequences.  Alpha is dropped.
+   */
+  void rgb32ToRgb24(const uint32_t* src, uint8_t* dst, int width) const { m_rgb32ToRgb24(src, dst, width); }
+
+  /**
+   * \brief Converts pixels to "RR GG BB AA" byte sequences.
+   */
+  void argb32ToRgba32(const uint32_t* src, uint8_t* dst, int width) const { m_argb32ToRgba32(src, dst, width); }
+
+ private:
+  typedef void (*ToGrayFunc)(const uint32_t* src, uint8_t* dst, int width);
+  typedef void (*GrayToBinaryFunc)(const uint8_t* src, uint32_t* dst, int width, int threshold);
+  typedef void (*Rgb32ToBinaryFunc)(const uint32_t* src, uint32_t* dst, int width, int threshold);
+  typedef void (*GrayToGrayFunc)(const uint8_t* src, uint8_t* dst, int width);
+  typedef void (*PackFunc)(const uint32_t* src, uint8_t* dst, int width);
+
+  explicit ScanlineConverter(SimdLevel level);
+
+  SimdLevel m_level;
+  ToGrayFunc m_rgb32ToGray;
+  GrayToBinaryFunc m_grayToBinary;
+  Rgb32ToBinaryFunc m_rgb32ToBinary;
+  GrayToGrayFunc m_invertGray;
+  PackFunc m_rgb32ToRgb24;
+  PackFunc m_argb32ToRgba32;
+};
+}  // namespace imageproc
+
+#endif  // SCANTAILOR_SCANLINECONVERSION_H
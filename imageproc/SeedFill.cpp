@@ -18,11 +18,21 @@
 
 #include "SeedFill.h"
 #include <QDebug>
+#include <algorithm>
+#include <vector>
+#include "FastQueue.h"
 #include "GrayImage.h"
+#include "ParallelFor.h"
 #include "SeedFillGeneric.h"
 
 namespace imageproc {
 namespace {
+/**
+ * seedFill() splits images into bands of at least that many lines and pixels.
+ */
+const int MIN_BAND_HEIGHT = 64;
+const int MIN_BAND_PIXELS = 1 << 20;
+
 inline uint32_t fillWordHorizontally(uint32_t word, const uint32_t mask) {
   uint32_t prev_word;
 
@@ -35,17 +45,21 @@ inline uint32_t fillWordHorizontally(uint32_t word, const uint32_t mask) {
   return word;
 }
 
-void seedFill4Iteration(BinaryImage& seed, const BinaryImage& mask) {
-  const int w = seed.width();
-  const int h = seed.height();
-
-  const int seed_wpl = seed.wordsPerLine();
-  const int mask_wpl = mask.wordsPerLine();
+/**
+ * A raster and an anti-raster pass over \p h lines starting at \p seed_data.
+ * Lines outside of that range are neither read nor written.
+ */
+void seedFill4Iteration(uint32_t* const seed_data,
+                        const int seed_wpl,
+                        const uint32_t* const mask_data,
+                        const int mask_wpl,
+                        const int w,
+                        const int h) {
   const int last_word_idx = (w - 1) >> 5;
   const uint32_t last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
 
-  uint32_t* seed_line = seed.data();
-  const uint32_t* mask_line = mask.data();
+  uint32_t* seed_line = seed_data;
+  const uint32_t* mask_line = mask_data;
   const uint32_t* prev_line = seed_line;
 
   // Top to bottom.
@@ -108,17 +122,17 @@ void seedFill4Iteration(BinaryImage& seed, const BinaryImage& mask) {
   }
 }  // seedFill4Iteration
 
-void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
-  const int w = seed.width();
-  const int h = seed.height();
-
-  const int seed_wpl = seed.wordsPerLine();
-  const int mask_wpl = mask.wordsPerLine();
+void seedFill8Iteration(uint32_t* const seed_data,
+                        const int seed_wpl,
+                        const uint32_t* const mask_data,
+                        const int mask_wpl,
+                        const int w,
+                        const int h) {
   const int last_word_idx = (w - 1) >> 5;
   const uint32_t last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
 
-  uint32_t* seed_line = seed.data();
-  const uint32_t* mask_line = mask.data();
+  uint32_t* seed_line = seed_data;
+  const uint32_t* mask_line = mask_data;
   const uint32_t* prev_line = seed_line;
 
   // Note: we start with prev_line == seed_line, but in this case
@@ -133,6 +147,8 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
   // Top to bottom.
   for (int y = 0; y < h; ++y) {
     uint32_t prev_word = 0;
+    // The word of prev_line to the left of the current one.
+    uint32_t prev_line_word = 0;
 
     // Make sure offscreen bits area 0.
     seed_line[last_word_idx] &= last_word_mask;
@@ -140,21 +156,25 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
     int i = 0;
     for (; i < last_word_idx; ++i) {
       const uint32_t mask = mask_line[i];
-      uint32_t word = prev_line[i];
+      const uint32_t prev_line_word_i = prev_line[i];
+      uint32_t word = prev_line_word_i;
       word |= (word << 1) | (word >> 1);
       word |= seed_line[i];
       word |= prev_line[i + 1] >> 31;
+      word |= prev_line_word << 31;
       word |= prev_word << 31;
       word &= mask;
       word = fillWordHorizontally(word, mask);
       seed_line[i] = word;
       prev_word = word;
+      prev_line_word = prev_line_word_i;
     }
     // Last word.
     const uint32_t mask = mask_line[i] & last_word_mask;
     uint32_t word = prev_line[i];
     word |= (word << 1) | (word >> 1);
     word |= seed_line[i];
+    word |= prev_line_word << 31;
     word |= prev_word << 31;
     word &= mask;
     word = fillWordHorizontally(word, mask);
@@ -172,6 +192,8 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
   // Bottom to top.
   for (int y = h - 1; y >= 0; --y) {
     uint32_t prev_word = 0;
+    // The word of prev_line to the right of the current one.
+    uint32_t prev_line_word = 0;
 
     // Make sure offscreen bits area 0.
     seed_line[last_word_idx] &= last_word_mask;
@@ -179,15 +201,18 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
     int i = last_word_idx;
     for (; i > 0; --i) {
       const uint32_t mask = mask_line[i];
-      uint32_t word = prev_line[i];
+      const uint32_t prev_line_word_i = prev_line[i];
+      uint32_t word = prev_line_word_i;
       word |= (word << 1) | (word >> 1);
       word |= seed_line[i];
       word |= prev_line[i - 1] << 31;
+      word |= prev_line_word >> 31;
       word |= prev_word >> 31;
       word &= mask;
       word = fillWordHorizontally(word, mask);
       seed_line[i] = word;
       prev_word = word;
+      prev_line_word = prev_line_word_i;
     }
 
     // Last word.
@@ -195,6 +220,7 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
     uint32_t word = prev_line[i];
     word |= (word << 1) | (word >> 1);
     word |= seed_line[i];
+    word |= prev_line_word >> 31;
     word |= prev_word >> 31;
     word &= mask;
     word = fillWordHorizontally(word, mask);
@@ -212,6 +238,247 @@ void seedFill8Iteration(BinaryImage& seed, const BinaryImage& mask) {
   }
 }  // seedFill8Iteration
 
+/**
+ * \brief Luc Vincent's hybrid seed fill, working on whole words rather than pixels.
+ *
+ * A raster and an anti-raster pass do most of the work.  Words still able
+ * to spread further are then propagated through a queue.  Large images are
+ * split into horizontal bands that get filled in parallel, with the changes
+ * crossing band borders exchanged between rounds, until there are none left.
+ * As the result of a seed fill doesn't depend on the order pixels get spread
+ * in, it's the same as the one of the iterative algorithm.
+ */
+class BinarySeedFiller {
+ public:
+  BinarySeedFiller(BinaryImage& seed, const BinaryImage& mask, Connectivity connectivity);
+
+  /**
+   * As many bands as is worth it for an image of this size, within the thread limit.
+   */
+  int defaultNumBands() const;
+
+  /**
+   * \param num_bands The number of bands to split the image into.  It's clipped
+   *        to the number of lines, as bands can't be empty.
+   */
+  void fill(int num_bands);
+
+ private:
+  struct WordPos {
+    int y;
+    int idx;
+  };
+
+  struct Band {
+    int top;
+    int bottom;
+    FastQueue<WordPos> queue;
+  };
+
+  uint32_t* seedLine(int y) const { return m_seed + y * m_seedWpl; }
+
+  const uint32_t* maskLine(int y) const { return m_mask + y * m_maskWpl; }
+
+  void rasterPasses(Band& band);
+
+  void propagate(Band& band);
+
+  void exchangeBorder(Band& upper, Band& lower);
+
+  void spreadToNeighbours(int idx, int y, Band& band);
+
+  void spreadToLine(uint32_t word, int idx, int y, FastQueue<WordPos>& queue);
+
+  bool spreadTo(int idx, int y, uint32_t bits);
+
+  uint32_t* const m_seed;
+  const uint32_t* const m_mask;
+  const int m_seedWpl;
+  const int m_maskWpl;
+  const int m_width;
+  const int m_height;
+  const int m_lastWordIdx;
+  const uint32_t m_lastWordMask;
+  const Connectivity m_connectivity;
+};
+
+
+BinarySeedFiller::BinarySeedFiller(BinaryImage& seed, const BinaryImage& mask, const Connectivity connectivity)
+    : m_seed(seed.data()),
+      m_mask(mask.data()),
+      m_seedWpl(seed.wordsPerLine()),
+      m_maskWpl(mask.wordsPerLine()),
+      m_width(seed.width()),
+      m_height(seed.height()),
+      m_lastWordIdx((m_width - 1) >> 5),
+      m_lastWordMask(~uint32_t(0) << (((m_lastWordIdx + 1) << 5) - m_width)),
+      m_connectivity(connectivity) {}
+
+int BinarySeedFiller::defaultNumBands() const {
+  // Bands are only worth it for images large enough.  More bands than threads
+  // would only make changes take more rounds to cross the image.
+  const int max_bands
+      = std::min(m_height / MIN_BAND_HEIGHT, static_cast<int>(qint64(m_width) * m_height / MIN_BAND_PIXELS));
+
+  return std::max(1, std::min(max_bands, processingThreadLimit()));
+}
+
+void BinarySeedFiller::fill(int num_bands) {
+  num_bands = std::max(1, std::min(num_bands, m_height));
+
+  std::vector<Band> bands(num_bands);
+  for (int i = 0; i < num_bands; ++i) {
+    bands[i].top = m_height * i / num_bands;
+    bands[i].bottom = m_height * (i + 1) / num_bands;
+  }
+
+  const auto process_bands = [this, &bands](const bool initial) {
+    parallelFor(0, static_cast<int>(bands.size()), 1, [this, &bands, initial](const int begin, const int end) {
+      for (int i = begin; i < end; ++i) {
+        if (initial) {
+          rasterPasses(bands[i]);
+        }
+        propagate(bands[i]);
+      }
+    });
+  };
+
+  process_bands(true);
+
+  while (true) {
+    for (size_t i = 1; i < bands.size(); ++i) {
+      exchangeBorder(bands[i - 1], bands[i]);
+    }
+
+    if (std::all_of(bands.begin(), bands.end(), [](const Band& band) { return band.queue.empty(); })) {
+      break;
+    }
+
+    process_bands(false);
+  }
+}  // BinarySeedFiller::fill
+
+void BinarySeedFiller::rasterPasses(Band& band) {
+  uint32_t* const seed_data = seedLine(band.top);
+  const uint32_t* const mask_data = maskLine(band.top);
+  const int height = band.bottom - band.top;
+  if (m_connectivity == CONN4) {
+    seedFill4Iteration(seed_data, m_seedWpl, mask_data, m_maskWpl, m_width, height);
+  } else {
+    seedFill8Iteration(seed_data, m_seedWpl, mask_data, m_maskWpl, m_width, height);
+  }
+
+  // The anti-raster pass doesn't spread to the words it has already processed,
+  // and the 8-connected one doesn't spread to the upper-left either.
+  // Rather than tracking such cases, we let every word try.
+  for (int y = band.top; y < band.bottom; ++y) {
+    for (int idx = 0; idx <= m_lastWordIdx; ++idx) {
+      spreadToNeighbours(idx, y, band);
+    }
+  }
+}
+
+void BinarySeedFiller::propagate(Band& band) {
+  // Flooding large areas is much faster with raster passes than through the queue.
+  // That may be necessary after receiving a few words from another band.
+  int budget = (band.bottom - band.top) * (m_lastWordIdx + 1) / 4;
+
+  while (!band.queue.empty()) {
+    const WordPos pos(band.queue.front());
+    band.queue.pop();
+    spreadToNeighbours(pos.idx, pos.y, band);
+
+    if (--budget == 0) {
+      FastQueue<WordPos>().swap(band.queue);
+      rasterPasses(band);
+    }
+  }
+}
+
+void BinarySeedFiller::exchangeBorder(Band& upper, Band& lower) {
+  const int upper_y = upper.bottom - 1;
+  const int lower_y = lower.top;
+
+  for (int idx = 0; idx <= m_lastWordIdx; ++idx) {
+    spreadToLine(seedLine(upper_y)[idx], idx, lower_y, lower.queue);
+  }
+  for (int idx = 0; idx <= m_lastWordIdx; ++idx) {
+    spreadToLine(seedLine(lower_y)[idx], idx, upper_y, upper.queue);
+  }
+}
+
+/**
+ * Spreads a word to its neighbours within the band, queuing the ones that have changed.
+ */
+void BinarySeedFiller::spreadToNeighbours(const int idx, const int y, Band& band) {
+  const uint32_t word = seedLine(y)[idx];
+  if (word == 0) {
+    return;
+  }
+
+  // The leftmost pixel of a word is adjacent to the rightmost one of the word to the left.
+  if ((idx > 0) && spreadTo(idx - 1, y, word >> 31)) {
+    band.queue.push(WordPos{y, idx - 1});
+  }
+  if ((idx < m_lastWordIdx) && spreadTo(idx + 1, y, word << 31)) {
+    band.queue.push(WordPos{y, idx + 1});
+  }
+  if (y > band.top) {
+    spreadToLine(word, idx, y - 1, band.queue);
+  }
+  if (y + 1 < band.bottom) {
+    spreadToLine(word, idx, y + 1, band.queue);
+  }
+}
+
+/**
+ * Spreads a word at \p idx to the line \p y above or below it,
+ * queuing the words that have changed.
+ */
+void BinarySeedFiller::spreadToLine(const uint32_t word, const int idx, const int y, FastQueue<WordPos>& queue) {
+  if (word == 0) {
+    return;
+  }
+
+  uint32_t bits = word;
+  if (m_connectivity == CONN8) {
+    bits |= (word << 1) | (word >> 1);
+    if ((idx > 0) && spreadTo(idx - 1, y, word >> 31)) {
+      queue.push(WordPos{y, idx - 1});
+    }
+    if ((idx < m_lastWordIdx) && spreadTo(idx + 1, y, word << 31)) {
+      queue.push(WordPos{y, idx + 1});
+    }
+  }
+
+  if (spreadTo(idx, y, bits)) {
+    queue.push(WordPos{y, idx});
+  }
+}
+
+/**
+ * Adds \p bits allowed by the mask to a word and fills it horizontally.
+ *
+ * \return Whether the word has changed.
+ */
+bool BinarySeedFiller::spreadTo(const int idx, const int y, const uint32_t bits) {
+  uint32_t mask = maskLine(y)[idx];
+  if (idx == m_lastWordIdx) {
+    mask &= m_lastWordMask;
+  }
+
+  uint32_t& word = seedLine(y)[idx];
+  const uint32_t new_bits = bits & mask & ~word;
+  if (new_bits == 0) {
+    return false;
+  }
+
+  word = fillWordHorizontally(word | new_bits, mask);
+
+  return true;
+}
+
+
 inline uint8_t lightest(uint8_t lhs, uint8_t rhs) {
   return lhs > rhs ? lhs : rhs;
 }
@@ -417,19 +684,42 @@ uint8_t seedFillGray8SlowIteration(GrayImage& seed, const GrayImage& mask) {
 }  // namespace
 
 BinaryImage seedFill(const BinaryImage& seed, const BinaryImage& mask, const Connectivity connectivity) {
+  return seedFill(seed, mask, connectivity, 0);
+}
+
+BinaryImage seedFill(const BinaryImage& seed,
+                     const BinaryImage& mask,
+                     const Connectivity connectivity,
+                     const int num_bands) {
   if (seed.size() != mask.size()) {
     throw std::invalid_argument("seedFill: seed and mask have different sizes");
   }
 
+  BinaryImage img(seed);
+  if (img.isNull()) {
+    return img;
+  }
+
+  BinarySeedFiller filler(img, mask, connectivity);
+  filler.fill((num_bands > 0) ? num_bands : filler.defaultNumBands());
+
+  return img;
+}
+
+BinaryImage seedFillSlow(const BinaryImage& seed, const BinaryImage& mask, const Connectivity connectivity) {
+  if (seed.size() != mask.size()) {
+    throw std::invalid_argument("seedFillSlow: seed and mask have different sizes");
+  }
+
   BinaryImage prev;
   BinaryImage img(seed);
 
   do {
     prev = img;
     if (connectivity == CONN4) {
-      seedFill4Iteration(img, mask);
+      seedFill4Iteration(img.data(), img.wordsPerLine(), mask.data(), mask.wordsPerLine(), img.width(), img.height());
     } else {
-      seedFill8Iteration(img, mask);
+      seedFill8Iteration(img.data(), img.wordsPerLine(), mask.data(), mask.wordsPerLine(), img.width(), img.height());
     }
   } while (img != prev);
 
@@ -37,11 +37,30 @@ class GrayImage;
  * \p seed is allowed to contain black pixels that are not in \p mask.
  * They will be ignored and will not appear in the resulting image.
  * \par
- * The underlying code implements Luc Vincent's iterative seed-fill
- * algorithm: http://www.vincent-net.com/luc/papers/93ieeeip_recons.pdf
+ * The underlying code implements Luc Vincent's hybrid seed-fill algorithm:
+ * http://www.vincent-net.com/luc/papers/93ieeeip_recons.pdf
+ * Pixels are propagated a word at a time, and large images are processed
+ * in parallel, in horizontal bands.
  */
 BinaryImage seedFill(const BinaryImage& seed, const BinaryImage& mask, Connectivity connectivity);
 
+/**
+ * \brief seedFill() splitting the image into \p num_bands bands, rather than
+ *        into as many as the image size and the number of threads justify.
+ *
+ * A \p num_bands of 0 or less has the default number of bands used.  This
+ * overload is meant for testing the exchange between bands on any machine.
+ */
+BinaryImage seedFill(const BinaryImage& seed, const BinaryImage& mask, Connectivity connectivity, int num_bands);
+
+/**
+ * \brief A slower but more simple implementation of seedFill().
+ *
+ * It's Luc Vincent's iterative seed-fill algorithm.  This function should
+ * not be used for anything but testing the correctness of seedFill().
+ */
+BinaryImage seedFillSlow(const BinaryImage& seed, const BinaryImage& mask, Connectivity connectivity);
+
 /**
  * \brief Spread darker colors from seed as long as mask allows it.
  *
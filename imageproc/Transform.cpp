@@ -61,15 +61,20 @@ static void transformGeneric(const StorageUnit* const src_data,
                              const int dst_stride,
                              const QTransform& xform,
                              const QRect& dst_rect,
+                             const QRect& area,
                              const StorageUnit outside_color,
                              const int outside_flags,
                              const QSizeF& min_mapping_area) {
   const int sw = src_size.width();
   const int sh = src_size.height();
-  const int dw = dst_rect.width();
-  const int dh = dst_rect.height();
 
-  StorageUnit* dst_line = dst_data;
+  // The part of dst to produce, in dst image coordinates.
+  const QRect dst_area(area.intersected(QRect(QPoint(0, 0), dst_rect.size())));
+  if (dst_area.isEmpty()) {
+    return;
+  }
+
+  StorageUnit* dst_line = dst_data + dst_area.top() * dst_stride;
 
   QTransform inv_xform;
   inv_xform.translate(dst_rect.x(), dst_rect.y());
@@ -83,12 +88,12 @@ static void transformGeneric(const StorageUnit* const src_data,
   const int src32_unit_w = std::max<int>(1, qRound(src32_unit_size.width()));
   const int src32_unit_h = std::max<int>(1, qRound(src32_unit_size.height()));
 
-  for (int dy = 0; dy < dh; ++dy, dst_line += dst_stride) {
+  for (int dy = dst_area.top(); dy <= dst_area.bottom(); ++dy, dst_line += dst_stride) {
     const double f_dy_center = dy + 0.5;
     const double f_sx32_base = f_dy_center * inv_xform.m21() + inv_xform.dx();
     const double f_sy32_base = f_dy_center * inv_xform.m22() + inv_xform.dy();
 
-    for (int dx = 0; dx < dw; ++dx) {
+    for (int dx = dst_area.left(); dx <= dst_area.right(); ++dx) {
       const double f_dx_center = dx + 0.5;
       const double f_sx32_center = f_sx32_base + f_dx_center * inv_xform.m11();
       const double f_sy32_center = f_sy32_base + f_dx_center * inv_xform.m12();
@@ -311,6 +316,59 @@ void fixDpiInPlace(GrayImage& image, const QTransform& xform) {
     image.setDotsPerMeterX(dpi_rect.width());
   }
 }
+
+bool isOpaqueGray(const QRgb rgba) {
+  return qAlpha(rgba) == 0xff && qRed(rgba) == qBlue(rgba) && qRed(rgba) == qGreen(rgba);
+}
+
+/**
+ * \brief The format transform() produces for the given source and outside pixels.
+ *
+ * Format_Indexed8 stands for a grayscale image.
+ */
+QImage::Format transformedFormat(const QImage& src, const OutsidePixels& outside_pixels) {
+  switch (src.format()) {
+    case QImage::Format_Indexed8:
+    case QImage::Format_Mono:
+    case QImage::Format_MonoLSB:
+      if (src.allGray() && isOpaqueGray(outside_pixels.rgba())) {
+        return QImage::Format_Indexed8;
+      }
+    default:
+      if (!src.hasAlphaChannel() && (qAlpha(outside_pixels.rgba()) == 0xff)) {
+        return QImage::Format_RGB32;
+      } else {
+        return QImage::Format_ARGB32;
+      }
+  }
+}
+
+bool canTransformAreasInto(const QImage& dst, const QRect& dst_rect, const QImage::Format format) {
+  if ((dst.size() != dst_rect.size()) || (dst.format() != format)) {
+    return false;
+  }
+
+  return (format != QImage::Format_Indexed8) || (dst.colorTable() == createGrayscalePalette());
+}
+
+void transformGrayAreas(const QImage& src,
+                        QImage& dst,
+                        const QTransform& xform,
+                        const QRect& dst_rect,
+                        const std::vector<QRect>& areas,
+                        const OutsidePixels outside_pixels,
+                        const QSizeF& min_mapping_area) {
+  const GrayImage gray_src(src);
+  uint8_t* const dst_data = dst.bits();
+  const int dst_stride = dst.bytesPerLine();
+
+  typedef unsigned AccumType;
+  for (const QRect& area : areas) {
+    transformGeneric<uint8_t, GrayColorMixer<AccumType>>(gray_src.data(), gray_src.stride(), gray_src.size(), dst_data,
+                                                         dst_stride, xform, dst_rect, area, outside_pixels.grayLevel(),
+                                                         outside_pixels.flags(), min_mapping_area);
+  }
+}
 }  // namespace
 
 QImage transform(const QImage& src,
@@ -330,59 +388,54 @@ QImage transform(const QImage& src,
     throw std::invalid_argument("transform: dst_rect is invalid");
   }
 
-  auto is_opaque_gray
-      = [](QRgb rgba) { return qAlpha(rgba) == 0xff && qRed(rgba) == qBlue(rgba) && qRed(rgba) == qGreen(rgba); };
-  switch (src.format()) {
-    case QImage::Format_Invalid:
-      return QImage();
-    case QImage::Format_Indexed8:
-    case QImage::Format_Mono:
-    case QImage::Format_MonoLSB:
-      if (src.allGray() && is_opaque_gray(outside_pixels.rgba())) {
-        // The palette of src may be non-standard, so we create a GrayImage,
-        // which is guaranteed to have a standard palette.
-        GrayImage gray_src(src);
-        GrayImage gray_dst(dst_rect.size());
-        typedef uint32_t AccumType;
-        transformGeneric<uint8_t, GrayColorMixer<AccumType>>(
-            gray_src.data(), gray_src.stride(), src.size(), gray_dst.data(), gray_dst.stride(), xform, dst_rect,
-            outside_pixels.grayLevel(), outside_pixels.flags(), min_mapping_area);
-
-        fixDpiInPlace(gray_dst, xform);
-
-        return gray_dst;
-      }
-    default:
-      if (!src.hasAlphaChannel() && (qAlpha(outside_pixels.rgba()) == 0xff)) {
-        const QImage src_rgb32(src.convertToFormat(QImage::Format_RGB32));
-        badAllocIfNull(src_rgb32);
-        QImage dst(dst_rect.size(), QImage::Format_RGB32);
-        badAllocIfNull(dst);
+  const QRect whole_dst(QPoint(0, 0), dst_rect.size());
+  switch (transformedFormat(src, outside_pixels)) {
+    case QImage::Format_Indexed8: {
+      // The palette of src may be non-standard, so we create a GrayImage,
+      // which is guaranteed to have a standard palette.
+      GrayImage gray_src(src);
+      GrayImage gray_dst(dst_rect.size());
+      typedef uint32_t AccumType;
+      transformGeneric<uint8_t, GrayColorMixer<AccumType>>(
+          gray_src.data(), gray_src.stride(), src.size(), gray_dst.data(), gray_dst.stride(), xform, dst_rect,
+          whole_dst, outside_pixels.grayLevel(), outside_pixels.flags(), min_mapping_area);
+
+      fixDpiInPlace(gray_dst, xform);
+
+      return gray_dst;
+    }
+    case QImage::Format_RGB32: {
+      const QImage src_rgb32(src.convertToFormat(QImage::Format_RGB32));
+      badAllocIfNull(src_rgb32);
+      QImage dst(dst_rect.size(), QImage::Format_RGB32);
+      badAllocIfNull(dst);
 
-        typedef uint32_t AccumType;
-        transformGeneric<uint32_t, RgbColorMixer<AccumType>>(
-            (const uint32_t*) src_rgb32.bits(), src_rgb32.bytesPerLine() / 4, src_rgb32.size(), (uint32_t*) dst.bits(),
-            dst.bytesPerLine() / 4, xform, dst_rect, outside_pixels.rgb(), outside_pixels.flags(), min_mapping_area);
+      typedef uint32_t AccumType;
+      transformGeneric<uint32_t, RgbColorMixer<AccumType>>(
+          (const uint32_t*) src_rgb32.bits(), src_rgb32.bytesPerLine() / 4, src_rgb32.size(), (uint32_t*) dst.bits(),
+          dst.bytesPerLine() / 4, xform, dst_rect, whole_dst, outside_pixels.rgb(), outside_pixels.flags(),
+          min_mapping_area);
 
-        fixDpiInPlace(dst, xform);
+      fixDpiInPlace(dst, xform);
 
-        return dst;
-      } else {
-        const QImage src_argb32(src.convertToFormat(QImage::Format_ARGB32));
-        badAllocIfNull(src_argb32);
-        QImage dst(dst_rect.size(), QImage::Format_ARGB32);
-        badAllocIfNull(dst);
+      return dst;
+    }
+    default: {
+      const QImage src_argb32(src.convertToFormat(QImage::Format_ARGB32));
+      badAllocIfNull(src_argb32);
+      QImage dst(dst_rect.size(), QImage::Format_ARGB32);
+      badAllocIfNull(dst);
 
-        typedef float AccumType;
-        transformGeneric<uint32_t, ArgbColorMixer<AccumType>>(
-            (const uint32_t*) src_argb32.bits(), src_argb32.bytesPerLine() / 4, src_argb32.size(),
-            (uint32_t*) dst.bits(), dst.bytesPerLine() / 4, xform, dst_rect, outside_pixels.rgba(),
-            outside_pixels.flags(), min_mapping_area);
+      typedef float AccumType;
+      transformGeneric<uint32_t, ArgbColorMixer<AccumType>>(
+          (const uint32_t*) src_argb32.bits(), src_argb32.bytesPerLine() / 4, src_argb32.size(),
+          (uint32_t*) dst.bits(), dst.bytesPerLine() / 4, xform, dst_rect, whole_dst, outside_pixels.rgba(),
+          outside_pixels.flags(), min_mapping_area);
 
-        fixDpiInPlace(dst, xform);
+      fixDpiInPlace(dst, xform);
 
-        return dst;
-      }
+      return dst;
+    }
   }
 }  // transform
 
@@ -407,12 +460,85 @@ GrayImage transformToGray(const QImage& src,
   GrayImage dst(dst_rect.size());
 
   typedef unsigned AccumType;
-  transformGeneric<uint8_t, GrayColorMixer<AccumType>>(gray_src.data(), gray_src.stride(), gray_src.size(), dst.data(),
-                                                       dst.stride(), xform, dst_rect, outside_pixels.grayLevel(),
-                                                       outside_pixels.flags(), min_mapping_area);
+  transformGeneric<uint8_t, GrayColorMixer<AccumType>>(
+      gray_src.data(), gray_src.stride(), gray_src.size(), dst.data(), dst.stride(), xform, dst_rect,
+      QRect(QPoint(0, 0), dst_rect.size()), outside_pixels.grayLevel(), outside_pixels.flags(), min_mapping_area);
 
   fixDpiInPlace(dst, xform);
 
   return dst;
 }
-}  // namespace imageproc
\ No newline at end of file
+
+void transformAreas(const QImage& src,
+                    QImage& dst,
+                    const QTransform& xform,
+                    const QRect& dst_rect,
+                    const std::vector<QRect>& areas,
+                    const OutsidePixels outside_pixels,
+                    const QSizeF& min_mapping_area) {
+  const QImage::Format format = src.isNull() ? QImage::Format_Invalid : transformedFormat(src, outside_pixels);
+  if (dst_rect.isEmpty() || !canTransformAreasInto(dst, dst_rect, format)) {
+    dst = transform(src, xform, dst_rect, outside_pixels, min_mapping_area);
+
+    return;
+  }
+
+  if (!xform.isAffine()) {
+    throw std::invalid_argument("transformAreas: only affine transformations are supported");
+  }
+
+  switch (format) {
+    case QImage::Format_Indexed8:
+      transformGrayAreas(src, dst, xform, dst_rect, areas, outside_pixels, min_mapping_area);
+      break;
+    case QImage::Format_RGB32: {
+      const QImage src_rgb32(src.convertToFormat(QImage::Format_RGB32));
+      badAllocIfNull(src_rgb32);
+      auto* const dst_data = (uint32_t*) dst.bits();
+
+      typedef uint32_t AccumType;
+      for (const QRect& area : areas) {
+        transformGeneric<uint32_t, RgbColorMixer<AccumType>>(
+            (const uint32_t*) src_rgb32.bits(), src_rgb32.bytesPerLine() / 4, src_rgb32.size(), dst_data,
+            dst.bytesPerLine() / 4, xform, dst_rect, area, outside_pixels.rgb(), outside_pixels.flags(),
+            min_mapping_area);
+      }
+      break;
+    }
+    default: {
+      const QImage src_argb32(src.convertToFormat(QImage::Format_ARGB32));
+      badAllocIfNull(src_argb32);
+      auto* const dst_data = (uint32_t*) dst.bits();
+
+      typedef float AccumType;
+      for (const QRect& area : areas) {
+        transformGeneric<uint32_t, ArgbColorMixer<AccumType>>(
+            (const uint32_t*) src_argb32.bits(), src_argb32.bytesPerLine() / 4, src_argb32.size(), dst_data,
+            dst.bytesPerLine() / 4, xform, dst_rect, area, outside_pixels.rgba(), outside_pixels.flags(),
+            min_mapping_area);
+      }
+      break;
+    }
+  }
+}  // transformAreas
+
+void transformAreasToGray(const QImage& src,
+                          QImage& dst,
+                          const QTransform& xform,
+                          const QRect& dst_rect,
+                          const std::vector<QRect>& areas,
+                          const OutsidePixels outside_pixels,
+                          const QSizeF& min_mapping_area) {
+  if (src.isNull() || dst_rect.isEmpty() || !canTransformAreasInto(dst, dst_rect, QImage::Format_Indexed8)) {
+    dst = transformToGray(src, xform, dst_rect, outside_pixels, min_mapping_area);
+
+    return;
+  }
+
+  if (!xform.isAffine()) {
+    throw std::invalid_argument("transformAreasToGray: only affine transformations are supported");
+  }
+
+  transformGrayAreas(src, dst, xform, dst_rect, areas, outside_pixels, min_mapping_area);
+}
+}  // namespace imageproc
@@ -22,6 +22,7 @@
 #include <QColor>
 #include <QSizeF>
 #include <cstdint>
+#include <vector>
 
 class QImage;
 class QRect;
@@ -113,5 +114,40 @@ GrayImage transformToGray(const QImage& src,
                           const QRect& dst_rect,
                           OutsidePixels outside_pixels,
                           const QSizeF& min_mapping_area = QSizeF(0.9, 0.9));
+
+/**
+ * \brief Recompute some areas of an image previously produced by transform().
+ *
+ * Pixels inside \p areas end up exactly as transform() would produce them,
+ * while the rest of \p dst is left intact.  That's useful when only parts
+ * of a transformed image are going to be used.
+ *
+ * \param dst The image to update.  If it's not of dst_rect.size() or not of
+ *        the format transform() would produce for these arguments, it gets
+ *        replaced with the result of transform().
+ * \param areas Rectangles in \p dst coordinates.
+ *
+ * The remaining parameters are the same as for transform().
+ */
+void transformAreas(const QImage& src,
+                    QImage& dst,
+                    const QTransform& xform,
+                    const QRect& dst_rect,
+                    const std::vector<QRect>& areas,
+                    OutsidePixels outside_pixels,
+                    const QSizeF& min_mapping_area = QSizeF(0.9, 0.9));
+
+/**
+ * \brief Same as transformAreas(), except it works like transformToGray().
+ *
+ * \p dst is expected to be a grayscale image of dst_rect.size().
+ */
+void transformAreasToGray(const QImage& src,
+                          QImage& dst,
+                          const QTransform& xform,
+                          const QRect& dst_rect,
+                          const std::vector<QRect>& areas,
+                          OutsidePixels outside_pixels,
+                          const QSizeF& min_mapping_area = QSizeF(0.9, 0.9));
 }  // namespace imageproc
 #endif  // ifndef IMAGEPROC_TRANSFORM_H_
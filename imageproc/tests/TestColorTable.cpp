@@ -0,0 +1,304 @@
+#include <QColor>
+#include <QImage>
+#include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
+#include "ColorTable.h"
+
+namespace imageproc {
+namespace tests {
+namespace {
+uint32_t pixelColor(const QImage& image, const int x, const int y) {
+  if (image.format() == QImage::Format_Indexed8) {
+    return image.color(image.constScanLine(y)[x]);
+  }
+
+  return reinterpret_cast<const uint32_t*>(image.constScanLine(y))[x];
+}
+
+std::vector<uint32_t> pixelColors(const QImage& image) {
+  std::vector<uint32_t> colors;
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      colors.push_back(pixelColor(image, x, y));
+    }
+  }
+
+  return colors;
+}
+
+/**
+ * The hash map based ColorTable it was rewritten from, cut down to computing
+ * the resulting color of every pixel.  Ties for the most frequent color
+ * in a group go to the lowest color, as they are now.
+ */
+namespace reference {
+std::map<uint32_t, int> paletteWithStatistics(const QImage& image) {
+  std::map<uint32_t, int> palette;
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      ++palette[pixelColor(image, x, y)];
+    }
+  }
+
+  return palette;
+}
+
+std::map<uint32_t, uint32_t> normalizePalette(const std::map<uint32_t, int>& palette, const int pixelCount) {
+  int red_hist[256] = {};
+  int green_hist[256] = {};
+  int blue_hist[256] = {};
+  for (const auto& colorAndStat : palette) {
+    const uint32_t color = colorAndStat.first;
+    if ((color == 0xff000000u) || (color == 0xffffffffu)) {
+      const int level = (color == 0xff000000u) ? 0 : 255;
+      red_hist[level] += colorAndStat.second;
+      green_hist[level] += colorAndStat.second;
+      blue_hist[level] += colorAndStat.second;
+      continue;
+    }
+    red_hist[qRed(color)] += colorAndStat.second;
+    green_hist[qGreen(color)] += colorAndStat.second;
+    blue_hist[qBlue(color)] += colorAndStat.second;
+  }
+
+  int min_level = 255;
+  int max_level = 0;
+  for (int level = 0; level < 256; ++level) {
+    if (((double(red_hist[level]) / pixelCount) >= 0.0005) || ((double(green_hist[level]) / pixelCount) >= 0.0005)
+        || ((double(blue_hist[level]) / pixelCount) >= 0.0005)) {
+      min_level = std::min(min_level, level);
+      max_level = std::max(max_level, level);
+    }
+  }
+
+  const auto normalizeLevel = [min_level, max_level](const int level) {
+    if (max_level <= min_level) {
+      return level;
+    }
+
+    return qBound(0, qRound((double(level - min_level) / (max_level - min_level)) * 255), 255);
+  };
+
+  std::map<uint32_t, uint32_t> colorToNormalized;
+  colorToNormalized[0xff000000u] = 0xff000000u;
+  colorToNormalized[0xffffffffu] = 0xffffffffu;
+  for (const auto& colorAndStat : palette) {
+    const uint32_t color = colorAndStat.first;
+    if ((color != 0xff000000u) && (color != 0xffffffffu)) {
+      colorToNormalized[color]
+          = qRgb(normalizeLevel(qRed(color)), normalizeLevel(qGreen(color)), normalizeLevel(qBlue(color)));
+    }
+  }
+
+  return colorToNormalized;
+}
+
+void makeGrayBlackOrWhiteInPlace(QRgb& rgb, const QRgb& normalized) {
+  const QColor color = QColor(normalized).toHsv();
+  const double saturation = color.saturationF();
+  const double value = color.valueF();
+  const double coefficient = std::max(.0, ((std::max(saturation, value) - 0.28) / 0.72)) + 1;
+  if ((saturation * value) < (0.1 * coefficient)) {
+    const int grayLevel = qGray(normalized);
+    const QColor grayColor = QColor(grayLevel, grayLevel, grayLevel).toHsl();
+    if (grayColor.lightnessF() <= 0.5) {
+      rgb = 0xff000000u;
+    } else if (grayColor.lightnessF() >= 0.8) {
+      rgb = 0xffffffffu;
+    }
+  }
+}
+
+std::vector<uint32_t> posterize(const QImage& image, const int level, const bool normalize, const bool forceBW) {
+  if ((level == 255) && !normalize && !forceBW) {
+    return pixelColors(image);
+  }
+
+  const std::map<uint32_t, int> palette = paletteWithStatistics(image);
+  std::map<uint32_t, uint32_t> colorToNormalized = normalizePalette(palette, image.width() * image.height());
+
+  const double levelStride = 255.0 / level;
+  const auto groupOf = [&](const uint32_t color) {
+    const uint32_t normalized = colorToNormalized[color];
+
+    return (static_cast<uint32_t>(qRed(normalized) / levelStride) << 16)
+           | (static_cast<uint32_t>(qGreen(normalized) / levelStride) << 8)
+           | static_cast<uint32_t>(qBlue(normalized) / levelStride);
+  };
+
+  std::map<uint32_t, uint32_t> mostOftenColors;
+  for (const auto& colorAndStat : palette) {
+    const auto it = mostOftenColors.find(groupOf(colorAndStat.first));
+    if (it == mostOftenColors.end()) {
+      mostOftenColors[groupOf(colorAndStat.first)] = colorAndStat.first;
+    } else if (colorAndStat.second > palette.at(it->second)) {
+      it->second = colorAndStat.first;
+    }
+  }
+
+  std::map<uint32_t, uint32_t> oldToNewColor;
+  for (const auto& colorAndStat : palette) {
+    QRgb mostOftenColor = mostOftenColors[groupOf(colorAndStat.first)];
+    if (forceBW) {
+      makeGrayBlackOrWhiteInPlace(mostOftenColor, colorToNormalized[mostOftenColor]);
+    }
+    oldToNewColor[colorAndStat.first] = normalize ? colorToNormalized[mostOftenColor] : mostOftenColor;
+  }
+
+  std::vector<uint32_t> colors;
+  for (int y = 0; y < image.height(); ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      colors.push_back(oldToNewColor[pixelColor(image, x, y)]);
+    }
+  }
+
+  return colors;
+}
+}  // namespace reference
+
+uint32_t randomColor(const bool opaque) {
+  const uint32_t alpha = opaque ? 0xff000000u : (static_cast<uint32_t>(std::rand() % 4) * 0x40000000u);
+
+  return alpha | (static_cast<uint32_t>(std::rand() & 0xfff) << 12) | static_cast<uint32_t>(std::rand() & 0xfff);
+}
+
+/**
+ * An image of \p numColors random colors, with less frequent colors
+ * being a few levels away from the common ones, like on a scan.
+ */
+QImage randomImage(const int width,
+                   const int height,
+                   const int numColors,
+                   const QImage::Format format = QImage::Format_RGB32) {
+  std::vector<uint32_t> palette;
+  for (int i = 0; i < numColors; ++i) {
+    if ((i < 4) || (std::rand() % 2 != 0)) {
+      palette.push_back(randomColor(format != QImage::Format_ARGB32));
+    } else {
+      const uint32_t base = palette[std::rand() % 4];
+      palette.push_back((base & 0xff000000u)
+                        | qRgb(qBound(0, qRed(base) + std::rand() % 9 - 4, 255),
+                               qBound(0, qGreen(base) + std::rand() % 9 - 4, 255),
+                               qBound(0, qBlue(base) + std::rand() % 9 - 4, 255))
+                              & 0x00ffffffu);
+    }
+  }
+
+  QImage image(width, height, format);
+  if (format == QImage::Format_Indexed8) {
+    QVector<QRgb> colorTable;
+    for (const uint32_t color : palette) {
+      colorTable.push_back(color);
+    }
+    image.setColorTable(colorTable);
+  }
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width;) {
+      // Skewed towards the first colors, so that groups have clear winners.
+      const int idx = std::min(std::rand() % numColors, std::rand() % numColors);
+      // Runs of equal pixels, as on scans.
+      for (const int runEnd = std::min(width, x + 1 + std::rand() % 8); x < runEnd; ++x) {
+        if (format == QImage::Format_Indexed8) {
+          image.scanLine(y)[x] = static_cast<uint8_t>(idx);
+        } else {
+          reinterpret_cast<uint32_t*>(image.scanLine(y))[x] = palette[idx];
+        }
+      }
+    }
+  }
+
+  return image;
+}
+
+std::vector<QImage> testImages() {
+  std::vector<QImage> images;
+  images.push_back(randomImage(67, 45, 3));
+  images.push_back(randomImage(67, 45, 40));
+  images.push_back(randomImage(67, 45, 250));
+  images.push_back(randomImage(67, 45, 1000));
+  images.push_back(randomImage(67, 45, 40, QImage::Format_ARGB32));
+  images.push_back(randomImage(67, 45, 40, QImage::Format_Indexed8));
+
+  // Many more colors than would fit into the initial tables.
+  QImage noise(300, 200, QImage::Format_RGB32);
+  for (int y = 0; y < noise.height(); ++y) {
+    for (int x = 0; x < noise.width(); ++x) {
+      reinterpret_cast<uint32_t*>(noise.scanLine(y))[x] = randomColor(true);
+    }
+  }
+  images.push_back(noise);
+
+  // A color table with duplicates and unused entries.
+  QImage indexed(randomImage(50, 30, 20, QImage::Format_Indexed8));
+  QVector<QRgb> colorTable(indexed.colorTable());
+  colorTable[5] = colorTable[3];
+  colorTable.push_back(0xff123456u);
+  indexed.setColorTable(colorTable);
+  images.push_back(indexed);
+
+  // A pale image, which normalization has to stretch.
+  QImage pale(randomImage(60, 40, 30));
+  for (int y = 0; y < pale.height(); ++y) {
+    auto* line = reinterpret_cast<uint32_t*>(pale.scanLine(y));
+    for (int x = 0; x < pale.width(); ++x) {
+      line[x] = qRgb(100 + qRed(line[x]) / 4, 120 + qGreen(line[x]) / 4, 110 + qBlue(line[x]) / 4);
+    }
+  }
+  images.push_back(pale);
+
+  return images;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ColorTableTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_palette) {
+  for (const QImage& image : testImages()) {
+    std::set<uint32_t> control;
+    for (const auto& colorAndStat : reference::paletteWithStatistics(image)) {
+      control.insert(colorAndStat.first);
+    }
+
+    const QVector<QRgb> palette = ColorTable(image).getPalette();
+    BOOST_CHECK(std::set<uint32_t>(palette.begin(), palette.end()) == control);
+    BOOST_CHECK_EQUAL(palette.size(), static_cast<int>(control.size()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_posterize) {
+  for (const QImage& image : testImages()) {
+    for (const int level : {2, 4, 16, 100, 255}) {
+      for (const bool normalize : {false, true}) {
+        for (const bool forceBW : {false, true}) {
+          ColorTable table(image);
+          table.posterize(level, normalize, forceBW);
+          BOOST_REQUIRE(pixelColors(table.getImage()) == reference::posterize(image, level, normalize, forceBW));
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_to_indexed_image) {
+  for (const QImage& image : testImages()) {
+    const ColorTable table(image);
+    const QImage indexed(table.toIndexedImage());
+    BOOST_CHECK(pixelColors(indexed) == pixelColors(image));
+
+    const QVector<QRgb> palette = table.getPalette();
+    BOOST_CHECK_EQUAL(indexed.format() == QImage::Format_Indexed8, palette.size() <= 256);
+
+    if (palette.size() <= 256) {
+      const QImage with_palette(table.toIndexedImage(&palette));
+      BOOST_CHECK(with_palette.format() == QImage::Format_Indexed8);
+      BOOST_CHECK(pixelColors(with_palette) == pixelColors(image));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace tests
+}  // namespace imageproc
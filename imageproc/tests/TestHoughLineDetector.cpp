@@ -0,0 +1,98 @@
+#include <QPoint>
+#include <QSize>
+#include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
+#include <vector>
+#include "HoughLineDetector.h"
+
+namespace imageproc {
+namespace tests {
+namespace {
+const int WIDTH = 300;
+const int HEIGHT = 400;
+
+HoughLineDetector makeDetector() {
+  return HoughLineDetector(QSize(WIDTH, HEIGHT), 5.0, -7.0, 0.25, 57);
+}
+
+/**
+ * Scattered points of low weight and two near-vertical lines of high weight.
+ * The lines are close to vertical, so that angles far from it get skipped
+ * when looking for lines of a quality close to that of theirs.
+ */
+void makePoints(std::vector<QPoint>& points, std::vector<unsigned>& weights) {
+  std::srand(1);
+  for (int i = 0; i < 5000; ++i) {
+    points.emplace_back(std::rand() % WIDTH, std::rand() % HEIGHT);
+    weights.push_back(1 + std::rand() % 3);
+  }
+
+  const double slopes[] = {0.0, 0.02};
+  const int offsets[] = {40, 200};
+  for (int line = 0; line < 2; ++line) {
+    for (int y = 0; y < HEIGHT; ++y) {
+      points.emplace_back(offsets[line] + static_cast<int>(slopes[line] * y), y);
+      weights.push_back(20);
+    }
+  }
+}
+
+void checkSameLines(const std::vector<HoughLine>& lines1, const std::vector<HoughLine>& lines2) {
+  BOOST_REQUIRE_EQUAL(lines1.size(), lines2.size());
+  for (size_t i = 0; i < lines1.size(); ++i) {
+    BOOST_CHECK(lines1[i].normUnitVector() == lines2[i].normUnitVector());
+    BOOST_CHECK_EQUAL(lines1[i].distance(), lines2[i].distance());
+    BOOST_CHECK_EQUAL(lines1[i].quality(), lines2[i].quality());
+  }
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(HoughLineDetectorTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_batch_matches_individual_points) {
+  std::vector<QPoint> points;
+  std::vector<unsigned> weights;
+  makePoints(points, weights);
+
+  HoughLineDetector individual(makeDetector());
+  for (size_t i = 0; i < points.size(); ++i) {
+    individual.process(points[i].x(), points[i].y(), weights[i]);
+  }
+
+  HoughLineDetector batch(makeDetector());
+  batch.process(points, weights);
+
+  checkSameLines(individual.findLines(1), batch.findLines(1));
+}
+
+BOOST_AUTO_TEST_CASE(test_skipped_angles_dont_affect_lines) {
+  std::vector<QPoint> points;
+  std::vector<unsigned> weights;
+  makePoints(points, weights);
+  const unsigned min_quality = HEIGHT * 18;
+
+  HoughLineDetector individual(makeDetector());
+  for (size_t i = 0; i < points.size(); ++i) {
+    individual.process(points[i].x(), points[i].y(), weights[i]);
+  }
+  const std::vector<HoughLine> expected(individual.findLines(min_quality));
+  BOOST_REQUIRE(!expected.empty());
+
+  HoughLineDetector batch(makeDetector());
+  batch.process(points, weights, min_quality);
+  checkSameLines(expected, batch.findLines(min_quality));
+
+  // Some points processed beforehand.
+  const size_t split = points.size() / 2;
+  HoughLineDetector mixed(makeDetector());
+  for (size_t i = 0; i < split; ++i) {
+    mixed.process(points[i].x(), points[i].y(), weights[i]);
+  }
+  mixed.process(std::vector<QPoint>(points.begin() + split, points.end()),
+                std::vector<unsigned>(weights.begin() + split, weights.end()), min_quality);
+  checkSameLines(expected, mixed.findLines(min_quality));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace tests
+}  // namespace imageproc
@@ -0,0 +1,133 @@
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <boost/test/auto_unit_test.hpp>
+#include <cstring>
+#include "BinaryImage.h"
+#include "GrayImage.h"
+#include "ImageBufferAllocator.h"
+#include "RasterOp.h"
+#include "Utils.h"
+
+namespace imageproc {
+namespace tests {
+using namespace utils;
+
+namespace {
+/**
+ * Spills every buffer of at least \p threshold bytes into \p dir while in scope.
+ */
+class SpillScope {
+ public:
+  SpillScope(const QString& dir, size_t threshold) : m_prevThreshold(ImageBufferAllocator::spillThreshold()) {
+    ImageBufferAllocator::setSpillThreshold(threshold);
+    ImageBufferAllocator::setSpillDirectory(dir);
+  }
+
+  ~SpillScope() {
+    ImageBufferAllocator::setSpillDirectory(QString());
+    ImageBufferAllocator::setSpillThreshold(m_prevThreshold);
+  }
+
+ private:
+  size_t m_prevThreshold;
+};
+
+int numFiles(const QTemporaryDir& dir) {
+  return QDir(dir.path()).entryList(QDir::Files).size();
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ImageBufferAllocatorTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_heap_buffers) {
+  BOOST_CHECK(!ImageBufferAllocator::isSpilled(size_t(1) << 30));
+
+  void* const buffer = ImageBufferAllocator::allocate(1000);
+  BOOST_REQUIRE(buffer);
+  memset(buffer, 0xff, 1000);
+  ImageBufferAllocator::release(buffer);
+  ImageBufferAllocator::release(nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_spilled_buffers) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const SpillScope spill(dir.path(), 4096);
+
+  BOOST_CHECK(!ImageBufferAllocator::isSpilled(4095));
+  BOOST_CHECK(ImageBufferAllocator::isSpilled(4096));
+
+  void* const small_buffer = ImageBufferAllocator::allocate(100);
+  BOOST_CHECK_EQUAL(numFiles(dir), 0);
+  ImageBufferAllocator::release(small_buffer);
+
+  {
+    const BinaryImage src(randomBinaryImage(1000, 300));
+    BinaryImage dst(src.size(), WHITE);
+    BOOST_CHECK_EQUAL(numFiles(dir), 2);
+    rasterOp<RopSrc>(dst, dst.rect(), src, QPoint(0, 0));
+    BOOST_CHECK(dst == src);
+
+    const GrayImage gray_src(randomGrayImage(301, 200));
+    GrayImage gray_dst(gray_src.size());
+    BOOST_CHECK_EQUAL(numFiles(dir), 3);
+    BOOST_CHECK(gray_dst.toQImage().isGrayscale());
+    for (int y = 0; y < gray_src.height(); ++y) {
+      memcpy(gray_dst.data() + y * gray_dst.stride(), gray_src.data() + y * gray_src.stride(), gray_src.width());
+    }
+    BOOST_CHECK(gray_dst == gray_src);
+  }
+
+  BOOST_CHECK_EQUAL(numFiles(dir), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_spilled_indexed8_images) {
+  QImage color(301, 200, QImage::Format_RGB32);
+  for (int y = 0; y < color.height(); ++y) {
+    for (int x = 0; x < color.width(); ++x) {
+      color.setPixel(x, y, qRgb(x & 0xff, y, (x ^ y) & 0xff));
+    }
+  }
+  const GrayImage heap_gray(color);
+
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const SpillScope spill(dir.path(), 4096);
+
+  BOOST_CHECK(ImageBufferAllocator::createIndexed8Image(QSize()).isNull());
+  {
+    const QImage small(ImageBufferAllocator::createIndexed8Image(QSize(10, 10)));
+    BOOST_CHECK(small.format() == QImage::Format_Indexed8);
+    BOOST_CHECK_EQUAL(numFiles(dir), 0);
+  }
+
+  {
+    // Conversions to grayscale produce spilled images too.
+    const GrayImage gray(color);
+    BOOST_CHECK_EQUAL(numFiles(dir), 1);
+    BOOST_CHECK(gray == heap_gray);
+  }
+
+  BOOST_CHECK_EQUAL(numFiles(dir), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_unusable_spill_directory) {
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  QFile blocker(dir.filePath("blocker"));
+  BOOST_REQUIRE(blocker.open(QIODevice::WriteOnly));
+  blocker.close();
+
+  // A file in place of the directory makes buffers fall back to the heap.
+  const SpillScope spill(blocker.fileName(), 0);
+  const BinaryImage src(randomBinaryImage(100, 100));
+  BinaryImage dst(src);
+  dst.invert();
+  dst.invert();
+  BOOST_CHECK(dst == src);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace tests
+}  // namespace imageproc
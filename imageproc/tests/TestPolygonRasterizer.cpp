@@ -27,9 +27,11 @@
 #include <Qt>
 #include <boost/test/auto_unit_test.hpp>
 #include <cmath>
+#include <cstdlib>
 #include "BWColor.h"
 #include "BinaryImage.h"
 #include "BinaryThreshold.h"
+#include "GrayImage.h"
 #include "PolygonRasterizer.h"
 #include "RasterOp.h"
 #include "Utils.h"
@@ -164,6 +166,55 @@ BOOST_AUTO_TEST_CASE(regression_test_1) {
   BOOST_CHECK(testFillExceptShape(QSize(938, 1299), shape, Qt::WindingFill));
 }
 
+BOOST_AUTO_TEST_CASE(test_color_fill) {
+  const QSize image_size(200, 150);
+  const QPolygonF shape(createShape(image_size, 60));
+  const QRect bounding_box(shape.boundingRect().toAlignedRect());
+  const QRgb color = qRgb(0x20, 0x80, 0xe0);
+
+  QImage image(image_size, QImage::Format_RGB32);
+  image.fill(0xffffffff);
+  PolygonRasterizer::colorFill(image, color, shape, Qt::WindingFill, true);
+
+  QImage control(image_size, QImage::Format_RGB32);
+  control.fill(0xffffffff);
+  {
+    QPainter painter(&control);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setBrush(QColor(color));
+    painter.setPen(Qt::NoPen);
+    painter.drawPolygon(shape, Qt::WindingFill);
+  }
+
+  for (int y = 0; y < image_size.height(); ++y) {
+    for (int x = 0; x < image_size.width(); ++x) {
+      const QRgb pixel = image.pixel(x, y);
+      const QRgb control_pixel = control.pixel(x, y);
+      BOOST_REQUIRE(std::abs(qRed(pixel) - qRed(control_pixel)) <= 32);
+      BOOST_REQUIRE(std::abs(qGreen(pixel) - qGreen(control_pixel)) <= 32);
+      BOOST_REQUIRE(std::abs(qBlue(pixel) - qBlue(control_pixel)) <= 32);
+      if (!bounding_box.contains(x, y)) {
+        BOOST_REQUIRE_EQUAL(pixel, 0xffffffff);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_color_fill_without_antialiasing) {
+  const QSize image_size(200, 150);
+  const QPolygonF shape(createShape(image_size, 90));
+
+  GrayImage image(image_size);
+  image.fill(0xff);
+  QImage control(image.toQImage().copy());
+  QImage filled(image.toQImage());
+  image = GrayImage();
+
+  PolygonRasterizer::grayFill(control, 100, shape, Qt::OddEvenFill);
+  PolygonRasterizer::colorFill(filled, qRgb(100, 100, 100), shape, Qt::OddEvenFill, false);
+  BOOST_CHECK(filled == control);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 }  // namespace tests
 }  // namespace imageproc
\ No newline at end of file
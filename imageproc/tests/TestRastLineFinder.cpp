@@ -79,6 +79,34 @@ BOOST_AUTO_TEST_CASE(test1) {
   BOOST_REQUIRE(finder.findNext().isNull());
 }
 
+BOOST_AUTO_TEST_CASE(test_many_points) {
+  // Enough points for search spaces to get subdivided in parallel.
+  std::vector<QPointF> pts;
+  std::set<unsigned> line1_idxs;
+  for (int i = 0; i < 5000; ++i) {
+    line1_idxs.insert(static_cast<unsigned>(pts.size()));
+    pts.emplace_back(i, i);
+  }
+
+  std::set<unsigned> line2_idxs;
+  for (int i = 0; i < 3000; ++i) {
+    line2_idxs.insert(static_cast<unsigned>(pts.size()));
+    pts.emplace_back(i, i + 100);
+  }
+
+  RastLineFinderParams params;
+  params.setMinSupportPoints(3);
+  RastLineFinder finder(pts, params);
+
+  std::vector<unsigned> support_idxs;
+
+  BOOST_REQUIRE(!finder.findNext(&support_idxs).isNull());
+  BOOST_REQUIRE(matchSupportPoints(support_idxs, line1_idxs));
+
+  BOOST_REQUIRE(!finder.findNext(&support_idxs).isNull());
+  BOOST_REQUIRE(matchSupportPoints(support_idxs, line2_idxs));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 }  // namespace tests
 }  // namespace imageproc
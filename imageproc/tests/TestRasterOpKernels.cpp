@@ -0,0 +1,226 @@
+#include <QElapsedTimer>
+#include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include "BinaryImage.h"
+#include "GrayImage.h"
+#include "GrayRasterOp.h"
+#include "RasterOp.h"
+#include "RasterOpKernels.h"
+#include "Utils.h"
+
+namespace imageproc {
+namespace tests {
+using namespace utils;
+
+namespace {
+std::vector<SimdLevel> levelsToTest() {
+  std::vector<SimdLevel> levels;
+  for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+    if (level <= ScanlineConverter::supportedLevel()) {
+      levels.push_back(level);
+    }
+  }
+
+  return levels;
+}
+
+const RasterOpKernels& scalar() {
+  return RasterOpKernels::forLevel(SimdLevel::SCALAR);
+}
+
+const BinaryRopKernel binaryOps[] = {BinaryRopKernel::SRC,
+                                     BinaryRopKernel::NOT_SRC,
+                                     BinaryRopKernel::AND,
+                                     BinaryRopKernel::OR,
+                                     BinaryRopKernel::XOR,
+                                     BinaryRopKernel::DST_AND_NOT_SRC,
+                                     BinaryRopKernel::SRC_AND_NOT_DST};
+
+std::vector<uint32_t> randomWords(const int num_words) {
+  std::vector<uint32_t> words(num_words);
+  for (uint32_t& word : words) {
+    word = (static_cast<uint32_t>(std::rand() & 0xffff) << 16) | static_cast<uint32_t>(std::rand() & 0xffff);
+  }
+
+  return words;
+}
+
+/**
+ * Computes the same as Rop, but isn't mapped to a kernel, so rasterOp() runs its generic loops.
+ */
+template <typename Rop>
+struct Generic {
+  static uint32_t transform(uint32_t src, uint32_t dst) { return Rop::transform(src, dst); }
+};
+
+template <typename Rop>
+bool kernelMatchesGeneric(const BinaryImage& src, const BinaryImage& dst, const QRect& dst_rect, const QPoint& src_pt) {
+  static_assert(detail::BinaryRopKernelOf<Rop>::value != BinaryRopKernel::NONE, "Rop has to be mapped to a kernel");
+
+  BinaryImage res1(dst);
+  BinaryImage res2(dst);
+  rasterOp<Rop>(res1, dst_rect, src, src_pt);
+  rasterOp<Generic<Rop>>(res2, dst_rect, src, src_pt);
+  if (res1 != res2) {
+    return false;
+  }
+
+  // The same image as source and destination.
+  res1 = dst;
+  res2 = dst;
+  rasterOp<Rop>(res1, dst_rect, res1, src_pt);
+  rasterOp<Generic<Rop>>(res2, dst_rect, res2, src_pt);
+
+  return res1 == res2;
+}
+
+template <typename GRop>
+bool grayKernelIsExact(const GrayRopKernel op) {
+  static_assert(detail::GrayRopKernelOf<GRop>::value != GrayRopKernel::NONE, "GRop has to be mapped to a kernel");
+
+  // Every pair of source and destination levels, at different offsets.
+  std::vector<uint8_t> src(256 * 256);
+  std::vector<uint8_t> dst(src.size() + 1, 0xaa);
+  for (int i = 0; i < 256 * 256; ++i) {
+    src[i] = static_cast<uint8_t>(i >> 8);
+    dst[i] = static_cast<uint8_t>(i & 0xff);
+  }
+
+  for (const SimdLevel level : levelsToTest()) {
+    const RasterOpKernels& kernels = RasterOpKernels::forLevel(level);
+    for (const int offset : {0, 1, 15, 31}) {
+      std::vector<uint8_t> res(dst);
+      kernels.gray(op, &src[offset], &res[offset], static_cast<int>(src.size()) - offset);
+      for (size_t i = 0; i < src.size(); ++i) {
+        const uint8_t expected = (static_cast<int>(i) < offset) ? dst[i] : GRop::transform(src[i], dst[i]);
+        if (res[i] != expected) {
+          return false;
+        }
+      }
+      if (res.back() != 0xaa) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(RasterOpKernelsTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_binary_kernels) {
+  for (const SimdLevel level : levelsToTest()) {
+    const RasterOpKernels& kernels = RasterOpKernels::forLevel(level);
+    BOOST_REQUIRE(kernels.level() == level);
+
+    for (const BinaryRopKernel op : binaryOps) {
+      for (int num_words = 0; num_words < 70; ++num_words) {
+        // One extra word, which has to stay intact.
+        const std::vector<uint32_t> src(randomWords(num_words + 1));
+        const std::vector<uint32_t> dst(randomWords(num_words + 1));
+
+        std::vector<uint32_t> control(dst);
+        std::vector<uint32_t> res(dst);
+        scalar().binary(op, src.data(), control.data(), num_words);
+        kernels.binary(op, src.data(), res.data(), num_words);
+        BOOST_REQUIRE(res == control);
+
+        // In place.
+        control = src;
+        res = src;
+        scalar().binary(op, control.data(), control.data(), num_words);
+        kernels.binary(op, res.data(), res.data(), num_words);
+        BOOST_REQUIRE(res == control);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_kernels) {
+  BOOST_CHECK(grayKernelIsExact<GRopInvert<GRopSrc>>(GrayRopKernel::INVERT_SRC));
+  BOOST_CHECK(grayKernelIsExact<GRopClippedSubtract<GRopDst, GRopSrc>>(GrayRopKernel::DST_MINUS_SRC_CLIPPED));
+  BOOST_CHECK(grayKernelIsExact<GRopClippedSubtract<GRopSrc, GRopDst>>(GrayRopKernel::SRC_MINUS_DST_CLIPPED));
+  BOOST_CHECK(grayKernelIsExact<GRopUnclippedSubtract<GRopDst, GRopSrc>>(GrayRopKernel::DST_MINUS_SRC_UNCLIPPED));
+  BOOST_CHECK(grayKernelIsExact<GRopUnclippedSubtract<GRopSrc, GRopDst>>(GrayRopKernel::SRC_MINUS_DST_UNCLIPPED));
+  BOOST_CHECK(grayKernelIsExact<GRopInvert<GRopClippedSubtract<GRopDst, GRopSrc>>>(
+      GrayRopKernel::INVERT_DST_MINUS_SRC_CLIPPED));
+  BOOST_CHECK(grayKernelIsExact<GRopClippedAdd<GRopSrc, GRopDst>>(GrayRopKernel::ADD_CLIPPED));
+  BOOST_CHECK(grayKernelIsExact<GRopUnclippedAdd<GRopSrc, GRopDst>>(GrayRopKernel::ADD_UNCLIPPED));
+  BOOST_CHECK(grayKernelIsExact<GRopDarkest<GRopSrc, GRopDst>>(GrayRopKernel::DARKEST));
+  BOOST_CHECK(grayKernelIsExact<GRopLightest<GRopSrc, GRopDst>>(GrayRopKernel::LIGHTEST));
+  BOOST_CHECK(grayKernelIsExact<GRopRaiseAboveBackground>(GrayRopKernel::RAISE_ABOVE_BACKGROUND));
+  BOOST_CHECK(grayKernelIsExact<GRopCombineInverted>(GrayRopKernel::COMBINE_INVERTED));
+}
+
+BOOST_AUTO_TEST_CASE(test_raster_op_unaligned_edges) {
+  const int w = 1000;
+  const int h = 6;
+  const BinaryImage src(randomBinaryImage(w, h));
+  const BinaryImage dst(randomBinaryImage(w, h));
+
+  for (int i = 0; i < 300; ++i) {
+    const int rect_width = 1 + std::rand() % w;
+    const int rect_height = 1 + std::rand() % h;
+    const QRect dst_rect(std::rand() % (w - rect_width + 1), std::rand() % (h - rect_height + 1), rect_width,
+                         rect_height);
+    const QPoint src_pt(std::rand() % (w - rect_width + 1), std::rand() % (h - rect_height + 1));
+
+    BOOST_REQUIRE((kernelMatchesGeneric<RopSrc>(src, dst, dst_rect, src_pt)));
+    BOOST_REQUIRE((kernelMatchesGeneric<RopNot<RopSrc>>(src, dst, dst_rect, src_pt)));
+    BOOST_REQUIRE((kernelMatchesGeneric<RopAnd<RopDst, RopSrc>>(src, dst, dst_rect, src_pt)));
+    BOOST_REQUIRE((kernelMatchesGeneric<RopOr<RopSrc, RopDst>>(src, dst, dst_rect, src_pt)));
+    BOOST_REQUIRE((kernelMatchesGeneric<RopXor<RopDst, RopSrc>>(src, dst, dst_rect, src_pt)));
+    BOOST_REQUIRE((kernelMatchesGeneric<RopSubtract<RopDst, RopSrc>>(src, dst, dst_rect, src_pt)));
+    BOOST_REQUIRE((kernelMatchesGeneric<RopSubtract<RopSrc, RopDst>>(src, dst, dst_rect, src_pt)));
+  }
+}
+
+/**
+ * Compares the kernels with the generic loops on a letter size page at 600 DPI.
+ * It's disabled by default.  To run it, pass
+ * --run_test=RasterOpKernelsTestSuite/benchmark_kernels --log_level=message
+ * to an optimized build of the test executable.
+ */
+BOOST_AUTO_TEST_CASE(benchmark_kernels, *boost::unit_test::disabled()) {
+  const int w = 5100;
+  const int h = 6600;
+  const BinaryImage src(randomBinaryImage(w, h));
+  BinaryImage dst(randomBinaryImage(w, h));
+  const QRect dst_rect(3, 0, w - 40, h);
+
+  QElapsedTimer timer;
+  timer.start();
+  rasterOp<Generic<RopXor<RopDst, RopSrc>>>(dst, dst_rect, src, dst_rect.topLeft());
+  const qint64 generic_ms = timer.restart();
+  rasterOp<RopXor<RopDst, RopSrc>>(dst, dst_rect, src, dst_rect.topLeft());
+  const qint64 kernel_ms = timer.elapsed();
+  BOOST_TEST_MESSAGE("rasterOp<RopXor>: generic " << generic_ms << " ms, kernel " << kernel_ms << " ms");
+
+  const GrayImage gray_src(randomGrayImage(w, h));
+  GrayImage gray_dst(randomGrayImage(w, h));
+  const std::pair<GrayRopKernel, const char*> gray_ops[]
+      = {{GrayRopKernel::DARKEST, "darkest"},
+         {GrayRopKernel::RAISE_ABOVE_BACKGROUND, "raise above background"},
+         {GrayRopKernel::COMBINE_INVERTED, "combine inverted"}};
+  for (const auto& op : gray_ops) {
+    timer.start();
+    for (int y = 0; y < h; ++y) {
+      scalar().gray(op.first, gray_src.data() + y * gray_src.stride(), gray_dst.data() + y * gray_dst.stride(), w);
+    }
+    const qint64 scalar_ms = timer.restart();
+    for (int y = 0; y < h; ++y) {
+      RasterOpKernels::instance().gray(op.first, gray_src.data() + y * gray_src.stride(),
+                                       gray_dst.data() + y * gray_dst.stride(), w);
+    }
+    const qint64 kernel_ms = timer.elapsed();
+    BOOST_TEST_MESSAGE("grayRasterOp " << op.second << ": scalar " << scalar_ms << " ms, kernel " << kernel_ms
+                                       << " ms");
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace tests
+}  // namespace imageproc
@@ -0,0 +1,65 @@
+#include <QImage>
+#include <QSize>
+#include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
+#include <functional>
+#include "GrayImage.h"
+#include "SavGolFilter.h"
+
+namespace imageproc {
+namespace tests {
+namespace {
+GrayImage makeImage(const QSize& size, const std::function<int(int, int)>& pixel) {
+  GrayImage img(size);
+  for (int y = 0; y < size.height(); ++y) {
+    uint8_t* line = img.data() + y * img.stride();
+    for (int x = 0; x < size.width(); ++x) {
+      line[x] = static_cast<uint8_t>(pixel(x, y));
+    }
+  }
+
+  return img;
+}
+
+/**
+ * Polynomials of a low enough degree must survive the filter, up to rounding.
+ */
+void checkPreserved(const GrayImage& img, const QSize& window_size, const int degree) {
+  const GrayImage filtered(savGolFilter(img, window_size, degree, degree));
+  BOOST_REQUIRE(filtered.size() == img.size());
+
+  for (int y = 0; y < img.height(); ++y) {
+    for (int x = 0; x < img.width(); ++x) {
+      const int expected = img.data()[y * img.stride() + x];
+      const int actual = filtered.data()[y * filtered.stride() + x];
+      BOOST_REQUIRE_LE(std::abs(actual - expected), 1);
+    }
+  }
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(SavGolFilterTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_constant_image) {
+  const GrayImage img(makeImage(QSize(71, 45), [](int, int) { return 137; }));
+  checkPreserved(img, QSize(5, 5), 3);
+  checkPreserved(img, QSize(7, 7), 4);
+  checkPreserved(img, QSize(11, 11), 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_horizontal_ramp) {
+  // Enough lines for several parallel bands.
+  const GrayImage img(makeImage(QSize(97, 301), [](int x, int) { return 10 + x * 2; }));
+  checkPreserved(img, QSize(5, 5), 3);
+  checkPreserved(img, QSize(7, 7), 4);
+  checkPreserved(img, QSize(11, 11), 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_window_larger_than_image) {
+  const GrayImage img(makeImage(QSize(5, 20), [](int x, int y) { return (x * 37 + y * 11) & 0xff; }));
+  BOOST_CHECK(GrayImage(savGolFilter(img, QSize(7, 7), 4, 4)) == img);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace tests
+}  // namespace imageproc
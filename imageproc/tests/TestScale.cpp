@@ -88,6 +88,96 @@ BOOST_AUTO_TEST_CASE(test_random_image) {
   // BOOST_CHECK(checkScale(img, QSize(145, 55)));
 }
 
+static GrayImage randomGrayImage(const QSize& size) {
+  GrayImage img(size);
+  uint8_t* line = img.data();
+  for (int y = 0; y < img.height(); ++y) {
+    for (int x = 0; x < img.width(); ++x) {
+      line[x] = static_cast<uint8_t>(rand() % 256);
+    }
+    line += img.stride();
+  }
+
+  return img;
+}
+
+BOOST_AUTO_TEST_CASE(test_integer_ratios) {
+  for (const int factor : {2, 3, 4, 5, 8}) {
+    const GrayImage img(randomGrayImage(QSize(factor * 13, factor * 7)));
+    const GrayImage scaled(scaleToGray(img, QSize(13, 7)));
+
+    const int area = factor * factor;
+    for (int y = 0; y < scaled.height(); ++y) {
+      for (int x = 0; x < scaled.width(); ++x) {
+        int sum = 0;
+        for (int sy = y * factor; sy < (y + 1) * factor; ++sy) {
+          for (int sx = x * factor; sx < (x + 1) * factor; ++sx) {
+            sum += img.data()[sy * img.stride() + sx];
+          }
+        }
+        BOOST_REQUIRE_EQUAL(int(scaled.data()[y * scaled.stride() + x]), (sum + area / 2) / area);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_color_channels_scale_independently) {
+  const QSize src_size(97, 61);
+  const GrayImage channels[] = {randomGrayImage(src_size), randomGrayImage(src_size), randomGrayImage(src_size)};
+
+  QImage color(src_size, QImage::Format_RGB32);
+  for (int y = 0; y < src_size.height(); ++y) {
+    auto* line = reinterpret_cast<QRgb*>(color.scanLine(y));
+    for (int x = 0; x < src_size.width(); ++x) {
+      line[x] = qRgb(channels[0].data()[y * channels[0].stride() + x], channels[1].data()[y * channels[1].stride() + x],
+                     channels[2].data()[y * channels[2].stride() + x]);
+    }
+  }
+
+  for (const QSize& dst_size : {QSize(48, 30), QSize(24, 15), QSize(40, 33), QSize(12, 60)}) {
+    const QImage scaled(scaleByArea(color, dst_size));
+    BOOST_REQUIRE(scaled.format() == QImage::Format_RGB32);
+    BOOST_REQUIRE(scaled.size() == dst_size);
+
+    const GrayImage scaled_channels[] = {scaleToGray(channels[0], dst_size), scaleToGray(channels[1], dst_size),
+                                         scaleToGray(channels[2], dst_size)};
+    for (int y = 0; y < dst_size.height(); ++y) {
+      const auto* line = reinterpret_cast<const QRgb*>(scaled.scanLine(y));
+      for (int x = 0; x < dst_size.width(); ++x) {
+        BOOST_REQUIRE_EQUAL(qRed(line[x]), int(scaled_channels[0].data()[y * scaled_channels[0].stride() + x]));
+        BOOST_REQUIRE_EQUAL(qGreen(line[x]), int(scaled_channels[1].data()[y * scaled_channels[1].stride() + x]));
+        BOOST_REQUIRE_EQUAL(qBlue(line[x]), int(scaled_channels[2].data()[y * scaled_channels[2].stride() + x]));
+        BOOST_REQUIRE_EQUAL(qAlpha(line[x]), 0xff);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_stays_gray) {
+  const GrayImage img(randomGrayImage(QSize(100, 80)));
+  const QImage scaled(scaleByArea(img.toQImage(), QSize(33, 20)));
+  BOOST_REQUIRE(scaled.format() == QImage::Format_Indexed8);
+  BOOST_CHECK(GrayImage(scaled) == scaleToGray(img, QSize(33, 20)));
+}
+
+BOOST_AUTO_TEST_CASE(test_upscaling_falls_back_to_qt) {
+  // Over 32x along one axis, which used to leave destination pixels without a source area.
+  const GrayImage img(randomGrayImage(QSize(3, 40)));
+  const QSize dst_size(100, 20);
+  const QImage scaled(scaleByArea(img.toQImage(), dst_size));
+  BOOST_REQUIRE(scaled.format() == QImage::Format_Indexed8);
+  BOOST_REQUIRE(scaled.size() == dst_size);
+  BOOST_CHECK(GrayImage(scaled)
+              == GrayImage(img.toQImage().scaled(dst_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)));
+
+  QImage color(3, 2, QImage::Format_RGB32);
+  color.fill(qRgb(10, 200, 30));
+  const QImage scaled_color(scaleByArea(color, QSize(200, 1)));
+  BOOST_REQUIRE(scaled_color.format() == QImage::Format_RGB32);
+  BOOST_REQUIRE(scaled_color.size() == QSize(200, 1));
+  BOOST_CHECK(scaled_color == color.scaled(QSize(200, 1), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 }  // namespace tests
 }  // namespace imageproc
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include <QRgb>
+#include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
+#include <vector>
+#include "ScanlineConversion.h"
+
+namespace imageproc {
+namespace tests {
+namespace {
+std::vector<SimdLevel> levelsToTest() {
+  std::vector<SimdLevel> levels;
+  for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::SSSE3, SimdLevel::AVX2}) {
+    if (level <= ScanlineConverter::supportedLevel()) {
+      levels.push_back(level);
+    }
+  }
+
+  return levels;
+}
+
+const ScanlineConverter& scalar() {
+  return ScanlineConverter::forLevel(SimdLevel::SCALAR);
+}
+
+/**
+ * Widths covering full vectors, partial vectors and partial words.
+ */
+const int widths[] = {0, 1, 3, 4, 5, 7, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 100, 127, 128, 129};
+
+std::vector<uint32_t> randomPixels(const int width) {
+  std::vector<uint32_t> pixels(width);
+  for (uint32_t& pixel : pixels) {
+    pixel = (static_cast<uint32_t>(std::rand() & 0xffff) << 16) | static_cast<uint32_t>(std::rand() & 0xffff);
+  }
+
+  return pixels;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ScanlineConversionTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_scalar_matches_qt) {
+  const ScanlineConverter& conv = scalar();
+  BOOST_REQUIRE(conv.level() == SimdLevel::SCALAR);
+
+  // Every RGB color, one line per red value.
+  std::vector<uint32_t> line(256 * 256);
+  std::vector<uint8_t> gray(line.size());
+  for (int r = 0; r < 256; ++r) {
+    for (int gb = 0; gb < 256 * 256; ++gb) {
+      line[gb] = qRgba(r, gb >> 8, gb & 0xff, gb & 0x7f);
+    }
+
+    conv.rgb32ToGray(line.data(), gray.data(), static_cast<int>(line.size()));
+    for (size_t i = 0; i < line.size(); ++i) {
+      BOOST_REQUIRE_EQUAL(gray[i], qGray(line[i]));
+    }
+  }
+
+  const uint8_t pixel = 0x7f;
+  for (int threshold = -1; threshold <= 257; ++threshold) {
+    uint32_t word = 0;
+    conv.grayToBinary(&pixel, &word, 1, threshold);
+    BOOST_REQUIRE_EQUAL(word, (pixel < threshold) ? 0x80000000u : 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_rgb32_to_gray) {
+  // Every RGB color, with varying alpha, one line per red value.
+  std::vector<uint32_t> line(256 * 256);
+  std::vector<uint8_t> control(line.size());
+  std::vector<uint8_t> gray(line.size());
+  for (const SimdLevel level : levelsToTest()) {
+    const ScanlineConverter& conv = ScanlineConverter::forLevel(level);
+    for (int r = 0; r < 256; ++r) {
+      for (int gb = 0; gb < 256 * 256; ++gb) {
+        line[gb] = qRgba(r, gb >> 8, gb & 0xff, (gb * 7) & 0xff);
+      }
+
+      scalar().rgb32ToGray(line.data(), control.data(), static_cast<int>(line.size()));
+      conv.rgb32ToGray(line.data(), gray.data(), static_cast<int>(line.size()));
+      BOOST_REQUIRE(gray == control);
+    }
+
+    for (const int width : widths) {
+      const std::vector<uint32_t> pixels(randomPixels(width + 1));
+      control.assign(width + 1, 0xaa);
+      gray.assign(width + 1, 0xaa);
+      scalar().rgb32ToGray(pixels.data(), control.data(), width);
+      conv.rgb32ToGray(pixels.data(), gray.data(), width);
+      // Also makes sure the byte past the end is untouched.
+      BOOST_REQUIRE(gray == control);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_to_binary) {
+  // Every gray level in every bit position.
+  std::vector<uint8_t> line(256 + 32);
+  for (size_t i = 0; i < line.size(); ++i) {
+    line[i] = static_cast<uint8_t>(i * 97);
+  }
+
+  for (const SimdLevel level : levelsToTest()) {
+    const ScanlineConverter& conv = ScanlineConverter::forLevel(level);
+    for (int threshold = -1; threshold <= 257; ++threshold) {
+      for (int offset = 0; offset < 32; ++offset) {
+        for (const int width : widths) {
+          const int num_words = (width + 31) / 32;
+          std::vector<uint32_t> control(num_words + 1, 0xdeadbeef);
+          std::vector<uint32_t> binary(num_words + 1, 0xdeadbeef);
+          scalar().grayToBinary(&line[offset], control.data(), width, threshold);
+          conv.grayToBinary(&line[offset], binary.data(), width, threshold);
+          BOOST_REQUIRE(binary == control);
+          BOOST_REQUIRE_EQUAL(binary[num_words], 0xdeadbeef);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_rgb32_to_binary) {
+  std::vector<uint32_t> line(256 * 256);
+  std::vector<uint32_t> control(line.size() / 32);
+  std::vector<uint32_t> binary(line.size() / 32);
+  for (const SimdLevel level : levelsToTest()) {
+    const ScanlineConverter& conv = ScanlineConverter::forLevel(level);
+
+    // Every RGB color against a few thresholds.
+    for (const int threshold : {1, 128, 255}) {
+      for (int r = 0; r < 256; ++r) {
+        for (int gb = 0; gb < 256 * 256; ++gb) {
+          line[gb] = qRgba(r, gb >> 8, gb & 0xff, gb & 0xff);
+        }
+
+        scalar().rgb32ToBinary(line.data(), control.data(), static_cast<int>(line.size()), threshold);
+        conv.rgb32ToBinary(line.data(), binary.data(), static_cast<int>(line.size()), threshold);
+        BOOST_REQUIRE(binary == control);
+      }
+    }
+
+    // Every threshold, and then some, against random colors.
+    for (int threshold = -5; threshold <= 260; ++threshold) {
+      for (const int width : widths) {
+        const std::vector<uint32_t> pixels(randomPixels(width));
+        const int num_words = (width + 31) / 32;
+        std::vector<uint32_t> control_words(num_words + 1, 0xdeadbeef);
+        std::vector<uint32_t> binary_words(num_words + 1, 0xdeadbeef);
+        scalar().rgb32ToBinary(pixels.data(), control_words.data(), width, threshold);
+        conv.rgb32ToBinary(pixels.data(), binary_words.data(), width, threshold);
+        BOOST_REQUIRE(binary_words == control_words);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_invert_gray) {
+  std::vector<uint8_t> line(256 + 64);
+  for (size_t i = 0; i < line.size(); ++i) {
+    line[i] = static_cast<uint8_t>(i);
+  }
+
+  for (const SimdLevel level : levelsToTest()) {
+    const ScanlineConverter& conv = ScanlineConverter::forLevel(level);
+    for (int offset = 0; offset < 64; ++offset) {
+      const int width = 256;
+      std::vector<uint8_t> inverted(width + 1, 0xaa);
+      conv.invertGray(&line[offset], inverted.data(), width);
+      for (int x = 0; x < width; ++x) {
+        BOOST_REQUIRE_EQUAL(inverted[x], 255 - line[offset + x]);
+      }
+      BOOST_REQUIRE_EQUAL(inverted[width], 0xaa);
+    }
+
+    // In place.
+    std::vector<uint8_t> copy(line);
+    conv.invertGray(copy.data(), copy.data(), static_cast<int>(copy.size()));
+    for (size_t i = 0; i < line.size(); ++i) {
+      BOOST_REQUIRE_EQUAL(copy[i], 255 - line[i]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_packing) {
+  for (const int width : widths) {
+    const std::vector<uint32_t> pixels(randomPixels(width));
+
+    std::vector<uint8_t> control_rgb(width * 3 + 1, 0xaa);
+    std::vector<uint8_t> control_rgba(width * 4 + 1, 0xaa);
+    scalar().rgb32ToRgb24(pixels.data(), control_rgb.data(), width);
+    scalar().argb32ToRgba32(pixels.data(), control_rgba.data(), width);
+    for (int x = 0; x < width; ++x) {
+      BOOST_REQUIRE_EQUAL(control_rgb[x * 3], qRed(pixels[x]));
+      BOOST_REQUIRE_EQUAL(control_rgb[x * 3 + 1], qGreen(pixels[x]));
+      BOOST_REQUIRE_EQUAL(control_rgb[x * 3 + 2], qBlue(pixels[x]));
+      BOOST_REQUIRE_EQUAL(control_rgba[x * 4], qRed(pixels[x]));
+      BOOST_REQUIRE_EQUAL(control_rgba[x * 4 + 1], qGreen(pixels[x]));
+      BOOST_REQUIRE_EQUAL(control_rgba[x * 4 + 2], qBlue(pixels[x]));
+      BOOST_REQUIRE_EQUAL(control_rgba[x * 4 + 3], qAlpha(pixels[x]));
+    }
+
+    for (const SimdLevel level : levelsToTest()) {
+      const ScanlineConverter& conv = ScanlineConverter::forLevel(level);
+      std::vector<uint8_t> rgb(width * 3 + 1, 0xaa);
+      std::vector<uint8_t> rgba(width * 4 + 1, 0xaa);
+      conv.rgb32ToRgb24(pixels.data(), rgb.data(), width);
+      conv.argb32ToRgba32(pixels.data(), rgba.data(), width);
+      // Also makes sure the byte past the end is untouched.
+      BOOST_REQUIRE(rgb == control_rgb);
+      BOOST_REQUIRE(rgba == control_rgba);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace tests
+}  // namespace imageproc
@@ -18,12 +18,15 @@
 
 #include <QImage>
 #include <QPoint>
+#include <QRect>
 #include <QSize>
 #include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
 #include "BWColor.h"
 #include "BinaryImage.h"
 #include "Connectivity.h"
 #include "Grayscale.h"
+#include "RasterOp.h"
 #include "SeedFill.h"
 #include "Utils.h"
 
@@ -94,6 +97,104 @@ BOOST_AUTO_TEST_CASE(test_regression_4) {
   BOOST_REQUIRE(seedFill(seed, mask, CONN4) == fill);
 }
 
+BOOST_AUTO_TEST_CASE(test_regression_5) {
+  // A diagonal link between words.
+  int seed_data[33 * 2] = {0};
+  int mask_data[33 * 2] = {0};
+
+  seed_data[31] = 1;
+
+  mask_data[31] = 1;
+  mask_data[33 + 32] = 1;
+
+  const BinaryImage seed(makeBinaryImage(seed_data, 33, 2));
+  const BinaryImage mask(makeBinaryImage(mask_data, 33, 2));
+  BOOST_CHECK(seedFill(seed, mask, CONN8) == mask);
+  BOOST_CHECK(seedFillSlow(seed, mask, CONN8) == mask);
+}
+
+namespace {
+/**
+ * Black pixels making up large connected components.
+ */
+BinaryImage randomDenseBinaryImage(const int width, const int height) {
+  BinaryImage img(randomBinaryImage(width, height));
+  rasterOp<RopOr<RopSrc, RopDst>>(img, randomBinaryImage(width, height));
+
+  return img;
+}
+
+/**
+ * Black pixels here and there.
+ */
+BinaryImage randomSparseBinaryImage(const int width, const int height) {
+  BinaryImage img(randomBinaryImage(width, height));
+  for (int i = 0; i < 4; ++i) {
+    rasterOp<RopAnd<RopSrc, RopDst>>(img, randomBinaryImage(width, height));
+  }
+
+  return img;
+}
+
+bool fillsMatch(const BinaryImage& seed, const BinaryImage& mask, const Connectivity connectivity) {
+  return seedFill(seed, mask, connectivity) == seedFillSlow(seed, mask, connectivity);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(test_binary_random) {
+  for (int i = 0; i < 300; ++i) {
+    const int width = 1 + std::rand() % 100;
+    const int height = 1 + std::rand() % 40;
+    const BinaryImage seed(randomSparseBinaryImage(width, height));
+    const BinaryImage mask(randomDenseBinaryImage(width, height));
+    BOOST_REQUIRE(fillsMatch(seed, mask, CONN4));
+    BOOST_REQUIRE(fillsMatch(seed, mask, CONN8));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_bands) {
+  // Down to bands of a single line.
+  for (const int num_bands : {2, 3, 8, 40}) {
+    for (int i = 0; i < 50; ++i) {
+      const int width = 1 + std::rand() % 100;
+      const int height = 1 + std::rand() % 40;
+      const BinaryImage seed(randomSparseBinaryImage(width, height));
+      const BinaryImage mask(randomDenseBinaryImage(width, height));
+      BOOST_REQUIRE(seedFill(seed, mask, CONN4, num_bands) == seedFillSlow(seed, mask, CONN4));
+      BOOST_REQUIRE(seedFill(seed, mask, CONN8, num_bands) == seedFillSlow(seed, mask, CONN8));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_large) {
+  // Large enough to be split into bands by default.  The number of bands is also
+  // set explicitly, so that the exchange between them gets tested on any machine.
+  const int num_bands_to_test[] = {0, 2, 3, 8};
+
+  const BinaryImage seed(randomSparseBinaryImage(1500, 3000));
+  const BinaryImage mask(randomDenseBinaryImage(1500, 3000));
+  const BinaryImage fill4(seedFillSlow(seed, mask, CONN4));
+  const BinaryImage fill8(seedFillSlow(seed, mask, CONN8));
+  for (const int num_bands : num_bands_to_test) {
+    BOOST_REQUIRE(seedFill(seed, mask, CONN4, num_bands) == fill4);
+    BOOST_REQUIRE(seedFill(seed, mask, CONN8, num_bands) == fill8);
+  }
+
+  // A path crossing the bands back and forth.
+  BinaryImage snake(1500, 3000, WHITE);
+  for (int x = 0; x < snake.width(); x += 4) {
+    snake.fill(QRect(x, 1, 1, snake.height() - 2), BLACK);
+    const int y = ((x / 4) % 2 == 0) ? snake.height() - 2 : 1;
+    snake.fill(QRect(x, y, 4, 1).intersected(snake.rect()), BLACK);
+  }
+  BinaryImage snake_seed(snake.size(), WHITE);
+  snake_seed.fill(QRect(0, 10, 1, 1), BLACK);
+  for (const int num_bands : num_bands_to_test) {
+    BOOST_REQUIRE(seedFill(snake_seed, snake, CONN4, num_bands) == snake);
+    BOOST_REQUIRE(seedFill(snake_seed, snake, CONN8, num_bands) == snake);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(test_gray4_random) {
   for (int i = 0; i < 200; ++i) {
     const GrayImage seed(randomGrayImage(5, 5));
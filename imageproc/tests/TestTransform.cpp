@@ -18,10 +18,12 @@
 
 #include <QImage>
 #include <QSize>
+#include <QTransform>
 #include <boost/test/auto_unit_test.hpp>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <vector>
 #include "Grayscale.h"
 #include "Transform.h"
 #include "Utils.h"
@@ -30,6 +32,26 @@ namespace imageproc {
 namespace tests {
 using namespace utils;
 
+namespace {
+bool insideAny(const std::vector<QRect>& areas, const QPoint& pt) {
+  for (const QRect& area : areas) {
+    if (area.contains(pt)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+QTransform rotateAndScale() {
+  QTransform xform;
+  xform.rotate(7.0);
+  xform.scale(1.3, 0.8);
+
+  return xform;
+}
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(TransformTestSuite);
 
 BOOST_AUTO_TEST_CASE(test_null_image) {
@@ -58,6 +80,67 @@ BOOST_AUTO_TEST_CASE(test_random_image) {
   BOOST_CHECK(transformToGray(img, null_xform, img.rect(), outside_pixels) == img);
 }
 
+BOOST_AUTO_TEST_CASE(test_areas_match_full_transform) {
+  QImage src(QSize(60, 50), QImage::Format_RGB32);
+  for (int y = 0; y < src.height(); ++y) {
+    for (int x = 0; x < src.width(); ++x) {
+      src.setPixel(x, y, qRgb(rand() % 256, rand() % 256, rand() % 256));
+    }
+  }
+
+  const QTransform xform(rotateAndScale());
+  const QRect dst_rect(-5, 3, 70, 40);
+  const OutsidePixels outside_pixels(OutsidePixels::assumeColor(QColor(0x10, 0x20, 0x30)));
+  const std::vector<QRect> areas{QRect(3, 4, 10, 7), QRect(20, -5, 5, 60), QRect(65, 35, 20, 20)};
+  const QRgb untouched = qRgb(0x12, 0x34, 0x56);
+
+  const QImage full(transform(src, xform, dst_rect, outside_pixels));
+  QImage partial(dst_rect.size(), QImage::Format_RGB32);
+  partial.fill(untouched);
+  transformAreas(src, partial, xform, dst_rect, areas, outside_pixels);
+  for (int y = 0; y < full.height(); ++y) {
+    for (int x = 0; x < full.width(); ++x) {
+      const QRgb expected = insideAny(areas, QPoint(x, y)) ? full.pixel(x, y) : untouched;
+      BOOST_REQUIRE_EQUAL(partial.pixel(x, y), expected);
+    }
+  }
+
+  // A destination transform() wouldn't produce gets replaced altogether.
+  QImage mismatching(dst_rect.size(), QImage::Format_ARGB32);
+  transformAreas(src, mismatching, xform, dst_rect, areas, outside_pixels);
+  BOOST_CHECK(mismatching == full);
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_areas_match_full_transform) {
+  GrayImage src(QSize(40, 70));
+  uint8_t* line = src.data();
+  for (int y = 0; y < src.height(); ++y) {
+    for (int x = 0; x < src.width(); ++x) {
+      line[x] = static_cast<uint8_t>(rand() % 256);
+    }
+    line += src.stride();
+  }
+
+  const QTransform xform(rotateAndScale());
+  const QRect dst_rect(0, 0, 55, 60);
+  const OutsidePixels outside_pixels(OutsidePixels::assumeColor(QColor(0xff, 0x00, 0x00)));
+  const std::vector<QRect> areas{QRect(0, 0, 55, 3), QRect(30, 10, 8, 40)};
+  const uint8_t untouched = 77;
+
+  const GrayImage full(transformToGray(src, xform, dst_rect, outside_pixels));
+  GrayImage partial_gray(dst_rect.size());
+  partial_gray.fill(untouched);
+  QImage partial(partial_gray.toQImage());
+  partial_gray = GrayImage();
+  transformAreasToGray(src, partial, xform, dst_rect, areas, outside_pixels);
+  for (int y = 0; y < full.height(); ++y) {
+    for (int x = 0; x < full.width(); ++x) {
+      const uint8_t expected = insideAny(areas, QPoint(x, y)) ? full.data()[y * full.stride() + x] : untouched;
+      BOOST_REQUIRE_EQUAL(partial.constScanLine(y)[x], expected);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 }  // namespace tests
 }  // namespace imageproc
\ No newline at end of file
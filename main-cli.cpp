@@ -18,8 +18,10 @@
  */
 
 #include <QCoreApplication>
+#include <imageproc/ImageBufferAllocator.h>
 #include <iostream>
 
+#include "CliDaemon.h"
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
 
@@ -42,6 +44,25 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if (cli.hasSpillDirectory()) {
+    if (cli.hasSpillThreshold()) {
+      imageproc::ImageBufferAllocator::setSpillThreshold(cli.getSpillThreshold());
+    }
+    imageproc::ImageBufferAllocator::setSpillDirectory(cli.getSpillDirectory());
+  }
+
+  if (cli.hasDaemon()) {
+    CliDaemon cli_daemon;
+    QString error;
+    if (!cli_daemon.listen(cli.getDaemonSocket(), &error)) {
+      std::cerr << error.toStdString() << std::endl;
+
+      return 1;
+    }
+
+    return app.exec();
+  }
+
   if (cli.hasHelp() || cli.outputDirectory().isEmpty() || ((cli.images().size() == 0) && cli.projectFile().isEmpty())) {
     cli.printHelp();
 
@@ -0,0 +1,102 @@
+
+#include "BandedCholesky.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+BandedCholesky::BandedCholesky() : m_size(0), m_bandwidth(0) {}
+
+size_t BandedCholesky::calcBandwidth(const double* a, const size_t n, const size_t lda) {
+  size_t bandwidth = 0;
+  for (size_t col = 0; col < n; ++col) {
+    const double* col_data = a + col * lda;
+    // Scan the lower triangle of this column from the bottom up.
+    for (size_t row = n - 1; row > col + bandwidth; --row) {
+      if ((col_data[row] != 0.0) || (a[row * lda + col] != 0.0)) {
+        bandwidth = row - col;
+        break;
+      }
+    }
+  }
+
+  return bandwidth;
+}
+
+bool BandedCholesky::factorize(const MatT<double>& a) {
+  assert(a.rows() == a.cols());
+
+  const size_t n = a.rows();
+
+  return factorize(a.data(), n, n, calcBandwidth(a.data(), n, n));
+}
+
+bool BandedCholesky::factorize(const double* a, const size_t n, const size_t lda, size_t bandwidth) {
+  if (n > 0) {
+    bandwidth = std::min(bandwidth, n - 1);
+  }
+  const size_t row_size = bandwidth + 1;
+
+  // Same as in LinearSolver.
+  const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+
+  m_size = 0;
+  m_bandwidth = bandwidth;
+  m_L.assign(n * row_size, 0.0);
+
+  for (size_t i = 0; i < n; ++i) {
+    // row_i[j] is L(i, j) for j in [first_col, i].
+    double* const row_i = &m_L[i * bandwidth + bandwidth];
+    const size_t first_col = (i > bandwidth) ? i - bandwidth : 0;
+
+    for (size_t j = first_col; j <= i; ++j) {
+      const double* const row_j = &m_L[j * bandwidth + bandwidth];
+
+      double sum = a[j * lda + i];
+      for (size_t k = first_col; k < j; ++k) {
+        sum -= row_i[k] * row_j[k];
+      }
+
+      if (j == i) {
+        if (!(sum > epsilon)) {
+          return false;
+        }
+        row_i[i] = std::sqrt(sum);
+      } else {
+        row_i[j] = sum / row_j[j];
+      }
+    }
+  }
+
+  m_size = n;
+
+  return true;
+}  // BandedCholesky::factorize
+
+void BandedCholesky::solve(double* x) const {
+  const size_t n = m_size;
+  const size_t bandwidth = m_bandwidth;
+
+  // Solve L * y = b.
+  for (size_t i = 0; i < n; ++i) {
+    const double* const row_i = &m_L[i * bandwidth + bandwidth];
+    const size_t first_col = (i > bandwidth) ? i - bandwidth : 0;
+
+    double sum = x[i];
+    for (size_t k = first_col; k < i; ++k) {
+      sum -= row_i[k] * x[k];
+    }
+    x[i] = sum / row_i[i];
+  }
+
+  // Solve L^T * x = y.
+  for (size_t i = n; i-- > 0;) {
+    const size_t last_row = std::min(n - 1, i + bandwidth);
+
+    double sum = x[i];
+    for (size_t k = i + 1; k <= last_row; ++k) {
+      sum -= m_L[k * bandwidth + bandwidth + i] * x[k];
+    }
+    x[i] = sum / m_L[i * bandwidth + bandwidth + i];
+  }
+}
@@ -0,0 +1,77 @@
+
+#ifndef SCANTAILOR_BANDEDCHOLESKY_H
+#define SCANTAILOR_BANDEDCHOLESKY_H
+
+#include <cstddef>
+#include <vector>
+#include "MatT.h"
+
+/**
+ * \brief Solves Ax = b for symmetric positive definite banded matrices
+ *        using Cholesky decomposition.
+ *
+ * Only the elements within the band are ever touched, so factorizing
+ * a NxN matrix with bandwidth W takes O(N*W^2) operations rather than O(N^3).
+ * The storage for the factor is kept between factorizations, so reusing
+ * the same object for a series of equally sized systems doesn't allocate.
+ *
+ * \note All matrices are assumed to be in column-major order.
+ */
+class BandedCholesky {
+  // Member-wise copying is OK.
+ public:
+  BandedCholesky();
+
+  /**
+   * \brief Returns the largest distance from the main diagonal to a non-zero element
+   *        of a square matrix.
+   *
+   * \param a The matrix data in column-major order.
+   * \param n The number of rows and columns to consider.
+   * \param lda The distance between columns in \p a.
+   */
+  static size_t calcBandwidth(const double* a, size_t n, size_t lda);
+
+  /**
+   * \brief Factorizes a symmetric matrix, detecting its bandwidth.
+   *
+   * \return false if the matrix is not positive definite, in which
+   *         case solve() must not be called.
+   */
+  bool factorize(const MatT<double>& a);
+
+  /**
+   * \brief Factorizes the top-left NxN submatrix of a symmetric matrix.
+   *
+   * Only the lower triangle within the given bandwidth is read.
+   *
+   * \return false if the matrix is not positive definite, in which
+   *         case solve() must not be called.
+   */
+  bool factorize(const double* a, size_t n, size_t lda, size_t bandwidth);
+
+  /**
+   * \brief Solves Ax = b in place, using the last successful factorization.
+   *
+   * \param x On input, the vector b.  On output, the vector x.
+   */
+  void solve(double* x) const;
+
+  size_t size() const { return m_size; }
+
+  size_t bandwidth() const { return m_bandwidth; }
+
+ private:
+  size_t m_size;
+  size_t m_bandwidth;
+
+  /**
+   * The lower triangular factor L, stored row by row, bandwidth + 1 elements
+   * per row, so that L(i, j) is m_L[i * bandwidth + bandwidth + j].
+   * The elements preceding the first column are unused.
+   */
+  std::vector<double> m_L;
+};
+
+
+#endif  // SCANTAILOR_BANDEDCHOLESKY_H
@@ -18,6 +18,7 @@
 
 #include "Optimizer.h"
 #include <boost/foreach.hpp>
+#include <algorithm>
 #include "MatrixCalc.h"
 
 namespace spfit {
@@ -102,25 +103,29 @@ OptimizationResult Optimizer::optimize(double internal_force_weight) {
   m_internalForce += m_externalForce;
 
   // For the layout of m_A and m_b, see setConstraints()
-  const QuadraticFunction::Gradient grad(m_internalForce.gradient());
+  // The gradient is written in place, see QuadraticFunction::gradient().
+  const QuadraticFunction& f = m_internalForce;
   for (size_t i = 0; i < m_numVars; ++i) {
-    m_b[i] = -grad.b[i];
+    m_b[i] = -f.b[i];
     for (size_t j = 0; j < m_numVars; ++j) {
-      m_A(i, j) = grad.A(i, j);
+      m_A(i, j) = f.A(i, j) + f.A(j, i);
     }
   }
 
   const double total_force_before = m_internalForce.c;
-  DynamicMatrixCalc<double> mc;
 
-  try {
-    mc(m_A).solve(mc(m_b)).write(m_x.data());
-  } catch (const std::runtime_error&) {
-    m_externalForce.reset();
-    m_internalForce.reset();
-    m_x.fill(0);  // To make undoLastStep() work as expected.
+  if (!solveBanded()) {
+    DynamicMatrixCalc<double> mc;
 
-    return OptimizationResult(total_force_before, total_force_before);
+    try {
+      mc(m_A).solve(mc(m_b)).write(m_x.data());
+    } catch (const std::runtime_error&) {
+      m_externalForce.reset();
+      m_internalForce.reset();
+      m_x.fill(0);  // To make undoLastStep() work as expected.
+
+      return OptimizationResult(total_force_before, total_force_before);
+    }
   }
 
   const double total_force_after = m_internalForce.evaluate(m_x.data());
@@ -133,6 +138,84 @@ OptimizationResult Optimizer::optimize(double internal_force_weight) {
   return OptimizationResult(total_force_before, total_force_after);
 }  // Optimizer::optimize
 
+bool Optimizer::solveBanded() {
+  // Control points of a spline only affect its nearby segments, so the
+  // non-constraint part of m_A (see setConstraints()) tends to be banded.
+  // We solve
+  // |H C^T| |x|   |-D|
+  // |C  0 | |L| = |-J|
+  // as H * x0 = -D, H * Y = C^T, (C * Y) * L = C * x0 + J, x = x0 - Y * L.
+  const size_t num_vars = m_numVars;
+  const size_t num_constraints = m_b.size() - num_vars;
+  const size_t lda = m_A.rows();
+
+  const size_t bandwidth = BandedCholesky::calcBandwidth(m_A.data(), num_vars, lda);
+  if (bandwidth * 2 >= num_vars) {
+    // The dense solver will do just as well.
+    return false;
+  }
+  if (!m_cholesky.factorize(m_A.data(), num_vars, lda, bandwidth)) {
+    return false;
+  }
+
+  double* const x = m_x.data();
+  std::copy(m_b.data(), m_b.data() + num_vars, x);
+  m_cholesky.solve(x);
+
+  if (num_constraints == 0) {
+    return true;
+  }
+
+  m_constraintSolutions.resize(num_vars * num_constraints);
+  for (size_t k = 0; k < num_constraints; ++k) {
+    double* const y = &m_constraintSolutions[k * num_vars];
+    for (size_t j = 0; j < num_vars; ++j) {
+      y[j] = m_A(num_vars + k, j);
+    }
+    m_cholesky.solve(y);
+  }
+
+  if ((m_schurComplement.rows() != num_constraints) || (m_schurComplement.cols() != num_constraints)) {
+    MatT<double>(num_constraints, num_constraints).swap(m_schurComplement);
+    VecT<double>(num_constraints).swap(m_schurRhs);
+  }
+  for (size_t k = 0; k < num_constraints; ++k) {
+    double rhs = -m_b[num_vars + k];
+    for (size_t j = 0; j < num_vars; ++j) {
+      rhs += m_A(num_vars + k, j) * x[j];
+    }
+    m_schurRhs[k] = rhs;
+
+    for (size_t l = 0; l < num_constraints; ++l) {
+      const double* const y = &m_constraintSolutions[l * num_vars];
+      double sum = 0.0;
+      for (size_t j = 0; j < num_vars; ++j) {
+        sum += m_A(num_vars + k, j) * y[j];
+      }
+      m_schurComplement(k, l) = sum;
+    }
+  }
+
+  // Lagrange multipliers go to the tail of m_x, just like with the dense solver.
+  double* const multipliers = x + num_vars;
+  try {
+    DynamicMatrixCalc<double> mc;
+    mc(m_schurComplement).solve(mc(m_schurRhs)).write(multipliers);
+  } catch (const std::runtime_error&) {
+    return false;
+  }
+
+  for (size_t l = 0; l < num_constraints; ++l) {
+    const double* const y = &m_constraintSolutions[l * num_vars];
+    const double multiplier = multipliers[l];
+    for (size_t j = 0; j < num_vars; ++j) {
+      x[j] -= y[j] * multiplier;
+    }
+  }
+
+  return true;
+}  // Optimizer::solveBanded
+
 void Optimizer::undoLastStep() {
   adjustConstraints(-1.0);
   m_x.fill(0);
@@ -21,6 +21,7 @@
 
 #include <list>
 #include <vector>
+#include "BandedCholesky.h"
 #include "FittableSpline.h"
 #include "LinearFunction.h"
 #include "MatT.h"
@@ -84,12 +85,25 @@ class Optimizer {
  private:
   void adjustConstraints(double direction);
 
+  /**
+   * Solves the system described by m_A and m_b by factorizing the banded
+   * part of it and eliminating the constraints through the Schur complement.
+   * Returns false if the banded part is too wide or not positive definite.
+   */
+  bool solveBanded();
+
   size_t m_numVars;
   MatT<double> m_A;
   VecT<double> m_b;
   VecT<double> m_x;
   QuadraticFunction m_externalForce;
   QuadraticFunction m_internalForce;
+
+  // Workspaces for solveBanded(), reused across iterations.
+  BandedCholesky m_cholesky;
+  std::vector<double> m_constraintSolutions;
+  MatT<double> m_schurComplement;
+  VecT<double> m_schurRhs;
 };
 
 
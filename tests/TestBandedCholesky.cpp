@@ -0,0 +1,96 @@
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <cstdlib>
+#include "BandedCholesky.h"
+#include "MatrixCalc.h"
+#include "VecT.h"
+
+namespace Tests {
+namespace {
+/**
+ * Builds a random symmetric, diagonally dominant (and therefore positive definite)
+ * matrix with the given bandwidth.
+ */
+MatT<double> randomBandedMatrix(const size_t n, const size_t bandwidth) {
+  MatT<double> mat(n, n);
+  for (size_t i = 0; i < n; ++i) {
+    mat(i, i) = 2.0 * bandwidth + 1.0 + (std::rand() % 100) / 100.0;
+    for (size_t j = i + 1; j <= i + bandwidth && j < n; ++j) {
+      mat(i, j) = mat(j, i) = (std::rand() % 200) / 100.0 - 1.0;
+    }
+  }
+
+  return mat;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(BandedCholeskyTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_bandwidth) {
+  MatT<double> mat(5, 5);
+  BOOST_CHECK_EQUAL(BandedCholesky::calcBandwidth(mat.data(), 5, 5), 0u);
+
+  mat(0, 0) = 1.0;
+  mat(3, 1) = 1.0;
+  BOOST_CHECK_EQUAL(BandedCholesky::calcBandwidth(mat.data(), 5, 5), 2u);
+
+  // The upper triangle counts as well.
+  mat(0, 4) = 1.0;
+  BOOST_CHECK_EQUAL(BandedCholesky::calcBandwidth(mat.data(), 5, 5), 4u);
+
+  // Only the top-left submatrix is considered.
+  BOOST_CHECK_EQUAL(BandedCholesky::calcBandwidth(mat.data(), 4, 5), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(test_matches_dense_solver) {
+  std::srand(0);
+
+  BandedCholesky cholesky;
+  for (size_t n = 1; n < 40; n += 3) {
+    for (size_t bandwidth = 0; bandwidth < n; bandwidth += 2) {
+      const MatT<double> A(randomBandedMatrix(n, bandwidth));
+      VecT<double> b(n);
+      for (size_t i = 0; i < n; ++i) {
+        b[i] = (std::rand() % 1000) / 100.0 - 5.0;
+      }
+
+      VecT<double> control(n);
+      DynamicMatrixCalc<double> mc;
+      mc(A).solve(mc(b)).write(control.data());
+
+      BOOST_REQUIRE(cholesky.factorize(A));
+      BOOST_REQUIRE_EQUAL(cholesky.bandwidth(), bandwidth);
+
+      VecT<double> x(b);
+      cholesky.solve(x.data());
+      for (size_t i = 0; i < n; ++i) {
+        BOOST_REQUIRE_SMALL(x[i] - control[i], 1e-9);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_submatrix) {
+  // A 3x3 system embedded into the top-left corner of a 4x4 matrix.
+  static const double A[] = {4, 1, 0, 9, 1, 4, 1, 9, 0, 1, 4, 9, 9, 9, 9, 9};
+  double x[] = {5, 6, 5};
+
+  BandedCholesky cholesky;
+  BOOST_REQUIRE(cholesky.factorize(A, 3, 4, 1));
+  cholesky.solve(x);
+  for (double val : x) {
+    BOOST_CHECK_CLOSE(val, 1.0, 1e-9);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_not_positive_definite) {
+  static const double indefinite[] = {1, 2, 2, 1};
+  static const double singular[] = {1, 1, 1, 1};
+
+  BandedCholesky cholesky;
+  BOOST_CHECK(!cholesky.factorize(indefinite, 2, 2, 1));
+  BOOST_CHECK(!cholesky.factorize(singular, 2, 2, 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
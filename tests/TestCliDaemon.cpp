@@ -0,0 +1,85 @@
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <boost/test/auto_unit_test.hpp>
+#include <map>
+#include "CliDaemon.h"
+
+namespace Tests {
+namespace {
+QByteArray jobLine(const QString& id, const QString& image, const QString& output, const QJsonObject& options) {
+  const QJsonObject job{{"id", id}, {"images", QJsonArray{image}}, {"output", output}, {"options", options}};
+
+  return QJsonDocument(job).toJson(QJsonDocument::Compact) + '\n';
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(CliDaemonTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_bad_job_fails_alone) {
+  int argc = 1;
+  char arg0[] = "daemon_tests";
+  char* argv[] = {arg0, nullptr};
+  QCoreApplication app(argc, argv);
+
+  QTemporaryDir dir;
+  BOOST_REQUIRE(dir.isValid());
+  const QString image(dir.filePath("page.png"));
+  QImage page(400, 600, QImage::Format_RGB32);
+  page.fill(Qt::white);
+  BOOST_REQUIRE(page.save(image));
+  const QString output(dir.filePath("out"));
+  const QString rejected_output(dir.filePath("rejected/out"));
+
+  const QString socket_name(QString("scantailor-daemon-test-%1").arg(QCoreApplication::applicationPid()));
+  CliDaemon daemon;
+  QString error;
+  BOOST_REQUIRE_MESSAGE(daemon.listen(socket_name, &error), error.toStdString());
+
+  QLocalSocket client;
+  client.connectToServer(socket_name);
+  BOOST_REQUIRE(client.waitForConnected(5000));
+
+  // Options that used to make the whole process exit, followed by a good job.
+  client.write(jobLine("bad-orientation", image, rejected_output, {{"orientation", "sideways"}}));
+  client.write(jobLine("bad-content-box", image, rejected_output, {{"content-box", "everything"}}));
+  client.write(jobLine("good", image, output, {{"dpi", 300}, {"end-filter", 1}}));
+  client.flush();
+
+  std::map<QString, QJsonObject> outcomes;
+  QEventLoop loop;
+  QObject::connect(&client, &QLocalSocket::readyRead, [&]() {
+    while (client.canReadLine()) {
+      const QJsonObject message(QJsonDocument::fromJson(client.readLine()).object());
+      const QString event(message.value("event").toString());
+      if ((event == "finished") || (event == "failed")) {
+        outcomes[message.value("id").toString()] = message;
+      }
+    }
+    if (outcomes.size() == 3) {
+      loop.quit();
+    }
+  });
+  QTimer::singleShot(120000, &loop, &QEventLoop::quit);
+  loop.exec();
+
+  BOOST_REQUIRE_EQUAL(outcomes.size(), 3);
+  BOOST_CHECK_EQUAL(outcomes["bad-orientation"].value("event").toString().toStdString(), "failed");
+  BOOST_CHECK(outcomes["bad-orientation"].value("error").toString().contains("orientation"));
+  BOOST_CHECK_EQUAL(outcomes["bad-content-box"].value("event").toString().toStdString(), "failed");
+  BOOST_CHECK(outcomes["bad-content-box"].value("error").toString().contains("content-box"));
+  BOOST_CHECK_EQUAL(outcomes["good"].value("event").toString().toStdString(), "finished");
+  // The rejected jobs don't leave their output directories behind.
+  BOOST_CHECK(!QFileInfo::exists(dir.filePath("rejected")));
+  BOOST_CHECK(QFileInfo(output).isDir());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
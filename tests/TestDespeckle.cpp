@@ -0,0 +1,101 @@
+#include <QRect>
+#include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
+#include "Despeckle.h"
+#include "Dpi.h"
+#include "EmptyTaskStatus.h"
+#include "imageproc/BinaryImage.h"
+
+namespace Tests {
+using namespace imageproc;
+
+namespace {
+const int PAGE_WIDTH = 36;
+const int PAGE_HEIGHT = 8;
+
+QRect placed(const QRect& rect, const bool mirrored) {
+  if (!mirrored) {
+    return rect;
+  }
+
+  return QRect(PAGE_WIDTH - rect.x() - rect.width(), rect.y(), rect.width(), rect.height());
+}
+
+/**
+ * A big corner-shaped object on the right, a mid-sized blob and a dot on the left,
+ * and a far away dot on top.  The blob and the dot next to it are close enough
+ * to the big object to be kept, the dot on top isn't.
+ */
+BinaryImage page(const bool mirrored, const bool with_far_dot) {
+  BinaryImage image(PAGE_WIDTH, PAGE_HEIGHT, WHITE);
+  image.fill(placed(QRect(24, 0, 11, 1), mirrored), BLACK);
+  image.fill(placed(QRect(35, 1, 1, 5), mirrored), BLACK);
+  image.fill(placed(QRect(0, 3, 1, 1), mirrored), BLACK);
+  image.fill(placed(QRect(2, 4, 4, 1), mirrored), BLACK);
+  image.fill(placed(QRect(0, 5, 6, 3), mirrored), BLACK);
+  if (with_far_dot) {
+    image.fill(placed(QRect(16, 0, 1, 1), mirrored), BLACK);
+  }
+
+  return image;
+}
+
+/**
+ * A few text-sized blobs surrounded by speckles of different sizes.
+ */
+BinaryImage randomPage(const int width, const int height) {
+  BinaryImage image(width, height, WHITE);
+  for (int i = 0; i < 300; ++i) {
+    const bool blob = (i % 10 == 0);
+    const int w = 1 + std::rand() % (blob ? 40 : 4);
+    const int h = 1 + std::rand() % (blob ? 30 : 4);
+    image.fill(QRect(std::rand() % width, std::rand() % height, w, h), BLACK);
+  }
+
+  return image;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(DespeckleTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_mirrored_page) {
+  // Component tagging used to compare sizes with the tag bits set, so the result
+  // depended on the order the components were visited in.  Here the blob on the left
+  // and the dot next to it were removed from the original page but kept on the mirrored one.
+  const Dpi dpi(300, 300);
+  const EmptyTaskStatus status;
+  for (const bool mirrored : {false, true}) {
+    const BinaryImage expected(page(mirrored, false));
+    BOOST_CHECK(Despeckle::despeckle(page(mirrored, true), dpi, Despeckle::NORMAL, status) == expected);
+
+    BinaryImage image(page(mirrored, true));
+    Despeckle::despeckleInPlace(image, dpi, Despeckle::NORMAL, status);
+    BOOST_CHECK(image == expected);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_analysis_matches_despeckle) {
+  std::srand(1);
+  const Dpi dpi(300, 300);
+  const EmptyTaskStatus status;
+  for (int i = 0; i < 5; ++i) {
+    const BinaryImage image(randomPage(320, 240));
+    const Despeckle::Analysis analysis(image, dpi, status);
+
+    for (const double level : {1.0, 1.7, 2.0, 2.5, 3.0}) {
+      BOOST_CHECK(analysis.despeckle(level, status) == Despeckle::despeckle(image, dpi, level, status));
+    }
+    for (const Despeckle::Level level : {Despeckle::CAUTIOUS, Despeckle::NORMAL, Despeckle::AGGRESSIVE}) {
+      BOOST_CHECK(analysis.despeckle(level, status) == Despeckle::despeckle(image, dpi, level, status));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_white_image) {
+  const BinaryImage image(64, 64, WHITE);
+  const Despeckle::Analysis analysis(image, Dpi(300, 300), EmptyTaskStatus());
+  BOOST_CHECK(analysis.despeckle(Despeckle::NORMAL, EmptyTaskStatus()) == image);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
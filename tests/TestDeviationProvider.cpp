@@ -0,0 +1,98 @@
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include "DeviationProvider.h"
+
+namespace Tests {
+namespace {
+double naiveMean(const std::map<int, double>& values) {
+  double sum = 0.0;
+  for (const auto& kv : values) {
+    sum += kv.second;
+  }
+
+  return sum / values.size();
+}
+
+double naiveStdDev(const std::map<int, double>& values) {
+  const double mean = naiveMean(values);
+  double sum = 0.0;
+  for (const auto& kv : values) {
+    sum += (kv.second - mean) * (kv.second - mean);
+  }
+
+  return std::sqrt(sum / (values.size() - 1));
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(DeviationProviderTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_deviation_value) {
+  DeviationProvider<int> provider;
+  provider.addOrUpdate(1, 1.0);
+  BOOST_CHECK_EQUAL(provider.getDeviationValue(1), 0.0);
+
+  provider.addOrUpdate(2, 3.0);
+  provider.addOrUpdate(3, 5.0);
+  BOOST_CHECK_CLOSE(provider.getDeviationValue(1), 2.0, 1e-9);
+  BOOST_CHECK_SMALL(provider.getDeviationValue(2), 1e-9);
+
+  provider.addOrUpdate(3, 11.0);
+  BOOST_CHECK_CLOSE(provider.getDeviationValue(3), 6.0, 1e-9);
+
+  provider.remove(3);
+  BOOST_CHECK_CLOSE(provider.getDeviationValue(1), 1.0, 1e-9);
+  BOOST_CHECK_EQUAL(provider.getDeviationValue(3), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_matches_full_recalculation) {
+  DeviationProvider<int> provider;
+  std::map<int, double> control;
+
+  std::srand(0);
+  for (int i = 0; i < 5000; ++i) {
+    const int key = std::rand() % 200;
+    if (std::rand() % 4 == 0) {
+      provider.remove(key);
+      control.erase(key);
+    } else {
+      const double value = (std::rand() % 10000) / 100.0;
+      provider.addOrUpdate(key, value);
+      control[key] = value;
+    }
+
+    if ((i % 97 != 0) || (control.size() < 3)) {
+      continue;
+    }
+
+    const double mean = naiveMean(control);
+    const double std_dev = naiveStdDev(control);
+    for (const auto& kv : control) {
+      BOOST_REQUIRE_SMALL(provider.getDeviationValue(kv.first) - std::abs(kv.second - mean), 1e-6);
+
+      const double deviation = std::abs(kv.second - mean);
+      // Avoid the cases where rounding errors could flip the outcome.
+      if (std::abs(deviation - std_dev) > 1e-6) {
+        BOOST_REQUIRE_EQUAL(provider.isDeviant(kv.first), deviation > std_dev);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_clear) {
+  DeviationProvider<int> provider;
+  provider.addOrUpdate(1, 10.0);
+  provider.addOrUpdate(2, 20.0);
+  provider.clear();
+
+  provider.addOrUpdate(1, 1.0);
+  provider.addOrUpdate(2, 2.0);
+  provider.addOrUpdate(3, 3.0);
+  BOOST_CHECK_CLOSE(provider.getDeviationValue(3), 1.0, 1e-9);
+  BOOST_CHECK(!provider.isDeviant(2));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
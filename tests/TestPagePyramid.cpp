@@ -0,0 +1,116 @@
+#include <QImage>
+#include <QPainter>
+#include <QRectF>
+#include <QTransform>
+#include <algorithm>
+#include <boost/test/auto_unit_test.hpp>
+#include <cmath>
+#include <cstdlib>
+#include "PagePyramid.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/Constants.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/SkewFinder.h"
+
+namespace Tests {
+using namespace imageproc;
+
+namespace {
+/**
+ * Lines of word-like blocks, rotated clockwise by \p angle degrees,
+ * on a page scanned at 600 DPI.
+ */
+GrayImage textPage(const double angle) {
+  QImage image(2400, 3000, QImage::Format_RGB32);
+  image.fill(0xffffffff);
+  const int dpm = qRound(600 * constants::DPI2DPM);
+  image.setDotsPerMeterX(dpm);
+  image.setDotsPerMeterY(dpm);
+
+  {
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.translate(0.5 * image.width(), 0.5 * image.height());
+    painter.rotate(angle);
+    painter.translate(-0.5 * image.width(), -0.5 * image.height());
+
+    for (int y = 300; y < image.height() - 300; y += 80) {
+      for (int x = 250; x < image.width() - 250;) {
+        const int word_width = std::min(60 + (x * 7 + y * 13) % 180, image.width() - 250 - x);
+        painter.fillRect(QRectF(x, y, word_width, 30), Qt::black);
+        x += word_width + 35;
+      }
+    }
+  }
+
+  return GrayImage(image);
+}
+
+Skew findSkew(const BinaryImage& image) {
+  SkewFinder skew_finder;
+
+  return skew_finder.findSkew(image);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(PagePyramidTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_levels) {
+  const GrayImage page(textPage(0));
+  const PagePyramid pyramid(page);
+
+  QTransform orig_to_level;
+  const GrayImage level300(pyramid.grayLevel(300, &orig_to_level));
+  // DPI to DPM conversions may make it a pixel larger.
+  BOOST_CHECK(std::abs(level300.width() - page.width() / 2) <= 1);
+  BOOST_CHECK(std::abs(level300.height() - page.height() / 2) <= 1);
+  BOOST_CHECK(std::fabs(orig_to_level.m11() - 0.5) < 0.001);
+  BOOST_CHECK(std::fabs(orig_to_level.m22() - 0.5) < 0.001);
+  // Levels get built once.
+  BOOST_CHECK_EQUAL(pyramid.grayLevel(300).toQImage().cacheKey(), level300.toQImage().cacheKey());
+
+  // Never upscaled, and not scaled for less than 10%.
+  for (const int dpi : {560, 600, 1200}) {
+    BOOST_CHECK(pyramid.grayLevel(dpi, &orig_to_level) == page);
+    BOOST_CHECK(orig_to_level.isIdentity());
+  }
+
+  const BinaryThreshold threshold(128);
+  BOOST_CHECK(pyramid.binaryLevel(300, threshold) == BinaryImage(level300, threshold));
+
+  BOOST_CHECK_EQUAL(pyramid.darkestGrayLevel(), 0);
+  BOOST_CHECK_EQUAL(pyramid.lightestGrayLevel(), 255);
+}
+
+BOOST_AUTO_TEST_CASE(test_unknown_resolution) {
+  GrayImage page(QSize(300, 200));
+  page.fill(180);
+  page.data()[page.stride() * 50 + 70] = 20;
+  const PagePyramid pyramid(page);
+
+  QTransform orig_to_level;
+  BOOST_CHECK(pyramid.grayLevel(300, &orig_to_level) == page);
+  BOOST_CHECK(orig_to_level.isIdentity());
+  BOOST_CHECK_EQUAL(pyramid.darkestGrayLevel(), 20);
+  BOOST_CHECK_EQUAL(pyramid.lightestGrayLevel(), 180);
+}
+
+BOOST_AUTO_TEST_CASE(test_deskew_angle) {
+  // Deskew used to binarize the full resolution image, while it now gets the 300 DPI level.
+  const BinaryThreshold threshold(128);
+  for (const double angle : {-2.7, 1.3}) {
+    const GrayImage page(textPage(angle));
+    const PagePyramid pyramid(page);
+
+    const Skew full_res_skew(findSkew(BinaryImage(page, threshold)));
+    const Skew level_skew(findSkew(pyramid.binaryLevel(300, threshold)));
+    BOOST_CHECK(full_res_skew.confidence() >= Skew::GOOD_CONFIDENCE);
+    BOOST_CHECK(level_skew.confidence() >= Skew::GOOD_CONFIDENCE);
+    BOOST_CHECK(std::fabs(full_res_skew.angle() - angle) < 0.15);
+    BOOST_CHECK(std::fabs(level_skew.angle() - angle) < 0.15);
+    BOOST_CHECK(std::fabs(level_skew.angle() - full_res_skew.angle()) < 0.15);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests